@@ -0,0 +1,28 @@
+#ifndef __BATCH_RUNNER_H_
+#define __BATCH_RUNNER_H_
+
+// Runs many guest programs on headless computers spread across a pool of host
+// threads and reports the final state of each one.
+//
+// The manifest is a text file with one job per line:
+//
+//     <program file> cycles <count>
+//     <program file> instructions <count>
+//
+// Either can be followed by "frame <file>" to dump the screen once the job is
+// done, as a PPM image if the file ends in ".ppm" and raw RGBA bytes
+// otherwise, and by "capture <file> <cycles>" to record the screen as it
+// runs, taking a frame every <cycles> cycles (Y4M video if the file ends in
+// ".y4m", raw RGBA frames otherwise), and by "input <file>" to play the key
+// events in an input script into the keyboard as it runs (see
+// input_script.h). Blank lines and anything after a '#' are ignored. Program
+// files are raw little-endian 32-bit words that get loaded starting at
+// address 0.
+
+#include "computer.h"
+#include <stdio.h>
+
+//returns the number of jobs that failed, or -1 if the manifest couldn't be read
+int run_batch(const char* manifest_path, unsigned num_threads, execution_engine_t engine, FILE* output);
+
+#endif // __BATCH_RUNNER_H_
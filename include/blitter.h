@@ -0,0 +1,41 @@
+#ifndef __BLITTER_H_
+#define __BLITTER_H_
+
+#include "interrupt_controller.h"
+#include "memory_bus.h"
+#include "memory.h"
+#include "graphics.h"
+#include "scheduler.h"
+#include "state_file.h"
+
+//where each of the blitter's registers sits relative to the start of its
+//region in the memory map
+enum blitter_register_t
+{
+    BLITTER_CONTROL_REGISTER = 0,
+    BLITTER_COMMAND_REGISTER = 1,
+    BLITTER_SOURCE_REGISTER = 2,
+    BLITTER_DESTINATION_REGISTER = 3,
+    BLITTER_SIZE_REGISTER = 4,
+    BLITTER_COLOR_REGISTER = 5,
+};
+
+//writing one of these to the command register starts the operation
+enum blitter_command_t
+{
+    BLITTER_NO_COMMAND = 0,
+    BLITTER_FILL_RECT = 1,
+    BLITTER_COPY_RECT = 2,
+    BLITTER_COLOR_KEY_BLIT = 3,
+};
+
+typedef struct blitter_t blitter_t;
+
+blitter_t* make_blitter(uint8_t IRQ_number, graphics_t* graphics, memory_t* RAM, scheduler_t* scheduler, interrupt_controller_t* ic);
+void destroy_blitter(blitter_t* blitter);
+void blitter_reset(blitter_t* blitter);
+void blitter_cycle(blitter_t* blitter, memory_bus_t* bus, uint64_t cycle);
+void blitter_save_state(blitter_t* blitter, state_writer_t* writer, uint64_t cycle);
+void blitter_restore_state(blitter_t* blitter, state_reader_t* reader, uint64_t cycle);
+
+#endif // __BLITTER_H_
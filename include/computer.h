@@ -4,16 +4,47 @@
 #define __COMPUTER_H_
 
 #include <stdint.h>
+#include <stdbool.h>
 #include <stdlib.h>
 
 typedef struct computer_t computer_t;
 
+//The timing engine clocks the CPU one pipeline stage at a time and handshakes
+//with every device over the bus. The fast engine runs a whole instruction at a
+//time and talks to RAM directly, which is much quicker for software bring-up
+//but only approximates how many cycles things take. The JIT engine is the fast
+//engine with hot code translated to native host code (where the host supports
+//it).
+enum execution_engine_t { TIMING_ENGINE, FAST_ENGINE, JIT_ENGINE };
+typedef enum execution_engine_t execution_engine_t;
+
 computer_t* build_computer(void);
+computer_t* build_headless_computer(void);
+void destroy_computer(computer_t* computer);
 void computer_reset(computer_t* computer);
-void computer_load_program(computer_t* computer, uint32_t* program, size_t program_length);
+void computer_set_execution_engine(computer_t* computer, execution_engine_t engine);
+bool computer_load_program(computer_t* computer, uint32_t* program, size_t program_length);
 void computer_single_step(computer_t* computer);
+void computer_run_until_cycle(computer_t* computer, uint64_t cycle);
 void computer_run(computer_t* computer);
 
+uint64_t computer_get_elapsed_cycles(computer_t* computer);
+uint32_t computer_get_register(computer_t* computer, uint8_t register_number);
+uint32_t computer_get_pc(computer_t* computer);
+uint64_t computer_hash_memory(computer_t* computer);
+uint64_t computer_get_idle_cycles_skipped(computer_t* computer);
+size_t computer_get_resident_memory_pages(computer_t* computer);
+uint64_t computer_hash_frame_buffer(computer_t* computer);
+bool computer_dump_frame_buffer(computer_t* computer, const char* path);
+bool computer_start_capture(computer_t* computer, const char* path, uint64_t cycles_per_frame);
+bool computer_stop_capture(computer_t* computer);
+bool computer_load_input_script(computer_t* computer, const char* path);
+bool computer_start_recording(computer_t* computer, const char* path);
+bool computer_stop_recording(computer_t* computer);
+bool computer_replay_journal(computer_t* computer, const char* path, uint64_t* end_cycle);
+bool computer_save_state(computer_t* computer, const char* path, bool compress);
+bool computer_restore_state(computer_t* computer, const char* path);
+
 void dump_computer_cpu_state(computer_t* computer);
 void dump_computer_memory(computer_t* computer, size_t starting_address, size_t ending_address);
 void computer_print_elapsed_cycles(computer_t* computer);
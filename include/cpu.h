@@ -14,17 +14,43 @@
 #include <stdbool.h>
 #include "memory_bus.h"
 #include "interrupt_controller.h"
+#include "state_file.h"
 
 
 typedef struct cpu cpu_t;
 
+//The fast execution engine bypasses the bus and reads/writes memory through
+//these callbacks instead
+typedef uint32_t (*cpu_memory_read_t)(void* context, uint32_t address);
+typedef void (*cpu_memory_write_t)(void* context, uint32_t address, uint32_t value);
+
+//It can also ask for the host address of the page that holds a guest address
+//so that RAM can be read and written directly. Pages are CPU_PAGE_WORDS words
+//long and start on a multiple of CPU_PAGE_WORDS. Return NULL for any page
+//that isn't entirely plain RAM (i.e. memory-mapped devices), and don't move or
+//free a page that has been handed out until the cpu is reset.
+#define CPU_PAGE_OFFSET_BITS    (10)
+#define CPU_PAGE_WORDS          (1u << CPU_PAGE_OFFSET_BITS)
+typedef uint32_t* (*cpu_memory_translate_t)(void* context, uint32_t address);
+
 cpu_t* make_cpu(memory_bus_t* bus, interrupt_controller_t* ic);
 void cpu_reset(cpu_t* cpu);
 void init_cpu(cpu_t* cpu);
 void destroy_cpu(cpu_t* cpu);
 void cpu_cycle(cpu_t* cpu);
+void cpu_attach_memory_port(cpu_t* cpu, cpu_memory_read_t read, cpu_memory_write_t write, cpu_memory_translate_t translate, void* context);
+uint32_t cpu_run(cpu_t* cpu, uint32_t cycle_budget);
+uint32_t cpu_run_translated(cpu_t* cpu, uint32_t cycle_budget);
+uint32_t cpu_check_for_idle_loop(cpu_t* cpu, uint32_t cycle_limit, uint32_t* cycles_run);
 void cpu_load_program(cpu_t* cpu, uint32_t program[], size_t program_length);
+void cpu_flush_decoded_instructions(cpu_t* cpu);
 void dump_cpu_state(cpu_t* cpu);
+uint32_t cpu_get_register(cpu_t* cpu, uint8_t register_number);
+uint32_t cpu_get_pc(cpu_t* cpu);
 bool cpu_completed_instruction(cpu_t* cpu);
+bool cpu_waiting_for_interrupt(cpu_t* cpu);
+bool cpu_between_instructions(cpu_t* cpu);
+void cpu_save_state(cpu_t* cpu, state_writer_t* writer);
+void cpu_restore_state(cpu_t* cpu, state_reader_t* reader);
 
 #endif
@@ -0,0 +1,25 @@
+//
+// Defines the interface between the CPU module and its dynamic binary
+// translator. The translator is purely for internal use within the cpu
+// module; the rest of the program only ever sees cpu_run_translated().
+//
+
+
+
+#ifndef __CPU_JIT_H
+#define __CPU_JIT_H
+
+#include "cpu.h"
+#include <stdint.h>
+#include <stdbool.h>
+
+typedef struct jit jit_t;
+
+//returns NULL when the host can't run translated code, in which case the cpu
+//just keeps using the interpreter
+jit_t* make_jit(void);
+void destroy_jit(jit_t* jit);
+void jit_flush(jit_t* jit);
+void jit_note_store(jit_t* jit, uint32_t address);
+
+#endif
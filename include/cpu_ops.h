@@ -22,8 +22,31 @@ bool is_pc_relative_instruction(uint8_t opcode);
 
 bool is_load_effective_address_instruction(uint8_t opcode);
 bool is_load_instruction(uint8_t opcode);
+bool interrupt_in_process(cpu_t* cpu);
+bool interrupt_can_be_taken(cpu_t* cpu);
 void enter_interrupt_mode(cpu_t* cpu);
 void exit_interrupt_mode(cpu_t* cpu);
+uint32_t get_condition_code_register(cpu_t* cpu);
+
+//the instruction handlers themselves, for the fast engine's dispatch loop
+void cpu_and(cpu_t* cpu);
+void cpu_or(cpu_t* cpu);
+void cpu_not(cpu_t* cpu);
+void cpu_xor(cpu_t* cpu);
+void cpu_add(cpu_t* cpu);
+void cpu_sub(cpu_t* cpu);
+void cpu_load_pc_relative(cpu_t* cpu);
+void cpu_load_base_plus_offset(cpu_t* cpu);
+void cpu_load_effective_address(cpu_t* cpu);
+void cpu_jump_pc_relative(cpu_t* cpu);
+void cpu_jump_base_plus_offset(cpu_t* cpu);
+void cpu_branch(cpu_t* cpu);
+void cpu_call(cpu_t* cpu);
+void cpu_callr(cpu_t* cpu);
+void cpu_swi(cpu_t* cpu);
+void cpu_rfi(cpu_t* cpu);
+void cpu_wfi(cpu_t* cpu);
+void cpu_nop(cpu_t* cpu);
 
 
 #endif
@@ -18,15 +18,90 @@
 typedef void (*cpu_op)(cpu_t*);
 typedef cpu_op opcode_table_t[NUM_INSTRUCTIONS];
 
+//The number of entries in the decoded instruction cache. This must be a power
+//of two because the cache is direct-mapped and indexed by the low bits of the PC
+#define DECODE_CACHE_SIZE 4096
+
+//A compact, pre-decoded form of an instruction. Decoding an instruction
+//extracts and sign-extends only the fields that its encoding format actually
+//uses, so this record is cheap to build once and then reuse every time the
+//same instruction word is executed again from the same address.
+struct decoded_instruction
+{
+    uint32_t address;           //the address the instruction was fetched from (the cache tag)
+    uint32_t instruction;       //the raw instruction word
+    cpu_op handler;             //the function from the opcode table that executes this instruction
+    uint8_t opcode;
+    uint8_t format;             //the encoding format that the fields below were extracted with
+    uint8_t reg_a;              //bits 21-25: destination/store source/trap vector register
+    uint8_t reg_b;              //bits 16-20: source register 1/base register
+    uint8_t reg_c;              //bits 11-15: source register 2
+    uint8_t condition_codes;    //bits 23-25: the condition codes to test for branches
+    bool immediate_mode;
+    bool valid;
+    uint32_t offset;            //the sign-extended immediate value/offset used by this format
+};
+
+typedef struct decoded_instruction decoded_instruction_t;
+
+//The number of entries in the software TLB that maps guest pages to host
+//pages for the fast engine. Like the decode cache, it is direct-mapped, so
+//this must be a power of two.
+#define TLB_SIZE 64
+
+//page numbers are at most 22 bits, so this never matches a real page
+#define TLB_INVALID_PAGE 0xFFFFFFFF
+
+struct tlb_entry
+{
+    uint32_t page_number;       //the guest page this entry maps (the tag)
+    uint32_t* page;             //the host copy of the page, NULL if the page belongs to a device
+};
+
+typedef struct tlb_entry tlb_entry_t;
+
+//How many interrupt handlers can be running at once (i.e. how deep they can
+//nest). Each level gets its own bank of registers to switch to.
+#ifndef INTERRUPT_NESTING_DEPTH
+#define INTERRUPT_NESTING_DEPTH 4
+#endif
+
+//everything besides the general purpose registers that has to be put back
+//the way it was when an interrupt handler returns
+struct cpu_architected_state
+{
+    uint32_t PC;
+    uint32_t CCR;
+    uint32_t process_status_reg;
+};
+
+typedef struct cpu_architected_state cpu_architected_state_t;
+
+//one of these is kept for each interrupt handler that is running
+struct interrupt_frame
+{
+    cpu_architected_state_t state;  //what to return to, if state_saved
+    uint32_t* registers;            //the register bank that was in use when the interrupt was taken
+    uint8_t irq;                    //the IRQ being serviced
+    bool state_saved;               //scheduler interrupts don't save anything
+};
+
+typedef struct interrupt_frame interrupt_frame_t;
+
+//the stages of the timing engine's pipeline, in the order that they run
+enum cpu_pipeline_stage_t { INTERRUPT, FETCH1, FETCH2, DECODE, MEMORY1, MEMORY2, EXECUTE };
+
 
 struct cpu
 {
-    uint32_t registers[NUM_REGISTERS]; //the general purpose registers for the processor
+    uint32_t* registers;    //the general purpose registers for the processor (the bank in use)
     uint32_t PC;            //the program counter of the processor
     uint32_t CCR;           //condition codes register
                             //CCR[0] = last result is positive
                             //CCR[1] = last result is zero
                             //CCR[2] = last result is negative
+                            //NOTE: only up to date when condition_codes_pending
+                            //is false, use get_condition_code_register()
     uint32_t IR;            //instruction register
     uint32_t MDR;           //memory data register
     uint32_t MAR;           //memory address register
@@ -55,15 +130,94 @@ struct cpu
 
     uint32_t* store_source_reg;      //the source register for store instructions
 
+    uint32_t last_ALU_result;       //the result that the CCR should reflect
+    bool condition_codes_pending;   //the CCR hasn't been updated from last_ALU_result yet
+
     uint8_t instruction_condition_codes;    //the condition codes extracted from the current instruction (for comparison against the CCR)
     //The process status register contains information about the currently executing process (such as whether an interrupt is currently in process)
     uint32_t process_status_reg;        //process_status_reg[0] = INTERRUPT_IN_PROCESS bit
 
+    //Bank 0 holds the registers of whatever was running before any interrupt
+    //was taken. Taking an interrupt switches to the next bank up and
+    //returning from it switches back, so the interrupted registers never
+    //have to be copied back in.
+    uint32_t register_banks[INTERRUPT_NESTING_DEPTH + 1][NUM_REGISTERS];
+    interrupt_frame_t interrupt_frames[INTERRUPT_NESTING_DEPTH];
+    uint8_t interrupt_depth;    //the number of interrupt handlers running
+
     //pointer to table of function pointers representing the opcodes goes here
     opcode_table_t* opcodes;
 
+    //cache of pre-decoded instructions indexed by the address they were
+    //fetched from, and the entry for the instruction currently being executed
+    decoded_instruction_t* decode_cache;
+    const decoded_instruction_t* decoded_instruction;
+
+    //the fast execution engine's direct connection to memory
+    cpu_memory_read_t read_memory;
+    cpu_memory_write_t write_memory;
+    cpu_memory_translate_t translate_memory;
+    void* memory_port_context;
+    tlb_entry_t* tlb;
+
+    //the dynamic binary translator (created the first time it is used) and
+    //the number of cycles that translated code may still run for. Translated
+    //code addresses everything relative to the cpu struct (and the registers
+    //relative to the bank in use), so these fields are part of its context
+    //block
+    struct jit* jit;
+    int32_t jit_cycles_remaining;
+
+    //what the registers and condition codes were the last time the fast
+    //engine looked to see if the program had gone idle
+    uint32_t idle_check_registers[NUM_REGISTERS];
+    uint32_t idle_check_CCR;
+
+    bool waiting_for_interrupt; //a WFI has halted the cpu
+
+    enum cpu_pipeline_stage_t pipeline_stage; //the stage that the next call to cpu_cycle() will run
     bool instruction_finished; //tells us whether we've completed the instruction yet
 
 };
 
+
+//shared between the interpreter in cpu.c and the translator in cpu_jit.c
+void predecode_instruction(cpu_t* cpu, decoded_instruction_t* decoded, uint32_t address, uint32_t instruction);
+void invalidate_decoded_instruction(cpu_t* cpu, uint32_t address);
+void check_for_interrupts(cpu_t* cpu);
+void fill_tlb_entry(cpu_t* cpu, tlb_entry_t* entry, uint32_t page_number);
+void cpu_flush_tlb(cpu_t* cpu);
+
+//finds the host copy of a guest word for the fast engine, or returns NULL if
+//the access has to go through the memory port's read/write callbacks
+static inline uint32_t* translate_guest_address(cpu_t* cpu, uint32_t address)
+{
+    uint32_t page_number = address >> CPU_PAGE_OFFSET_BITS;
+    tlb_entry_t* entry = &cpu->tlb[page_number & (TLB_SIZE - 1)];
+    if(entry->page_number != page_number)
+    {
+        fill_tlb_entry(cpu, entry, page_number);
+    }
+    return (NULL == entry->page) ? NULL : &entry->page[address & (CPU_PAGE_WORDS - 1)];
+}
+
+static inline uint32_t memory_port_read(cpu_t* cpu, uint32_t address)
+{
+    uint32_t* word = translate_guest_address(cpu, address);
+    return (NULL != word) ? *word : cpu->read_memory(cpu->memory_port_context, address);
+}
+
+static inline void memory_port_write(cpu_t* cpu, uint32_t address, uint32_t value)
+{
+    uint32_t* word = translate_guest_address(cpu, address);
+    if(NULL != word)
+    {
+        *word = value;
+    }
+    else
+    {
+        cpu->write_memory(cpu->memory_port_context, address, value);
+    }
+}
+
 #endif
@@ -0,0 +1,32 @@
+#ifndef __FRAME_CAPTURE_H_
+#define __FRAME_CAPTURE_H_
+
+// Streams frames from the display into an uncompressed video file without
+// holding up the simulation: submitting a frame only copies the rows that
+// changed into a spare buffer, and a writer thread of its own does the
+// converting and writing. Files ending in ".y4m" are YUV4MPEG2 (4:4:4, which
+// most video tools can open); anything else gets raw RGBA bytes, frame after
+// frame. Frames that are identical to the one before them aren't written.
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "graphics_backend.h"
+
+typedef struct frame_capture_t frame_capture_t;
+
+//the frame rate is only written into the file's header; returns NULL if the
+//file can't be created
+frame_capture_t* frame_capture_open(const char* path, uint16_t width, uint16_t height,
+                                    uint32_t rate_numerator, uint32_t rate_denominator);
+//waits for every submitted frame to be written out before closing the file.
+//Returns false if any of the file couldn't be written.
+bool frame_capture_close(frame_capture_t* capture);
+
+//returns false if the writer has fallen so far behind that the frame had to
+//be dropped
+bool frame_capture_submit(frame_capture_t* capture, const graphics_frame_t* frame, uint64_t cycle);
+
+uint64_t frame_capture_frames_written(frame_capture_t* capture);
+uint64_t frame_capture_frames_dropped(frame_capture_t* capture);
+
+#endif // __FRAME_CAPTURE_H_
@@ -6,17 +6,46 @@
 #include <stdio.h>
 #include <stdint.h>
 #include <stdbool.h>
+#include "memory_bus.h"
+#include "spsc_queue.h"
+#include "graphics_backend.h"
+#include "state_file.h"
 
+enum graphics_dump_format_t { GRAPHICS_DUMP_PPM, GRAPHICS_DUMP_RAW };
+
+typedef enum graphics_dump_format_t graphics_dump_format_t;
 typedef struct graphics_t graphics_t;
 
+//backends don't open anything (windows, etc) until they have a frame to show
+graphics_t* create_graphics(uint16_t width, uint16_t height, uint32_t graphics_memory_map_starting_address, const graphics_backend_ops_t* backend_ops);
 graphics_t* create_graphics_display(uint16_t width, uint16_t height, uint32_t graphics_memory_map_starting_address);
+graphics_t* create_headless_graphics_display(uint16_t width, uint16_t height, uint32_t graphics_memory_map_starting_address);
 void graphics_destroy(graphics_t* graphics);
 //updates the contents of a pixel within the framebuffer; this is our memory
 //bus's interface to the graphics subsystem
 void graphics_update(graphics_t* graphics, uint32_t pixel_address, uint32_t RGBA_pixel);
-//renders the frame buffer contents to the screen
+//sends the frame buffer contents to the screen
 void graphics_draw(graphics_t* graphics);
+spsc_queue_t* graphics_get_key_events(graphics_t* graphics);
 void graphics_reset(graphics_t* graphics);
+uint16_t graphics_get_width(graphics_t* graphics);
+uint16_t graphics_get_height(graphics_t* graphics);
+//host-side drawing for the blitter; rectangles start at a pixel's address in
+//the memory map and are clipped to the screen
+void graphics_fill_rect(graphics_t* graphics, uint32_t pixel_address, uint16_t width, uint16_t height, uint32_t RGBA_pixel);
+void graphics_read_rect(graphics_t* graphics, uint32_t pixel_address, uint16_t width, uint16_t height, uint32_t* pixels);
+void graphics_blit(graphics_t* graphics, uint32_t pixel_address, uint16_t width, uint16_t height, const uint32_t* pixels, bool color_keyed, uint32_t key);
+uint64_t graphics_hash_frame_buffer(graphics_t* graphics);
+graphics_dump_format_t graphics_dump_format_for_path(const char* path);
+//writes the current contents of the frame buffer to a file
+bool graphics_dump_frame(graphics_t* graphics, const char* path, graphics_dump_format_t format);
+//streams frames to a video file, as Y4M if the path ends in ".y4m" and raw
+//RGBA frames otherwise
+bool graphics_start_capture(graphics_t* graphics, const char* path, uint32_t rate_numerator, uint32_t rate_denominator);
+void graphics_capture_frame(graphics_t* graphics, uint64_t cycle);
+bool graphics_stop_capture(graphics_t* graphics);
 void graphics_cycle(graphics_t* graphics, memory_bus_t* bus);
+void graphics_save_state(graphics_t* graphics, state_writer_t* writer, bool compress);
+void graphics_restore_state(graphics_t* graphics, state_reader_t* reader);
 
 #endif //__GRAPHICS_H_
@@ -0,0 +1,45 @@
+#ifndef __GRAPHICS_BACKEND_H_
+#define __GRAPHICS_BACKEND_H_
+
+// The interface between the simulated display hardware (graphics.c), which
+// owns the frame buffer, and whatever actually shows the frames to somebody.
+// The SDL backend opens a window; the null backend shows nothing at all, for
+// running where there is no display (CI hosts, batch jobs, etc).
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "spsc_queue.h"
+
+//what a backend gets to see of a frame. Every row of the frame carries the
+//sequence number of the frame that it last changed in, so backends can
+//work out which rows they need to update.
+struct graphics_frame_t
+{
+    uint16_t width;
+    uint16_t height;
+    uint64_t sequence;
+    const uint64_t* row_sequence;
+    const uint32_t* pixels;     //RGBA8888, row after row
+};
+
+typedef struct graphics_frame_t graphics_frame_t;
+
+struct graphics_backend_ops_t
+{
+    const char* name;
+    //returns the backend's own state, which is handed back to every other op
+    void* (*create)(uint16_t width, uint16_t height);
+    void (*destroy)(void* backend);
+    //shows a frame, which is only ever done when it has changed since the
+    //last one. The frame can't be kept once this returns.
+    void (*present)(void* backend, const graphics_frame_t* frame);
+    //the key presses that come from the backend's window, NULL if it has none
+    spsc_queue_t* (*get_key_events)(void* backend);
+};
+
+typedef struct graphics_backend_ops_t graphics_backend_ops_t;
+
+extern const graphics_backend_ops_t sdl_graphics_backend;
+extern const graphics_backend_ops_t null_graphics_backend;
+
+#endif // __GRAPHICS_BACKEND_H_
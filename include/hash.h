@@ -0,0 +1,32 @@
+//A tiny non-cryptographic hash (64-bit FNV-1a) for fingerprinting the contents
+//of memory, the frame buffer, etc so that runs can be compared cheaply
+
+#ifndef __HASH_H_
+#define __HASH_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define HASH_SEED   (0xCBF29CE484222325ull)
+
+static inline uint64_t hash_word(uint64_t hash, uint32_t word)
+{
+    const uint64_t FNV_PRIME = 0x100000001B3ull;
+    for(int i = 0; i < 4; i++)
+    {
+        hash ^= (word >> (8 * i)) & 0xFF;
+        hash *= FNV_PRIME;
+    }
+    return hash;
+}
+
+static inline uint64_t hash_words(uint64_t hash, const uint32_t* words, size_t num_words)
+{
+    for(size_t i = 0; i < num_words; i++)
+    {
+        hash = hash_word(hash, words[i]);
+    }
+    return hash;
+}
+
+#endif //__HASH_H_
@@ -0,0 +1,14 @@
+#ifndef __HOST_CLOCK_H_
+#define __HOST_CLOCK_H_
+
+// The host's wall clock, for pacing things (like the display) that have to
+// keep up with real time rather than simulated time. These are kept apart
+// from the rest of the simulator because the POSIX headers they need define
+// a timer_t of their own.
+
+#include <stdint.h>
+
+uint32_t host_clock_milliseconds(void);
+void host_clock_sleep(uint32_t milliseconds);
+
+#endif // __HOST_CLOCK_H_
@@ -0,0 +1,40 @@
+#ifndef __INPUT_JOURNAL_H_
+#define __INPUT_JOURNAL_H_
+
+// Records everything that comes into the simulation from outside (the key
+// events from the host's window) along with the cycle that each one arrived
+// on, so that a run can be played back later exactly as it happened, without
+// the window, as fast as the host allows. Everything else the guest sees
+// comes from the simulated clock, so a replay that hands it the same input on
+// the same cycles, with the same engine, ends up in the same state.
+//
+// Journals are binary files: an 8 byte "ZCPUJRNL" magic number, a version
+// byte and the engine the run used, then one record per event. Each record is
+// a tag byte followed by the cycles since the previous record and (for keys)
+// the keycode, both as unsigned LEB128 numbers. Every record is flushed as
+// soon as it's written, so the journal of a run that had to be killed is
+// still good up to the last key.
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "computer.h"
+#include "input_script.h"
+
+typedef struct input_journal_t input_journal_t;
+
+//starts a new journal at the given path, returns NULL if it can't be written
+input_journal_t* input_journal_create(const char* path, execution_engine_t engine);
+//returns false if the journal couldn't be written to
+bool input_journal_record(input_journal_t* journal, uint64_t cycle, uint32_t scancode);
+//marks the cycle the run finished on and closes the journal, returns false if
+//any of it couldn't be written
+bool input_journal_close(input_journal_t* journal, uint64_t end_cycle);
+
+//Reads a journal back in as a script of key events. The engine it was
+//recorded with and the cycle that the run finished on are handed back too,
+//if the run didn't get to finish, the end is the cycle of the last key.
+//Returns NULL (after saying what was wrong on stderr) if the file can't be
+//read or isn't a journal.
+input_script_t* input_journal_load(const char* path, execution_engine_t* engine, uint64_t* end_cycle);
+
+#endif // __INPUT_JOURNAL_H_
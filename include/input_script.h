@@ -0,0 +1,45 @@
+#ifndef __INPUT_SCRIPT_H_
+#define __INPUT_SCRIPT_H_
+
+// Feeds key events to the keyboard at set points in simulated time instead of
+// whenever the host's window happens to deliver them, so that interactive
+// programs can be run headless, as fast as the host allows, and get exactly
+// the same keystrokes at exactly the same cycles every time.
+//
+// Scripts are text files with one event per line:
+//
+//     <cycle> down <key>
+//     <cycle> up <key>
+//     <cycle> press <key>      (down and up on the same cycle)
+//
+// where <cycle> counts from when the computer was reset and <key> is a single
+// character, one of space/return/escape/backspace/tab/delete, or a number
+// (decimal or 0x hex) for any other SDL keycode. Events have to be in cycle
+// order. Blank lines and anything after a '#' are ignored.
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
+#include "keyboard.h"
+#include "scheduler.h"
+
+typedef struct input_script_t input_script_t;
+
+input_script_t* make_input_script(void);
+//returns NULL (after saying what was wrong on stderr) if the file can't be
+//read or isn't a valid script
+input_script_t* input_script_load(const char* path);
+void destroy_input_script(input_script_t* script);
+
+//events can only be added in cycle order, returns false otherwise
+bool input_script_add(input_script_t* script, uint64_t cycle, uint32_t scancode);
+size_t input_script_num_events(input_script_t* script);
+
+//delivers the events from the given cycle on to the keyboard, using the
+//scheduler to wake up for each one. This has to be called again whenever the
+//scheduler's notion of the current cycle starts over (i.e. when the computer
+//is reset), which plays the script again from the top.
+void input_script_start(input_script_t* script, keyboard_t* keyboard, scheduler_t* scheduler, uint64_t cycle);
+void input_script_stop(input_script_t* script);
+
+#endif // __INPUT_SCRIPT_H_
@@ -4,6 +4,8 @@
 #ifndef __INTERRUPT_CONTROLLER_H_
 #define __INTERRUPT_CONTROLLER_H_
 
+#include "state_file.h"
+
 enum IRQ_NUMBERS
 {
     IRQ_0 = 0, IRQ_1, IRQ_2, IRQ_3, IRQ_4, IRQ_5, IRQ_6, IRQ_7, IRQ_8, IRQ_9,
@@ -41,11 +43,20 @@ typedef struct interrupt_controller_t interrupt_controller_t;
 
 interrupt_controller_t* make_interrupt_controller(uint32_t ivt_start_address);
 void destroy_interrupt_controller(interrupt_controller_t* ic);
+void interrupt_controller_reset(interrupt_controller_t* ic);
 
 void request_interrupt(interrupt_controller_t* ic, uint8_t irq_number);
 
+//the lowest numbered IRQ that is pending and unmasked is serviced first
 bool interrupt_requested(interrupt_controller_t* ic);
 uint8_t get_interrupt_source(interrupt_controller_t* ic);
+void acknowledge_interrupt(interrupt_controller_t* ic, uint8_t irq_number);
+
+void mask_interrupt(interrupt_controller_t* ic, uint8_t irq_number);
+void unmask_interrupt(interrupt_controller_t* ic, uint8_t irq_number);
 uint32_t get_interrupt_vector_table_starting_address(interrupt_controller_t* ic);
 
+void interrupt_controller_save_state(interrupt_controller_t* ic, state_writer_t* writer);
+void interrupt_controller_restore_state(interrupt_controller_t* ic, state_reader_t* reader);
+
 #endif
@@ -1,17 +1,47 @@
-
 #ifndef __KEYBOARD_H_
 #define __KEYBOARD_H_
 
 #include <stdio.h>
 #include <stdint.h>
 #include <stdbool.h>
+#include <stddef.h>
+#include "memory_bus.h"
+#include "spsc_queue.h"
+#include "interrupt_controller.h"
+#include "state_file.h"
+
+//key events are SDL keycodes, apart from this one which means that the user
+//closed the window
+#define KEYBOARD_QUIT_EVENT     (0xFFFFFFFF)
+//set on the key events (and the scancodes that the guest reads) for keys
+//being let go of
+#define KEYBOARD_BREAK_CODE     (0x80000000)
+
+//where each of the keyboard's registers sits relative to the start of its
+//region in the memory map
+enum keyboard_register_t
+{
+    KEYBOARD_STATUS_REGISTER = 0,
+    KEYBOARD_DATA_REGISTER = 1,
+};
 
+typedef enum keyboard_register_t keyboard_register_t;
 typedef struct keyboard_t keyboard_t;
+//told about every key event that comes in from the host, for recording runs
+typedef void (*keyboard_input_listener_t)(void* context, uint32_t scancode);
 
-keyboard_t* create_keyboard(void);
+keyboard_t* create_keyboard(uint8_t IRQ_number, size_t fifo_depth, interrupt_controller_t* ic);
 void destroy_keyboard(keyboard_t* keyboard);
+void keyboard_reset(keyboard_t* keyboard);
 
-void input(keyboard_t* keyboard);
+void input(keyboard_t* keyboard, spsc_queue_t* key_events);
+//NULL stops telling anyone
+void keyboard_set_input_listener(keyboard_t* keyboard, keyboard_input_listener_t listener, void* context);
+//queues up a make (or break) scancode for the guest to read
+bool keyboard_press(keyboard_t* keyboard, uint32_t scancode);
+bool keyboard_quit_requested(keyboard_t* keyboard);
 void keyboard_cycle(keyboard_t* keyboard, memory_bus_t* bus);
+void keyboard_save_state(keyboard_t* keyboard, state_writer_t* writer);
+void keyboard_restore_state(keyboard_t* keyboard, state_reader_t* reader);
 
 #endif //__KEYBOARD_H_
@@ -8,17 +8,30 @@
 #include <stdio.h>
 #include <stdint.h>
 #include <stdbool.h>
+#include "state_file.h"
 
 
 typedef struct memory memory_t;
 
+//memory is allocated a page (1024 words, 4 KiB) at a time
+#define MEMORY_PAGE_OFFSET_BITS     (10)
+#define MEMORY_PAGE_WORDS           (1u << MEMORY_PAGE_OFFSET_BITS)
+
 
 memory_t* make_memory(size_t mem_size);
+void destroy_memory(memory_t* RAM);
 void memory_reset(memory_t* RAM);
 
 uint32_t memory_get(memory_t* RAM, size_t address);
 void memory_set(memory_t* RAM, size_t address, uint32_t value);
+size_t memory_size(memory_t* RAM);
+size_t memory_resident_pages(memory_t* RAM);
+void memory_read_block(memory_t* RAM, size_t address, uint32_t* values, size_t count);
+uint32_t* memory_get_page(memory_t* RAM, size_t address);
+uint64_t memory_hash(memory_t* RAM);
 void memory_print(memory_t* RAM, size_t starting_address, size_t ending_address);
+void memory_save_state(memory_t* RAM, state_writer_t* writer, bool compress);
+void memory_restore_state(memory_t* RAM, state_reader_t* reader);
 void memory_cycle(memory_t* RAM, memory_bus_t* bus);
 
 
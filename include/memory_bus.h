@@ -6,13 +6,14 @@
 #include <stdint.h>
 
 enum bus_mode_t { DATA_READ, DATA_WRITE };
-enum selected_device_t { NO_DEVICE_SELECTED, MEMORY_SELECTED, GRAPHICS_SELECTED, KEYBOARD_SELECTED };
+enum selected_device_t { NO_DEVICE_SELECTED, MEMORY_SELECTED, GRAPHICS_SELECTED, KEYBOARD_SELECTED, TIMER_SELECTED, BLITTER_SELECTED };
 
 typedef enum bus_mode_t bus_mode_t;
 typedef enum selected_device_t selected_device_t;
 typedef struct memory_bus_t memory_bus_t;
 
 memory_bus_t* make_memory_bus(void);
+void destroy_memory_bus(memory_bus_t* bus);
 
 //the device being read/written to is signaling the data is ready
 void bus_set_device_ready(memory_bus_t* bus);
@@ -24,6 +25,7 @@ bool bus_is_device_ready(memory_bus_t* bus);
 void bus_enable(memory_bus_t* bus);
 void bus_disable(memory_bus_t* bus);
 bool bus_is_enabled(memory_bus_t* bus);
+bool bus_is_idle(memory_bus_t* bus);
 
 void bus_set_read_operation(memory_bus_t* bus);
 void bus_set_write_operation(memory_bus_t* bus);
@@ -36,6 +38,9 @@ uint32_t bus_get_address_lines(memory_bus_t* bus);
 uint32_t bus_get_data_lines(memory_bus_t* bus);
 
 selected_device_t bus_get_selected_device(memory_bus_t* bus);
+bool bus_map_device(memory_bus_t* bus, selected_device_t device, uint32_t first_address, uint32_t last_address);
+selected_device_t bus_decode_address(memory_bus_t* bus, uint32_t address);
+bool bus_range_is_memory(memory_bus_t* bus, uint32_t first_address, uint32_t last_address);
 
 void bus_cycle(memory_bus_t* bus);
 
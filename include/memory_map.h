@@ -15,7 +15,9 @@
     0x00001000 - 0x000010FF     Interrupt Vector Table  256
     0x00001100 - 0x0004C0FF     Graphics Frame Buffer   307200 = 640 x 480
     0x0004C100 - 0x0004C101     Keyboard                2
-    0x0004C102 - 0x0004C1??     Timers                  ?
+    0x0004C102 - 0x0004C104     System Timer            3
+    0x0004C105 - 0x0004C10A     Blitter                 6
+    0x0004C10B - 0x0004C1??     Timers                  ?
     0x0004C1?? - 0x0004C2??     PWM?/"serial"?/GPIO?    ?
     0x00050000 - 0xFFFFFFFF     RAM                     several GB
 */
@@ -35,6 +37,12 @@
 #define KEYBOARD_REGION_START               (GRAPHICS_REGION_END + 1)
 #define KEYBOARD_REGION_SIZE                (2)
 #define KEYBOARD_REGION_END                 (KEYBOARD_REGION_START + KEYBOARD_REGION_SIZE - 1)
+#define TIMER_REGION_START                  (KEYBOARD_REGION_END + 1)
+#define TIMER_REGION_SIZE                   (3)
+#define TIMER_REGION_END                    (TIMER_REGION_START + TIMER_REGION_SIZE - 1)
+#define BLITTER_REGION_START                (TIMER_REGION_END + 1)
+#define BLITTER_REGION_SIZE                 (6)
+#define BLITTER_REGION_END                  (BLITTER_REGION_START + BLITTER_REGION_SIZE - 1)
 
 
 #endif // __MEMORY_MAP_H_
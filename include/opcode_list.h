@@ -39,7 +39,8 @@ enum opcode_t
 
     OPCODE_JUMPR   = (0x14),
     OPCODE_TRAP    = (0x15),
-    OPCODE_RETURNI = (0x16)
+    OPCODE_RETURNI = (0x16),
+    OPCODE_WFI     = (0x17)
 };
 
 #endif
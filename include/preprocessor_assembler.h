@@ -141,6 +141,10 @@
 #define RFI                                                                 RETURNI
 #define SYSCALL_EXIT                                                        RETURNI
 
+//WFI (WAIT FOR INTERRUPT INSTRUCTION)
+#define WFI                                                                 REGISTER_OP(OPCODE_WFI, 0x00, 0x00, 0x00)
+#define HALT                                                                WFI
+
 
 
 #endif // __PREPROCESSOR_ASSEMBLER_H_
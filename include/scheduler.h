@@ -0,0 +1,34 @@
+#ifndef __SCHEDULER_H_
+#define __SCHEDULER_H_
+
+// A discrete-event scheduler. Devices register the cycle at which something
+// interesting next happens to them (a timer overflowing, etc) and the
+// computer only has to service them once that cycle comes around, instead of
+// clocking every device on every cycle.
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
+
+typedef struct scheduler_t scheduler_t;
+
+//event callbacks get the cycle that the event was scheduled for
+typedef void (*scheduler_callback_t)(void* context, uint64_t cycle);
+
+typedef uint64_t event_id_t;
+
+#define NO_EVENT_ID             ((event_id_t)0)
+#define NO_EVENT_SCHEDULED      (UINT64_MAX)
+
+scheduler_t* make_scheduler(void);
+void destroy_scheduler(scheduler_t* scheduler);
+void scheduler_reset(scheduler_t* scheduler);
+
+event_id_t scheduler_add_event(scheduler_t* scheduler, uint64_t cycle, scheduler_callback_t callback, void* context);
+bool scheduler_cancel_event(scheduler_t* scheduler, event_id_t id);
+
+uint64_t scheduler_next_event_cycle(scheduler_t* scheduler);
+size_t scheduler_num_events(scheduler_t* scheduler);
+void scheduler_run_due_events(scheduler_t* scheduler, uint64_t cycle);
+
+#endif // __SCHEDULER_H_
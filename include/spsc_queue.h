@@ -0,0 +1,26 @@
+#ifndef __SPSC_QUEUE_H_
+#define __SPSC_QUEUE_H_
+
+// A lock-free queue for passing values from exactly one producer thread to
+// exactly one consumer thread (e.g. key presses from the render thread to the
+// simulation). Unlike queue.h, it is safe to use from two threads at once.
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
+
+typedef struct spsc_queue_t spsc_queue_t;
+
+spsc_queue_t* spsc_queue_create(size_t queue_size);
+void spsc_queue_destroy(spsc_queue_t* queue);
+
+size_t spsc_queue_get_size(spsc_queue_t* queue);
+
+//producer side
+bool spsc_queue_put(spsc_queue_t* queue, uint32_t value);
+
+//consumer side
+bool spsc_queue_is_empty(spsc_queue_t* queue);
+bool spsc_queue_get(spsc_queue_t* queue, uint32_t* value);
+
+#endif // __SPSC_QUEUE_H_
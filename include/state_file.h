@@ -0,0 +1,54 @@
+#ifndef __STATE_FILE_H_
+#define __STATE_FILE_H_
+
+// Reads and writes the binary images that computer_save_state() keeps a whole
+// machine in. Each part of the computer writes its own state out with these
+// and reads it back in the same order. Numbers are kept in the host's byte
+// order (the image says which that was) so that blocks of memory can be
+// copied straight out of the file, which the reader maps into memory rather
+// than parsing through stdio.
+//
+// Errors are sticky: once anything fails to be written (or runs off the end
+// of the image, or doesn't check out) the writer or reader stops doing
+// anything, reads give back 0, and the failure is reported at the end.
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
+
+typedef struct state_writer_t state_writer_t;
+typedef struct state_reader_t state_reader_t;
+
+//returns NULL if the file can't be made
+state_writer_t* state_writer_create(const char* path);
+//returns false if any of the image couldn't be written
+bool state_writer_close(state_writer_t* writer);
+void state_write_u8(state_writer_t* writer, uint8_t value);
+void state_write_u32(state_writer_t* writer, uint32_t value);
+void state_write_u64(state_writer_t* writer, uint64_t value);
+void state_write_words(state_writer_t* writer, const uint32_t* words, size_t count);
+//pads the image with zeros up to a multiple of alignment bytes
+void state_writer_align(state_writer_t* writer, size_t alignment);
+
+//Blocks of words can be run-length encoded, as a (run length, value) pair of
+//words for each run. Mostly empty memory comes down to almost nothing.
+size_t state_rle_length(const uint32_t* words, size_t count);
+void state_write_rle(state_writer_t* writer, const uint32_t* words, size_t count);
+
+//returns NULL if the file can't be opened
+state_reader_t* state_reader_open(const char* path);
+void state_reader_close(state_reader_t* reader);
+uint8_t state_read_u8(state_reader_t* reader);
+uint32_t state_read_u32(state_reader_t* reader);
+uint64_t state_read_u64(state_reader_t* reader);
+void state_read_words(state_reader_t* reader, uint32_t* words, size_t count);
+void state_reader_align(state_reader_t* reader, size_t alignment);
+//decodes a block that took up encoded_length words in the image, which has
+//to come out at exactly count words
+void state_read_rle(state_reader_t* reader, uint32_t* words, size_t count, size_t encoded_length);
+//fails the read unless the condition holds, returns false once it has failed
+bool state_reader_check(state_reader_t* reader, bool condition);
+bool state_reader_failed(state_reader_t* reader);
+bool state_reader_at_end(state_reader_t* reader);
+
+#endif // __STATE_FILE_H_
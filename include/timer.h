@@ -3,12 +3,27 @@
 #ifndef __TIMER_H_
 #define __TIMER_H_
 
-#include "memory_bus.h"
 #include "interrupt_controller.h"
+#include "memory_bus.h"
+#include "scheduler.h"
+#include "state_file.h"
+
+//where each of a timer's registers sits relative to the start of its region
+//in the memory map
+enum timer_register_t
+{
+    TIMER_CONTROL_REGISTER = 0,
+    TIMER_PRESCALE_REGISTER = 1,
+    TIMER_VALUE_REGISTER = 2,
+};
 
 typedef struct timer_t timer_t;
 
-timer_t* make_timer(uint8_t IRQ_number);
-void timer_cycle(timer_t* timer, memory_bus_t* bus, interrupt_controller_t* ic);
+timer_t* make_timer(uint8_t IRQ_number, scheduler_t* scheduler, interrupt_controller_t* ic);
+void destroy_timer(timer_t* timer);
+void timer_start(timer_t* timer, uint64_t cycle);
+void timer_cycle(timer_t* timer, memory_bus_t* bus, uint64_t cycle);
+void timer_save_state(timer_t* timer, state_writer_t* writer, uint64_t cycle);
+void timer_restore_state(timer_t* timer, state_reader_t* reader, uint64_t cycle);
 
 #endif
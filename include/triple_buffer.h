@@ -0,0 +1,26 @@
+#ifndef __TRIPLE_BUFFER_H_
+#define __TRIPLE_BUFFER_H_
+
+// A lock-free triple buffer for handing whole frames (or any other fixed-size
+// snapshot) from one producer thread to one consumer thread. The producer
+// always has a buffer of its own to fill in and the consumer always has one
+// of its own to read, so neither of them ever waits on the other. The
+// consumer just sees the most recently published snapshot; any that it was
+// too slow to pick up are skipped.
+
+#include <stdbool.h>
+#include <stddef.h>
+
+typedef struct triple_buffer_t triple_buffer_t;
+
+triple_buffer_t* triple_buffer_create(size_t buffer_size);
+void triple_buffer_destroy(triple_buffer_t* buffer);
+
+//producer side
+void* triple_buffer_get_back_buffer(triple_buffer_t* buffer);
+void triple_buffer_publish(triple_buffer_t* buffer);
+
+//consumer side
+const void* triple_buffer_get_latest(triple_buffer_t* buffer, bool* is_new);
+
+#endif // __TRIPLE_BUFFER_H_
@@ -0,0 +1,467 @@
+// ----------------------------------------------------------------------------
+//
+//  FILE: batch_runner.c
+//
+//  DESCRIPTION: This module runs a whole list of guest programs (regression
+//  tests, fuzzing corpora, etc) as fast as the host allows. Every job gets its
+//  own headless computer, so jobs share nothing and can run on as many host
+//  threads as there are cores.
+//
+//  Jobs are handed out with work stealing: each worker starts with its own
+//  slice of the manifest and pops jobs off the back of its deque, and when
+//  it runs dry it takes jobs off the front of somebody else's. Programs can
+//  run for wildly different lengths of time, so this keeps every thread busy
+//  without funnelling every job through one shared lock.
+//
+//  Results are kept per job and printed in manifest order once everything is
+//  finished, so the output doesn't depend on the thread count or scheduling.
+//
+// ----------------------------------------------------------------------------
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "batch_runner.h"
+#include "computer.h"
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#define NUM_REGISTERS           32
+//anything this big is rejected before it gets anywhere near a computer, the
+//computer itself decides whether smaller programs fit in its memory
+#define MAX_PROGRAM_WORDS       (64 * 1024)
+#define MAX_PATH_LENGTH         (512)
+#define MAX_THREADS             (256)
+
+enum job_limit_t { CYCLE_LIMIT, INSTRUCTION_LIMIT };
+
+struct batch_job_t
+{
+    //inputs
+    char path[MAX_PATH_LENGTH];
+    enum job_limit_t limit_type;
+    uint64_t limit;
+    char frame_path[MAX_PATH_LENGTH];   //where to dump the screen, "" for nowhere
+    char capture_path[MAX_PATH_LENGTH]; //where to stream video to, "" for nowhere
+    uint64_t capture_interval;
+    char input_path[MAX_PATH_LENGTH];   //key events to play in, "" for none
+
+    //results
+    const char* error;
+    uint64_t elapsed_cycles;
+    uint32_t pc;
+    uint32_t registers[NUM_REGISTERS];
+    uint64_t memory_hash;
+    size_t resident_memory_pages;
+    uint64_t idle_cycles_skipped;
+    uint64_t frame_buffer_hash;
+};
+
+typedef struct batch_job_t batch_job_t;
+
+//a deque of job indices. The owner works from the tail, thieves from the head.
+struct work_deque_t
+{
+    pthread_mutex_t lock;
+    size_t* jobs;
+    size_t head;
+    size_t tail;
+};
+
+typedef struct work_deque_t work_deque_t;
+
+struct batch_t
+{
+    batch_job_t* jobs;
+    size_t num_jobs;
+    work_deque_t* deques;
+    unsigned num_workers;
+    execution_engine_t engine;
+};
+
+typedef struct batch_t batch_t;
+
+struct worker_t
+{
+    batch_t* batch;
+    unsigned id;
+};
+
+typedef struct worker_t worker_t;
+
+
+static bool deque_pop_tail(work_deque_t* deque, size_t* job)
+{
+    bool found = false;
+    pthread_mutex_lock(&deque->lock);
+    if(deque->head < deque->tail)
+    {
+        *job = deque->jobs[--deque->tail];
+        found = true;
+    }
+    pthread_mutex_unlock(&deque->lock);
+    return found;
+}
+
+static bool deque_steal_head(work_deque_t* deque, size_t* job)
+{
+    bool found = false;
+    pthread_mutex_lock(&deque->lock);
+    if(deque->head < deque->tail)
+    {
+        *job = deque->jobs[deque->head++];
+        found = true;
+    }
+    pthread_mutex_unlock(&deque->lock);
+    return found;
+}
+
+//nothing is ever added to a deque once the workers start, so once every deque
+//has come up empty there's no more work anywhere
+static bool get_next_job(batch_t* batch, unsigned worker_id, size_t* job)
+{
+    if(deque_pop_tail(&batch->deques[worker_id], job))
+    {
+        return true;
+    }
+
+    for(unsigned i = 1; i < batch->num_workers; i++)
+    {
+        unsigned victim = (worker_id + i) % batch->num_workers;
+        if(deque_steal_head(&batch->deques[victim], job))
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+//reads a raw program image, returns the number of words read or 0 on failure
+static size_t read_program(const char* path, uint32_t* program, size_t max_words)
+{
+    FILE* file = fopen(path, "rb");
+    if(NULL == file)
+    {
+        return 0;
+    }
+
+    size_t num_words = 0;
+    uint8_t bytes[4];
+    while((num_words <= max_words) && (sizeof(bytes) == fread(bytes, 1, sizeof(bytes), file)))
+    {
+        if(num_words == max_words)
+        {
+            //far too big to be a real program
+            num_words = 0;
+            break;
+        }
+        program[num_words++] = (uint32_t)bytes[0] | ((uint32_t)bytes[1] << 8) |
+                               ((uint32_t)bytes[2] << 16) | ((uint32_t)bytes[3] << 24);
+    }
+    fclose(file);
+    return num_words;
+}
+
+static void run_job(batch_job_t* job, execution_engine_t engine)
+{
+    uint32_t* program = calloc(MAX_PROGRAM_WORDS, sizeof(*program));
+    size_t program_length = read_program(job->path, program, MAX_PROGRAM_WORDS);
+    if(0 == program_length)
+    {
+        job->error = "could not load program";
+        free(program);
+        return;
+    }
+
+    computer_t* computer = build_headless_computer();
+    computer_set_execution_engine(computer, engine);
+    if(!computer_load_program(computer, program, program_length))
+    {
+        job->error = "program does not fit in memory";
+    }
+    else if(('\0' != job->input_path[0]) && !computer_load_input_script(computer, job->input_path))
+    {
+        job->error = "could not load input script";
+    }
+    else if(('\0' != job->capture_path[0]) && !computer_start_capture(computer, job->capture_path, job->capture_interval))
+    {
+        job->error = "could not start video capture";
+    }
+    else
+    {
+        if(CYCLE_LIMIT == job->limit_type)
+        {
+            computer_run_until_cycle(computer, job->limit);
+        }
+        else
+        {
+            for(uint64_t i = 0; i < job->limit; i++)
+            {
+                computer_single_step(computer);
+            }
+        }
+
+        job->elapsed_cycles = computer_get_elapsed_cycles(computer);
+        job->pc = computer_get_pc(computer);
+        for(uint8_t i = 0; i < NUM_REGISTERS; i++)
+        {
+            job->registers[i] = computer_get_register(computer, i);
+        }
+        job->memory_hash = computer_hash_memory(computer);
+        job->resident_memory_pages = computer_get_resident_memory_pages(computer);
+        job->idle_cycles_skipped = computer_get_idle_cycles_skipped(computer);
+        job->frame_buffer_hash = computer_hash_frame_buffer(computer);
+        if(('\0' != job->frame_path[0]) && !computer_dump_frame_buffer(computer, job->frame_path))
+        {
+            job->error = "could not dump frame buffer";
+        }
+        if(!computer_stop_capture(computer))
+        {
+            job->error = "could not write video capture";
+        }
+    }
+
+    destroy_computer(computer);
+    free(program);
+}
+
+static void* worker_thread(void* arg)
+{
+    worker_t* worker = arg;
+    size_t job;
+    while(get_next_job(worker->batch, worker->id, &job))
+    {
+        run_job(&worker->batch->jobs[job], worker->batch->engine);
+    }
+    return NULL;
+}
+
+//parses the options that can follow a job's limit, returns false if any of
+//them are malformed
+static bool parse_job_options(const char* options, batch_job_t* job)
+{
+    char option[16];
+    int length;
+    while(1 == sscanf(options, "%15s%n", option, &length))
+    {
+        options += length;
+        if(0 == strcmp(option, "frame"))
+        {
+            if(1 != sscanf(options, "%511s%n", job->frame_path, &length))
+            {
+                return false;
+            }
+        }
+        else if(0 == strcmp(option, "input"))
+        {
+            if(1 != sscanf(options, "%511s%n", job->input_path, &length))
+            {
+                return false;
+            }
+        }
+        else if(0 == strcmp(option, "capture"))
+        {
+            if(2 != sscanf(options, "%511s %" SCNu64 "%n", job->capture_path, &job->capture_interval, &length) ||
+               (0 == job->capture_interval))
+            {
+                return false;
+            }
+        }
+        else
+        {
+            return false;
+        }
+        options += length;
+    }
+    return true;
+}
+
+//parses one manifest line into a job, returns false for blank/comment lines
+//and sets *error for malformed ones
+static bool parse_manifest_line(char* line, batch_job_t* job, bool* error)
+{
+    char* comment = strchr(line, '#');
+    if(NULL != comment)
+    {
+        *comment = '\0';
+    }
+
+    char limit_type[16];
+    int length = 0;
+    int num_fields = sscanf(line, "%511s %15s %" SCNu64 "%n", job->path, limit_type, &job->limit, &length);
+    *error = false;
+    if(num_fields <= 0)
+    {
+        return false;
+    }
+
+    if((3 != num_fields) || !parse_job_options(&line[length], job))
+    {
+        *error = true;
+    }
+    else if(0 == strcmp(limit_type, "cycles"))
+    {
+        job->limit_type = CYCLE_LIMIT;
+    }
+    else if(0 == strcmp(limit_type, "instructions"))
+    {
+        job->limit_type = INSTRUCTION_LIMIT;
+    }
+    else
+    {
+        *error = true;
+    }
+    return !*error;
+}
+
+static batch_job_t* read_manifest(const char* manifest_path, size_t* num_jobs)
+{
+    FILE* manifest = fopen(manifest_path, "r");
+    if(NULL == manifest)
+    {
+        fprintf(stderr, "could not open manifest %s\n", manifest_path);
+        return NULL;
+    }
+
+    size_t capacity = 16;
+    batch_job_t* jobs = malloc(capacity * sizeof(*jobs));
+    *num_jobs = 0;
+
+    char line[1024];
+    unsigned line_number = 0;
+    while(NULL != fgets(line, sizeof(line), manifest))
+    {
+        line_number++;
+        if(*num_jobs == capacity)
+        {
+            capacity *= 2;
+            jobs = realloc(jobs, capacity * sizeof(*jobs));
+        }
+
+        batch_job_t* job = &jobs[*num_jobs];
+        memset(job, 0, sizeof(*job));
+        bool error;
+        if(parse_manifest_line(line, job, &error))
+        {
+            (*num_jobs)++;
+        }
+        else if(error)
+        {
+            fprintf(stderr, "%s:%u: expected \"<program> cycles|instructions <count> [frame <file>] [capture <file> <cycles per frame>] [input <file>]\"\n", manifest_path, line_number);
+            free(jobs);
+            fclose(manifest);
+            return NULL;
+        }
+    }
+
+    fclose(manifest);
+    return jobs;
+}
+
+static void print_job_result(FILE* output, batch_job_t* job)
+{
+    fprintf(output, "path=%s\n", job->path);
+    if(NULL != job->error)
+    {
+        fprintf(output, "error=%s\n\n", job->error);
+        return;
+    }
+
+    fprintf(output, "cycles=%" PRIu64 "\n", job->elapsed_cycles);
+    fprintf(output, "idle_cycles=%" PRIu64 "\n", job->idle_cycles_skipped);
+    fprintf(output, "pc=0x%08" PRIX32 "\n", job->pc);
+    for(int i = 0; i < NUM_REGISTERS; i++)
+    {
+        fprintf(output, "r%d=0x%08" PRIX32 "\n", i, job->registers[i]);
+    }
+    fprintf(output, "ram_hash=0x%016" PRIX64 "\n", job->memory_hash);
+    fprintf(output, "ram_pages=%zu\n", job->resident_memory_pages);
+    fprintf(output, "fb_hash=0x%016" PRIX64 "\n\n", job->frame_buffer_hash);
+}
+
+int run_batch(const char* manifest_path, unsigned num_threads, execution_engine_t engine, FILE* output)
+{
+    batch_t batch;
+    batch.engine = engine;
+    batch.jobs = read_manifest(manifest_path, &batch.num_jobs);
+    if(NULL == batch.jobs)
+    {
+        return -1;
+    }
+
+    //0 means one thread per online core
+    if(0 == num_threads)
+    {
+        long num_cores = sysconf(_SC_NPROCESSORS_ONLN);
+        num_threads = (num_cores > 0) ? (unsigned)num_cores : 1;
+    }
+    if(num_threads > MAX_THREADS)
+    {
+        num_threads = MAX_THREADS;
+    }
+    if(num_threads > batch.num_jobs)
+    {
+        num_threads = (batch.num_jobs > 0) ? (unsigned)batch.num_jobs : 1;
+    }
+    batch.num_workers = num_threads;
+
+    //deal the jobs out round robin. Each worker pops from its tail, so put
+    //them in backwards to have each worker start at the top of its slice.
+    batch.deques = calloc(num_threads, sizeof(*batch.deques));
+    for(unsigned w = 0; w < num_threads; w++)
+    {
+        work_deque_t* deque = &batch.deques[w];
+        pthread_mutex_init(&deque->lock, NULL);
+        deque->jobs = calloc(batch.num_jobs / num_threads + 1, sizeof(*deque->jobs));
+        deque->head = 0;
+        deque->tail = 0;
+    }
+    for(size_t j = batch.num_jobs; j-- > 0;)
+    {
+        work_deque_t* deque = &batch.deques[j % num_threads];
+        deque->jobs[deque->tail++] = j;
+    }
+
+    //the calling thread counts as worker 0
+    pthread_t threads[MAX_THREADS];
+    worker_t workers[MAX_THREADS];
+    for(unsigned w = 0; w < num_threads; w++)
+    {
+        workers[w].batch = &batch;
+        workers[w].id = w;
+    }
+    for(unsigned w = 1; w < num_threads; w++)
+    {
+        pthread_create(&threads[w], NULL, worker_thread, &workers[w]);
+    }
+    worker_thread(&workers[0]);
+    for(unsigned w = 1; w < num_threads; w++)
+    {
+        pthread_join(threads[w], NULL);
+    }
+
+    int num_failed = 0;
+    for(size_t j = 0; j < batch.num_jobs; j++)
+    {
+        print_job_result(output, &batch.jobs[j]);
+        if(NULL != batch.jobs[j].error)
+        {
+            num_failed++;
+        }
+    }
+
+    for(unsigned w = 0; w < num_threads; w++)
+    {
+        pthread_mutex_destroy(&batch.deques[w].lock);
+        free(batch.deques[w].jobs);
+    }
+    free(batch.deques);
+    free(batch.jobs);
+    return num_failed;
+}
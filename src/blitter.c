@@ -0,0 +1,326 @@
+// ----------------------------------------------------------------------------
+//
+//  FILE: blitter.c
+//
+//  DESCRIPTION: This is the computer's 2D drawing accelerator. Rather than
+//  having the CPU store every pixel of a rectangle to the frame buffer one at
+//  a time (each one a trip across the bus), programs set up the blitter's
+//  registers and write a command to it:
+//
+//      fill rect       fills the destination rectangle with the color register
+//      copy rect       copies the source rectangle to the destination
+//      color key blit  like copy rect, but source pixels that are the color
+//                      register's color are left out (for drawing sprites)
+//
+//  The destination is the address of the rectangle's top left pixel in the
+//  frame buffer, and the size register holds the width in its low 16 bits and
+//  the height in its high 16 bits. The source can be in the frame buffer
+//  (where its rows are a screen's width apart) or in RAM (where its rows are
+//  packed one after another). Rectangles are clipped to the edges of the
+//  screen.
+//
+//  The drawing is done on the host, straight into the frame buffer (see
+//  graphics_fill_rect(), etc), at the moment the command is written, but the
+//  blitter stays busy for as long as the real thing would take to push that
+//  many pixels. When it's done, it sets its done flag and, if it's been
+//  allowed to, requests an interrupt. Commands that are written while it's
+//  still busy are ignored.
+//
+// ----------------------------------------------------------------------------
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+
+#include "blitter.h"
+#include "bit_twiddling.h"
+#include "memory_map.h"
+
+//what it costs to set up an operation, and how many pixels get moved every
+//cycle after that (4 pixels is a 128-bit wide path to the frame buffer)
+#define BLITTER_SETUP_CYCLES            (8)
+#define BLITTER_PIXELS_PER_CYCLE        (4)
+
+enum blitter_control_bits_t
+{
+    BLITTER_INTERRUPT_ENABLE_BIT = 0,
+    BLITTER_DONE_FLAG_BIT = 1,
+    BLITTER_BUSY_BIT = 2,
+};
+
+struct blitter_t
+{
+    uint8_t control_bits;
+    uint32_t command;
+    uint32_t source;
+    uint32_t destination;
+    uint32_t size;
+    uint32_t color;
+
+    uint8_t IRQ_number;
+    graphics_t* graphics;
+    memory_t* RAM;
+    scheduler_t* scheduler;
+    interrupt_controller_t* ic;
+    event_id_t done_event;
+    uint64_t done_cycle;    //when the operation in flight (if any) finishes
+
+    //where the source rectangle is gathered before it gets drawn, so that
+    //copies between overlapping parts of the screen come out right
+    uint32_t* source_pixels;
+};
+
+
+blitter_t* make_blitter(uint8_t IRQ_number, graphics_t* graphics, memory_t* RAM, scheduler_t* scheduler, interrupt_controller_t* ic)
+{
+    blitter_t* blitter = calloc(1, sizeof(struct blitter_t));
+    blitter->IRQ_number = IRQ_number;
+    blitter->graphics = graphics;
+    blitter->RAM = RAM;
+    blitter->scheduler = scheduler;
+    blitter->ic = ic;
+    blitter->done_event = NO_EVENT_ID;
+    //nothing bigger than the screen ever gets drawn
+    blitter->source_pixels = calloc((size_t)graphics_get_width(graphics) * graphics_get_height(graphics), sizeof(uint32_t));
+    return blitter;
+}
+
+void destroy_blitter(blitter_t* blitter)
+{
+    free(blitter->source_pixels);
+    free(blitter);
+}
+
+//Puts the blitter back the way it was built. The scheduler has to have been
+//reset already, since any operation that was in flight is forgotten about.
+void blitter_reset(blitter_t* blitter)
+{
+    blitter->control_bits = 0;
+    blitter->command = BLITTER_NO_COMMAND;
+    blitter->source = 0;
+    blitter->destination = 0;
+    blitter->size = 0;
+    blitter->color = 0;
+    blitter->done_event = NO_EVENT_ID;
+}
+
+static void done_event(void* context, uint64_t cycle)
+{
+    (void)cycle;
+    blitter_t* blitter = context;
+    blitter->done_event = NO_EVENT_ID;
+    BIT_CLEAR(blitter->control_bits, BLITTER_BUSY_BIT);
+    BIT_SET(blitter->control_bits, BLITTER_DONE_FLAG_BIT);
+    if(CHECK_BIT_SET(blitter->control_bits, BLITTER_INTERRUPT_ENABLE_BIT))
+    {
+        request_interrupt(blitter->ic, blitter->IRQ_number);
+    }
+}
+
+static bool is_in_frame_buffer(uint32_t address)
+{
+    return (GRAPHICS_REGION_START <= address) && (address <= GRAPHICS_REGION_END);
+}
+
+//shrinks a rectangle whose top left pixel is at the given frame buffer address
+//down to the part of it that's on the screen
+static void clip_rect(blitter_t* blitter, uint32_t address, uint16_t* width, uint16_t* height)
+{
+    uint16_t screen_width = graphics_get_width(blitter->graphics);
+    uint16_t screen_height = graphics_get_height(blitter->graphics);
+    uint32_t offset = address - GRAPHICS_REGION_START;
+    uint16_t x = (uint16_t)(offset % screen_width);
+    uint16_t y = (uint16_t)(offset / screen_width);
+    if(*width > screen_width - x)
+    {
+        *width = screen_width - x;
+    }
+    if(*height > screen_height - y)
+    {
+        *height = screen_height - y;
+    }
+}
+
+//works out how much of the rectangle is actually on the screen (at both
+//ends, for copies out of the frame buffer), returns false if none of it is
+static bool clip_to_screen(blitter_t* blitter, uint16_t* width, uint16_t* height)
+{
+    if(!is_in_frame_buffer(blitter->destination))
+    {
+        return false;
+    }
+
+    *width = (uint16_t)blitter->size;
+    *height = (uint16_t)(blitter->size >> 16);
+    clip_rect(blitter, blitter->destination, width, height);
+    if((BLITTER_FILL_RECT != blitter->command) && is_in_frame_buffer(blitter->source))
+    {
+        clip_rect(blitter, blitter->source, width, height);
+    }
+    return (*width > 0) && (*height > 0);
+}
+
+//gathers the part of the source rectangle that will be drawn into
+//source_pixels, with its rows packed one after another
+static void read_source(blitter_t* blitter, uint16_t width, uint16_t height)
+{
+    if(is_in_frame_buffer(blitter->source))
+    {
+        graphics_read_rect(blitter->graphics, blitter->source, width, height, blitter->source_pixels);
+        return;
+    }
+
+    uint32_t source_width = (uint16_t)blitter->size;
+    for(uint16_t row = 0; row < height; row++)
+    {
+        memory_read_block(blitter->RAM, (size_t)blitter->source + (size_t)row * source_width,
+                          &blitter->source_pixels[row * width], width);
+    }
+}
+
+//does the drawing for the command and returns how many pixels it moved
+static uint32_t run_command(blitter_t* blitter)
+{
+    uint16_t width;
+    uint16_t height;
+    if(!clip_to_screen(blitter, &width, &height))
+    {
+        return 0;
+    }
+
+    switch(blitter->command)
+    {
+        case BLITTER_FILL_RECT:
+            graphics_fill_rect(blitter->graphics, blitter->destination, width, height, blitter->color);
+            break;
+        case BLITTER_COPY_RECT:
+        case BLITTER_COLOR_KEY_BLIT:
+            read_source(blitter, width, height);
+            graphics_blit(blitter->graphics, blitter->destination, width, height, blitter->source_pixels,
+                          (BLITTER_COLOR_KEY_BLIT == blitter->command), blitter->color);
+            break;
+        default:
+            return 0;
+    }
+    return (uint32_t)width * height;
+}
+
+static void start_command(blitter_t* blitter, uint32_t command, uint64_t cycle)
+{
+    if(CHECK_BIT_SET(blitter->control_bits, BLITTER_BUSY_BIT))
+    {
+        return;
+    }
+
+    blitter->command = command;
+    uint32_t pixels = run_command(blitter);
+    uint64_t busy_cycles = BLITTER_SETUP_CYCLES + (pixels + BLITTER_PIXELS_PER_CYCLE - 1) / BLITTER_PIXELS_PER_CYCLE;
+    BIT_SET(blitter->control_bits, BLITTER_BUSY_BIT);
+    blitter->done_cycle = cycle + busy_cycles;
+    blitter->done_event = scheduler_add_event(blitter->scheduler, blitter->done_cycle, &done_event, blitter);
+}
+
+static uint32_t read_register(blitter_t* blitter, uint32_t offset)
+{
+    switch(offset)
+    {
+        case BLITTER_CONTROL_REGISTER:
+            return blitter->control_bits;
+        case BLITTER_COMMAND_REGISTER:
+            return blitter->command;
+        case BLITTER_SOURCE_REGISTER:
+            return blitter->source;
+        case BLITTER_DESTINATION_REGISTER:
+            return blitter->destination;
+        case BLITTER_SIZE_REGISTER:
+            return blitter->size;
+        case BLITTER_COLOR_REGISTER:
+            return blitter->color;
+        default:
+            return 0;
+    }
+}
+
+//Like the timer's overflow flag, the done flag can only be cleared from
+//software (by writing a 0 to it), and the busy bit can't be written at all
+static void write_register(blitter_t* blitter, uint32_t offset, uint32_t value, uint64_t cycle)
+{
+    switch(offset)
+    {
+        case BLITTER_CONTROL_REGISTER:
+        {
+            uint32_t done_flag = blitter->control_bits & value & ((1u) << BLITTER_DONE_FLAG_BIT);
+            uint32_t busy = blitter->control_bits & ((1u) << BLITTER_BUSY_BIT);
+            blitter->control_bits = (uint8_t)(busy | done_flag | (value & ((1u) << BLITTER_INTERRUPT_ENABLE_BIT)));
+            break;
+        }
+        case BLITTER_COMMAND_REGISTER:
+            start_command(blitter, value, cycle);
+            break;
+        case BLITTER_SOURCE_REGISTER:
+            blitter->source = value;
+            break;
+        case BLITTER_DESTINATION_REGISTER:
+            blitter->destination = value;
+            break;
+        case BLITTER_SIZE_REGISTER:
+            blitter->size = value;
+            break;
+        case BLITTER_COLOR_REGISTER:
+            blitter->color = value;
+            break;
+        default:
+            break;
+    }
+}
+
+void blitter_cycle(blitter_t* blitter, memory_bus_t* bus, uint64_t cycle)
+{
+    if(BLITTER_SELECTED != bus_get_selected_device(bus) || !bus_is_enabled(bus))
+    {
+        return;
+    }
+
+    uint32_t offset = bus_get_address_lines(bus) - BLITTER_REGION_START;
+    if(bus_is_read_operation(bus))
+    {
+        bus_set_data_lines(bus, read_register(blitter, offset));
+    }
+    else
+    {
+        write_register(blitter, offset, bus_get_data_lines(bus), cycle);
+    }
+    bus_set_device_ready(bus);
+}
+
+//Operations draw everything as soon as they start, so all that's left of one
+//that is still in flight is how much longer the blitter stays busy for
+void blitter_save_state(blitter_t* blitter, state_writer_t* writer, uint64_t cycle)
+{
+    bool busy = CHECK_BIT_SET(blitter->control_bits, BLITTER_BUSY_BIT);
+    state_write_u8(writer, blitter->control_bits);
+    state_write_u32(writer, blitter->command);
+    state_write_u32(writer, blitter->source);
+    state_write_u32(writer, blitter->destination);
+    state_write_u32(writer, blitter->size);
+    state_write_u32(writer, blitter->color);
+    state_write_u64(writer, (busy && (blitter->done_cycle > cycle)) ? blitter->done_cycle - cycle : 0);
+}
+
+//the blitter has to have been reset first
+void blitter_restore_state(blitter_t* blitter, state_reader_t* reader, uint64_t cycle)
+{
+    blitter->control_bits = state_read_u8(reader);
+    blitter->command = state_read_u32(reader);
+    blitter->source = state_read_u32(reader);
+    blitter->destination = state_read_u32(reader);
+    blitter->size = state_read_u32(reader);
+    blitter->color = state_read_u32(reader);
+    uint64_t busy_cycles = state_read_u64(reader);
+    if(CHECK_BIT_SET(blitter->control_bits, BLITTER_BUSY_BIT))
+    {
+        blitter->done_cycle = cycle + busy_cycles;
+        blitter->done_event = scheduler_add_event(blitter->scheduler, blitter->done_cycle, &done_event, blitter);
+    }
+}
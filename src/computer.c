@@ -18,8 +18,14 @@
 #include "memory.h"
 #include "graphics.h"
 #include "keyboard.h"
+#include "input_script.h"
+#include "input_journal.h"
 #include "timer.h"
+#include "blitter.h"
+#include "scheduler.h"
 #include "interrupt_controller.h"
+#include "host_clock.h"
+#include "state_file.h"
 #include "debug.h"
 
 #include <stdio.h>
@@ -28,20 +34,31 @@
 #include <inttypes.h>
 
 
-bool simulation_running = false;
-
 struct computer_t 
 {
     uint64_t elapsed_cycles;
+    uint32_t cycles_this_second;    //for the once a second speed report in computer_run()
+    uint64_t idle_cycles_skipped;   //cycles that went by while the cpu was stuck in an idle loop
+    bool running;
+    execution_engine_t engine;
     cpu_t* cpu;
     memory_bus_t* bus;
     memory_t* RAM;
     graphics_t* screen;
     keyboard_t* keyboard;
     timer_t* system_timer;
+    blitter_t* blitter;
     interrupt_controller_t* interrupt_controller;
+    scheduler_t* scheduler;     //when each device next needs servicing
+    uint64_t capture_interval;  //cycles between captured video frames, 0 when not capturing
+    event_id_t capture_event;
+    input_script_t* input_script;   //key events to play into the keyboard, NULL for none
+    input_journal_t* journal;       //where the host's input is being recorded, NULL when it isn't
 };
 
+//the cpu's clock rate, which is how fast captured video plays back in real time
+#define CPU_CLOCK_HZ    (25000000)
+
 //FIXME: these will need parameters for graphics and memory_bus later
 //Creates a computer object and connects its dependencies, but doesn't 
 //initialize it
@@ -51,7 +68,9 @@ computer_t* make_computer(cpu_t* cpu,
                           graphics_t* graphics, 
                           keyboard_t* keyboard, 
                           timer_t* system_timer, 
-                          interrupt_controller_t* ic)
+                          blitter_t* blitter,
+                          interrupt_controller_t* ic,
+                          scheduler_t* scheduler)
 {
     computer_t* computer = calloc(1, sizeof(struct computer_t));
     computer->cpu = cpu;
@@ -60,10 +79,17 @@ computer_t* make_computer(cpu_t* cpu,
     computer->screen = graphics;
     computer->keyboard = keyboard;
     computer->system_timer = system_timer;
+    computer->blitter = blitter;
     computer->interrupt_controller = ic;
+    computer->scheduler = scheduler;
     return computer;
 }
 
+static uint32_t read_memory_port(void* context, uint32_t address);
+static void schedule_capture(computer_t* computer, uint64_t cycle);
+static void write_memory_port(void* context, uint32_t address, uint32_t value);
+static uint32_t* translate_memory_port(void* context, uint32_t address);
+
 //This is our CPU "factory" function, which handles the initialization and dependency
 //injection to the CPU "constructor" separately
 cpu_t* build_cpu(memory_bus_t* bus, interrupt_controller_t* ic)
@@ -74,100 +100,440 @@ cpu_t* build_cpu(memory_bus_t* bus, interrupt_controller_t* ic)
     return cpu;
 }
 
-//creates a new computer system complete with all subsystems
-//and initializes/resets it
-computer_t* build_computer(void)
+static const uint16_t DISPLAY_WIDTH = 640;
+static const uint16_t DISPLAY_HEIGHT = 480;
+//how many scancodes the keyboard can hold on to before the guest reads them
+static const size_t KEYBOARD_FIFO_DEPTH = 64;
+
+static computer_t* build_computer_with_display(graphics_t* display)
 {
-    const uint16_t DISPLAY_WIDTH = 640;
-    const uint16_t DISPLAY_HEIGHT = 480;
-    const uint32_t NUM_MEM_LOCATIONS = 1024;
+    //the whole 32-bit address space, pages only get allocated once they're used
+    const size_t NUM_MEM_LOCATIONS = (size_t)1 << 32;
     memory_bus_t* bus = make_memory_bus();
+    bus_map_device(bus, GRAPHICS_SELECTED, GRAPHICS_REGION_START, GRAPHICS_REGION_END);
+    bus_map_device(bus, KEYBOARD_SELECTED, KEYBOARD_REGION_START, KEYBOARD_REGION_END);
+    bus_map_device(bus, TIMER_SELECTED, TIMER_REGION_START, TIMER_REGION_END);
+    bus_map_device(bus, BLITTER_SELECTED, BLITTER_REGION_START, BLITTER_REGION_END);
     interrupt_controller_t* ic = make_interrupt_controller(INTERRUPT_VECTOR_TABLE_START);
 
     cpu_t* cpu = build_cpu(bus, ic);
     memory_t* RAM = make_memory(NUM_MEM_LOCATIONS);
-    //DEBUG
-    graphics_t* display = create_graphics_display(DISPLAY_WIDTH, DISPLAY_HEIGHT, GRAPHICS_REGION_START);
-    keyboard_t* keyboard = create_keyboard();
-    timer_t* sys_timer = make_timer(IRQ_1);
+    keyboard_t* keyboard = create_keyboard(IRQ_2, KEYBOARD_FIFO_DEPTH, ic);
+    scheduler_t* scheduler = make_scheduler();
+    timer_t* sys_timer = make_timer(IRQ_1, scheduler, ic);
+    blitter_t* blitter = make_blitter(IRQ_3, display, RAM, scheduler, ic);
 
-    computer_t* computer = make_computer(cpu, RAM, bus, display, keyboard, sys_timer, ic);
+    computer_t* computer = make_computer(cpu, RAM, bus, display, keyboard, sys_timer, blitter, ic, scheduler);
+    cpu_attach_memory_port(cpu, &read_memory_port, &write_memory_port, &translate_memory_port, computer);
     computer_reset(computer);
     return computer;
 }
 
+//creates a new computer system complete with all subsystems
+//and initializes/resets it
+computer_t* build_computer(void)
+{
+    return build_computer_with_display(create_graphics_display(DISPLAY_WIDTH, DISPLAY_HEIGHT, GRAPHICS_REGION_START));
+}
+
+//creates a computer whose display never opens a window. These don't need SDL
+//to be set up, so any number of them can be built and run on separate threads
+computer_t* build_headless_computer(void)
+{
+    return build_computer_with_display(create_headless_graphics_display(DISPLAY_WIDTH, DISPLAY_HEIGHT, GRAPHICS_REGION_START));
+}
+
+//tears down a computer made by build_computer() along with all of its subsystems
+void destroy_computer(computer_t* computer)
+{
+    computer_stop_recording(computer);
+    destroy_cpu(computer->cpu);
+    destroy_memory(computer->RAM);
+    destroy_memory_bus(computer->bus);
+    graphics_destroy(computer->screen);
+    destroy_keyboard(computer->keyboard);
+    destroy_timer(computer->system_timer);
+    destroy_blitter(computer->blitter);
+    destroy_interrupt_controller(computer->interrupt_controller);
+    if(NULL != computer->input_script)
+    {
+        destroy_input_script(computer->input_script);
+    }
+    destroy_scheduler(computer->scheduler);
+    free(computer);
+}
+
+//Time has started over (or jumped), so everything that uses the scheduler
+//has to schedule itself again from the current cycle. The blitter only
+//schedules anything while it's busy, so it's dealt with separately.
+static void restart_scheduled_events(computer_t* computer)
+{
+    scheduler_reset(computer->scheduler);
+    timer_start(computer->system_timer, computer->elapsed_cycles);
+    schedule_capture(computer, computer->elapsed_cycles);
+    if(NULL != computer->input_script)
+    {
+        input_script_start(computer->input_script, computer->keyboard, computer->scheduler, computer->elapsed_cycles);
+    }
+}
+
 void computer_reset(computer_t* computer)
 {
     computer->elapsed_cycles = 0;
-    cpu_reset(computer->cpu);
+    computer->cycles_this_second = 0;
+    computer->idle_cycles_skipped = 0;
+    //memory has to go first since resetting it frees the pages that the cpu
+    //may still have mapped
     memory_reset(computer->RAM);
+    cpu_reset(computer->cpu);
     graphics_reset(computer->screen);
+    keyboard_reset(computer->keyboard);
+    interrupt_controller_reset(computer->interrupt_controller);
+    restart_scheduled_events(computer);
+    blitter_reset(computer->blitter);
     //reset_IO(computer->IO);
     //reset_memory_bus(computer->memory_bus);
 }
 
-//load the supplied program into computer memory
-void computer_load_program(computer_t* computer, uint32_t* program, size_t program_length)
+void computer_set_execution_engine(computer_t* computer, execution_engine_t engine)
+{
+    computer->engine = engine;
+}
+
+//clocks every device that is attached to the bus
+static void clock_bus_devices(computer_t* computer)
 {
+    bus_cycle(computer->bus);
+
+    memory_cycle(computer->RAM, computer->bus);
+    graphics_cycle(computer->screen, computer->bus);
+    keyboard_cycle(computer->keyboard, computer->bus);
+    timer_cycle(computer->system_timer, computer->bus, computer->elapsed_cycles);
+    blitter_cycle(computer->blitter, computer->bus, computer->elapsed_cycles);
+}
+
+//runs a complete bus read/write on behalf of the fast engine for addresses
+//that belong to memory-mapped devices rather than plain RAM. The system is
+//only caught up at the end of each batch, so devices that keep time (the
+//timer) see the cycle that the current batch started on.
+static uint32_t bus_transaction(computer_t* computer, uint32_t address, bool write, uint32_t value)
+{
+    memory_bus_t* bus = computer->bus;
+    bus_enable(bus);
+    bus_set_address_lines(bus, address);
+    if(write)
+    {
+        bus_set_write_operation(bus);
+        bus_set_data_lines(bus, value);
+    }
+    else
+    {
+        bus_set_read_operation(bus);
+    }
+
+    do
+    {
+        clock_bus_devices(computer);
+    }
+    while(!bus_is_device_ready(bus));
+
+    value = bus_get_data_lines(bus);
+    bus_clear_device_ready(bus);
+    bus_disable(bus);
+    return value;
+}
+
+static uint32_t read_memory_port(void* context, uint32_t address)
+{
+    computer_t* computer = context;
+    if(MEMORY_SELECTED == bus_decode_address(computer->bus, address))
+    {
+        return memory_get(computer->RAM, address);
+    }
+    return bus_transaction(computer, address, false, 0);
+}
+
+static void write_memory_port(void* context, uint32_t address, uint32_t value)
+{
+    computer_t* computer = context;
+    if(MEMORY_SELECTED == bus_decode_address(computer->bus, address))
+    {
+        memory_set(computer->RAM, address, value);
+        return;
+    }
+    bus_transaction(computer, address, true, value);
+}
+
+#if CPU_PAGE_OFFSET_BITS != MEMORY_PAGE_OFFSET_BITS
+#error "the CPU's TLB maps whole RAM pages, so both have to use the same page size"
+#endif
+
+//lets the fast engine map pages of plain RAM (or what stands in for the boot
+//ROM for now) straight into its TLB. Pages with a device anywhere in them
+//have to use the bus.
+static uint32_t* translate_memory_port(void* context, uint32_t address)
+{
+    computer_t* computer = context;
+    uint32_t page_start = address & ~(MEMORY_PAGE_WORDS - 1);
+    if(!bus_range_is_memory(computer->bus, page_start, page_start + (MEMORY_PAGE_WORDS - 1)))
+    {
+        return NULL;
+    }
+    return memory_get_page(computer->RAM, page_start);
+}
+
+//load the supplied program into computer memory, returns false (and loads
+//nothing) if the program doesn't fit
+bool computer_load_program(computer_t* computer, uint32_t* program, size_t program_length)
+{
+    if(program_length > memory_size(computer->RAM))
+    {
+        return false;
+    }
+
     for(size_t i = 0; i < program_length; i++)
     {
         memory_set(computer->RAM, i, program[i]);
     }
+    cpu_flush_decoded_instructions(computer->cpu);
+    return true;
 }
 
-uint32_t cycles = 0;
-//execute the next single instruction for the program in memory
-void computer_single_step(computer_t* computer)
+//The bus devices only have anything to do while the CPU has a bus transaction
+//in flight, and everything else only needs servicing when the scheduler says
+//that one of its events is due.
+static void timing_single_step(computer_t* computer)
 {
     do
     {
         cpu_cycle(computer->cpu);
 
-        bus_cycle(computer->bus);
-
-        memory_cycle(computer->RAM, computer->bus);
-        graphics_cycle(computer->screen, computer->bus);
-        timer_cycle(computer->system_timer, computer->bus, computer->interrupt_controller);
+        if(!bus_is_idle(computer->bus))
+        {
+            clock_bus_devices(computer);
+        }
 
         computer->elapsed_cycles++;
-        cycles++;
+        computer->cycles_this_second++;
+        if(computer->elapsed_cycles >= scheduler_next_event_cycle(computer->scheduler))
+        {
+            scheduler_run_due_events(computer->scheduler, computer->elapsed_cycles);
+        }
     }
     while(!cpu_completed_instruction(computer->cpu));
 }
 
+//catches the rest of the system up with the cycles that the fast engine ran for
+static void account_for_cycles(computer_t* computer, uint32_t elapsed)
+{
+    computer->elapsed_cycles += elapsed;
+    computer->cycles_this_second += elapsed;
+    scheduler_run_due_events(computer->scheduler, computer->elapsed_cycles);
+}
+
+//moves time forward over cycles where the cpu had nothing to do
+static void skip_cycles(computer_t* computer, uint64_t cycles)
+{
+    computer->elapsed_cycles += cycles;
+    computer->idle_cycles_skipped += cycles;
+    scheduler_run_due_events(computer->scheduler, computer->elapsed_cycles);
+}
+
+//the earliest point that time can skip ahead to: the next scheduled event or
+//skip_limit, whichever comes first
+static uint64_t get_skip_limit(computer_t* computer, uint64_t skip_limit)
+{
+    uint64_t next_event = scheduler_next_event_cycle(computer->scheduler);
+    return (next_event < skip_limit) ? next_event : skip_limit;
+}
+
+//A cpu that has been halted by a WFI can only be woken up by an interrupt,
+//and only devices servicing a scheduled event can request one, so time jumps
+//straight to the next event (or skip_limit). This is exact for both engines:
+//the cpu wakes on the same cycle as it would have by sitting through every
+//one of the halted cycles. Returns true if the cpu is halted.
+static bool skip_halted_cycles(computer_t* computer, uint64_t skip_limit)
+{
+    if(!cpu_waiting_for_interrupt(computer->cpu) || !bus_is_idle(computer->bus))
+    {
+        return false;
+    }
+
+    uint64_t limit = get_skip_limit(computer, skip_limit);
+    if((NO_EVENT_SCHEDULED != limit) && (limit > computer->elapsed_cycles))
+    {
+        skip_cycles(computer, limit - computer->elapsed_cycles);
+    }
+    return true;
+}
+
+//When the cpu is stuck going around a loop that can't change anything,
+//nothing is going to happen until the next scheduled event, so time can jump
+//straight there (or to skip_limit, if that comes first). Only whole trips
+//around the loop are skipped so that the cpu comes out of it at the same
+//point, on the same cycle, as it would have by running every trip. Returns
+//true if the cpu is idle (or halted).
+static bool skip_idle_cycles(computer_t* computer, uint64_t skip_limit)
+{
+    if(skip_halted_cycles(computer, skip_limit))
+    {
+        return true;
+    }
+
+    uint64_t limit = get_skip_limit(computer, skip_limit);
+    if(limit <= computer->elapsed_cycles)
+    {
+        return false;
+    }
+
+    uint64_t room = limit - computer->elapsed_cycles;
+    uint32_t cycles_run = 0;
+    uint32_t trip_cycles = cpu_check_for_idle_loop(computer->cpu, (room > UINT32_MAX) ? UINT32_MAX : (uint32_t)room, &cycles_run);
+    account_for_cycles(computer, cycles_run);
+    if(0 == trip_cycles)
+    {
+        return false;
+    }
+
+    //with nothing scheduled there's nowhere to skip to
+    if(NO_EVENT_SCHEDULED != limit)
+    {
+        skip_cycles(computer, ((limit - computer->elapsed_cycles) / trip_cycles) * trip_cycles);
+    }
+    return true;
+}
+
+//lets the fast engine run instructions back-to-back for (at least) the given
+//number of cycles before catching the rest of the system up. The batch is cut
+//short at the next scheduled event so that devices (and any interrupts they
+//raise) are serviced on time, give or take the instruction that was running.
+//If the program goes idle, time skips ahead to whatever comes first out of
+//the next event and skip_limit (NO_EVENT_SCHEDULED to only stop at events).
+//Returns true if the program is idle with nothing scheduled to wake it up.
+static bool fast_run_cycles(computer_t* computer, uint32_t num_cycles, uint64_t skip_limit)
+{
+    uint64_t next_event = scheduler_next_event_cycle(computer->scheduler);
+    if(next_event <= computer->elapsed_cycles)
+    {
+        num_cycles = 1;
+    }
+    else if(next_event - computer->elapsed_cycles < num_cycles)
+    {
+        num_cycles = (uint32_t)(next_event - computer->elapsed_cycles);
+    }
+
+    if(JIT_ENGINE == computer->engine)
+    {
+        account_for_cycles(computer, cpu_run_translated(computer->cpu, num_cycles));
+    }
+    else
+    {
+        account_for_cycles(computer, cpu_run(computer->cpu, num_cycles));
+    }
+
+    bool idle = skip_idle_cycles(computer, skip_limit);
+    return idle && (NO_EVENT_SCHEDULED == scheduler_next_event_cycle(computer->scheduler));
+}
+
+//execute the next single instruction for the program in memory
+void computer_single_step(computer_t* computer)
+{
+    if(TIMING_ENGINE == computer->engine)
+    {
+        timing_single_step(computer);
+    }
+    else
+    {
+        //every instruction takes at least one cycle, so a one cycle budget
+        //runs exactly one instruction. Translated code always runs a whole
+        //block at a time, so single steps are always interpreted.
+        account_for_cycles(computer, cpu_run(computer->cpu, 1));
+    }
+}
+
+//execute the program in memory until at least the given number of cycles
+//have gone by in total since the computer was reset
+void computer_run_until_cycle(computer_t* computer, uint64_t cycle)
+{
+    const uint32_t FAST_ENGINE_BATCH_CYCLES = 1000;
+    while(computer->elapsed_cycles < cycle)
+    {
+        if(TIMING_ENGINE == computer->engine)
+        {
+            timing_single_step(computer);
+            skip_halted_cycles(computer, cycle);
+        }
+        else
+        {
+            uint64_t remaining = cycle - computer->elapsed_cycles;
+            fast_run_cycles(computer, (remaining < FAST_ENGINE_BATCH_CYCLES) ? (uint32_t)remaining : FAST_ENGINE_BATCH_CYCLES, cycle);
+        }
+    }
+}
+
 //execute the program in memory until told to stop
 void computer_run(computer_t* computer)
 {
+    const uint32_t FAST_ENGINE_BATCH_CYCLES = 1000;
+    //reading the host's clock isn't free, so it's only looked at once this
+    //many cycles have gone by (a small fraction of a frame at any speed)
+    const uint32_t HOST_CLOCK_CHECK_CYCLES = 10000;
     const uint32_t MAX_FPS = 60;
     const uint32_t MAX_TIME_BETWEEN_FRAMES_MILLISECONDS = (1000 / MAX_FPS);
     uint32_t frame_time = 0;
     uint32_t old_frame_time = 0;
+    uint64_t next_clock_check = 0;
 
-    uint32_t timestamp = SDL_GetTicks();
-    simulation_running = true;
-    while(simulation_running)
+    uint32_t timestamp = host_clock_milliseconds();
+    computer->running = true;
+    while(computer->running)
     {
-        computer_single_step(computer);
-        
+        bool waiting_for_input = false;
+        if(TIMING_ENGINE == computer->engine)
+        {
+            computer_single_step(computer);
+            waiting_for_input = skip_halted_cycles(computer, NO_EVENT_SCHEDULED) &&
+                                (NO_EVENT_SCHEDULED == scheduler_next_event_cycle(computer->scheduler));
+        }
+        else
+        {
+            waiting_for_input = fast_run_cycles(computer, FAST_ENGINE_BATCH_CYCLES, NO_EVENT_SCHEDULED);
+        }
+
+        //an idle (or halted) program with nothing scheduled can only be woken
+        //up by the user, so give the host its CPU back until the next frame
+        if(waiting_for_input)
+        {
+            host_clock_sleep(MAX_TIME_BETWEEN_FRAMES_MILLISECONDS);
+        }
+        else if(computer->elapsed_cycles < next_clock_check)
+        {
+            continue;
+        }
+        next_clock_check = computer->elapsed_cycles + HOST_CLOCK_CHECK_CYCLES;
+
         //We are limiting updating the display and taking keyboard input to a
         //60Hz rate because before we were executing these functions at every
         //opportunity, and they cause the rest of the simulation to slow down.
         //They keyboard input is also done at 60Hz because it seems like a
         //reasonable rate to gather events since nobody can possibly type that
-        //fast.
-        frame_time = SDL_GetTicks();
+        //fast. Drawing only hands a copy of the frame buffer to the render
+        //thread, so the simulation never waits for the screen.
+        frame_time = host_clock_milliseconds();
         if(MAX_TIME_BETWEEN_FRAMES_MILLISECONDS < (frame_time - old_frame_time))
         {
             old_frame_time = frame_time;
             graphics_draw(computer->screen);
-            input(computer->keyboard);
+            input(computer->keyboard, graphics_get_key_events(computer->screen));
+            computer->running = !keyboard_quit_requested(computer->keyboard);
         }
 
-        if(SDL_GetTicks() - timestamp >= 1000)
+        if(frame_time - timestamp >= 1000)
         {
-            printf("%d cycles processed \n", cycles);
-            cycles = 0;
-            timestamp = SDL_GetTicks();
+            printf("%d cycles processed, %" PRIu64 " idle cycles skipped in total, %zu RAM pages resident \n",
+                   computer->cycles_this_second, computer->idle_cycles_skipped, memory_resident_pages(computer->RAM));
+            computer->cycles_this_second = 0;
+            timestamp = frame_time;
         }
     }
 }
@@ -182,6 +548,282 @@ void dump_computer_memory(computer_t* computer, size_t starting_address, size_t
     memory_print(computer->RAM, starting_address, ending_address);
 }
 
+uint64_t computer_get_elapsed_cycles(computer_t* computer)
+{
+    return computer->elapsed_cycles;
+}
+
+uint32_t computer_get_register(computer_t* computer, uint8_t register_number)
+{
+    return cpu_get_register(computer->cpu, register_number);
+}
+
+uint32_t computer_get_pc(computer_t* computer)
+{
+    return cpu_get_pc(computer->cpu);
+}
+
+uint64_t computer_hash_memory(computer_t* computer)
+{
+    return memory_hash(computer->RAM);
+}
+
+uint64_t computer_get_idle_cycles_skipped(computer_t* computer)
+{
+    return computer->idle_cycles_skipped;
+}
+
+size_t computer_get_resident_memory_pages(computer_t* computer)
+{
+    return memory_resident_pages(computer->RAM);
+}
+
+uint64_t computer_hash_frame_buffer(computer_t* computer)
+{
+    return graphics_hash_frame_buffer(computer->screen);
+}
+
+static void capture_frame_event(void* context, uint64_t cycle)
+{
+    computer_t* computer = context;
+    graphics_capture_frame(computer->screen, cycle);
+    schedule_capture(computer, cycle + computer->capture_interval);
+}
+
+static void schedule_capture(computer_t* computer, uint64_t cycle)
+{
+    if(0 != computer->capture_interval)
+    {
+        computer->capture_event = scheduler_add_event(computer->scheduler, cycle, &capture_frame_event, computer);
+    }
+}
+
+//Streams the screen to a video file (Y4M if the path ends in ".y4m", raw
+//RGBA frames otherwise) with a frame every cycles_per_frame cycles, starting
+//now. Frames are taken on simulated time rather than the host's, so the
+//video comes out the same on any host and with any engine. Frames where
+//nothing was drawn are left out. Returns false if the file couldn't be made.
+bool computer_start_capture(computer_t* computer, const char* path, uint64_t cycles_per_frame)
+{
+    computer_stop_capture(computer);
+    if((0 == cycles_per_frame) || (cycles_per_frame > UINT32_MAX) ||
+       !graphics_start_capture(computer->screen, path, CPU_CLOCK_HZ, (uint32_t)cycles_per_frame))
+    {
+        return false;
+    }
+
+    computer->capture_interval = cycles_per_frame;
+    graphics_capture_frame(computer->screen, computer->elapsed_cycles);
+    schedule_capture(computer, computer->elapsed_cycles + cycles_per_frame);
+    return true;
+}
+
+//finishes off the video, returns false if any of it couldn't be written
+bool computer_stop_capture(computer_t* computer)
+{
+    if(0 != computer->capture_interval)
+    {
+        scheduler_cancel_event(computer->scheduler, computer->capture_event);
+        computer->capture_interval = 0;
+    }
+    return graphics_stop_capture(computer->screen);
+}
+
+//Plays the key events in the script at the given path into the keyboard, each
+//one on the cycle (counted from the last reset) that the script gives for it.
+//Events that are already in the past are left out. Replaces any script that
+//was already playing. Returns false if the script couldn't be loaded.
+bool computer_load_input_script(computer_t* computer, const char* path)
+{
+    input_script_t* script = input_script_load(path);
+    if(NULL == script)
+    {
+        return false;
+    }
+
+    if(NULL != computer->input_script)
+    {
+        destroy_input_script(computer->input_script);
+    }
+    computer->input_script = script;
+    input_script_start(script, computer->keyboard, computer->scheduler, computer->elapsed_cycles);
+    return true;
+}
+
+static void record_input(void* context, uint32_t scancode)
+{
+    computer_t* computer = context;
+    input_journal_record(computer->journal, computer->elapsed_cycles, scancode);
+}
+
+//Writes every key event that comes in from the host's window to a journal,
+//along with the cycle (counted from the last reset) that it arrived on, until
+//computer_stop_recording(). Replaying the journal with
+//computer_replay_journal() then takes the computer through exactly the same
+//run, so recording has to start before any input comes in and the computer
+//mustn't be reset part way through. Anything else that is scheduled (video
+//capture, input scripts) has to be set up the same way for the replay too.
+//Returns false if the journal couldn't be made.
+bool computer_start_recording(computer_t* computer, const char* path)
+{
+    computer_stop_recording(computer);
+    computer->journal = input_journal_create(path, computer->engine);
+    if(NULL == computer->journal)
+    {
+        return false;
+    }
+
+    keyboard_set_input_listener(computer->keyboard, &record_input, computer);
+    return true;
+}
+
+//marks the journal with the cycle the run got to and closes it, returns false
+//if any of it couldn't be written
+bool computer_stop_recording(computer_t* computer)
+{
+    if(NULL == computer->journal)
+    {
+        return true;
+    }
+
+    keyboard_set_input_listener(computer->keyboard, NULL, NULL);
+    bool written = input_journal_close(computer->journal, computer->elapsed_cycles);
+    computer->journal = NULL;
+    return written;
+}
+
+//Sets the computer up to play back a run recorded by
+//computer_start_recording(): the keys in the journal are played into the
+//keyboard on the cycles that they originally arrived on (replacing any input
+//script), and the computer switches to the engine that the run used, since
+//the engines don't take the same number of cycles to get through a program.
+//The program has to be loaded the same way it was for the recording.
+//Running until end_cycle (where the recording stopped) without a window
+//then ends up in the same state as the recorded run did, as fast as the
+//host can go. Returns false if the journal couldn't be loaded.
+bool computer_replay_journal(computer_t* computer, const char* path, uint64_t* end_cycle)
+{
+    execution_engine_t engine;
+    input_script_t* script = input_journal_load(path, &engine, end_cycle);
+    if(NULL == script)
+    {
+        return false;
+    }
+
+    if(NULL != computer->input_script)
+    {
+        destroy_input_script(computer->input_script);
+    }
+    computer->input_script = script;
+    computer->engine = engine;
+    input_script_start(script, computer->keyboard, computer->scheduler, computer->elapsed_cycles);
+    return true;
+}
+
+static const char STATE_MAGIC[8] = { 'Z', 'C', 'P', 'U', 'S', 'N', 'A', 'P' };
+#define STATE_VERSION       (1)
+//written in the host's byte order, so it reads back differently on a host
+//with the other one
+#define STATE_BYTE_ORDER    (0x01020304)
+#define STATE_COMPRESSED    (1u << 0)
+
+//Saves everything the program running on the computer can see (the cpu, the
+//devices, what's pending at the interrupt controller, the screen and every
+//page of RAM that has anything in it) to a file, so that the computer can be
+//put back in the same state later with computer_restore_state(), on any
+//engine. Compression run-length encodes pages and the screen where that
+//makes them smaller; without it pages are kept whole and page aligned.
+//Returns false if the file couldn't be written, or if the timing engine is
+//part way through an instruction (which it never is between steps or runs).
+bool computer_save_state(computer_t* computer, const char* path, bool compress)
+{
+    if(!cpu_between_instructions(computer->cpu) || bus_is_enabled(computer->bus))
+    {
+        return false;
+    }
+
+    state_writer_t* writer = state_writer_create(path);
+    if(NULL == writer)
+    {
+        return false;
+    }
+
+    for(size_t i = 0; i < sizeof(STATE_MAGIC); i++)
+    {
+        state_write_u8(writer, (uint8_t)STATE_MAGIC[i]);
+    }
+    state_write_u32(writer, STATE_VERSION);
+    state_write_u32(writer, STATE_BYTE_ORDER);
+    state_write_u32(writer, compress ? STATE_COMPRESSED : 0);
+    state_write_u64(writer, computer->elapsed_cycles);
+    state_write_u64(writer, computer->idle_cycles_skipped);
+    cpu_save_state(computer->cpu, writer);
+    interrupt_controller_save_state(computer->interrupt_controller, writer);
+    keyboard_save_state(computer->keyboard, writer);
+    timer_save_state(computer->system_timer, writer, computer->elapsed_cycles);
+    blitter_save_state(computer->blitter, writer, computer->elapsed_cycles);
+    graphics_save_state(computer->screen, writer, compress);
+    memory_save_state(computer->RAM, writer, compress);
+    return state_writer_close(writer);
+}
+
+//Puts the computer back in the state saved by computer_save_state(), carrying
+//on from the cycle it was saved on. The file is mapped into memory and only
+//the pages that were saved are copied out, so this takes about as long as
+//reading the file does. Video capture and input scripts carry on from the
+//restored cycle. Returns false if the file can't be read or isn't a state
+//image from this version of the simulator; the computer is left as it was if
+//the file can't be used at all and is reset if it turns out to be damaged.
+bool computer_restore_state(computer_t* computer, const char* path)
+{
+    state_reader_t* reader = state_reader_open(path);
+    if(NULL == reader)
+    {
+        return false;
+    }
+
+    bool magic_matches = true;
+    for(size_t i = 0; i < sizeof(STATE_MAGIC); i++)
+    {
+        magic_matches = (state_read_u8(reader) == (uint8_t)STATE_MAGIC[i]) && magic_matches;
+    }
+    uint32_t version = state_read_u32(reader);
+    uint32_t byte_order = state_read_u32(reader);
+    state_read_u32(reader); //the flags only say how the pages are stored, which each page says too
+    if(!state_reader_check(reader, magic_matches && (STATE_VERSION == version) && (STATE_BYTE_ORDER == byte_order)))
+    {
+        state_reader_close(reader);
+        return false;
+    }
+
+    computer_reset(computer);
+    computer->elapsed_cycles = state_read_u64(reader);
+    computer->idle_cycles_skipped = state_read_u64(reader);
+    restart_scheduled_events(computer);
+    cpu_restore_state(computer->cpu, reader);
+    interrupt_controller_restore_state(computer->interrupt_controller, reader);
+    keyboard_restore_state(computer->keyboard, reader);
+    timer_restore_state(computer->system_timer, reader, computer->elapsed_cycles);
+    blitter_restore_state(computer->blitter, reader, computer->elapsed_cycles);
+    graphics_restore_state(computer->screen, reader);
+    memory_restore_state(computer->RAM, reader);
+
+    bool restored = !state_reader_failed(reader) && state_reader_at_end(reader);
+    state_reader_close(reader);
+    if(!restored)
+    {
+        computer_reset(computer);
+    }
+    return restored;
+}
+
+//writes out what's on the computer's screen, as a PPM image if the path ends
+//in ".ppm" and as raw RGBA bytes otherwise. Returns false if it couldn't.
+bool computer_dump_frame_buffer(computer_t* computer, const char* path)
+{
+    return graphics_dump_frame(computer->screen, path, graphics_dump_format_for_path(path));
+}
+
 void computer_print_elapsed_cycles(computer_t* computer)
 {
     printf("the number of elapsed cycles is now %" PRIu64 "\n", computer->elapsed_cycles);
@@ -18,7 +18,9 @@
 #include "cpu.h"
 #include "cpu_private.h"
 #include "cpu_ops.h"
+#include "cpu_jit.h"
 #include "bit_twiddling.h"
+#include "opcode_list.h"
 #include "interrupt_controller.h"
 #include <stdio.h>
 #include <string.h>
@@ -27,10 +29,6 @@
 
 
 
-enum cpu_pipeline_stage_t { INTERRUPT, FETCH1, FETCH2, DECODE, MEMORY1, MEMORY2, EXECUTE };
-
-enum cpu_pipeline_stage_t pipeline_stage = INTERRUPT;
-
 static void install_opcodes(cpu_t* cpu);
 static void update_pc(cpu_t* cpu);
 static void interrupt(cpu_t* cpu);
@@ -43,26 +41,25 @@ static void execute(cpu_t* cpu);
 //static void write_back(cpu_t* cpu);
 
 typedef void (*pipeline_stage_t)(cpu_t*);
-pipeline_stage_t pipeline_stages[] = { &interrupt, &fetch1, &fetch2, &decode, &memory1, &memory2, &execute};
+static const pipeline_stage_t pipeline_stages[] = { &interrupt, &fetch1, &fetch2, &decode, &memory1, &memory2, &execute};
 
 
 static uint32_t* get_source_reg1(cpu_t* cpu);
 static uint32_t* get_source_reg2(cpu_t* cpu);
 static uint32_t* get_destination_reg1(cpu_t* cpu);
 static uint32_t* get_destination_reg2(cpu_t* cpu);
-static bool get_immediate_mode_flag(cpu_t* cpu);
-static uint32_t get_ALU_immediate_bits(cpu_t* cpu);
-static uint32_t get_opcode(cpu_t* cpu);
+static bool get_immediate_mode_flag(uint32_t instruction);
+static uint32_t get_ALU_immediate_bits(uint32_t instruction);
+static uint32_t get_opcode(uint32_t instruction);
 static cpu_op get_instruction(cpu_t* cpu);
-static uint32_t get_pc_relative_offset(cpu_t* cpu);
-static uint32_t* get_base_reg(cpu_t* cpu);
-static uint8_t get_condition_code_bits(cpu_t* cpu);
+static uint32_t get_pc_relative_offset(uint32_t instruction);
+static uint8_t get_condition_code_bits(uint32_t instruction);
 
 
 //extracts the encoded condition code bits from the instruction
-static uint8_t get_condition_code_bits(cpu_t* cpu)
+static uint8_t get_condition_code_bits(uint32_t instruction)
 {
-    return GET_BITS_IN_RANGE(cpu->IR, 23 ,25);
+    return GET_BITS_IN_RANGE(instruction, 23 ,25);
 }
 
 
@@ -113,9 +110,9 @@ static void install_opcodes(cpu_t* cpu)
     cpu->opcodes = get_instruction_table();
 }
 
-static uint32_t get_opcode(cpu_t* cpu)
+static uint32_t get_opcode(uint32_t instruction)
 {
-    return GET_BITS_IN_RANGE(cpu->IR, 26, 31);
+    return GET_BITS_IN_RANGE(instruction, 26, 31);
 }
 
 #warning FIXME!! the source and destination register encodings in the instructions might prove problematic when we add multiplication! Think about how to fix this!
@@ -151,46 +148,40 @@ static uint32_t* get_store_source_reg(cpu_t* cpu)
     return &cpu->registers[reg_name];
 }
 
-static bool get_immediate_mode_flag(cpu_t* cpu)
+static bool get_immediate_mode_flag(uint32_t instruction)
 {
     //the last bit of the instruction is the immediate mode flag
     const uint8_t IMMEDIATE_MODE_BIT = 0;
-    return CHECK_BIT_SET(cpu->IR, IMMEDIATE_MODE_BIT);
+    return CHECK_BIT_SET(instruction, IMMEDIATE_MODE_BIT);
 }
 
 //gets the 15-bit immediate mode operand from the instruction for ALU operations
-static uint32_t get_ALU_immediate_bits(cpu_t* cpu)
+static uint32_t get_ALU_immediate_bits(uint32_t instruction)
 {
-    return GET_BITS_IN_RANGE(cpu->IR, 1, 15);
+    return GET_BITS_IN_RANGE(instruction, 1, 15);
 }
 
 //gets the 21-bit pc-relative offset encoded in the load/store instruction
-static uint32_t get_pc_relative_offset(cpu_t* cpu)
+static uint32_t get_pc_relative_offset(uint32_t instruction)
 {
-    return GET_BITS_IN_RANGE(cpu->IR, 0, 20);
-}
-
-static uint32_t* get_base_reg(cpu_t* cpu)
-{
-    uint32_t reg_name = GET_BITS_IN_RANGE(cpu->IR, 16, 20);
-    return &cpu->registers[reg_name];
+    return GET_BITS_IN_RANGE(instruction, 0, 20);
 }
 
 //get the 16-bit base-register offset for base_reg + offset style instructions
-static uint32_t get_base_register_offset(cpu_t* cpu)
+static uint32_t get_base_register_offset(uint32_t instruction)
 {
-    return GET_BITS_IN_RANGE(cpu->IR, 0, 15);
+    return GET_BITS_IN_RANGE(instruction, 0, 15);
 }
 
 //get the 26-bit pc-relative offset for the jump instruction
-static uint32_t get_jump_pc_offset(cpu_t* cpu)
+static uint32_t get_jump_pc_offset(uint32_t instruction)
 {
-    return GET_BITS_IN_RANGE(cpu->IR, 0, 25);
+    return GET_BITS_IN_RANGE(instruction, 0, 25);
 }
 
-static uint32_t get_branch_pc_offset(cpu_t* cpu)
+static uint32_t get_branch_pc_offset(uint32_t instruction)
 {
-    return GET_BITS_IN_RANGE(cpu->IR, 0, 22);
+    return GET_BITS_IN_RANGE(instruction, 0, 22);
 }
 
 static uint32_t* get_trap_vector_register(cpu_t* cpu)
@@ -201,17 +192,23 @@ static uint32_t* get_trap_vector_register(cpu_t* cpu)
 
 static void interrupt(cpu_t* cpu)
 {
-    if(interrupt_requested(cpu->ic) && !interrupt_in_process(cpu))
+    //a halted cpu sits in this stage until an interrupt wakes it up
+    if(cpu_waiting_for_interrupt(cpu))
+    {
+        return;
+    }
+
+    if(interrupt_can_be_taken(cpu))
     {
         enter_interrupt_mode(cpu);
     }
 
-    pipeline_stage = FETCH1;
+    cpu->pipeline_stage = FETCH1;
 }
 
 static void fetch1(cpu_t* cpu)
 {
-    pipeline_stage = FETCH2;
+    cpu->pipeline_stage = FETCH2;
     cpu->MAR = cpu->PC;
     update_pc(cpu);
     bus_enable(cpu->bus);
@@ -223,7 +220,7 @@ static void fetch2(cpu_t* cpu)
 {
     if(bus_is_device_ready(cpu->bus))
     {
-        pipeline_stage = DECODE;
+        cpu->pipeline_stage = DECODE;
         cpu->MDR = bus_get_data_lines(cpu->bus);
         cpu->IR = cpu->MDR;
         bus_clear_device_ready(cpu->bus);
@@ -231,59 +228,164 @@ static void fetch2(cpu_t* cpu)
     }
     else
     {
-        pipeline_stage = FETCH2;
+        cpu->pipeline_stage = FETCH2;
     }
 
 }
 
-static void decode(cpu_t* cpu)
+//the different ways that the fields of an instruction can be laid out; every
+//opcode uses exactly one of these encodings
+enum instruction_format_t
+{
+    NO_OPERANDS_FORMAT,
+    ALU_FORMAT,
+    PC_RELATIVE_FORMAT,
+    BASE_PLUS_OFFSET_FORMAT,
+    JUMP_FORMAT,
+    BRANCH_FORMAT,
+    TRAP_FORMAT
+};
+
+static enum instruction_format_t get_instruction_format(uint32_t opcode)
+{
+    switch(opcode)
+    {
+        case OPCODE_AND: case OPCODE_OR: case OPCODE_NOT: case OPCODE_XOR:
+        case OPCODE_ADD: case OPCODE_SUB: case OPCODE_MUL: case OPCODE_DIV:
+        case OPCODE_COMPARE: case OPCODE_SHIFTL: case OPCODE_ASHIFTR:
+            return ALU_FORMAT;
+        case OPCODE_LOAD: case OPCODE_LOADA: case OPCODE_STORE:
+            return PC_RELATIVE_FORMAT;
+        case OPCODE_LOADR: case OPCODE_STORER: case OPCODE_JUMPR: case OPCODE_CALLR:
+            return BASE_PLUS_OFFSET_FORMAT;
+        case OPCODE_JUMP: case OPCODE_CALL:
+            return JUMP_FORMAT;
+        case OPCODE_BRANCH:
+            return BRANCH_FORMAT;
+        case OPCODE_TRAP:
+            return TRAP_FORMAT;
+        default:
+            return NO_OPERANDS_FORMAT;
+    }
+}
+
+//extracts only the fields of the given instruction word that its encoding
+//format actually uses and stores them in the given decoded instruction record
+void predecode_instruction(cpu_t* cpu, decoded_instruction_t* decoded, uint32_t address, uint32_t instruction)
+{
+    decoded->address = address;
+    decoded->instruction = instruction;
+    decoded->opcode = get_opcode(instruction);
+    decoded->handler = (*cpu->opcodes)[decoded->opcode];
+    decoded->format = get_instruction_format(decoded->opcode);
+    decoded->reg_a = GET_BITS_IN_RANGE(instruction, 21, 25);
+    decoded->reg_b = GET_BITS_IN_RANGE(instruction, 16, 20);
+    decoded->reg_c = GET_BITS_IN_RANGE(instruction, 11, 15);
+    decoded->condition_codes = 0;
+    decoded->immediate_mode = false;
+    decoded->offset = 0;
+
+    switch(decoded->format)
+    {
+        case ALU_FORMAT:
+            decoded->immediate_mode = get_immediate_mode_flag(instruction);
+            decoded->offset = sign_extend_ALU_immediate_bits(get_ALU_immediate_bits(instruction));
+            break;
+        case PC_RELATIVE_FORMAT:
+            decoded->offset = sign_extend_pc_relative_offset(get_pc_relative_offset(instruction));
+            break;
+        case BASE_PLUS_OFFSET_FORMAT:
+            decoded->offset = sign_extend_base_offset(get_base_register_offset(instruction));
+            break;
+        case JUMP_FORMAT:
+            decoded->offset = sign_extend_jump_pc_relative_offset(get_jump_pc_offset(instruction));
+            break;
+        case BRANCH_FORMAT:
+            decoded->condition_codes = get_condition_code_bits(instruction);
+            decoded->offset = sign_extend_branch_pc_relative_offset(get_branch_pc_offset(instruction));
+            break;
+        default:
+            break;
+    }
+    decoded->valid = true;
+}
+
+//looks up the instruction that was fetched from the given address in the
+//decode cache, decoding it and filling in the cache entry on a miss
+static const decoded_instruction_t* get_decoded_instruction(cpu_t* cpu, uint32_t address)
 {
-    uint32_t instruction = cpu->IR;
-    cpu->opcode = GET_BITS_IN_RANGE(instruction, 26, 31);
-    //we don't know what kind of instruction we have yet, but we can speculatively
-    //gather other information like source registers and what not because during
-    //execution, the instructions will only reference what they need, effectively discarding the
-    //garbage information in the other registers
-    cpu->source_reg1 = &cpu->registers[GET_BITS_IN_RANGE(instruction, 16, 20)];
-    cpu->source_reg2 = &cpu->registers[GET_BITS_IN_RANGE(instruction, 11, 15)];
+    decoded_instruction_t* decoded = &cpu->decode_cache[address & (DECODE_CACHE_SIZE - 1)];
+    if(!decoded->valid || decoded->address != address)
+    {
+        predecode_instruction(cpu, decoded, address, cpu->IR);
+    }
+    return decoded;
+}
 
+//stores that overwrite an instruction that we have already decoded or
+//translated must throw away the stale copy (i.e. self-modifying code and
+//program loading)
+void invalidate_decoded_instruction(cpu_t* cpu, uint32_t address)
+{
+    decoded_instruction_t* decoded = &cpu->decode_cache[address & (DECODE_CACHE_SIZE - 1)];
+    if(decoded->address == address)
+    {
+        decoded->valid = false;
+    }
 
-    cpu->destination_reg1 = &cpu->registers[GET_BITS_IN_RANGE(instruction, 21, 25)];
-    cpu->destination_reg2 = &cpu->registers[GET_BITS_IN_RANGE(instruction, 6, 10)];
+    if(NULL != cpu->jit)
+    {
+        jit_note_store(cpu->jit, address);
+    }
+}
 
-    cpu->store_source_reg = &cpu->registers[GET_BITS_IN_RANGE(instruction, 21, 25)];
+//sets up the operand registers/offsets that the instruction handlers read
+//from. Only the fields belonging to the instruction's format are touched,
+//since the handlers never look at the others
+static void unpack_decoded_instruction(cpu_t* cpu, const decoded_instruction_t* decoded)
+{
+    cpu->decoded_instruction = decoded;
+    cpu->opcode = decoded->opcode;
 
-    cpu->trap_vector_register = &cpu->registers[GET_BITS_IN_RANGE(instruction, 21, 25)];
+    switch(decoded->format)
+    {
+        case ALU_FORMAT:
+            cpu->destination_reg1 = &cpu->registers[decoded->reg_a];
+            cpu->source_reg1 = &cpu->registers[decoded->reg_b];
+            cpu->source_reg2 = &cpu->registers[decoded->reg_c];
+            cpu->immediate_mode = decoded->immediate_mode;
+            cpu->ALU_immediate_bits = decoded->offset;
+            break;
+        case PC_RELATIVE_FORMAT:
+            cpu->destination_reg1 = &cpu->registers[decoded->reg_a];
+            cpu->store_source_reg = &cpu->registers[decoded->reg_a];
+            cpu->load_pc_relative_offset_bits = decoded->offset;
+            break;
+        case BASE_PLUS_OFFSET_FORMAT:
+            cpu->destination_reg1 = &cpu->registers[decoded->reg_a];
+            cpu->store_source_reg = &cpu->registers[decoded->reg_a];
+            cpu->base_reg = &cpu->registers[decoded->reg_b];
+            cpu->base_register_offset_bits = decoded->offset;
+            break;
+        case JUMP_FORMAT:
+            cpu->jump_pc_relative_offset_bits = decoded->offset;
+            break;
+        case BRANCH_FORMAT:
+            cpu->instruction_condition_codes = decoded->condition_codes;
+            cpu->branch_pc_relative_offset_bits = decoded->offset;
+            break;
+        case TRAP_FORMAT:
+            cpu->trap_vector_register = &cpu->registers[decoded->reg_a];
+            break;
+        default:
+            break;
+    }
+}
 
-    cpu->immediate_mode = CHECK_BIT_SET(instruction, 0);
-    cpu->instruction_condition_codes = get_condition_code_bits(cpu);
-    cpu->ALU_immediate_bits = sign_extend_ALU_immediate_bits(get_ALU_immediate_bits(cpu));
-    cpu->load_pc_relative_offset_bits = sign_extend_pc_relative_offset(get_pc_relative_offset(cpu));
-    cpu->base_reg = get_base_reg(cpu);
-    cpu->base_register_offset_bits = sign_extend_base_offset(get_base_register_offset(cpu));
-    cpu->jump_pc_relative_offset_bits = sign_extend_jump_pc_relative_offset(get_jump_pc_offset(cpu));
-    cpu->branch_pc_relative_offset_bits = sign_extend_branch_pc_relative_offset(get_branch_pc_offset(cpu));
-#if 0
-    cpu->opcode = get_opcode(cpu);
-    //we don't know what kind of instruction we have yet, but we can speculatively 
-    //gather other information like source registers and what not because during
-    //execution, the instructions will only reference what they need, effectively discarding the
-    //garbage information in the other registers
-    cpu->source_reg1 = get_source_reg1(cpu);
-    cpu->source_reg2 = get_source_reg2(cpu);
-    cpu->destination_reg1 = get_destination_reg1(cpu);
-    cpu->destination_reg2 = get_destination_reg2(cpu);
-    cpu->store_source_reg = get_store_source_reg(cpu);
-    cpu->trap_vector_register = get_trap_vector_register(cpu);
-    cpu->immediate_mode = get_immediate_mode_flag(cpu);
-    cpu->instruction_condition_codes = get_condition_code_bits(cpu);
-    cpu->ALU_immediate_bits = sign_extend_ALU_immediate_bits(get_ALU_immediate_bits(cpu));
-    cpu->load_pc_relative_offset_bits = sign_extend_pc_relative_offset(get_pc_relative_offset(cpu));
-    cpu->base_reg = get_base_reg(cpu);
-    cpu->base_register_offset_bits = sign_extend_base_offset(get_base_register_offset(cpu));
-    cpu->jump_pc_relative_offset_bits = sign_extend_jump_pc_relative_offset(get_jump_pc_offset(cpu));
-    cpu->branch_pc_relative_offset_bits = sign_extend_branch_pc_relative_offset(get_branch_pc_offset(cpu));
-#endif
+static void decode(cpu_t* cpu)
+{
+    //the MAR still holds the address that the instruction was fetched from
+    unpack_decoded_instruction(cpu, get_decoded_instruction(cpu, cpu->MAR));
 
     //load/store instructions get special treatment in our FSM
     if(is_memory_instruction(cpu->opcode))
@@ -292,30 +394,36 @@ static void decode(cpu_t* cpu)
         {
             //This instruction doesn't actually access memory, it just loads an
             //address into a register, so skip the memory accesses
-            pipeline_stage = EXECUTE;
+            cpu->pipeline_stage = EXECUTE;
         }
         else
         {
-            pipeline_stage = MEMORY1;
+            cpu->pipeline_stage = MEMORY1;
         }
     }
     else
     {
-        pipeline_stage = EXECUTE;
+        cpu->pipeline_stage = EXECUTE;
     }
 }
 
-static void memory1(cpu_t* cpu)
+//computes the address that a load/store instruction accesses
+static uint32_t get_memory_operand_address(cpu_t* cpu)
 {
-    pipeline_stage = MEMORY2;
     if(is_pc_relative_instruction(cpu->opcode))
     {
-        cpu->MAR = cpu->PC + cpu->load_pc_relative_offset_bits;
+        return cpu->PC + cpu->load_pc_relative_offset_bits;
     }
     else //base register + offset
     {
-        cpu->MAR = *cpu->base_reg + cpu->base_register_offset_bits;
+        return *cpu->base_reg + cpu->base_register_offset_bits;
     }
+}
+
+static void memory1(cpu_t* cpu)
+{
+    cpu->pipeline_stage = MEMORY2;
+    cpu->MAR = get_memory_operand_address(cpu);
 
     bus_enable(cpu->bus);
     bus_set_address_lines(cpu->bus, cpu->MAR);
@@ -326,6 +434,7 @@ static void memory1(cpu_t* cpu)
     else //store instruction
     {
         bus_set_write_operation(cpu->bus);
+        invalidate_decoded_instruction(cpu, cpu->MAR);
         cpu->MDR = *cpu->store_source_reg;
         bus_set_data_lines(cpu->bus, cpu->MDR);
     }
@@ -341,19 +450,19 @@ static void memory2(cpu_t* cpu)
         if(is_load_instruction(cpu->opcode))
         {
             cpu->MDR = bus_get_data_lines(cpu->bus);
-            pipeline_stage = EXECUTE;
+            cpu->pipeline_stage = EXECUTE;
         }
         else
         {
             //store instructions don't really have anything to execute, they
             //are purely memory access commands, so we can go back to fetch
             //instead of executing nothing
-            pipeline_stage = INTERRUPT;
+            cpu->pipeline_stage = INTERRUPT;
         }
     }
     else
     {
-        pipeline_stage = MEMORY2;
+        cpu->pipeline_stage = MEMORY2;
     }
 }
 
@@ -361,12 +470,12 @@ static void execute(cpu_t* cpu)
 {
     cpu_op instruction = get_instruction(cpu);
     instruction(cpu);
-    pipeline_stage = INTERRUPT;
+    cpu->pipeline_stage = INTERRUPT;
 }
 
 static cpu_op get_instruction(cpu_t* cpu)
 {
-    return (*cpu->opcodes)[cpu->opcode];
+    return cpu->decoded_instruction->handler;
 }
 
 #if 0
@@ -388,6 +497,10 @@ cpu_t* make_cpu(memory_bus_t* bus, interrupt_controller_t* ic)
     cpu_t* new_cpu = calloc(1, sizeof(struct cpu));
     new_cpu->bus = bus;
     new_cpu->ic = ic;
+    new_cpu->decode_cache = calloc(DECODE_CACHE_SIZE, sizeof(decoded_instruction_t));
+    new_cpu->tlb = calloc(TLB_SIZE, sizeof(tlb_entry_t));
+    cpu_flush_tlb(new_cpu);
+    new_cpu->registers = new_cpu->register_banks[0];
     return new_cpu;
 }
 
@@ -395,9 +508,13 @@ void cpu_reset(cpu_t* cpu)
 {
     const uint32_t INITIAL_ADDRESS = 0x00;
     const uint32_t INITIAL_VALUE = 0x00;
-    memset(cpu->registers, INITIAL_VALUE, sizeof(cpu->registers));
+    memset(cpu->register_banks, INITIAL_VALUE, sizeof(cpu->register_banks));
+    cpu->registers = cpu->register_banks[0];
+    cpu->interrupt_depth = 0;
+    cpu->process_status_reg = INITIAL_VALUE;
     cpu->PC = INITIAL_ADDRESS;
     cpu->CCR = INITIAL_VALUE;
+    cpu->condition_codes_pending = false;
     cpu->IR = INITIAL_VALUE;
     cpu->MDR = INITIAL_VALUE;
     cpu->MAR = INITIAL_ADDRESS;
@@ -408,6 +525,46 @@ void cpu_reset(cpu_t* cpu)
     cpu->destination_reg2 = NULL;
     cpu->immediate_mode = false;
     cpu->ALU_immediate_bits = INITIAL_VALUE;
+    cpu->decoded_instruction = NULL;
+    cpu->waiting_for_interrupt = false;
+    cpu->pipeline_stage = INTERRUPT;
+    cpu_flush_decoded_instructions(cpu);
+    cpu_flush_tlb(cpu);
+}
+
+//forgets every guest page to host page mapping, which have to be looked up
+//again through the memory port
+void cpu_flush_tlb(cpu_t* cpu)
+{
+    for(uint32_t i = 0; i < TLB_SIZE; i++)
+    {
+        cpu->tlb[i].page_number = TLB_INVALID_PAGE;
+        cpu->tlb[i].page = NULL;
+    }
+}
+
+//looks up a page that missed in the TLB. Device pages are remembered too (as
+//NULL) so that they go straight to the read/write callbacks next time.
+void fill_tlb_entry(cpu_t* cpu, tlb_entry_t* entry, uint32_t page_number)
+{
+    entry->page_number = page_number;
+    entry->page = NULL;
+    if(NULL != cpu->translate_memory)
+    {
+        entry->page = cpu->translate_memory(cpu->memory_port_context, page_number << CPU_PAGE_OFFSET_BITS);
+    }
+}
+
+//throws away every pre-decoded and translated instruction; this must be done whenever memory
+//is changed behind the CPU's back (e.g. when a new program is loaded)
+void cpu_flush_decoded_instructions(cpu_t* cpu)
+{
+    memset(cpu->decode_cache, 0x00, DECODE_CACHE_SIZE * sizeof(decoded_instruction_t));
+
+    if(NULL != cpu->jit)
+    {
+        jit_flush(cpu->jit);
+    }
 }
 
 void init_cpu(cpu_t* cpu)
@@ -418,6 +575,12 @@ void init_cpu(cpu_t* cpu)
 
 void destroy_cpu(cpu_t* cpu)
 {
+    if(NULL != cpu->jit)
+    {
+        destroy_jit(cpu->jit);
+    }
+    free(cpu->decode_cache);
+    free(cpu->tlb);
     free(cpu);
 }
 
@@ -425,7 +588,7 @@ void dump_cpu_state(cpu_t* cpu)
 {
     printf("\n\n**** CPU STATE ****\n\n");
     printf("PC = 0x%08X \t IR = 0x%08X\n", cpu->PC, cpu->IR);
-    printf("CCR = 0x%08X\n", cpu->CCR);
+    printf("CCR = 0x%08X\n", get_condition_code_register(cpu));
     printf("MDR = 0x%08X \t MAR = 0x%08X\n\n", cpu->MDR, cpu->MAR);
 
     for (int i = 0; i < NUM_REGISTERS; i+=2)
@@ -434,14 +597,543 @@ void dump_cpu_state(cpu_t* cpu)
     }
 }
 
+uint32_t cpu_get_register(cpu_t* cpu, uint8_t register_number)
+{
+    return cpu->registers[register_number % NUM_REGISTERS];
+}
+
+uint32_t cpu_get_pc(cpu_t* cpu)
+{
+    return cpu->PC;
+}
+
+//a cpu that has been halted by a WFI instruction wakes back up as soon as an
+//interrupt is requested. Returns true if it is still halted.
+bool cpu_waiting_for_interrupt(cpu_t* cpu)
+{
+    if(cpu->waiting_for_interrupt && interrupt_requested(cpu->ic))
+    {
+        cpu->waiting_for_interrupt = false;
+    }
+    return cpu->waiting_for_interrupt;
+}
+
+//The timing engine can stop part way through an instruction, with it spread
+//out across the pipeline registers and the bus. State can only be saved once
+//the instruction is done.
+bool cpu_between_instructions(cpu_t* cpu)
+{
+    return INTERRUPT == cpu->pipeline_stage;
+}
+
+//which register bank a pointer into the banks is to
+static uint8_t bank_index(cpu_t* cpu, const uint32_t* registers)
+{
+    return (NULL == registers) ? 0 : (uint8_t)((registers - cpu->register_banks[0]) / NUM_REGISTERS);
+}
+
+//Only state that the program can see is saved, anything cached (decoded or
+//translated instructions, the TLB) is just built up again. The register
+//banks are kept as indexes, since pointers won't mean anything next time.
+void cpu_save_state(cpu_t* cpu, state_writer_t* writer)
+{
+    state_write_u8(writer, INTERRUPT_NESTING_DEPTH);
+    state_write_u32(writer, cpu->PC);
+    state_write_u32(writer, get_condition_code_register(cpu));
+    state_write_u32(writer, cpu->process_status_reg);
+    state_write_u32(writer, cpu->IR);
+    state_write_u32(writer, cpu->MDR);
+    state_write_u32(writer, cpu->MAR);
+    state_write_u8(writer, (uint8_t)cpu->pipeline_stage);
+    state_write_u8(writer, cpu->waiting_for_interrupt);
+    state_write_u8(writer, cpu->interrupt_depth);
+    state_write_u8(writer, bank_index(cpu, cpu->registers));
+    state_write_words(writer, cpu->register_banks[0], sizeof(cpu->register_banks) / sizeof(uint32_t));
+    for(uint8_t i = 0; i < INTERRUPT_NESTING_DEPTH; i++)
+    {
+        const interrupt_frame_t* frame = &cpu->interrupt_frames[i];
+        state_write_u8(writer, frame->irq);
+        state_write_u8(writer, frame->state_saved);
+        state_write_u8(writer, frame->state_saved ? bank_index(cpu, frame->registers) : 0);
+        state_write_u32(writer, frame->state.PC);
+        state_write_u32(writer, frame->state.CCR);
+        state_write_u32(writer, frame->state.process_status_reg);
+    }
+}
+
+//the cpu has to have been reset first
+void cpu_restore_state(cpu_t* cpu, state_reader_t* reader)
+{
+    if(!state_reader_check(reader, INTERRUPT_NESTING_DEPTH == state_read_u8(reader)))
+    {
+        return;
+    }
+
+    cpu->PC = state_read_u32(reader);
+    cpu->CCR = state_read_u32(reader);
+    cpu->condition_codes_pending = false;
+    cpu->process_status_reg = state_read_u32(reader);
+    cpu->IR = state_read_u32(reader);
+    cpu->MDR = state_read_u32(reader);
+    cpu->MAR = state_read_u32(reader);
+    uint8_t pipeline_stage = state_read_u8(reader);
+    cpu->waiting_for_interrupt = (0 != state_read_u8(reader));
+    cpu->interrupt_depth = state_read_u8(reader);
+    uint8_t active_bank = state_read_u8(reader);
+    state_reader_check(reader, (INTERRUPT == pipeline_stage) && (cpu->interrupt_depth <= INTERRUPT_NESTING_DEPTH) &&
+                               (active_bank <= INTERRUPT_NESTING_DEPTH));
+    state_read_words(reader, cpu->register_banks[0], sizeof(cpu->register_banks) / sizeof(uint32_t));
+    for(uint8_t i = 0; i < INTERRUPT_NESTING_DEPTH; i++)
+    {
+        interrupt_frame_t* frame = &cpu->interrupt_frames[i];
+        frame->irq = state_read_u8(reader);
+        frame->state_saved = (0 != state_read_u8(reader));
+        uint8_t frame_bank = state_read_u8(reader);
+        state_reader_check(reader, frame_bank <= INTERRUPT_NESTING_DEPTH);
+        frame->registers = cpu->register_banks[state_reader_failed(reader) ? 0 : frame_bank];
+        frame->state.PC = state_read_u32(reader);
+        frame->state.CCR = state_read_u32(reader);
+        frame->state.process_status_reg = state_read_u32(reader);
+    }
+
+    if(state_reader_failed(reader))
+    {
+        cpu_reset(cpu);
+        return;
+    }
+    cpu->registers = cpu->register_banks[active_bank];
+    cpu->pipeline_stage = INTERRUPT;
+    cpu_flush_decoded_instructions(cpu);
+    cpu_flush_tlb(cpu);
+}
+
+//The fast engine accesses memory through these callbacks instead of the bus.
+//translate is optional, without it every access goes through read/write.
+void cpu_attach_memory_port(cpu_t* cpu, cpu_memory_read_t read, cpu_memory_write_t write, cpu_memory_translate_t translate, void* context)
+{
+    cpu->read_memory = read;
+    cpu->write_memory = write;
+    cpu->translate_memory = translate;
+    cpu->memory_port_context = context;
+    cpu_flush_tlb(cpu);
+}
+
+//fetches the instruction at the given address for the fast engine. Memory
+//only needs to be read on a decode cache miss, since stores invalidate any
+//cached copy of the word they overwrite
+static const decoded_instruction_t* fetch_decoded_instruction(cpu_t* cpu, uint32_t address)
+{
+    decoded_instruction_t* decoded = &cpu->decode_cache[address & (DECODE_CACHE_SIZE - 1)];
+    if(!decoded->valid || decoded->address != address)
+    {
+        predecode_instruction(cpu, decoded, address, memory_port_read(cpu, address));
+    }
+    cpu->IR = decoded->instruction;
+    cpu->MDR = cpu->IR;
+    return decoded;
+}
+
+void check_for_interrupts(cpu_t* cpu)
+{
+    if(interrupt_can_be_taken(cpu))
+    {
+        enter_interrupt_mode(cpu);
+    }
+}
+
+//how long each kind of instruction takes in the timing engine: 1 cycle for
+//the interrupt stage, 3 for each memory access, and 1 each for decoding
+//and executing (stores have nothing to execute)
+static const uint32_t INSTRUCTION_CYCLES = 6;
+static const uint32_t LOAD_INSTRUCTION_CYCLES = 9;
+static const uint32_t STORE_INSTRUCTION_CYCLES = 8;
+
+//the longest loop (in instructions) that is checked to see if the program is
+//just spinning its wheels
+#define IDLE_LOOP_MAX_LENGTH    8
+
+//Works out if the straight run of instructions starting at head is a loop
+//that can never get anywhere: it has to be short, end with a JUMP/BRANCH back
+//to head, and contain nothing but ALU operations and loads (no stores, calls,
+//traps or other branches). On top of that, no register can be read before it
+//has been written in the same trip around the loop if it is written anywhere
+//in it, so that nothing gets carried over from one trip to the next. Every
+//trip then computes exactly the same thing as the one before it (memory can't
+//change, since nothing stores to it), so once one full trip has been made the
+//program is stuck until an interrupt comes along.
+//
+//Returns how many cycles one trip around the loop takes, or 0 if it isn't
+//that kind of loop. Instructions are read straight from RAM (code in device
+//memory never counts) so that the decode cache isn't disturbed. Loads only
+//count if they read RAM too, since a device (the timer's value, say) can
+//change underneath the loop without anything storing to it. Base + offset
+//loads are checked against the base register as it is now, so this has to be
+//asked again once the cpu has got to head.
+static uint32_t find_idle_loop(cpu_t* cpu, uint32_t head)
+{
+    uint32_t written = 0;       //registers written anywhere in the loop so far
+    uint32_t read_first = 0;    //registers read before they were written on this trip
+    uint32_t cycles = 0;
+
+    for(uint32_t i = 0; i < IDLE_LOOP_MAX_LENGTH; i++)
+    {
+        uint32_t* word = translate_guest_address(cpu, head + i);
+        if(NULL == word)
+        {
+            return 0;
+        }
+
+        decoded_instruction_t decoded;
+        predecode_instruction(cpu, &decoded, head + i, *word);
+        uint32_t sources = 0;
+        switch(decoded.opcode)
+        {
+            case OPCODE_AND: case OPCODE_OR: case OPCODE_XOR: case OPCODE_ADD: case OPCODE_SUB:
+                sources = (1u << decoded.reg_b) | (decoded.immediate_mode ? 0 : (1u << decoded.reg_c));
+                cycles += INSTRUCTION_CYCLES;
+                break;
+            case OPCODE_NOT:
+                sources = 1u << decoded.reg_b;
+                cycles += INSTRUCTION_CYCLES;
+                break;
+            case OPCODE_LOADR:
+                //the address has to be the same on every trip, so the base
+                //register can't have been worked out earlier in the loop
+                if((0 != (written & (1u << decoded.reg_b))) ||
+                   (NULL == translate_guest_address(cpu, cpu->registers[decoded.reg_b] + decoded.offset)))
+                {
+                    return 0;
+                }
+                sources = 1u << decoded.reg_b;
+                cycles += LOAD_INSTRUCTION_CYCLES;
+                break;
+            case OPCODE_LOAD:
+                if(NULL == translate_guest_address(cpu, head + i + 1 + decoded.offset))
+                {
+                    return 0;
+                }
+                cycles += LOAD_INSTRUCTION_CYCLES;
+                break;
+            case OPCODE_LOADA:
+                cycles += INSTRUCTION_CYCLES;
+                break;
+            case OPCODE_JUMP: case OPCODE_BRANCH:
+            {
+                //the condition codes only ever come from the last ALU
+                //operation, so they can't carry anything over either
+                uint32_t target = head + i + 1 + decoded.offset;
+                bool idle = (target == head) && (0 == (read_first & written));
+                return idle ? cycles + INSTRUCTION_CYCLES : 0;
+            }
+            default:
+                return 0;
+        }
+
+        //everything that gets this far writes its result to reg_a
+        read_first |= sources & ~written;
+        written |= 1u << decoded.reg_a;
+    }
+    return 0;
+}
+
+//This is meant to be called between runs of the fast engine, so that none of
+//it gets in the way of the instructions themselves. A program stuck in an idle
+//loop (see find_idle_loop()) leaves every register and the condition codes
+//alone, so a search for the loop is only made when nothing has changed since
+//the last call. When one is found, the cpu is run on to the top of the loop and
+//then once all the way around it to make sure that it is stuck there (an
+//interrupt or a branch out of the loop would land it somewhere else). That
+//never takes more than cycle_limit cycles; the cycles that it does take are
+//added to *cycles_run.
+//
+//Returns how many cycles each trip around the loop takes if the program is
+//idle, so that the caller can skip ahead by whole trips until something (i.e.
+//an interrupt) can happen. Returns 0 otherwise.
+uint32_t cpu_check_for_idle_loop(cpu_t* cpu, uint32_t cycle_limit, uint32_t* cycles_run)
+{
+    uint32_t CCR = get_condition_code_register(cpu);
+    bool unchanged = (CCR == cpu->idle_check_CCR) &&
+                     (0 == memcmp(cpu->registers, cpu->idle_check_registers, sizeof(cpu->idle_check_registers)));
+    memcpy(cpu->idle_check_registers, cpu->registers, sizeof(cpu->idle_check_registers));
+    cpu->idle_check_CCR = CCR;
+    if(!unchanged)
+    {
+        return 0;
+    }
+
+    uint32_t head = cpu->PC;
+    uint32_t trip_cycles = 0;
+    for(uint32_t distance = 0; (distance < IDLE_LOOP_MAX_LENGTH) && (0 == trip_cycles); distance++)
+    {
+        head = cpu->PC - distance;
+        trip_cycles = find_idle_loop(cpu, head);
+    }
+    if(0 == trip_cycles)
+    {
+        return 0;
+    }
+
+    for(uint32_t i = 0; (i < IDLE_LOOP_MAX_LENGTH) && (cpu->PC != head); i++)
+    {
+        if(*cycles_run + LOAD_INSTRUCTION_CYCLES > cycle_limit)
+        {
+            return 0;
+        }
+        *cycles_run += cpu_run(cpu, 1);
+    }
+    if((cpu->PC != head) || (trip_cycles != find_idle_loop(cpu, head)) || (*cycles_run + trip_cycles > cycle_limit))
+    {
+        return 0;
+    }
+
+    *cycles_run += cpu_run(cpu, trip_cycles);
+    return (cpu->PC == head) ? trip_cycles : 0;
+}
+
+//does the fetch/decode work that is common to every instruction in the fast
+//engine and hands back the decoded instruction to dispatch on
+static inline const decoded_instruction_t* begin_instruction(cpu_t* cpu)
+{
+    cpu->MAR = cpu->PC;
+    update_pc(cpu);
+    const decoded_instruction_t* decoded = fetch_decoded_instruction(cpu, cpu->MAR);
+    unpack_decoded_instruction(cpu, decoded);
+    return decoded;
+}
+
+//these return true if the access went to a device (which might have raised
+//an interrupt) rather than straight to RAM
+static inline bool load_memory_operand(cpu_t* cpu)
+{
+    cpu->MAR = get_memory_operand_address(cpu);
+    uint32_t* word = translate_guest_address(cpu, cpu->MAR);
+    if(NULL != word)
+    {
+        cpu->MDR = *word;
+        return false;
+    }
+    cpu->MDR = cpu->read_memory(cpu->memory_port_context, cpu->MAR);
+    return true;
+}
+
+static inline bool store_memory_operand(cpu_t* cpu)
+{
+    cpu->MAR = get_memory_operand_address(cpu);
+    cpu->MDR = *cpu->store_source_reg;
+    invalidate_decoded_instruction(cpu, cpu->MAR);
+    uint32_t* word = translate_guest_address(cpu, cpu->MAR);
+    if(NULL != word)
+    {
+        *word = cpu->MDR;
+        return false;
+    }
+    cpu->write_memory(cpu->memory_port_context, cpu->MAR, cpu->MDR);
+    return true;
+}
+
+//The threaded interpreter jumps straight from the end of one instruction to
+//the start of the next with a computed goto (a GCC/Clang extension), so every
+//instruction gets its own indirect branch for the host's branch predictor to
+//learn. Other compilers fall back to a switch statement inside of a loop.
+#if defined(__GNUC__)
+#define THREADED_DISPATCH
+#endif
+
+#ifdef THREADED_DISPATCH
+#define INSTRUCTION(opcode)         do_##opcode:
+#define UNIMPLEMENTED_INSTRUCTIONS  do_unimplemented:
+#define NEXT_INSTRUCTION()          do { if(cycles >= cycle_budget) { return cycles; } \
+                                         goto *dispatch_table[begin_instruction(cpu)->opcode]; } while(0)
+#else
+#define INSTRUCTION(opcode)         case opcode:
+#define UNIMPLEMENTED_INSTRUCTIONS  default:
+#define NEXT_INSTRUCTION()          continue
+#endif
+
+//This is the "fast" execution engine. Rather than advancing one pipeline stage
+//per call and handshaking with the bus, it fuses the fetch, decode, memory and
+//execute stages together and keeps running whole instructions, accessing
+//memory directly through the attached memory port, until at least
+//cycle_budget cycles have gone by. The architectural state afterwards is
+//identical to what the pipeline stages would produce. It returns the number
+//of cycles the instructions would have taken in the timing engine so that
+//the rest of the system can be clocked accordingly.
+//
+//Interrupts can only be requested from inside of this loop by a TRAP or by a
+//device that is accessed by a load/store, so those are the only places (other
+//than the start of the run) where we need to look for them. Loads/stores that
+//the TLB sends straight to RAM can't touch a device, so they don't need to.
+//That also means that once a WFI has halted the cpu, it stays halted for the
+//rest of the run, so the whole budget goes by without anything happening.
+uint32_t cpu_run(cpu_t* cpu, uint32_t cycle_budget)
+{
+    uint32_t cycles = 0;
+    bool accessed_device = false;
+    cpu->instruction_finished = true;
+    if(cpu_waiting_for_interrupt(cpu))
+    {
+        return cycle_budget;
+    }
+    check_for_interrupts(cpu);
+
+#ifdef THREADED_DISPATCH
+    //every opcode without an entry of its own is unimplemented, which means
+    //overriding the range's initializer on purpose
+#pragma GCC diagnostic push
+#if defined(__clang__)
+#pragma GCC diagnostic ignored "-Winitializer-overrides"
+#else
+#pragma GCC diagnostic ignored "-Woverride-init"
+#endif
+    static const void* const dispatch_table[NUM_INSTRUCTIONS] =
+    {
+        [0 ... NUM_INSTRUCTIONS - 1] = &&do_unimplemented,
+        [OPCODE_AND]     = &&do_OPCODE_AND,
+        [OPCODE_OR]      = &&do_OPCODE_OR,
+        [OPCODE_NOT]     = &&do_OPCODE_NOT,
+        [OPCODE_XOR]     = &&do_OPCODE_XOR,
+        [OPCODE_ADD]     = &&do_OPCODE_ADD,
+        [OPCODE_SUB]     = &&do_OPCODE_SUB,
+        [OPCODE_LOAD]    = &&do_OPCODE_LOAD,
+        [OPCODE_LOADR]   = &&do_OPCODE_LOADR,
+        [OPCODE_LOADA]   = &&do_OPCODE_LOADA,
+        [OPCODE_STORE]   = &&do_OPCODE_STORE,
+        [OPCODE_STORER]  = &&do_OPCODE_STORER,
+        [OPCODE_JUMP]    = &&do_OPCODE_JUMP,
+        [OPCODE_BRANCH]  = &&do_OPCODE_BRANCH,
+        [OPCODE_CALL]    = &&do_OPCODE_CALL,
+        [OPCODE_CALLR]   = &&do_OPCODE_CALLR,
+        [OPCODE_JUMPR]   = &&do_OPCODE_JUMPR,
+        [OPCODE_TRAP]    = &&do_OPCODE_TRAP,
+        [OPCODE_RETURNI] = &&do_OPCODE_RETURNI,
+        [OPCODE_WFI]     = &&do_OPCODE_WFI,
+    };
+#pragma GCC diagnostic pop
+
+    NEXT_INSTRUCTION();
+#else
+    while(cycles < cycle_budget)
+    {
+        switch(begin_instruction(cpu)->opcode)
+        {
+#endif
+            INSTRUCTION(OPCODE_AND)
+                cpu_and(cpu);
+                cycles += INSTRUCTION_CYCLES;
+                NEXT_INSTRUCTION();
+            INSTRUCTION(OPCODE_OR)
+                cpu_or(cpu);
+                cycles += INSTRUCTION_CYCLES;
+                NEXT_INSTRUCTION();
+            INSTRUCTION(OPCODE_NOT)
+                cpu_not(cpu);
+                cycles += INSTRUCTION_CYCLES;
+                NEXT_INSTRUCTION();
+            INSTRUCTION(OPCODE_XOR)
+                cpu_xor(cpu);
+                cycles += INSTRUCTION_CYCLES;
+                NEXT_INSTRUCTION();
+            INSTRUCTION(OPCODE_ADD)
+                cpu_add(cpu);
+                cycles += INSTRUCTION_CYCLES;
+                NEXT_INSTRUCTION();
+            INSTRUCTION(OPCODE_SUB)
+                cpu_sub(cpu);
+                cycles += INSTRUCTION_CYCLES;
+                NEXT_INSTRUCTION();
+            INSTRUCTION(OPCODE_LOAD)
+                accessed_device = load_memory_operand(cpu);
+                cpu_load_pc_relative(cpu);
+                cycles += LOAD_INSTRUCTION_CYCLES;
+                if(accessed_device)
+                {
+                    check_for_interrupts(cpu);
+                }
+                NEXT_INSTRUCTION();
+            INSTRUCTION(OPCODE_LOADR)
+                accessed_device = load_memory_operand(cpu);
+                cpu_load_base_plus_offset(cpu);
+                cycles += LOAD_INSTRUCTION_CYCLES;
+                if(accessed_device)
+                {
+                    check_for_interrupts(cpu);
+                }
+                NEXT_INSTRUCTION();
+            INSTRUCTION(OPCODE_LOADA)
+                cpu_load_effective_address(cpu);
+                cycles += INSTRUCTION_CYCLES;
+                NEXT_INSTRUCTION();
+            INSTRUCTION(OPCODE_STORE)
+            INSTRUCTION(OPCODE_STORER)
+                accessed_device = store_memory_operand(cpu);
+                cycles += STORE_INSTRUCTION_CYCLES;
+                if(accessed_device)
+                {
+                    check_for_interrupts(cpu);
+                }
+                NEXT_INSTRUCTION();
+            INSTRUCTION(OPCODE_JUMP)
+                cpu_jump_pc_relative(cpu);
+                cycles += INSTRUCTION_CYCLES;
+                NEXT_INSTRUCTION();
+            INSTRUCTION(OPCODE_BRANCH)
+                cpu_branch(cpu);
+                cycles += INSTRUCTION_CYCLES;
+                NEXT_INSTRUCTION();
+            INSTRUCTION(OPCODE_CALL)
+                cpu_call(cpu);
+                cycles += INSTRUCTION_CYCLES;
+                NEXT_INSTRUCTION();
+            INSTRUCTION(OPCODE_CALLR)
+                cpu_callr(cpu);
+                cycles += INSTRUCTION_CYCLES;
+                NEXT_INSTRUCTION();
+            INSTRUCTION(OPCODE_JUMPR)
+                cpu_jump_base_plus_offset(cpu);
+                cycles += INSTRUCTION_CYCLES;
+                NEXT_INSTRUCTION();
+            INSTRUCTION(OPCODE_TRAP)
+                cpu_swi(cpu);
+                cycles += INSTRUCTION_CYCLES;
+                check_for_interrupts(cpu);
+                NEXT_INSTRUCTION();
+            INSTRUCTION(OPCODE_RETURNI)
+                cpu_rfi(cpu);
+                cycles += INSTRUCTION_CYCLES;
+                check_for_interrupts(cpu);
+                NEXT_INSTRUCTION();
+            INSTRUCTION(OPCODE_WFI)
+                cpu_wfi(cpu);
+                cycles += INSTRUCTION_CYCLES;
+                if(cpu_waiting_for_interrupt(cpu))
+                {
+                    return (cycles < cycle_budget) ? cycle_budget : cycles;
+                }
+                NEXT_INSTRUCTION();
+            UNIMPLEMENTED_INSTRUCTIONS
+                cpu_nop(cpu);
+                cycles += INSTRUCTION_CYCLES;
+                NEXT_INSTRUCTION();
+#ifndef THREADED_DISPATCH
+        }
+    }
+    return cycles;
+#endif
+}
+
+#undef INSTRUCTION
+#undef UNIMPLEMENTED_INSTRUCTIONS
+#undef NEXT_INSTRUCTION
+
 void cpu_cycle(cpu_t* cpu)
 {
-    pipeline_stage_t stage = pipeline_stages[pipeline_stage];
+    pipeline_stage_t stage = pipeline_stages[cpu->pipeline_stage];
     stage(cpu);
 
     //if we just finished executing then we've completed the instruction 
-    //(FIXME: this won't be true when we add the memory write stage)
-    if(stage == execute)
+    //(FIXME: this won't be true when we add the memory write stage). Every
+    //cycle spent halted counts as an instruction that does nothing.
+    if(stage == execute || cpu->waiting_for_interrupt)
         cpu->instruction_finished = true;
     else
     {
@@ -0,0 +1,786 @@
+// ----------------------------------------------------------------------------
+//
+//  FILE: cpu_jit.c
+//
+//  DESCRIPTION: This is a submodule for the CPU that implements a dynamic
+//  binary translator. Rather than interpreting instructions one at a time, it
+//  compiles each guest basic block (a straight run of instructions ending in
+//  a JUMP/BRANCH/CALL/CALLR/JUMPR/TRAP/RETURNI/WFI) into native x86-64 code the
+//  first time the block is reached, then just calls the native code every
+//  time after that.
+//
+//  The translated code keeps a pointer to the cpu struct pinned in RBX (and
+//  one to the register bank in use in RBP) for as long as it runs and
+//  reads/writes the guest registers straight out of them, so no state ever
+//  needs to be copied in or out when entering or leaving translated code. Blocks that end by jumping to a known address
+//  get patched to jump directly to the translation of their successor, so
+//  hot loops never come back out to the dispatcher until their cycle budget
+//  runs out.
+//
+//  Loads and stores are handed to small C helpers that go through the same
+//  memory port as the interpreter, so MMIO accesses that hit the graphics
+//  or keyboard still get a full bus transaction. TRAP, RETURNI and
+//  WFI are always left to the interpreter.
+//
+//  Translations are thrown away (all at once) as soon as something stores to
+//  a page of guest memory that holds translated code.
+//
+// ----------------------------------------------------------------------------
+
+#define _DEFAULT_SOURCE //for MAP_ANONYMOUS
+
+#include "cpu_jit.h"
+#include "cpu_private.h"
+#include "cpu_ops.h"
+#include "opcode_list.h"
+#include "memory_bus.h"
+#include "interrupt_controller.h"
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+
+#if defined(__x86_64__) && (defined(__linux__) || defined(__APPLE__))
+#define JIT_SUPPORTED
+#endif
+
+#ifdef JIT_SUPPORTED
+
+#include <sys/mman.h>
+
+#define JIT_CODE_BUFFER_SIZE    (4 * 1024 * 1024)
+#define JIT_MAX_BLOCK_BYTES     (8 * 1024)          //worst case size of one translated block
+#define JIT_MAX_BLOCK_LENGTH    64                  //instructions per block
+#define JIT_BLOCK_TABLE_SIZE    4096                //must be a power of two
+
+//code pages are tracked at 1024 word (4KiB) granularity
+#define JIT_PAGE_BITS           10
+#define JIT_NUM_PAGES           (1u << (32 - JIT_PAGE_BITS))
+
+//the same costs that the interpreter charges (see cpu_run())
+#define INSTRUCTION_CYCLES          6
+#define LOAD_INSTRUCTION_CYCLES     9
+#define STORE_INSTRUCTION_CYCLES    8
+
+//why translated code handed control back to the dispatcher
+enum jit_exit_reason_t
+{
+    EXIT_TO_DISPATCHER,     //the PC is up to date, just carry on from there
+    EXIT_TO_CHAIN,          //the block's successor hasn't been linked in yet
+    EXIT_TO_INTERPRETER     //the instruction at the PC has to be interpreted
+};
+
+//returned in RAX:RDX by translated code
+typedef struct
+{
+    uint64_t reason;
+    uint8_t* patch_site;    //the jump to link up for EXIT_TO_CHAIN exits
+} jit_exit_t;
+
+typedef jit_exit_t (*jit_entry_t)(cpu_t* cpu, const uint8_t* block);
+
+typedef struct
+{
+    uint32_t address;
+    const uint8_t* code;
+} jit_block_t;
+
+struct jit
+{
+    uint8_t* code_buffer;
+    uint8_t* cursor;            //where the next block will be emitted
+    uint8_t* first_block;       //everything after the entry/exit stubs
+    uint8_t* exit_stub;         //restores the host registers and returns to the dispatcher
+    jit_entry_t enter;
+    uint32_t generation;        //bumped on every flush so stale patch sites can be spotted
+    bool flush_pending;
+    uint64_t* code_pages;       //bitmap of guest pages that have been translated
+    jit_block_t blocks[JIT_BLOCK_TABLE_SIZE];
+};
+
+//x86-64 register numbers for the registers the translated code uses
+enum host_register_t { EAX = 0, ECX = 1, EDX = 2, ESI = 6 };
+
+//where each guest register lives relative to RBP
+#define GUEST_REGISTER(n)   ((uint32_t)((n) * sizeof(uint32_t)))
+//where everything else in the context block lives relative to RBX
+#define REGISTER_BANK       ((uint32_t)offsetof(struct cpu, registers))
+#define GUEST_PC            ((uint32_t)offsetof(struct cpu, PC))
+#define GUEST_CCR           ((uint32_t)offsetof(struct cpu, CCR))
+#define GUEST_IR            ((uint32_t)offsetof(struct cpu, IR))
+#define GUEST_MAR           ((uint32_t)offsetof(struct cpu, MAR))
+#define GUEST_MDR           ((uint32_t)offsetof(struct cpu, MDR))
+#define LAST_ALU_RESULT     ((uint32_t)offsetof(struct cpu, last_ALU_result))
+#define CONDITION_CODES_PENDING ((uint32_t)offsetof(struct cpu, condition_codes_pending))
+#define CYCLES_REMAINING    ((uint32_t)offsetof(struct cpu, jit_cycles_remaining))
+
+static const uint8_t RETURN_ADDRESS_REGISTER = 30;
+
+
+// ---- x86-64 code emission ----
+
+static void emit8(jit_t* jit, uint8_t byte)
+{
+    *jit->cursor++ = byte;
+}
+
+static void emit32(jit_t* jit, uint32_t value)
+{
+    memcpy(jit->cursor, &value, sizeof(value));
+    jit->cursor += sizeof(value);
+}
+
+static void emit64(jit_t* jit, uint64_t value)
+{
+    memcpy(jit->cursor, &value, sizeof(value));
+    jit->cursor += sizeof(value);
+}
+
+//points the rel32 field at the given address to the target
+static void patch_rel32(uint8_t* site, const uint8_t* target)
+{
+    int32_t displacement = (int32_t)(target - (site + sizeof(int32_t)));
+    memcpy(site, &displacement, sizeof(displacement));
+}
+
+//a ModRM byte that addresses [rbx + disp32] followed by its displacement
+static void emit_context_operand(jit_t* jit, uint8_t reg_field, uint32_t offset)
+{
+    emit8(jit, 0x83 | (reg_field << 3));
+    emit32(jit, offset);
+}
+
+//mov reg, [rbx + offset]
+static void emit_load_context(jit_t* jit, enum host_register_t reg, uint32_t offset)
+{
+    emit8(jit, 0x8B);
+    emit_context_operand(jit, reg, offset);
+}
+
+//mov [rbx + offset], reg
+static void emit_store_context(jit_t* jit, enum host_register_t reg, uint32_t offset)
+{
+    emit8(jit, 0x89);
+    emit_context_operand(jit, reg, offset);
+}
+
+//mov dword [rbx + offset], imm32
+static void emit_store_context_immediate(jit_t* jit, uint32_t offset, uint32_t value)
+{
+    emit8(jit, 0xC7);
+    emit_context_operand(jit, 0, offset);
+    emit32(jit, value);
+}
+
+//a ModRM byte that addresses [rbp + disp32] (a guest register) followed by
+//its displacement
+static void emit_register_operand(jit_t* jit, uint8_t reg_field, uint32_t offset)
+{
+    emit8(jit, 0x85 | (reg_field << 3));
+    emit32(jit, offset);
+}
+
+//mov reg, [rbp + offset]
+static void emit_load_register(jit_t* jit, enum host_register_t reg, uint32_t offset)
+{
+    emit8(jit, 0x8B);
+    emit_register_operand(jit, reg, offset);
+}
+
+//mov [rbp + offset], reg
+static void emit_store_register(jit_t* jit, enum host_register_t reg, uint32_t offset)
+{
+    emit8(jit, 0x89);
+    emit_register_operand(jit, reg, offset);
+}
+
+//mov dword [rbp + offset], imm32
+static void emit_store_register_immediate(jit_t* jit, uint32_t offset, uint32_t value)
+{
+    emit8(jit, 0xC7);
+    emit_register_operand(jit, 0, offset);
+    emit32(jit, value);
+}
+
+//mov reg, imm32
+static void emit_load_immediate(jit_t* jit, enum host_register_t reg, uint32_t value)
+{
+    emit8(jit, 0xB8 + reg);
+    emit32(jit, value);
+}
+
+//jmp rel32/jcc rel32, hands back the rel32 field so that it can be patched
+static uint8_t* emit_jump(jit_t* jit)
+{
+    emit8(jit, 0xE9);
+    uint8_t* site = jit->cursor;
+    emit32(jit, 0);
+    return site;
+}
+
+static uint8_t* emit_jump_if_zero(jit_t* jit)
+{
+    emit8(jit, 0x0F);
+    emit8(jit, 0x84);
+    uint8_t* site = jit->cursor;
+    emit32(jit, 0);
+    return site;
+}
+
+//calls a C helper with the cpu as the first argument (the others have to be
+//loaded into ESI/EDX beforehand)
+static void emit_call_helper(jit_t* jit, uintptr_t helper)
+{
+    emit8(jit, 0x48); emit8(jit, 0x89); emit8(jit, 0xDF);   //mov rdi, rbx
+    emit8(jit, 0x48); emit8(jit, 0xB8); emit64(jit, helper);  //mov rax, helper
+    emit8(jit, 0xFF); emit8(jit, 0xD0);                     //call rax
+}
+
+//records the ALU result in EAX for the condition codes to be worked out from
+//later, the same way that update_condition_code_bits() does
+static void emit_record_ALU_result(jit_t* jit)
+{
+    emit_store_context(jit, EAX, LAST_ALU_RESULT);
+    emit8(jit, 0xC6);
+    emit_context_operand(jit, 0, CONDITION_CODES_PENDING);  //mov byte [rbx + pending], 1
+    emit8(jit, 0x01);
+}
+
+//brings the CCR up to date if an ALU operation has run since it was last set,
+//the same way that get_condition_code_register() does
+static void emit_materialize_condition_codes(jit_t* jit)
+{
+    emit8(jit, 0x80);
+    emit_context_operand(jit, 7, CONDITION_CODES_PENDING);  //cmp byte [rbx + pending], 0
+    emit8(jit, 0x00);
+    emit8(jit, 0x74);                                       //je done
+    uint8_t* done = jit->cursor;
+    emit8(jit, 0x00);
+
+    emit_load_context(jit, EAX, LAST_ALU_RESULT);
+    emit8(jit, 0x85); emit8(jit, 0xC0);                     //test eax, eax
+    emit_load_immediate(jit, ECX, 0x1);                     //positive
+    emit_load_immediate(jit, EDX, 0x4);
+    emit8(jit, 0x0F); emit8(jit, 0x48); emit8(jit, 0xCA);   //cmovs ecx, edx (negative)
+    emit_load_immediate(jit, EDX, 0x2);
+    emit8(jit, 0x0F); emit8(jit, 0x44); emit8(jit, 0xCA);   //cmovz ecx, edx (zero)
+    emit_store_context(jit, ECX, GUEST_CCR);
+    emit8(jit, 0xC6);
+    emit_context_operand(jit, 0, CONDITION_CODES_PENDING);  //mov byte [rbx + pending], 0
+    emit8(jit, 0x00);
+
+    *done = (uint8_t)(jit->cursor - (done + 1));
+}
+
+//leaves translated code with the given guest PC
+static void emit_exit(jit_t* jit, enum jit_exit_reason_t reason, uint32_t address)
+{
+    emit_store_context_immediate(jit, GUEST_PC, address);
+    emit_load_immediate(jit, EAX, reason);
+    patch_rel32(emit_jump(jit), jit->exit_stub);
+}
+
+//jumps to the translation of the block at the given address. Until the
+//dispatcher links the two blocks together the jump just falls through to
+//an exit asking it to do so
+static void emit_chain(jit_t* jit, uint32_t address)
+{
+    uint8_t* site = emit_jump(jit);
+    patch_rel32(site, jit->cursor);
+
+    emit_store_context_immediate(jit, GUEST_PC, address);
+    emit_load_immediate(jit, EAX, EXIT_TO_CHAIN);
+    emit8(jit, 0x48); emit8(jit, 0xBA); emit64(jit, (uint64_t)(uintptr_t)site); //mov rdx, site
+    patch_rel32(emit_jump(jit), jit->exit_stub);
+}
+
+//builds the code that every entry into and exit out of translated code goes
+//through. RBX holds the cpu and RBP its register bank for the whole time we
+//are in translated code (the bank can only change when an interrupt is
+//taken or returned from, which never happens in translated code) and the
+//stack is kept 16-byte aligned for the helper calls.
+static void emit_entry_and_exit_stubs(jit_t* jit)
+{
+    jit->enter = (jit_entry_t)(uintptr_t)jit->cursor;
+    emit8(jit, 0x53);                                       //push rbx
+    emit8(jit, 0x55);                                       //push rbp
+    emit8(jit, 0x48); emit8(jit, 0x83); emit8(jit, 0xEC); emit8(jit, 0x08); //sub rsp, 8
+    emit8(jit, 0x48); emit8(jit, 0x89); emit8(jit, 0xFB);   //mov rbx, rdi
+    emit8(jit, 0x48); emit8(jit, 0x8B);
+    emit_context_operand(jit, 5, REGISTER_BANK);            //mov rbp, [rbx + registers]
+    emit8(jit, 0xFF); emit8(jit, 0xE6);                     //jmp rsi
+
+    jit->exit_stub = jit->cursor;
+    emit8(jit, 0x48); emit8(jit, 0x83); emit8(jit, 0xC4); emit8(jit, 0x08); //add rsp, 8
+    emit8(jit, 0x5D);                                       //pop rbp
+    emit8(jit, 0x5B);                                       //pop rbx
+    emit8(jit, 0xC3);                                       //ret
+
+    jit->first_block = jit->cursor;
+}
+
+
+// ---- helpers called from translated code ----
+
+//loads/stores leave translated code straight away if they raised an interrupt
+//or overwrote translated code, just like the interpreter checks for
+//interrupts after each load/store. Only devices can raise interrupts, so
+//accesses that the TLB sends straight to RAM don't need to check for them.
+static uint32_t must_leave_translated_code(cpu_t* cpu)
+{
+    return cpu->jit->flush_pending || interrupt_can_be_taken(cpu);
+}
+
+static uint32_t load_helper(cpu_t* cpu, uint32_t address, uint32_t destination)
+{
+    cpu->MAR = address;
+    uint32_t* word = translate_guest_address(cpu, address);
+    if(NULL != word)
+    {
+        cpu->MDR = *word;
+        cpu->registers[destination] = cpu->MDR;
+        return false;
+    }
+
+    cpu->MDR = cpu->read_memory(cpu->memory_port_context, address);
+    cpu->registers[destination] = cpu->MDR;
+    return must_leave_translated_code(cpu);
+}
+
+static uint32_t store_helper(cpu_t* cpu, uint32_t address, uint32_t value)
+{
+    cpu->MAR = address;
+    cpu->MDR = value;
+    invalidate_decoded_instruction(cpu, address);
+    uint32_t* word = translate_guest_address(cpu, address);
+    if(NULL != word)
+    {
+        *word = value;
+        return cpu->jit->flush_pending;
+    }
+
+    cpu->write_memory(cpu->memory_port_context, address, value);
+    return must_leave_translated_code(cpu);
+}
+
+
+// ---- block translation ----
+
+//keeps track of what the translated code has done so far, so that every way
+//out of the block can leave the cpu exactly as the interpreter would have
+typedef struct
+{
+    uint32_t cycles;            //cycles taken by the instructions translated so far
+    uint32_t last_address;      //the address/word of the last instruction translated
+    uint32_t last_instruction;
+    bool last_accessed_memory;  //if so, the helper already set the MAR/MDR
+} block_state_t;
+
+static bool is_code_page(jit_t* jit, uint32_t address)
+{
+    uint32_t page = address >> JIT_PAGE_BITS;
+    return jit->code_pages[page / 64] & (1ull << (page % 64));
+}
+
+static void mark_code_page(jit_t* jit, uint32_t address)
+{
+    uint32_t page = address >> JIT_PAGE_BITS;
+    jit->code_pages[page / 64] |= (1ull << (page % 64));
+}
+
+static bool is_ram(cpu_t* cpu, uint32_t address)
+{
+    return MEMORY_SELECTED == bus_decode_address(cpu->bus, address);
+}
+
+//charges the block's cycles and leaves the IR/MAR/MDR as the last
+//instruction would have
+static void emit_retire(jit_t* jit, const block_state_t* state)
+{
+    if(0 == state->cycles)
+    {
+        return;
+    }
+
+    emit8(jit, 0x81);
+    emit_context_operand(jit, 5, CYCLES_REMAINING);         //sub dword [rbx + remaining], cycles
+    emit32(jit, state->cycles);
+
+    emit_store_context_immediate(jit, GUEST_IR, state->last_instruction);
+    if(!state->last_accessed_memory)
+    {
+        emit_store_context_immediate(jit, GUEST_MAR, state->last_address);
+        emit_store_context_immediate(jit, GUEST_MDR, state->last_instruction);
+    }
+}
+
+static void emit_alu_operation(jit_t* jit, const decoded_instruction_t* decoded)
+{
+    //opcodes for "op eax, [rbx + disp32]" and "op eax, imm32"
+    uint8_t register_form = 0;
+    uint8_t immediate_form = 0;
+    uint32_t immediate = decoded->offset;
+
+    switch(decoded->opcode)
+    {
+        case OPCODE_AND:
+            register_form = 0x23; immediate_form = 0x25;
+            immediate |= 0xFFFF0000;
+            break;
+        case OPCODE_OR:
+            register_form = 0x0B; immediate_form = 0x0D;
+            immediate &= 0x0000FFFF;
+            break;
+        case OPCODE_XOR:
+            register_form = 0x33; immediate_form = 0x35;
+            immediate &= 0x0000FFFF;
+            break;
+        case OPCODE_ADD:
+            register_form = 0x03; immediate_form = 0x05;
+            break;
+        case OPCODE_SUB:
+            register_form = 0x2B; immediate_form = 0x2D;
+            break;
+    }
+
+    emit_load_register(jit, EAX, GUEST_REGISTER(decoded->reg_b));
+    if(OPCODE_NOT == decoded->opcode)
+    {
+        emit8(jit, 0xF7); emit8(jit, 0xD0);                 //not eax
+    }
+    else if(decoded->immediate_mode)
+    {
+        emit8(jit, immediate_form);
+        emit32(jit, immediate);
+    }
+    else
+    {
+        emit8(jit, register_form);
+        emit_register_operand(jit, EAX, GUEST_REGISTER(decoded->reg_c));
+    }
+    emit_store_register(jit, EAX, GUEST_REGISTER(decoded->reg_a));
+    emit_record_ALU_result(jit);
+}
+
+//puts the effective address of a load/store in ESI
+static void emit_memory_operand_address(jit_t* jit, const decoded_instruction_t* decoded)
+{
+    if(is_pc_relative_instruction(decoded->opcode))
+    {
+        emit_load_immediate(jit, ESI, decoded->address + 1 + decoded->offset);
+    }
+    else
+    {
+        emit_load_register(jit, ESI, GUEST_REGISTER(decoded->reg_b));
+        emit8(jit, 0x81); emit8(jit, 0xC6); emit32(jit, decoded->offset); //add esi, offset
+    }
+}
+
+static void emit_memory_access(jit_t* jit, const decoded_instruction_t* decoded, block_state_t* state)
+{
+    emit_memory_operand_address(jit, decoded);
+    if(is_load_instruction(decoded->opcode))
+    {
+        emit_load_immediate(jit, EDX, decoded->reg_a);
+        emit_call_helper(jit, (uintptr_t)&load_helper);
+    }
+    else
+    {
+        emit_load_register(jit, EDX, GUEST_REGISTER(decoded->reg_a));
+        emit_call_helper(jit, (uintptr_t)&store_helper);
+    }
+
+    //leave right after this instruction if the helper asked us to
+    emit8(jit, 0x85); emit8(jit, 0xC0);                     //test eax, eax
+    uint8_t* carry_on = emit_jump_if_zero(jit);
+    emit_retire(jit, state);
+    emit_exit(jit, EXIT_TO_DISPATCHER, decoded->address + 1);
+    patch_rel32(carry_on, jit->cursor);
+}
+
+//translates one instruction, returning false once it has ended the block
+static bool translate_instruction(jit_t* jit, const decoded_instruction_t* decoded, block_state_t* state)
+{
+    const uint32_t next_address = decoded->address + 1;
+
+    if(OPCODE_TRAP == decoded->opcode || OPCODE_RETURNI == decoded->opcode || OPCODE_WFI == decoded->opcode)
+    {
+        emit_retire(jit, state);
+        emit_exit(jit, EXIT_TO_INTERPRETER, decoded->address);
+        return false;
+    }
+
+    state->last_address = decoded->address;
+    state->last_instruction = decoded->instruction;
+    state->last_accessed_memory = false;
+
+    switch(decoded->opcode)
+    {
+        case OPCODE_AND: case OPCODE_OR: case OPCODE_NOT:
+        case OPCODE_XOR: case OPCODE_ADD: case OPCODE_SUB:
+            emit_alu_operation(jit, decoded);
+            state->cycles += INSTRUCTION_CYCLES;
+            return true;
+        case OPCODE_LOADA:
+            emit_store_register_immediate(jit, GUEST_REGISTER(decoded->reg_a), next_address + decoded->offset);
+            state->cycles += INSTRUCTION_CYCLES;
+            return true;
+        case OPCODE_LOAD: case OPCODE_LOADR:
+            state->cycles += LOAD_INSTRUCTION_CYCLES;
+            state->last_accessed_memory = true;
+            emit_memory_access(jit, decoded, state);
+            return true;
+        case OPCODE_STORE: case OPCODE_STORER:
+            state->cycles += STORE_INSTRUCTION_CYCLES;
+            state->last_accessed_memory = true;
+            emit_memory_access(jit, decoded, state);
+            return true;
+        case OPCODE_CALL:
+            emit_store_register_immediate(jit, GUEST_REGISTER(RETURN_ADDRESS_REGISTER), next_address);
+            //fall through
+        case OPCODE_JUMP:
+            state->cycles += INSTRUCTION_CYCLES;
+            emit_retire(jit, state);
+            emit_chain(jit, next_address + decoded->offset);
+            return false;
+        case OPCODE_BRANCH:
+        {
+            state->cycles += INSTRUCTION_CYCLES;
+            uint8_t* not_taken = NULL;
+            if(0 != decoded->condition_codes)
+            {
+                emit_materialize_condition_codes(jit);
+                emit8(jit, 0xF7);
+                emit_context_operand(jit, 0, GUEST_CCR);    //test dword [rbx + CCR], condition_codes
+                emit32(jit, decoded->condition_codes);
+                not_taken = emit_jump_if_zero(jit);
+                emit_retire(jit, state);
+                emit_chain(jit, next_address + decoded->offset);
+                patch_rel32(not_taken, jit->cursor);
+            }
+            emit_retire(jit, state);
+            emit_chain(jit, next_address);
+            return false;
+        }
+        case OPCODE_CALLR:
+            //the return address goes in first, in case the base register is R30
+            emit_store_register_immediate(jit, GUEST_REGISTER(RETURN_ADDRESS_REGISTER), next_address);
+            //fall through
+        case OPCODE_JUMPR:
+            state->cycles += INSTRUCTION_CYCLES;
+            emit_load_register(jit, EAX, GUEST_REGISTER(decoded->reg_b));
+            emit8(jit, 0x05); emit32(jit, decoded->offset);   //add eax, offset
+            emit_store_context(jit, EAX, GUEST_PC);
+            emit_retire(jit, state);
+            emit_load_immediate(jit, EAX, EXIT_TO_DISPATCHER);
+            patch_rel32(emit_jump(jit), jit->exit_stub);
+            return false;
+        default:
+            //unimplemented instructions are NOPs
+            state->cycles += INSTRUCTION_CYCLES;
+            return true;
+    }
+}
+
+static const uint8_t* translate_block(cpu_t* cpu, uint32_t address)
+{
+    jit_t* jit = cpu->jit;
+    if(jit->cursor + JIT_MAX_BLOCK_BYTES > jit->code_buffer + JIT_CODE_BUFFER_SIZE)
+    {
+        jit_flush(jit);
+    }
+
+    const uint8_t* block = jit->cursor;
+    block_state_t state = { 0 };
+
+    //don't start running the block unless there are cycles left in the budget
+    emit8(jit, 0x83);
+    emit_context_operand(jit, 7, CYCLES_REMAINING);         //cmp dword [rbx + remaining], 0
+    emit8(jit, 0x00);
+    emit8(jit, 0x7F);                                       //jg body
+    uint8_t* skip = jit->cursor;
+    emit8(jit, 0x00);
+    emit_exit(jit, EXIT_TO_DISPATCHER, address);
+    *skip = (uint8_t)(jit->cursor - (skip + 1));
+
+    for(uint32_t i = 0; i < JIT_MAX_BLOCK_LENGTH; i++, address++)
+    {
+        //code can't be translated out of device memory
+        if(!is_ram(cpu, address))
+        {
+            break;
+        }
+
+        decoded_instruction_t decoded;
+        predecode_instruction(cpu, &decoded, address, memory_port_read(cpu, address));
+        mark_code_page(jit, address);
+        if(!translate_instruction(jit, &decoded, &state))
+        {
+            return block;
+        }
+    }
+
+    //the block was too long or ran into device memory
+    emit_retire(jit, &state);
+    emit_chain(jit, address);
+    return block;
+}
+
+//finds the translation of the block at the given address, translating it
+//if necessary. Returns NULL if the block can't be translated.
+static const uint8_t* get_translated_block(cpu_t* cpu, uint32_t address)
+{
+    jit_t* jit = cpu->jit;
+    jit_block_t* entry = &jit->blocks[address & (JIT_BLOCK_TABLE_SIZE - 1)];
+    if(NULL != entry->code && entry->address == address)
+    {
+        return entry->code;
+    }
+
+    if(!is_ram(cpu, address))
+    {
+        return NULL;
+    }
+
+    entry->code = translate_block(cpu, address);
+    entry->address = address;
+    return entry->code;
+}
+
+jit_t* make_jit(void)
+{
+    jit_t* jit = calloc(1, sizeof(struct jit));
+    jit->code_pages = calloc(JIT_NUM_PAGES / 64, sizeof(uint64_t));
+    jit->code_buffer = mmap(NULL, JIT_CODE_BUFFER_SIZE, PROT_READ | PROT_WRITE | PROT_EXEC, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if(MAP_FAILED == jit->code_buffer)
+    {
+        free(jit->code_pages);
+        free(jit);
+        return NULL;
+    }
+
+    jit->cursor = jit->code_buffer;
+    emit_entry_and_exit_stubs(jit);
+    return jit;
+}
+
+void destroy_jit(jit_t* jit)
+{
+    munmap(jit->code_buffer, JIT_CODE_BUFFER_SIZE);
+    free(jit->code_pages);
+    free(jit);
+}
+
+//throws away every translation. This must never be called from inside of
+//translated code
+void jit_flush(jit_t* jit)
+{
+    jit->cursor = jit->first_block;
+    memset(jit->blocks, 0x00, sizeof(jit->blocks));
+    memset(jit->code_pages, 0x00, (JIT_NUM_PAGES / 64) * sizeof(uint64_t));
+    jit->flush_pending = false;
+    jit->generation++;
+}
+
+//stores to a page with translated code in it throw all of the translations
+//away as soon as we are back out of translated code
+void jit_note_store(jit_t* jit, uint32_t address)
+{
+    if(is_code_page(jit, address))
+    {
+        jit->flush_pending = true;
+    }
+}
+
+//This is the translating execution engine. It behaves exactly like cpu_run()
+//(and returns the cycles taken the same way), except that whole basic blocks
+//are run as native code. Since a block can't be stopped partway through, the
+//run may go over the cycle budget by up to one block.
+uint32_t cpu_run_translated(cpu_t* cpu, uint32_t cycle_budget)
+{
+    if(NULL == cpu->jit)
+    {
+        cpu->jit = make_jit();
+        if(NULL == cpu->jit)
+        {
+            return cpu_run(cpu, cycle_budget);
+        }
+    }
+
+    jit_t* jit = cpu->jit;
+    cpu->jit_cycles_remaining = (cycle_budget > INT32_MAX) ? INT32_MAX : (int32_t)cycle_budget;
+    const int64_t budget = cpu->jit_cycles_remaining;
+    cpu->instruction_finished = true;
+
+    while(cpu->jit_cycles_remaining > 0)
+    {
+        //a halted cpu can't be woken up before the end of the run
+        if(cpu_waiting_for_interrupt(cpu))
+        {
+            cpu->jit_cycles_remaining = 0;
+            break;
+        }
+
+        check_for_interrupts(cpu);
+        if(jit->flush_pending)
+        {
+            jit_flush(jit);
+        }
+
+        const uint8_t* block = get_translated_block(cpu, cpu->PC);
+        if(NULL == block)
+        {
+            cpu->jit_cycles_remaining -= cpu_run(cpu, 1);
+            continue;
+        }
+
+        jit_exit_t exit = jit->enter(cpu, block);
+        if(EXIT_TO_CHAIN == exit.reason && !jit->flush_pending)
+        {
+            //link the block we just left straight to its successor, as long
+            //as translating the successor didn't flush the block away
+            uint32_t generation = jit->generation;
+            const uint8_t* successor = get_translated_block(cpu, cpu->PC);
+            if(NULL != successor && generation == jit->generation)
+            {
+                patch_rel32(exit.patch_site, successor);
+            }
+        }
+        else if(EXIT_TO_INTERPRETER == exit.reason)
+        {
+            cpu->jit_cycles_remaining -= cpu_run(cpu, 1);
+        }
+    }
+
+    return (uint32_t)(budget - cpu->jit_cycles_remaining);
+}
+
+#else
+
+jit_t* make_jit(void)
+{
+    return NULL;
+}
+
+void destroy_jit(jit_t* jit)
+{
+    (void)jit;
+}
+
+void jit_flush(jit_t* jit)
+{
+    (void)jit;
+}
+
+void jit_note_store(jit_t* jit, uint32_t address)
+{
+    (void)jit;
+    (void)address;
+}
+
+//there's no translator for this host, so just interpret
+uint32_t cpu_run_translated(cpu_t* cpu, uint32_t cycle_budget)
+{
+    return cpu_run(cpu, cycle_budget);
+}
+
+#endif
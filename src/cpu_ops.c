@@ -20,9 +20,7 @@
 #include "cpu_ops.h"
 #include "opcode_list.h"
 #include "debug.h"
-#include <stdlib.h> //for exit()
-
-struct cpu backup_cpu; //holds backups of our cpu's registers, etc while in interrupt mode
+#include <string.h> //for memcpy()
 
 static cpu_op instruction_table[NUM_INSTRUCTIONS];
 
@@ -31,10 +29,27 @@ enum condition_code_register_bit_position_t { POSITIVE_BIT = 0, ZERO_BIT = 1, NE
 static const uint8_t INTERRUPT_IN_PROCESS_BIT = 0;
 
 static void set_interrupt_in_process_status(cpu_t* cpu, bool interrupt_in_process);
+//Most ALU results get overwritten by the next ALU operation before anything
+//looks at the condition codes, so all we do here is remember the result. The
+//N/Z/P bits are only worked out from it once someone actually reads the CCR
+//(see get_condition_code_register())
+void update_condition_code_bits(cpu_t* cpu, uint32_t result)
+{
+    cpu->last_ALU_result = result;
+    cpu->condition_codes_pending = true;
+}
+
 //sets the condition code bits according to the result of the last ALU operation
 //FIXME: Do I want or need additional condition codes?
-void update_condition_code_bits(cpu_t* cpu, uint32_t result)
+uint32_t get_condition_code_register(cpu_t* cpu)
 {
+    if(!cpu->condition_codes_pending)
+    {
+        return cpu->CCR;
+    }
+
+    uint32_t result = cpu->last_ALU_result;
+    cpu->condition_codes_pending = false;
     cpu->CCR = 0; //condition code bits are mutually exclusive
     const uint8_t SIGN_BIT = 31;
     if(0 == result)
@@ -49,6 +64,7 @@ void update_condition_code_bits(cpu_t* cpu, uint32_t result)
     {
         BIT_SET(cpu->CCR, POSITIVE_BIT);
     }
+    return cpu->CCR;
 }
 
 
@@ -70,7 +86,7 @@ void set_interrupt_in_process_status(cpu_t* cpu, bool interrupt_in_process)
     }
 }
 
-static bool is_operating_system_scheduler_interrupt(interrupt_controller_t* ic)
+static bool is_operating_system_scheduler_interrupt(uint8_t interrupt_source)
 {
     //OS scheduler interrupt service routines must manually save software
     //context because the whole point of the scheduler is that it will not
@@ -78,45 +94,97 @@ static bool is_operating_system_scheduler_interrupt(interrupt_controller_t* ic)
     //saving/restoring the machine state automatically would defeat this.
     const uint8_t PREEMPTIVE_SCHEDULER_IRQ = IRQ_0;
     const uint8_t COOPERATIVE_SCHEDULER_IRQ = IRQ_128;
-    uint8_t interrupt_source = get_interrupt_source(ic);
     return (PREEMPTIVE_SCHEDULER_IRQ == interrupt_source || COOPERATIVE_SCHEDULER_IRQ == interrupt_source);
 }
 
-static void backup_machine_state(cpu_t* cpu)
+//A running interrupt handler can only be interrupted by a more urgent (lower
+//numbered) IRQ, and only if there is a register bank left for it. The
+//scheduler never interrupts a handler, since it wouldn't come back to it.
+bool interrupt_can_be_taken(cpu_t* cpu)
 {
-    backup_cpu = *cpu;
+    if(!interrupt_requested(cpu->ic))
+    {
+        return false;
+    }
+    if(!interrupt_in_process(cpu))
+    {
+        return true;
+    }
+    if(0 == cpu->interrupt_depth || INTERRUPT_NESTING_DEPTH == cpu->interrupt_depth)
+    {
+        return false;
+    }
+
+    uint8_t interrupt_source = get_interrupt_source(cpu->ic);
+    return !is_operating_system_scheduler_interrupt(interrupt_source) &&
+           interrupt_source < cpu->interrupt_frames[cpu->interrupt_depth - 1].irq;
 }
 
-static void restore_machine_state(cpu_t* cpu)
+//Switches to the next register bank up, which starts out as a copy of the
+//interrupted registers so that the handler can carry on using them (e.g. as
+//a stack pointer). Everything else that has to be put back is kept in the
+//interrupt frame.
+static void save_machine_state(cpu_t* cpu, interrupt_frame_t* frame)
 {
-    *cpu = backup_cpu;
+    frame->state.PC = cpu->PC;
+    frame->state.CCR = get_condition_code_register(cpu);
+    frame->state.process_status_reg = cpu->process_status_reg;
+    frame->registers = cpu->registers;
+
+    uint32_t* bank = cpu->register_banks[cpu->interrupt_depth + 1];
+    memcpy(bank, cpu->registers, sizeof(cpu->register_banks[0]));
+    cpu->registers = bank;
 }
 
+//switches straight back to the interrupted registers
+static void restore_machine_state(cpu_t* cpu, const interrupt_frame_t* frame)
+{
+    cpu->registers = frame->registers;
+    cpu->PC = frame->state.PC;
+    cpu->CCR = frame->state.CCR;
+    cpu->condition_codes_pending = false;
+    cpu->process_status_reg = frame->state.process_status_reg;
+}
+
+//Precondition: interrupt_can_be_taken() must be true
 void enter_interrupt_mode(cpu_t* cpu)
 {
-    if(!is_operating_system_scheduler_interrupt(cpu->ic))
+    uint8_t interrupt_source = get_interrupt_source(cpu->ic);
+    acknowledge_interrupt(cpu->ic, interrupt_source);
+
+    interrupt_frame_t* frame = &cpu->interrupt_frames[cpu->interrupt_depth];
+    frame->irq = interrupt_source;
+    frame->state_saved = !is_operating_system_scheduler_interrupt(interrupt_source);
+    if(frame->state_saved)
     {
-        backup_machine_state(cpu);
+        save_machine_state(cpu, frame);
     }
+    cpu->interrupt_depth++;
 
     set_interrupt_in_process_status(cpu, true);
-
-    beacon();       //DEBUG
-    exit(-1);       //DEBUG
-
-    cpu->PC = get_interrupt_vector_table_starting_address(cpu->ic) + get_interrupt_source(cpu->ic);
+    cpu->PC = get_interrupt_vector_table_starting_address(cpu->ic) + interrupt_source;
 }
 
 
 
 void exit_interrupt_mode(cpu_t* cpu)
 {
-    if(!is_operating_system_scheduler_interrupt(cpu->ic))
+    if(0 == cpu->interrupt_depth)
+    {
+        set_interrupt_in_process_status(cpu, false);
+        return;
+    }
+
+    cpu->interrupt_depth--;
+    const interrupt_frame_t* frame = &cpu->interrupt_frames[cpu->interrupt_depth];
+    if(frame->state_saved)
+    {
+        restore_machine_state(cpu, frame);
+    }
+    else
     {
-        restore_machine_state(cpu);
+        set_interrupt_in_process_status(cpu, 0 != cpu->interrupt_depth);
     }
-    set_interrupt_in_process_status(cpu, false);
-    beacon();
 }
 
 
@@ -273,8 +341,9 @@ void cpu_branch(cpu_t* cpu)
     uint32_t N = CHECK_BIT_SET(cpu->instruction_condition_codes, NEGATIVE_BIT);
     uint32_t Z = CHECK_BIT_SET(cpu->instruction_condition_codes, ZERO_BIT);
     uint32_t P = CHECK_BIT_SET(cpu->instruction_condition_codes, POSITIVE_BIT);
+    uint32_t CCR = get_condition_code_register(cpu);
 
-    if((cpu->CCR & N) || (cpu->CCR & Z) || (cpu->CCR & P))
+    if((CCR & N) || (CCR & Z) || (CCR & P))
     {
         cpu->PC = cpu->PC + cpu->branch_pc_relative_offset_bits;
     }
@@ -370,6 +439,18 @@ void cpu_rfi(cpu_t* cpu)
     exit_interrupt_mode(cpu);
 }
 
+//  WFI/HALT
+//      opcode = 010111
+//      e.g. WFI
+//          "WFI 0x0000000"
+//          6-bits + 26-bits-unused
+void cpu_wfi(cpu_t* cpu)
+{
+    //the cpu stops fetching instructions until an interrupt is requested
+    //(see cpu_waiting_for_interrupt())
+    cpu->waiting_for_interrupt = true;
+}
+
 
 void cpu_nop(cpu_t* cpu)
 {
@@ -383,7 +464,7 @@ static cpu_op instruction_table[NUM_INSTRUCTIONS] =
 {
     &cpu_and, &cpu_or, &cpu_not, &cpu_xor, &cpu_add, &cpu_sub, &cpu_nop, &cpu_nop,
     &cpu_nop, &cpu_nop, &cpu_nop, &cpu_load_pc_relative, &cpu_load_base_plus_offset, &cpu_load_effective_address, &cpu_nop, &cpu_nop,
-    &cpu_jump_pc_relative, &cpu_branch, &cpu_call, &cpu_callr, &cpu_jump_base_plus_offset, &cpu_swi, &cpu_rfi, &cpu_nop,
+    &cpu_jump_pc_relative, &cpu_branch, &cpu_call, &cpu_callr, &cpu_jump_base_plus_offset, &cpu_swi, &cpu_rfi, &cpu_wfi,
     &cpu_nop, &cpu_nop, &cpu_nop, &cpu_nop, &cpu_nop, &cpu_nop, &cpu_nop, &cpu_nop,
     &cpu_nop, &cpu_nop, &cpu_nop, &cpu_nop, &cpu_nop, &cpu_nop, &cpu_nop, &cpu_nop,
     &cpu_nop, &cpu_nop, &cpu_nop, &cpu_nop, &cpu_nop, &cpu_nop, &cpu_nop, &cpu_nop,
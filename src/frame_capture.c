@@ -0,0 +1,374 @@
+// ----------------------------------------------------------------------------
+//
+//  FILE: frame_capture.c
+//
+//  DESCRIPTION: This module records what is on the simulated computer's screen
+//  to a video file, for looking at what a program drew without having to sit
+//  and watch it run.
+//
+//  The simulation and the writer thread pass a handful of frame buffers
+//  ("slots") back and forth over a pair of lock-free queues: free slots go to
+//  the simulation, which copies a frame into one and hands it to the writer,
+//  which converts it, writes it out and gives it back. Every slot remembers
+//  which frame it last held, so only the rows that have changed since then
+//  need copying. If the writer falls behind and there are no free slots, the
+//  frame is dropped rather than making the simulation wait.
+//
+//  The writer holds on to the last frame it wrote so that it can skip frames
+//  that are identical to it, which is most of them for programs that sit
+//  waiting for something. Y4M frames are tagged with the cycle that they were
+//  captured on ("FRAME Xcycle=<n>"), so none of the timing is lost by it.
+//
+//  Converting RGBA8888 to YUV or to RGBA bytes is done 8 pixels at a time
+//  with SSE2 where the host has it, and a pixel at a time everywhere else.
+//
+// ----------------------------------------------------------------------------
+
+#include "frame_capture.h"
+#include "spsc_queue.h"
+#include "host_clock.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include <pthread.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+//frames that can be waiting for the writer at once
+#define NUM_CAPTURE_SLOTS               (8)
+//how long the writer waits before looking for more frames when it has none
+#define WRITER_WAIT_MILLISECONDS        (1)
+
+enum capture_format_t { CAPTURE_Y4M, CAPTURE_RAW };
+
+struct capture_slot_t
+{
+    uint64_t sequence;      //the display frame that the pixels are from
+    uint64_t cycle;         //when it was captured
+    uint32_t* pixels;
+};
+
+typedef struct capture_slot_t capture_slot_t;
+
+struct frame_capture_t
+{
+    uint16_t width;
+    uint16_t height;
+    enum capture_format_t format;
+    FILE* file;
+
+    capture_slot_t slots[NUM_CAPTURE_SLOTS];
+    spsc_queue_t* free_slots;       //writer to simulation
+    spsc_queue_t* filled_slots;     //simulation to writer
+
+    pthread_t writer_thread;
+    bool stop_writing;              //only accessed atomically
+    uint64_t frames_written;        //only accessed atomically
+    uint64_t frames_dropped;        //only touched by the simulation
+
+    //everything below here belongs to the writer thread
+    uint8_t* converted;             //one frame in the file's format
+    bool has_previous_frame;
+    uint32_t previous_slot;         //the last frame written, kept to compare against
+    bool write_failed;
+};
+
+static void* writer_thread(void* context);
+
+static enum capture_format_t format_for_path(const char* path)
+{
+    const char* extension = strrchr(path, '.');
+    if(extension != NULL && 0 == strcmp(extension, ".y4m"))
+    {
+        return CAPTURE_Y4M;
+    }
+    return CAPTURE_RAW;
+}
+
+static size_t num_pixels(frame_capture_t* capture)
+{
+    return (size_t)capture->width * capture->height;
+}
+
+//Y4M frames are three full size planes (Y, then U, then V), raw ones are 4
+//bytes per pixel
+static size_t converted_frame_size(frame_capture_t* capture)
+{
+    return num_pixels(capture) * ((CAPTURE_Y4M == capture->format) ? 3 : 4);
+}
+
+frame_capture_t* frame_capture_open(const char* path, uint16_t width, uint16_t height,
+                                    uint32_t rate_numerator, uint32_t rate_denominator)
+{
+    FILE* file = fopen(path, "wb");
+    if(file == NULL)
+    {
+        return NULL;
+    }
+
+    frame_capture_t* capture = calloc(1, sizeof(frame_capture_t));
+    capture->width = width;
+    capture->height = height;
+    capture->format = format_for_path(path);
+    capture->file = file;
+    capture->free_slots = spsc_queue_create(NUM_CAPTURE_SLOTS);
+    capture->filled_slots = spsc_queue_create(NUM_CAPTURE_SLOTS);
+    capture->converted = malloc(converted_frame_size(capture));
+    for(uint32_t i = 0; i < NUM_CAPTURE_SLOTS; i++)
+    {
+        //sequence 0 is older than any frame, so the first copy is a whole one
+        capture->slots[i].pixels = calloc(num_pixels(capture), sizeof(uint32_t));
+        spsc_queue_put(capture->free_slots, i);
+    }
+
+    if(CAPTURE_Y4M == capture->format)
+    {
+        //4:4:4 so that nothing is lost to chroma subsampling, and square pixels
+        fprintf(file, "YUV4MPEG2 W%u H%u F%" PRIu32 ":%" PRIu32 " Ip A1:1 C444\n",
+                width, height, rate_numerator, rate_denominator);
+    }
+
+    if(0 != pthread_create(&capture->writer_thread, NULL, &writer_thread, capture))
+    {
+        fprintf(stderr, "failed to start the capture writer thread\n");
+        exit(EXIT_FAILURE);
+    }
+    return capture;
+}
+
+bool frame_capture_close(frame_capture_t* capture)
+{
+    //the writer finishes off everything that was submitted before it stops
+    __atomic_store_n(&capture->stop_writing, true, __ATOMIC_RELEASE);
+    pthread_join(capture->writer_thread, NULL);
+
+    bool written = !capture->write_failed;
+    if(0 != fclose(capture->file))
+    {
+        written = false;
+    }
+
+    for(uint32_t i = 0; i < NUM_CAPTURE_SLOTS; i++)
+    {
+        free(capture->slots[i].pixels);
+    }
+    free(capture->converted);
+    spsc_queue_destroy(capture->free_slots);
+    spsc_queue_destroy(capture->filled_slots);
+    free(capture);
+    return written;
+}
+
+bool frame_capture_submit(frame_capture_t* capture, const graphics_frame_t* frame, uint64_t cycle)
+{
+    uint32_t index;
+    if(!spsc_queue_get(capture->free_slots, &index))
+    {
+        capture->frames_dropped++;
+        return false;
+    }
+
+    //the slot still holds an older frame, so it only needs the rows that
+    //have changed since then
+    capture_slot_t* slot = &capture->slots[index];
+    size_t row_size = capture->width * sizeof(uint32_t);
+    for(uint16_t row = 0; row < capture->height; row++)
+    {
+        if(frame->row_sequence[row] > slot->sequence)
+        {
+            size_t offset = (size_t)row * capture->width;
+            memcpy(&slot->pixels[offset], &frame->pixels[offset], row_size);
+        }
+    }
+    slot->sequence = frame->sequence;
+    slot->cycle = cycle;
+    spsc_queue_put(capture->filled_slots, index);
+    return true;
+}
+
+uint64_t frame_capture_frames_written(frame_capture_t* capture)
+{
+    return __atomic_load_n(&capture->frames_written, __ATOMIC_ACQUIRE);
+}
+
+uint64_t frame_capture_frames_dropped(frame_capture_t* capture)
+{
+    return capture->frames_dropped;
+}
+
+//BT.601 studio range, in the 8 bit fixed point that everybody uses for it
+static void rgba_to_yuv(uint32_t pixel, uint8_t* y, uint8_t* u, uint8_t* v)
+{
+    int32_t r = (int32_t)(pixel >> 24);
+    int32_t g = (int32_t)((pixel >> 16) & 0xFF);
+    int32_t b = (int32_t)((pixel >> 8) & 0xFF);
+    *y = (uint8_t)(((66*r + 129*g + 25*b + 128) >> 8) + 16);
+    *u = (uint8_t)(((-38*r - 74*g + 112*b + 128) >> 8) + 128);
+    *v = (uint8_t)(((112*r - 94*g - 18*b + 128) >> 8) + 128);
+}
+
+#if defined(__SSE2__)
+
+//pulls the R, G and B channels out of 8 RGBA8888 pixels as 16 bit lanes
+static void unpack_channels(const uint32_t* pixels, __m128i* r, __m128i* g, __m128i* b)
+{
+    const __m128i BYTE_MASK = _mm_set1_epi32(0xFF);
+    __m128i low = _mm_loadu_si128((const __m128i*)pixels);
+    __m128i high = _mm_loadu_si128((const __m128i*)&pixels[4]);
+    *r = _mm_packs_epi32(_mm_srli_epi32(low, 24), _mm_srli_epi32(high, 24));
+    *g = _mm_packs_epi32(_mm_and_si128(_mm_srli_epi32(low, 16), BYTE_MASK),
+                         _mm_and_si128(_mm_srli_epi32(high, 16), BYTE_MASK));
+    *b = _mm_packs_epi32(_mm_and_si128(_mm_srli_epi32(low, 8), BYTE_MASK),
+                         _mm_and_si128(_mm_srli_epi32(high, 8), BYTE_MASK));
+}
+
+//the same sums as rgba_to_yuv(), which all fit in 16 bits: Y's are never
+//negative and never go past 56228, U's and V's stay within +/-28688
+static __m128i weigh_channels(__m128i r, __m128i g, __m128i b, int16_t r_weight, int16_t g_weight, int16_t b_weight)
+{
+    __m128i sum = _mm_add_epi16(_mm_mullo_epi16(r, _mm_set1_epi16(r_weight)),
+                                _mm_mullo_epi16(g, _mm_set1_epi16(g_weight)));
+    sum = _mm_add_epi16(sum, _mm_mullo_epi16(b, _mm_set1_epi16(b_weight)));
+    return _mm_add_epi16(sum, _mm_set1_epi16(128));
+}
+
+static size_t convert_to_yuv_sse2(const uint32_t* pixels, size_t count, uint8_t* y, uint8_t* u, uint8_t* v)
+{
+    size_t i = 0;
+    for(; i + 8 <= count; i += 8)
+    {
+        __m128i r, g, b;
+        unpack_channels(&pixels[i], &r, &g, &b);
+
+        __m128i luma = _mm_add_epi16(_mm_srli_epi16(weigh_channels(r, g, b, 66, 129, 25), 8), _mm_set1_epi16(16));
+        __m128i blue = _mm_add_epi16(_mm_srai_epi16(weigh_channels(r, g, b, -38, -74, 112), 8), _mm_set1_epi16(128));
+        __m128i red = _mm_add_epi16(_mm_srai_epi16(weigh_channels(r, g, b, 112, -94, -18), 8), _mm_set1_epi16(128));
+
+        _mm_storel_epi64((__m128i*)&y[i], _mm_packus_epi16(luma, luma));
+        _mm_storel_epi64((__m128i*)&u[i], _mm_packus_epi16(blue, blue));
+        _mm_storel_epi64((__m128i*)&v[i], _mm_packus_epi16(red, red));
+    }
+    return i;
+}
+
+//byte swaps 4 pixels at a time, which turns RGBA8888 words into R, G, B, A
+//bytes on a little endian host (which all SSE2 hosts are)
+static size_t convert_to_rgba_sse2(const uint32_t* pixels, size_t count, uint8_t* bytes)
+{
+    size_t i = 0;
+    for(; i + 4 <= count; i += 4)
+    {
+        __m128i words = _mm_loadu_si128((const __m128i*)&pixels[i]);
+        __m128i halves_swapped = _mm_shufflehi_epi16(_mm_shufflelo_epi16(words, _MM_SHUFFLE(2, 3, 0, 1)), _MM_SHUFFLE(2, 3, 0, 1));
+        __m128i swapped = _mm_or_si128(_mm_slli_epi16(halves_swapped, 8), _mm_srli_epi16(halves_swapped, 8));
+        _mm_storeu_si128((__m128i*)&bytes[i * 4], swapped);
+    }
+    return i;
+}
+
+#endif
+
+static void convert_to_yuv(frame_capture_t* capture, const uint32_t* pixels)
+{
+    size_t count = num_pixels(capture);
+    uint8_t* y = capture->converted;
+    uint8_t* u = &y[count];
+    uint8_t* v = &u[count];
+    size_t i = 0;
+#if defined(__SSE2__)
+    i = convert_to_yuv_sse2(pixels, count, y, u, v);
+#endif
+    for(; i < count; i++)
+    {
+        rgba_to_yuv(pixels[i], &y[i], &u[i], &v[i]);
+    }
+}
+
+static void convert_to_rgba(frame_capture_t* capture, const uint32_t* pixels)
+{
+    size_t count = num_pixels(capture);
+    uint8_t* bytes = capture->converted;
+    size_t i = 0;
+#if defined(__SSE2__)
+    i = convert_to_rgba_sse2(pixels, count, bytes);
+#endif
+    for(; i < count; i++)
+    {
+        bytes[i*4 + 0] = (uint8_t)(pixels[i] >> 24);
+        bytes[i*4 + 1] = (uint8_t)(pixels[i] >> 16);
+        bytes[i*4 + 2] = (uint8_t)(pixels[i] >> 8);
+        bytes[i*4 + 3] = (uint8_t)pixels[i];
+    }
+}
+
+static void write_frame(frame_capture_t* capture, const capture_slot_t* slot)
+{
+    if(CAPTURE_Y4M == capture->format)
+    {
+        fprintf(capture->file, "FRAME Xcycle=%" PRIu64 "\n", slot->cycle);
+        convert_to_yuv(capture, slot->pixels);
+    }
+    else
+    {
+        convert_to_rgba(capture, slot->pixels);
+    }
+
+    size_t size = converted_frame_size(capture);
+    if(size != fwrite(capture->converted, 1, size, capture->file))
+    {
+        capture->write_failed = true;
+    }
+    __atomic_add_fetch(&capture->frames_written, 1, __ATOMIC_RELEASE);
+}
+
+//writes the frame out unless it's the same as the last one, and gives back
+//whichever of the two slots is no longer needed
+static void process_slot(frame_capture_t* capture, uint32_t index)
+{
+    const capture_slot_t* slot = &capture->slots[index];
+    if(capture->has_previous_frame &&
+       0 == memcmp(slot->pixels, capture->slots[capture->previous_slot].pixels, num_pixels(capture) * sizeof(uint32_t)))
+    {
+        spsc_queue_put(capture->free_slots, index);
+        return;
+    }
+
+    write_frame(capture, slot);
+    if(capture->has_previous_frame)
+    {
+        spsc_queue_put(capture->free_slots, capture->previous_slot);
+    }
+    capture->previous_slot = index;
+    capture->has_previous_frame = true;
+}
+
+static void* writer_thread(void* context)
+{
+    frame_capture_t* capture = context;
+    while(true)
+    {
+        uint32_t index;
+        if(spsc_queue_get(capture->filled_slots, &index))
+        {
+            process_slot(capture, index);
+        }
+        else if(__atomic_load_n(&capture->stop_writing, __ATOMIC_ACQUIRE))
+        {
+            //anything submitted before the stop was asked for is in the
+            //queue by now
+            if(spsc_queue_is_empty(capture->filled_slots))
+            {
+                break;
+            }
+        }
+        else
+        {
+            host_clock_sleep(WRITER_WAIT_MILLISECONDS);
+        }
+    }
+    return NULL;
+}
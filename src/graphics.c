@@ -1,4 +1,5 @@
 
+
 // ----------------------------------------------------------------------------
 //
 //  FILE: graphics.c
@@ -8,29 +9,33 @@
 //  CPU so that the CPU can just write to the frame buffer in its memory map
 //  and everything will appear on the screen as expected.
 //
-//  On the user interface side of things, this module connects our virtual
-//  graphics and display "hardware" to the program's output window so that the
-//  user can see what the simulated computer is trying to display. It uses the
-//  Simple DirectMedia Layer (SDL) in order to do this is a cross-platform way.
-//
-//  All of the SDL code necessary to make this work will be encapsulated here.
-//  TODO: I may eventually need to separate out the SDL code from this module
-//  so that I can initialize it separately. Currently, since the SDL code is
-//  initialized here, I can't run a simulation without a window being created,
-//  which makes remote development/testing new code that doesn't need graphics
-//  very difficult. I don't know yet how I will separate the graphics
-//  simulation code from the SDL initialization code yet, though.
+//  On the user interface side of things, the frames are handed over to a
+//  graphics backend (see graphics_backend.h), which is what actually shows
+//  them to somebody. The SDL backend (graphics_sdl.c) puts them up in a
+//  window; the null backend doesn't show them to anyone, so that programs can
+//  run where there is no display at all. Either way, the frame buffer can be
+//  dumped to a file (PPM or raw RGBA) whenever somebody wants to look at it,
+//  or streamed to a video file (see frame_capture.c) as the program runs.
 //
-//  The bulk of this code was gleaned from http://lazyfoo.net/tutorials/SDL/
-//  and https://wiki.libsdl.org/MigrationGuide because prior to today
-//  (2015-03-16), I had no idea how to use SDL!
+//  Most frames only change a few rows of the screen (if any), so every row
+//  remembers the frame that it last changed in. That lets the backends only
+//  copy what changed, and frames where nothing changed aren't presented at
+//  all.
 //
 // ----------------------------------------------------------------------------
 
-// include any SDL stuff here
-#include "SDL.h"
 #include "memory_bus.h"
 #include "graphics.h"
+#include "graphics_backend.h"
+#include "frame_capture.h"
+#include "hash.h"
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 
 struct graphics_t 
 {
@@ -39,52 +44,120 @@ struct graphics_t
     //This is where our custom computer will write the graphical output
     uint32_t* frame_buffer;
 
-    //The window we'll be rendering to
-    SDL_Window* window;
-    //the renderer is an SDL2 concept that handles getting our data to the GPU
-    SDL_Renderer* renderer;
-    //This texture is where we will copy our framebuffer to for SDL to do its magic
-    SDL_Texture* screen;
+    //the sequence number of the frame that is being drawn right now, and the
+    //one that each row of the frame buffer last changed in
+    uint64_t frame_sequence;
+    uint64_t* row_sequence;
+    bool frame_changed;
+
+    //whatever is showing the frames to the user
+    const graphics_backend_ops_t* backend_ops;
+    void* backend;
+
+    //the video that frames are being captured to (NULL when there isn't
+    //one), and the last frame that went into it
+    frame_capture_t* capture;
+    uint64_t capture_sequence;
     uint32_t GRAPHICS_MEMORY_MAP_START_ADDRESS;
 };
 
 
-static void init_window(graphics_t* graphics);
 static void program_failure(void);
 
-//static void change_color(graphics_t* graphics, uint32_t pixel_value);
-static void clear_screen(graphics_t* graphics);
+//the backend for displays that nobody is watching: frames go nowhere and
+//there is never any key presses
+static void* null_create(uint16_t width, uint16_t height)
+{
+    (void)width;
+    (void)height;
+    return NULL;
+}
 
-//creates our display for the program and initializes the frame buffer and the
-//SDL subsystem
-graphics_t* create_graphics_display(uint16_t width, uint16_t height, uint32_t graphics_memory_map_starting_address)
+static void null_destroy(void* backend)
+{
+    (void)backend;
+}
+
+static void null_present(void* backend, const graphics_frame_t* frame)
+{
+    (void)backend;
+    (void)frame;
+}
+
+static spsc_queue_t* null_get_key_events(void* backend)
+{
+    (void)backend;
+    return NULL;
+}
+
+const graphics_backend_ops_t null_graphics_backend =
+{
+    .name = "null",
+    .create = &null_create,
+    .destroy = &null_destroy,
+    .present = &null_present,
+    .get_key_events = &null_get_key_events,
+};
+
+static size_t frame_buffer_size(graphics_t* graphics)
+{
+    return graphics->WINDOW_WIDTH * graphics->WINDOW_HEIGHT * sizeof(uint32_t);
+}
+
+//creates our display for the program, initializes the frame buffer and
+//hooks it up to the given backend. Backends don't have to open anything
+//(windows, etc) until the first frame is presented to them.
+graphics_t* create_graphics(uint16_t width, uint16_t height, uint32_t graphics_memory_map_starting_address, const graphics_backend_ops_t* backend_ops)
 {
     graphics_t* graphics = calloc(1, sizeof(graphics_t));
+    if(graphics == NULL)
+    {
+        fprintf(stderr, "failed to allocate graphics display\n");
+        program_failure();
+    }
     graphics->WINDOW_HEIGHT = height;
     graphics->WINDOW_WIDTH = width;
     graphics->GRAPHICS_MEMORY_MAP_START_ADDRESS = graphics_memory_map_starting_address;
 
-    //FIXME: eventually need to handle the double buffering
-    uint32_t buffer_size = graphics->WINDOW_WIDTH * graphics->WINDOW_HEIGHT * sizeof(uint32_t);
-    graphics->frame_buffer = calloc(1, buffer_size);
-    if(graphics->frame_buffer == NULL)
+    graphics->frame_buffer = calloc(1, frame_buffer_size(graphics));
+    graphics->row_sequence = calloc(graphics->WINDOW_HEIGHT, sizeof(uint64_t));
+    //backends have seen nothing yet, which is frame 0
+    graphics->frame_sequence = 1;
+    if(graphics->frame_buffer == NULL || graphics->row_sequence == NULL)
     {
         fprintf(stderr, "failed to allocate frame buffer\n");
         program_failure();
     }
-    init_window(graphics);
 
+    //marks every row as changed, so that the blank screen is the first thing
+    //that the backend gets
+    graphics_reset(graphics);
+
+    graphics->backend_ops = backend_ops;
+    graphics->backend = backend_ops->create(width, height);
     return graphics;
 }
 
+//a display that shows up in a window on the host
+graphics_t* create_graphics_display(uint16_t width, uint16_t height, uint32_t graphics_memory_map_starting_address)
+{
+    return create_graphics(width, height, graphics_memory_map_starting_address, &sdl_graphics_backend);
+}
+
+//creates a display that has a frame buffer but never opens a window, for
+//running programs where nobody is watching (e.g. batch jobs)
+graphics_t* create_headless_graphics_display(uint16_t width, uint16_t height, uint32_t graphics_memory_map_starting_address)
+{
+    return create_graphics(width, height, graphics_memory_map_starting_address, &null_graphics_backend);
+}
+
 //de-allocates all of the display resources
 void graphics_destroy(graphics_t* graphics)
 {
-    SDL_DestroyWindow(graphics->window);
-    SDL_DestroyTexture(graphics->screen);
-    SDL_DestroyRenderer(graphics->renderer);
-    SDL_Quit();
+    graphics_stop_capture(graphics);
+    graphics->backend_ops->destroy(graphics->backend);
     free(graphics->frame_buffer);
+    free(graphics->row_sequence);
     free(graphics);
 }
 
@@ -92,14 +165,19 @@ void graphics_update(graphics_t* graphics, uint32_t pixel_address, uint32_t RGBA
 {
     uint32_t index = pixel_address - graphics->GRAPHICS_MEMORY_MAP_START_ADDRESS;
     graphics->frame_buffer[index] = RGBA_pixel;
+    graphics->row_sequence[index / graphics->WINDOW_WIDTH] = graphics->frame_sequence;
+    graphics->frame_changed = true;
 }
 
 
 void graphics_reset(graphics_t* graphics)
 {
-    clear_screen(graphics);
-    size_t fb_size = graphics->WINDOW_WIDTH * graphics->WINDOW_HEIGHT * sizeof(uint32_t);
-    memset(graphics->frame_buffer, 0x00, fb_size);
+    memset(graphics->frame_buffer, 0x00, frame_buffer_size(graphics));
+    for(uint16_t row = 0; row < graphics->WINDOW_HEIGHT; row++)
+    {
+        graphics->row_sequence[row] = graphics->frame_sequence;
+    }
+    graphics->frame_changed = true;
 }
 
 static void program_failure(void)
@@ -107,78 +185,368 @@ static void program_failure(void)
     exit(EXIT_FAILURE);
 }
 
-static void init_window(graphics_t* graphics)
+#if 0
+
+//this is just a little function to help me debug this code; it just fills the
+//framebuffer with the requested RGBA encoded pixel value
+static void change_color(graphics_t* graphics, uint32_t pixel_value)
 {
-    int init_error = SDL_Init(SDL_INIT_VIDEO);
-    if(init_error)
+    for(int col = 0; col < graphics->WINDOW_WIDTH; col++)
     {
-        fprintf(stderr, "%s\n", SDL_GetError());
-        program_failure();
+        for(int row = 0; row < graphics->WINDOW_HEIGHT; row++)
+        {
+            graphics->frame_buffer[row*graphics->WINDOW_WIDTH + col] = pixel_value;
+        }
     }
+}
+#endif
 
-    graphics->window = SDL_CreateWindow("zcpu-sim", 
-                                        SDL_WINDOWPOS_CENTERED, 
-                                        SDL_WINDOWPOS_CENTERED, 
-                                        graphics->WINDOW_WIDTH, 
-                                        graphics->WINDOW_HEIGHT, 
-                                        SDL_WINDOW_SHOWN);
-    if(graphics->window == NULL)
+//hands the frame buffer over to the backend to be shown. Nothing is sent if
+//nothing has changed since the last one.
+void graphics_draw(graphics_t* graphics)
+{
+    if(!graphics->frame_changed)
     {
-        fprintf(stderr, "failed to allocate SDL window\n");
-        program_failure();
+        return;
     }
 
-    graphics->renderer = SDL_CreateRenderer(graphics->window, -1, 0);
-    if(graphics->renderer == NULL)
+    graphics_frame_t frame =
     {
-        fprintf(stderr, "failed to allocate SDL renderer\n");
-        program_failure();
+        .width = graphics->WINDOW_WIDTH,
+        .height = graphics->WINDOW_HEIGHT,
+        .sequence = graphics->frame_sequence,
+        .row_sequence = graphics->row_sequence,
+        .pixels = graphics->frame_buffer,
+    };
+    graphics->backend_ops->present(graphics->backend, &frame);
+
+    graphics->frame_sequence++;
+    graphics->frame_changed = false;
+}
+
+//starts streaming frames to a video file (see frame_capture.h), at whatever
+//rate graphics_capture_frame() gets called. The frame rate is only for the
+//file's header. Returns false if the file couldn't be created.
+bool graphics_start_capture(graphics_t* graphics, const char* path, uint32_t rate_numerator, uint32_t rate_denominator)
+{
+    graphics_stop_capture(graphics);
+    graphics->capture = frame_capture_open(path, graphics->WINDOW_WIDTH, graphics->WINDOW_HEIGHT, rate_numerator, rate_denominator);
+    //the first frame always goes in
+    graphics->capture_sequence = 0;
+    return (NULL != graphics->capture);
+}
+
+//adds what is in the frame buffer to the video, unless nothing has been
+//drawn since the last frame that went in
+void graphics_capture_frame(graphics_t* graphics, uint64_t cycle)
+{
+    if(NULL == graphics->capture)
+    {
+        return;
     }
 
-    graphics->screen = SDL_CreateTexture(graphics->renderer, 
-                                        SDL_PIXELFORMAT_RGBA8888, 
-                                        SDL_TEXTUREACCESS_STREAMING, 
-                                        graphics->WINDOW_WIDTH, 
-                                        graphics->WINDOW_HEIGHT);
-    if(graphics->screen == NULL)
+    bool changed = false;
+    for(uint16_t row = 0; !changed && row < graphics->WINDOW_HEIGHT; row++)
     {
-        fprintf(stderr, "failed to allocate SDL texture\n");
-        program_failure();
+        changed = (graphics->row_sequence[row] > graphics->capture_sequence);
+    }
+    if(!changed)
+    {
+        return;
     }
 
+    graphics_frame_t frame =
+    {
+        .width = graphics->WINDOW_WIDTH,
+        .height = graphics->WINDOW_HEIGHT,
+        .sequence = graphics->frame_sequence,
+        .row_sequence = graphics->row_sequence,
+        .pixels = graphics->frame_buffer,
+    };
+    frame_capture_submit(graphics->capture, &frame, cycle);
+    graphics->capture_sequence = graphics->frame_sequence;
+
+    //anything drawn from here on belongs to the next frame, for the capture
+    //and the backend both
+    graphics->frame_sequence++;
 }
 
-#if 0
+//finishes writing the video, returns false if any of it couldn't be written
+bool graphics_stop_capture(graphics_t* graphics)
+{
+    if(NULL == graphics->capture)
+    {
+        return true;
+    }
 
-//this is just a little function to help me debug this code; it just fills the
-//framebuffer with the requested RGBA encoded pixel value
-static void change_color(graphics_t* graphics, uint32_t pixel_value)
+    uint64_t dropped = frame_capture_frames_dropped(graphics->capture);
+    if(dropped > 0)
+    {
+        fprintf(stderr, "frame capture fell behind and dropped %" PRIu64 " frames\n", dropped);
+    }
+    bool written = frame_capture_close(graphics->capture);
+    graphics->capture = NULL;
+    return written;
+}
+
+//the key presses from the display window, NULL if there is no window
+spsc_queue_t* graphics_get_key_events(graphics_t* graphics)
 {
-    for(int col = 0; col < graphics->WINDOW_WIDTH; col++)
+    return graphics->backend_ops->get_key_events(graphics->backend);
+}
+
+uint16_t graphics_get_width(graphics_t* graphics)
+{
+    return graphics->WINDOW_WIDTH;
+}
+
+uint16_t graphics_get_height(graphics_t* graphics)
+{
+    return graphics->WINDOW_HEIGHT;
+}
+
+//The drawing operations below are the blitter's (see blitter.c) way into the
+//frame buffer. Rectangles are given by the address of their top left pixel
+//in the memory map and are clipped to the edges of the screen. Rectangles
+//that start off the screen aren't drawn at all.
+static bool clip_rect(graphics_t* graphics, uint32_t pixel_address, uint16_t* width, uint16_t* height, uint32_t* index)
+{
+    uint32_t offset = pixel_address - graphics->GRAPHICS_MEMORY_MAP_START_ADDRESS;
+    if((pixel_address < graphics->GRAPHICS_MEMORY_MAP_START_ADDRESS) ||
+       (offset >= (uint32_t)graphics->WINDOW_WIDTH * graphics->WINDOW_HEIGHT))
     {
-        for(int row = 0; row < graphics->WINDOW_HEIGHT; row++)
+        return false;
+    }
+
+    uint16_t x = (uint16_t)(offset % graphics->WINDOW_WIDTH);
+    uint16_t y = (uint16_t)(offset / graphics->WINDOW_WIDTH);
+    if(*width > graphics->WINDOW_WIDTH - x)
+    {
+        *width = graphics->WINDOW_WIDTH - x;
+    }
+    if(*height > graphics->WINDOW_HEIGHT - y)
+    {
+        *height = graphics->WINDOW_HEIGHT - y;
+    }
+    *index = offset;
+    return true;
+}
+
+static void mark_rows_changed(graphics_t* graphics, uint32_t index, uint16_t height)
+{
+    uint16_t first_row = (uint16_t)(index / graphics->WINDOW_WIDTH);
+    for(uint16_t row = first_row; row < first_row + height; row++)
+    {
+        graphics->row_sequence[row] = graphics->frame_sequence;
+    }
+    graphics->frame_changed = (graphics->frame_changed || (height > 0));
+}
+
+static void fill_row(uint32_t* pixels, uint16_t width, uint32_t RGBA_pixel)
+{
+    uint16_t col = 0;
+#if defined(__SSE2__)
+    __m128i color = _mm_set1_epi32((int32_t)RGBA_pixel);
+    for(; col + 4 <= width; col += 4)
+    {
+        _mm_storeu_si128((__m128i*)&pixels[col], color);
+    }
+#endif
+    for(; col < width; col++)
+    {
+        pixels[col] = RGBA_pixel;
+    }
+}
+
+//copies every pixel in the row that isn't the key color
+static void copy_row_keyed(uint32_t* pixels, const uint32_t* source, uint16_t width, uint32_t key)
+{
+    uint16_t col = 0;
+#if defined(__SSE2__)
+    __m128i key_color = _mm_set1_epi32((int32_t)key);
+    for(; col + 4 <= width; col += 4)
+    {
+        __m128i from = _mm_loadu_si128((const __m128i*)&source[col]);
+        __m128i to = _mm_loadu_si128((const __m128i*)&pixels[col]);
+        __m128i keep = _mm_cmpeq_epi32(from, key_color);
+        _mm_storeu_si128((__m128i*)&pixels[col], _mm_or_si128(_mm_and_si128(keep, to), _mm_andnot_si128(keep, from)));
+    }
+#endif
+    for(; col < width; col++)
+    {
+        if(source[col] != key)
         {
-            graphics->frame_buffer[row*graphics->WINDOW_WIDTH + col] = pixel_value;
+            pixels[col] = source[col];
         }
     }
 }
-#endif
 
-static void clear_screen(graphics_t* graphics)
+void graphics_fill_rect(graphics_t* graphics, uint32_t pixel_address, uint16_t width, uint16_t height, uint32_t RGBA_pixel)
 {
-    SDL_SetRenderDrawColor(graphics->renderer, 0x00, 0x00, 0x00, 0xFF); //clear to black
-    SDL_RenderClear(graphics->renderer);
+    uint32_t index;
+    if(!clip_rect(graphics, pixel_address, &width, &height, &index))
+    {
+        return;
+    }
+
+    for(uint16_t row = 0; row < height; row++)
+    {
+        fill_row(&graphics->frame_buffer[index + row * graphics->WINDOW_WIDTH], width, RGBA_pixel);
+    }
+    mark_rows_changed(graphics, index, height);
 }
 
-void graphics_draw(graphics_t* graphics)
+//copies a rectangle of the screen out to pixels, which is width pixels wide
+void graphics_read_rect(graphics_t* graphics, uint32_t pixel_address, uint16_t width, uint16_t height, uint32_t* pixels)
 {
-    clear_screen(graphics);
+    uint16_t stride = width;
+    uint32_t index;
+    if(!clip_rect(graphics, pixel_address, &width, &height, &index))
+    {
+        return;
+    }
 
-    //"blit" the framebuffer to the screen using SDL 2.0 GPU magic
-    int pitch = graphics->WINDOW_WIDTH*sizeof(uint32_t);
-    SDL_UpdateTexture(graphics->screen, NULL, graphics->frame_buffer, pitch);
-    SDL_RenderCopy(graphics->renderer, graphics->screen, NULL, NULL);
-    SDL_RenderPresent(graphics->renderer);
+    for(uint16_t row = 0; row < height; row++)
+    {
+        memcpy(&pixels[row * stride], &graphics->frame_buffer[index + row * graphics->WINDOW_WIDTH], width * sizeof(uint32_t));
+    }
+}
+
+//draws width x height pixels onto the screen. With a color key, pixels of
+//that color are left out so that whatever is underneath shows through.
+void graphics_blit(graphics_t* graphics, uint32_t pixel_address, uint16_t width, uint16_t height, const uint32_t* pixels, bool color_keyed, uint32_t key)
+{
+    uint16_t stride = width;
+    uint32_t index;
+    if(!clip_rect(graphics, pixel_address, &width, &height, &index))
+    {
+        return;
+    }
+
+    for(uint16_t row = 0; row < height; row++)
+    {
+        uint32_t* destination = &graphics->frame_buffer[index + row * graphics->WINDOW_WIDTH];
+        if(color_keyed)
+        {
+            copy_row_keyed(destination, &pixels[row * stride], width, key);
+        }
+        else
+        {
+            memcpy(destination, &pixels[row * stride], width * sizeof(uint32_t));
+        }
+    }
+    mark_rows_changed(graphics, index, height);
+}
+
+//The frame buffer is saved along with its size, which has to match when it
+//is restored. Compressing it (when that comes out smaller) is recorded as the
+//number of words it was encoded in, 0 meaning it was stored as it is.
+void graphics_save_state(graphics_t* graphics, state_writer_t* writer, bool compress)
+{
+    size_t num_pixels = (size_t)graphics->WINDOW_WIDTH * graphics->WINDOW_HEIGHT;
+    size_t rle_length = compress ? state_rle_length(graphics->frame_buffer, num_pixels) : num_pixels;
+    bool encoded = (rle_length < num_pixels);
+    state_write_u32(writer, graphics->WINDOW_WIDTH);
+    state_write_u32(writer, graphics->WINDOW_HEIGHT);
+    state_write_u32(writer, encoded ? (uint32_t)rle_length : 0);
+    if(encoded)
+    {
+        state_write_rle(writer, graphics->frame_buffer, num_pixels);
+    }
+    else
+    {
+        state_write_words(writer, graphics->frame_buffer, num_pixels);
+    }
+}
+
+void graphics_restore_state(graphics_t* graphics, state_reader_t* reader)
+{
+    size_t num_pixels = (size_t)graphics->WINDOW_WIDTH * graphics->WINDOW_HEIGHT;
+    uint32_t width = state_read_u32(reader);
+    uint32_t height = state_read_u32(reader);
+    uint32_t encoded_length = state_read_u32(reader);
+    if(!state_reader_check(reader, (width == graphics->WINDOW_WIDTH) && (height == graphics->WINDOW_HEIGHT) &&
+                                   (encoded_length < num_pixels)))
+    {
+        return;
+    }
+
+    if(0 == encoded_length)
+    {
+        state_read_words(reader, graphics->frame_buffer, num_pixels);
+    }
+    else
+    {
+        state_read_rle(reader, graphics->frame_buffer, num_pixels, encoded_length);
+    }
+    mark_rows_changed(graphics, 0, graphics->WINDOW_HEIGHT);
+}
+
+//a fingerprint of everything that is currently in the frame buffer
+uint64_t graphics_hash_frame_buffer(graphics_t* graphics)
+{
+    return hash_words(HASH_SEED, graphics->frame_buffer, graphics->WINDOW_WIDTH * graphics->WINDOW_HEIGHT);
+}
+
+//picks the dump format from a file's extension: PPM for ".ppm" and raw
+//RGBA for anything else
+graphics_dump_format_t graphics_dump_format_for_path(const char* path)
+{
+    const char* extension = strrchr(path, '.');
+    if(extension != NULL && 0 == strcmp(extension, ".ppm"))
+    {
+        return GRAPHICS_DUMP_PPM;
+    }
+    return GRAPHICS_DUMP_RAW;
+}
+
+//writes out what is in the frame buffer right now, which doesn't need a
+//backend (or a window) to be showing it. PPM files (binary, "P6") can be
+//opened by most image viewers; raw files are just the pixels as R, G, B, A
+//bytes, row after row. Returns false if the file couldn't be written.
+bool graphics_dump_frame(graphics_t* graphics, const char* path, graphics_dump_format_t format)
+{
+    FILE* file = fopen(path, "wb");
+    if(file == NULL)
+    {
+        return false;
+    }
+
+    bool is_ppm = (GRAPHICS_DUMP_PPM == format);
+    if(is_ppm)
+    {
+        fprintf(file, "P6\n%u %u\n255\n", graphics->WINDOW_WIDTH, graphics->WINDOW_HEIGHT);
+    }
+
+    //a row at a time, since the pixels are RGBA8888 words and the files want
+    //their bytes in order no matter what the host's byte order is
+    size_t bytes_per_pixel = is_ppm ? 3 : 4;
+    size_t row_size = graphics->WINDOW_WIDTH * bytes_per_pixel;
+    uint8_t* row_bytes = malloc(row_size);
+    bool written = (row_bytes != NULL);
+    for(uint16_t row = 0; written && row < graphics->WINDOW_HEIGHT; row++)
+    {
+        const uint32_t* pixels = &graphics->frame_buffer[row * graphics->WINDOW_WIDTH];
+        uint8_t* bytes = row_bytes;
+        for(uint16_t col = 0; col < graphics->WINDOW_WIDTH; col++)
+        {
+            *bytes++ = (uint8_t)(pixels[col] >> 24);
+            *bytes++ = (uint8_t)(pixels[col] >> 16);
+            *bytes++ = (uint8_t)(pixels[col] >> 8);
+            if(!is_ppm)
+            {
+                *bytes++ = (uint8_t)pixels[col];
+            }
+        }
+        written = (row_size == fwrite(row_bytes, 1, row_size, file));
+    }
+
+    free(row_bytes);
+    if(0 != fclose(file))
+    {
+        written = false;
+    }
+    return written;
 }
 
 void graphics_cycle(graphics_t* graphics, memory_bus_t* bus)
@@ -0,0 +1,327 @@
+
+// ----------------------------------------------------------------------------
+//
+//  FILE: graphics_sdl.c
+//
+//  DESCRIPTION: The graphics backend that puts the simulated computer's
+//  display up in a window, using the Simple DirectMedia Layer (SDL) to do it
+//  in a cross-platform way. All of the SDL code in the program lives here.
+//
+//  SDL is owned by a render thread of its own, so that waiting for the
+//  screen to be presented (vsync) and for the window's events never holds up
+//  the simulation. The simulation publishes snapshots of the frame buffer to
+//  it through a lock-free triple buffer, and it sends the key presses back
+//  over a lock-free queue. The render thread (and so the window) isn't
+//  started until the first frame is presented, so a computer that never
+//  draws anything never opens a window.
+//
+//  Publishing a frame only copies the rows that changed since the buffer it's
+//  going into was last published, and the render thread only uploads the
+//  rows that changed since the frame it last showed.
+//
+//  The bulk of this code was gleaned from http://lazyfoo.net/tutorials/SDL/
+//  and https://wiki.libsdl.org/MigrationGuide because prior to today
+//  (2015-03-16), I had no idea how to use SDL!
+//
+// ----------------------------------------------------------------------------
+
+#include "SDL.h"
+#include "graphics_backend.h"
+#include "keyboard.h"
+#include "triple_buffer.h"
+#include "spsc_queue.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+//how long the render thread waits for window events before it looks for a
+//new frame again
+#define RENDER_THREAD_WAIT_MILLISECONDS    (16)
+//key presses that haven't been picked up by the simulation yet
+#define KEY_EVENT_QUEUE_SIZE               (256)
+
+//What the frames in the triple buffer look like: the frame's sequence number,
+//the sequence number of the frame that each row last changed in, and then the
+//pixels themselves (see frame_pixels())
+struct frame_t
+{
+    uint64_t sequence;
+    uint64_t row_sequence[];
+};
+
+typedef struct frame_t frame_t;
+
+struct sdl_backend_t
+{
+    uint16_t WINDOW_WIDTH;
+    uint16_t WINDOW_HEIGHT;
+
+    //snapshots of the frame buffer on their way to the render thread and key
+    //presses on their way back
+    triple_buffer_t* frames;
+    spsc_queue_t* key_events;
+    pthread_t render_thread;
+    bool rendering;         //whether the render thread has been started
+    bool stop_rendering;    //only accessed atomically
+
+    //everything below here belongs to the render thread
+    //The window we'll be rendering to
+    SDL_Window* window;
+    //the renderer is an SDL2 concept that handles getting our data to the GPU
+    SDL_Renderer* renderer;
+    //This texture is where we will copy our framebuffer to for SDL to do its magic
+    SDL_Texture* screen;
+    //the sequence number of the frame in the texture (0 before the first one)
+    uint64_t screen_sequence;
+};
+
+typedef struct sdl_backend_t sdl_backend_t;
+
+static void* render_thread(void* context);
+
+static void program_failure(void)
+{
+    exit(EXIT_FAILURE);
+}
+
+static size_t frame_size(sdl_backend_t* sdl)
+{
+    return sizeof(frame_t) + sdl->WINDOW_HEIGHT * (sizeof(uint64_t) + sdl->WINDOW_WIDTH * sizeof(uint32_t));
+}
+
+static uint32_t* frame_pixels(sdl_backend_t* sdl, const frame_t* frame)
+{
+    return (uint32_t*)&frame->row_sequence[sdl->WINDOW_HEIGHT];
+}
+
+static void* sdl_create(uint16_t width, uint16_t height)
+{
+    sdl_backend_t* sdl = calloc(1, sizeof(sdl_backend_t));
+    if(sdl == NULL)
+    {
+        fprintf(stderr, "failed to allocate the SDL backend\n");
+        program_failure();
+    }
+    sdl->WINDOW_WIDTH = width;
+    sdl->WINDOW_HEIGHT = height;
+    //frames in the triple buffer start out blank with a sequence number of 0
+    sdl->frames = triple_buffer_create(frame_size(sdl));
+    sdl->key_events = spsc_queue_create(KEY_EVENT_QUEUE_SIZE);
+    return sdl;
+}
+
+static void sdl_destroy(void* backend)
+{
+    sdl_backend_t* sdl = backend;
+    if(sdl->rendering)
+    {
+        //the render thread tears down its own SDL resources on the way out
+        __atomic_store_n(&sdl->stop_rendering, true, __ATOMIC_RELEASE);
+        pthread_join(sdl->render_thread, NULL);
+    }
+    triple_buffer_destroy(sdl->frames);
+    spsc_queue_destroy(sdl->key_events);
+    free(sdl);
+}
+
+//hands a snapshot of the frame over to the render thread, which puts it on
+//the screen whenever it gets around to it
+static void sdl_present(void* backend, const graphics_frame_t* frame)
+{
+    sdl_backend_t* sdl = backend;
+
+    //the back buffer still holds an older frame, so it only needs the rows
+    //that have changed since then
+    frame_t* back = triple_buffer_get_back_buffer(sdl->frames);
+    uint32_t* pixels = frame_pixels(sdl, back);
+    size_t row_size = sdl->WINDOW_WIDTH * sizeof(uint32_t);
+    for(uint16_t row = 0; row < sdl->WINDOW_HEIGHT; row++)
+    {
+        if(frame->row_sequence[row] > back->sequence)
+        {
+            size_t offset = row * sdl->WINDOW_WIDTH;
+            memcpy(&pixels[offset], &frame->pixels[offset], row_size);
+        }
+    }
+    memcpy(back->row_sequence, frame->row_sequence, sdl->WINDOW_HEIGHT * sizeof(uint64_t));
+    back->sequence = frame->sequence;
+    triple_buffer_publish(sdl->frames);
+
+    //the window only opens once there is something to put in it
+    if(!sdl->rendering)
+    {
+        if(0 != pthread_create(&sdl->render_thread, NULL, &render_thread, sdl))
+        {
+            fprintf(stderr, "failed to start the render thread\n");
+            program_failure();
+        }
+        sdl->rendering = true;
+    }
+}
+
+static spsc_queue_t* sdl_get_key_events(void* backend)
+{
+    sdl_backend_t* sdl = backend;
+    return sdl->key_events;
+}
+
+const graphics_backend_ops_t sdl_graphics_backend =
+{
+    .name = "sdl",
+    .create = &sdl_create,
+    .destroy = &sdl_destroy,
+    .present = &sdl_present,
+    .get_key_events = &sdl_get_key_events,
+};
+
+static void init_window(sdl_backend_t* sdl)
+{
+    int init_error = SDL_Init(SDL_INIT_VIDEO);
+    if(init_error)
+    {
+        fprintf(stderr, "%s\n", SDL_GetError());
+        program_failure();
+    }
+
+    sdl->window = SDL_CreateWindow("zcpu-sim", 
+                                   SDL_WINDOWPOS_CENTERED, 
+                                   SDL_WINDOWPOS_CENTERED, 
+                                   sdl->WINDOW_WIDTH, 
+                                   sdl->WINDOW_HEIGHT, 
+                                   SDL_WINDOW_SHOWN);
+    if(sdl->window == NULL)
+    {
+        fprintf(stderr, "failed to allocate SDL window\n");
+        program_failure();
+    }
+
+    //presenting waits for vsync, but that only ever holds up the render thread
+    sdl->renderer = SDL_CreateRenderer(sdl->window, -1, SDL_RENDERER_PRESENTVSYNC);
+    if(sdl->renderer == NULL)
+    {
+        fprintf(stderr, "failed to allocate SDL renderer\n");
+        program_failure();
+    }
+
+    sdl->screen = SDL_CreateTexture(sdl->renderer, 
+                                    SDL_PIXELFORMAT_RGBA8888, 
+                                    SDL_TEXTUREACCESS_STREAMING, 
+                                    sdl->WINDOW_WIDTH, 
+                                    sdl->WINDOW_HEIGHT);
+    if(sdl->screen == NULL)
+    {
+        fprintf(stderr, "failed to allocate SDL texture\n");
+        program_failure();
+    }
+
+}
+
+static void clear_screen(sdl_backend_t* sdl)
+{
+    SDL_SetRenderDrawColor(sdl->renderer, 0x00, 0x00, 0x00, 0xFF); //clear to black
+    SDL_RenderClear(sdl->renderer);
+}
+
+//copies the rows of the frame that changed after the given frame into the
+//texture, as one rectangle per run of changed rows. Returns false if there
+//weren't any.
+static bool upload_changed_rows(sdl_backend_t* sdl, const frame_t* frame, uint64_t since_sequence)
+{
+    const uint32_t* pixels = frame_pixels(sdl, frame);
+    int pitch = sdl->WINDOW_WIDTH*sizeof(uint32_t);
+    bool uploaded = false;
+    uint16_t row = 0;
+    while(row < sdl->WINDOW_HEIGHT)
+    {
+        if(frame->row_sequence[row] <= since_sequence)
+        {
+            row++;
+            continue;
+        }
+
+        uint16_t first_row = row;
+        while((row < sdl->WINDOW_HEIGHT) && (frame->row_sequence[row] > since_sequence))
+        {
+            row++;
+        }
+        SDL_Rect changed = { 0, first_row, sdl->WINDOW_WIDTH, row - first_row };
+        SDL_UpdateTexture(sdl->screen, &changed, &pixels[first_row * sdl->WINDOW_WIDTH], pitch);
+        uploaded = true;
+    }
+    return uploaded;
+}
+
+//puts the latest frame that the simulation has published up on the screen,
+//if there is one that hasn't been shown yet
+static void present_latest_frame(sdl_backend_t* sdl)
+{
+    bool is_new = false;
+    const frame_t* frame = triple_buffer_get_latest(sdl->frames, &is_new);
+    if(!is_new)
+    {
+        return;
+    }
+
+    //"blit" the framebuffer to the screen using SDL 2.0 GPU magic. The
+    //texture starts out with garbage in it, so the first frame goes up whole.
+    bool changed = upload_changed_rows(sdl, frame, sdl->screen_sequence);
+    sdl->screen_sequence = frame->sequence;
+    if(!changed)
+    {
+        return;
+    }
+
+    clear_screen(sdl);
+    SDL_RenderCopy(sdl->renderer, sdl->screen, NULL, NULL);
+    SDL_RenderPresent(sdl->renderer);
+}
+
+//passes window events along to the simulation's keyboard
+static void handle_event(sdl_backend_t* sdl, const SDL_Event* e)
+{
+    if(e->type == SDL_QUIT)
+    {
+        spsc_queue_put(sdl->key_events, KEYBOARD_QUIT_EVENT);
+    }
+    else if(e->type == SDL_KEYDOWN)
+    {
+        spsc_queue_put(sdl->key_events, (uint32_t)e->key.keysym.sym);
+    }
+    else if(e->type == SDL_KEYUP)
+    {
+        spsc_queue_put(sdl->key_events, (uint32_t)e->key.keysym.sym | KEYBOARD_BREAK_CODE);
+    }
+}
+
+//The render thread owns everything to do with SDL. It sleeps until the window
+//has something to say (or a frame's worth of time goes by) and then shows the
+//newest frame from the simulation, so it never has to wait on the simulation
+//and the simulation never has to wait on it.
+static void* render_thread(void* context)
+{
+    sdl_backend_t* sdl = context;
+    init_window(sdl);
+
+    while(!__atomic_load_n(&sdl->stop_rendering, __ATOMIC_ACQUIRE))
+    {
+        SDL_Event e;
+        if(SDL_WaitEventTimeout(&e, RENDER_THREAD_WAIT_MILLISECONDS))
+        {
+            do
+            {
+                handle_event(sdl, &e);
+            }
+            while(SDL_PollEvent(&e));
+        }
+        present_latest_frame(sdl);
+    }
+
+    SDL_DestroyTexture(sdl->screen);
+    SDL_DestroyRenderer(sdl->renderer);
+    SDL_DestroyWindow(sdl->window);
+    //other computers may still have displays open, so only give back our
+    //reference to the video subsystem rather than shutting all of SDL down
+    SDL_QuitSubSystem(SDL_INIT_VIDEO);
+    return NULL;
+}
@@ -0,0 +1,30 @@
+// ----------------------------------------------------------------------------
+//
+//  FILE: host_clock.c
+//
+//  DESCRIPTION: This module reads and waits on the host's clock. It used to
+//  come from SDL, but SDL now belongs to the display's render thread and the
+//  simulation thread shouldn't have to touch it.
+//
+// ----------------------------------------------------------------------------
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "host_clock.h"
+#include <time.h>
+
+
+//milliseconds since some arbitrary point in the past, which wraps around
+//every 49 days or so (only the differences between readings mean anything)
+uint32_t host_clock_milliseconds(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint32_t)((uint64_t)now.tv_sec * 1000 + (uint64_t)now.tv_nsec / 1000000);
+}
+
+void host_clock_sleep(uint32_t milliseconds)
+{
+    struct timespec duration = { milliseconds / 1000, (long)(milliseconds % 1000) * 1000000 };
+    nanosleep(&duration, NULL);
+}
@@ -0,0 +1,205 @@
+// ----------------------------------------------------------------------------
+//
+//  FILE: input_journal.c
+//
+//  DESCRIPTION: This module writes and reads journals of the input that came
+//  into a run. People type a few keys a second while the cpu gets through
+//  millions of cycles, so the cycles are stored as the (small) gap since the
+//  last record and every number is LEB128 encoded: 7 bits to a byte, with
+//  the top bit set on every byte but the last. A typical key comes to about
+//  five bytes, which keeps hours of input down to a few hundred kilobytes.
+//
+//  Journals are read back in as input scripts, so a replay delivers each key
+//  to the keyboard from the scheduler, on exactly the cycle it arrived on.
+//
+// ----------------------------------------------------------------------------
+
+#include "input_journal.h"
+#include "keyboard.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const char JOURNAL_MAGIC[8] = { 'Z', 'C', 'P', 'U', 'J', 'R', 'N', 'L' };
+#define JOURNAL_VERSION     (1)
+
+enum journal_record_tag_t
+{
+    JOURNAL_KEY_DOWN = 1,
+    JOURNAL_KEY_UP = 2,
+    JOURNAL_END = 3,        //the cycle the run finished on
+};
+
+//the most bytes a 64-bit number can take up
+#define MAX_LEB128_LENGTH   (10)
+
+struct input_journal_t
+{
+    FILE* file;
+    uint64_t last_cycle;    //of the previous record
+    bool failed;            //set once anything couldn't be written
+};
+
+input_journal_t* input_journal_create(const char* path, execution_engine_t engine)
+{
+    FILE* file = fopen(path, "wb");
+    if(NULL == file)
+    {
+        return NULL;
+    }
+
+    uint8_t header[sizeof(JOURNAL_MAGIC) + 2];
+    memcpy(header, JOURNAL_MAGIC, sizeof(JOURNAL_MAGIC));
+    header[sizeof(JOURNAL_MAGIC)] = JOURNAL_VERSION;
+    header[sizeof(JOURNAL_MAGIC) + 1] = (uint8_t)engine;
+    if((1 != fwrite(header, sizeof(header), 1, file)) || (0 != fflush(file)))
+    {
+        fclose(file);
+        return NULL;
+    }
+
+    input_journal_t* journal = calloc(1, sizeof(struct input_journal_t));
+    journal->file = file;
+    return journal;
+}
+
+static size_t encode_leb128(uint8_t* bytes, uint64_t value)
+{
+    size_t length = 0;
+    do
+    {
+        bytes[length] = value & 0x7F;
+        value >>= 7;
+        if(0 != value)
+        {
+            bytes[length] |= 0x80;
+        }
+        length++;
+    } while(0 != value);
+    return length;
+}
+
+static bool write_record(input_journal_t* journal, uint8_t tag, uint64_t cycle, const uint32_t* keycode)
+{
+    uint8_t record[1 + 2 * MAX_LEB128_LENGTH];
+    size_t length = 0;
+    record[length++] = tag;
+    length += encode_leb128(&record[length], cycle - journal->last_cycle);
+    if(NULL != keycode)
+    {
+        length += encode_leb128(&record[length], *keycode);
+    }
+    journal->last_cycle = cycle;
+
+    //flushed straight away so that nothing is lost if the run never finishes
+    if((1 != fwrite(record, length, 1, journal->file)) || (0 != fflush(journal->file)))
+    {
+        journal->failed = true;
+    }
+    return !journal->failed;
+}
+
+bool input_journal_record(input_journal_t* journal, uint64_t cycle, uint32_t scancode)
+{
+    uint32_t keycode = scancode & ~KEYBOARD_BREAK_CODE;
+    return write_record(journal, (scancode & KEYBOARD_BREAK_CODE) ? JOURNAL_KEY_UP : JOURNAL_KEY_DOWN, cycle, &keycode);
+}
+
+bool input_journal_close(input_journal_t* journal, uint64_t end_cycle)
+{
+    bool written = write_record(journal, JOURNAL_END, end_cycle, NULL);
+    written = (0 == fclose(journal->file)) && written;
+    free(journal);
+    return written;
+}
+
+//returns false if the file ends part way through the number
+static bool read_leb128(FILE* file, uint64_t* value)
+{
+    *value = 0;
+    for(unsigned shift = 0; shift < 7 * MAX_LEB128_LENGTH; shift += 7)
+    {
+        int byte = fgetc(file);
+        if(EOF == byte)
+        {
+            return false;
+        }
+
+        *value |= (uint64_t)(byte & 0x7F) << shift;
+        if(0 == (byte & 0x80))
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+static input_script_t* fail_load(const char* path, const char* problem, FILE* file, input_script_t* script)
+{
+    fprintf(stderr, "%s: %s\n", path, problem);
+    if(NULL != script)
+    {
+        destroy_input_script(script);
+    }
+    fclose(file);
+    return NULL;
+}
+
+input_script_t* input_journal_load(const char* path, execution_engine_t* engine, uint64_t* end_cycle)
+{
+    FILE* file = fopen(path, "rb");
+    if(NULL == file)
+    {
+        fprintf(stderr, "could not open input journal %s\n", path);
+        return NULL;
+    }
+
+    uint8_t header[sizeof(JOURNAL_MAGIC) + 2];
+    if((1 != fread(header, sizeof(header), 1, file)) || (0 != memcmp(header, JOURNAL_MAGIC, sizeof(JOURNAL_MAGIC))))
+    {
+        return fail_load(path, "not an input journal", file, NULL);
+    }
+    if((JOURNAL_VERSION != header[sizeof(JOURNAL_MAGIC)]) || (header[sizeof(JOURNAL_MAGIC) + 1] > JIT_ENGINE))
+    {
+        return fail_load(path, "input journal is from an unsupported version", file, NULL);
+    }
+    *engine = (execution_engine_t)header[sizeof(JOURNAL_MAGIC) + 1];
+
+    input_script_t* script = make_input_script();
+    uint64_t cycle = 0;
+    bool finished = false;
+    int tag;
+    while(!finished && (EOF != (tag = fgetc(file))))
+    {
+        uint64_t gap;
+        uint64_t keycode = 0;
+        bool is_key = (JOURNAL_KEY_DOWN == tag) || (JOURNAL_KEY_UP == tag);
+        if((!is_key && (JOURNAL_END != tag)) || !read_leb128(file, &gap) ||
+           (is_key && (!read_leb128(file, &keycode) || (keycode > UINT32_MAX) || (keycode & KEYBOARD_BREAK_CODE))))
+        {
+            //a run that was killed part way through writing a record still
+            //has every key before it
+            if(EOF != fgetc(file))
+            {
+                return fail_load(path, "input journal is corrupt", file, script);
+            }
+            fprintf(stderr, "%s: input journal was cut short, replaying up to the last whole record\n", path);
+            break;
+        }
+
+        cycle += gap;
+        if(JOURNAL_END == tag)
+        {
+            finished = true;
+        }
+        else
+        {
+            input_script_add(script, cycle, (uint32_t)keycode | ((JOURNAL_KEY_UP == tag) ? KEYBOARD_BREAK_CODE : 0));
+        }
+    }
+
+    *end_cycle = cycle;
+    fclose(file);
+    return script;
+}
@@ -0,0 +1,250 @@
+// ----------------------------------------------------------------------------
+//
+//  FILE: input_script.c
+//
+//  DESCRIPTION: This module plays a script of key events into the keyboard,
+//  timed by the simulated clock. The whole script is read in up front and
+//  kept in cycle order. Only the next event is ever registered with the
+//  scheduler, and when it comes due every event for that cycle is handed to
+//  the keyboard before the one after them is registered. Idle programs can
+//  then be skipped straight up to the next keystroke, and nothing the host
+//  does (how fast it runs, when its window gets events) changes what the
+//  guest sees.
+//
+// ----------------------------------------------------------------------------
+
+#include "input_script.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+
+struct input_event_t
+{
+    uint64_t cycle;
+    uint32_t scancode;
+};
+
+typedef struct input_event_t input_event_t;
+
+struct input_script_t
+{
+    input_event_t* events;
+    size_t num_events;
+    size_t capacity;
+
+    //where playback has got to
+    size_t next_event;
+    keyboard_t* keyboard;
+    scheduler_t* scheduler;
+    event_id_t scheduled_event;
+};
+
+//the SDL keycodes for keys that don't print anything
+struct key_name_t
+{
+    const char* name;
+    uint32_t keycode;
+};
+
+static const struct key_name_t KEY_NAMES[] = {
+    { "space", ' ' },
+    { "return", '\r' },
+    { "escape", 0x1B },
+    { "backspace", 0x08 },
+    { "tab", '\t' },
+    { "delete", 0x7F },
+};
+
+static void schedule_next_event(input_script_t* script);
+
+input_script_t* make_input_script(void)
+{
+    input_script_t* script = calloc(1, sizeof(struct input_script_t));
+    script->scheduled_event = NO_EVENT_ID;
+    return script;
+}
+
+void destroy_input_script(input_script_t* script)
+{
+    input_script_stop(script);
+    free(script->events);
+    free(script);
+}
+
+bool input_script_add(input_script_t* script, uint64_t cycle, uint32_t scancode)
+{
+    if((0 != script->num_events) && (cycle < script->events[script->num_events - 1].cycle))
+    {
+        return false;
+    }
+
+    if(script->num_events == script->capacity)
+    {
+        script->capacity = (0 == script->capacity) ? 64 : 2 * script->capacity;
+        script->events = realloc(script->events, script->capacity * sizeof(*script->events));
+    }
+    script->events[script->num_events].cycle = cycle;
+    script->events[script->num_events].scancode = scancode;
+    script->num_events++;
+    return true;
+}
+
+size_t input_script_num_events(input_script_t* script)
+{
+    return script->num_events;
+}
+
+//returns false if the key isn't a character, a name or a number
+static bool parse_key(const char* key, uint32_t* keycode)
+{
+    if(1 == strlen(key))
+    {
+        *keycode = (uint8_t)key[0];
+        return true;
+    }
+
+    for(size_t i = 0; i < sizeof(KEY_NAMES) / sizeof(KEY_NAMES[0]); i++)
+    {
+        if(0 == strcmp(key, KEY_NAMES[i].name))
+        {
+            *keycode = KEY_NAMES[i].keycode;
+            return true;
+        }
+    }
+
+    char* end;
+    unsigned long value = strtoul(key, &end, 0);
+    if(('\0' != *end) || (value > UINT32_MAX) || (value & KEYBOARD_BREAK_CODE))
+    {
+        return false;
+    }
+    *keycode = (uint32_t)value;
+    return true;
+}
+
+//adds the events on one line of a script, returns false if it's malformed
+static bool parse_script_line(input_script_t* script, char* line)
+{
+    char* comment = strchr(line, '#');
+    if(NULL != comment)
+    {
+        *comment = '\0';
+    }
+
+    uint64_t cycle;
+    char action[16];
+    char key[32];
+    char extra[2];
+    int num_fields = sscanf(line, "%" SCNu64 " %15s %31s %1s", &cycle, action, key, extra);
+    if(num_fields <= 0)
+    {
+        return true;
+    }
+
+    uint32_t keycode;
+    if((3 != num_fields) || !parse_key(key, &keycode))
+    {
+        return false;
+    }
+
+    if(0 == strcmp(action, "down"))
+    {
+        return input_script_add(script, cycle, keycode);
+    }
+    else if(0 == strcmp(action, "up"))
+    {
+        return input_script_add(script, cycle, keycode | KEYBOARD_BREAK_CODE);
+    }
+    else if(0 == strcmp(action, "press"))
+    {
+        return input_script_add(script, cycle, keycode) &&
+               input_script_add(script, cycle, keycode | KEYBOARD_BREAK_CODE);
+    }
+    return false;
+}
+
+input_script_t* input_script_load(const char* path)
+{
+    FILE* file = fopen(path, "r");
+    if(NULL == file)
+    {
+        fprintf(stderr, "could not open input script %s\n", path);
+        return NULL;
+    }
+
+    input_script_t* script = make_input_script();
+    char line[256];
+    unsigned line_number = 0;
+    while(NULL != fgets(line, sizeof(line), file))
+    {
+        line_number++;
+        if(!parse_script_line(script, line))
+        {
+            fprintf(stderr, "%s:%u: expected \"<cycle> down|up|press <key>\" in cycle order\n", path, line_number);
+            destroy_input_script(script);
+            fclose(file);
+            return NULL;
+        }
+    }
+
+    fclose(file);
+    return script;
+}
+
+static void input_event(void* context, uint64_t cycle)
+{
+    input_script_t* script = context;
+    script->scheduled_event = NO_EVENT_ID;
+    while((script->next_event < script->num_events) && (script->events[script->next_event].cycle <= cycle))
+    {
+        keyboard_press(script->keyboard, script->events[script->next_event].scancode);
+        script->next_event++;
+    }
+    schedule_next_event(script);
+}
+
+static void schedule_next_event(input_script_t* script)
+{
+    if(script->next_event < script->num_events)
+    {
+        script->scheduled_event = scheduler_add_event(script->scheduler, script->events[script->next_event].cycle, &input_event, script);
+    }
+}
+
+void input_script_start(input_script_t* script, keyboard_t* keyboard, scheduler_t* scheduler, uint64_t cycle)
+{
+    //the scheduler won't mix up an event from before it was reset with a
+    //newer one, so this is safe either way
+    input_script_stop(script);
+    script->keyboard = keyboard;
+    script->scheduler = scheduler;
+
+    //events are kept in cycle order, so skip everything before the given cycle
+    size_t low = 0;
+    size_t high = script->num_events;
+    while(low < high)
+    {
+        size_t middle = low + (high - low) / 2;
+        if(script->events[middle].cycle < cycle)
+        {
+            low = middle + 1;
+        }
+        else
+        {
+            high = middle;
+        }
+    }
+    script->next_event = low;
+    schedule_next_event(script);
+}
+
+void input_script_stop(input_script_t* script)
+{
+    if(NO_EVENT_ID != script->scheduled_event)
+    {
+        scheduler_cancel_event(script->scheduler, script->scheduled_event);
+        script->scheduled_event = NO_EVENT_ID;
+    }
+}
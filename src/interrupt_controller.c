@@ -14,62 +14,153 @@
 //  that info to the CPU, which will use the IRQ number to determine
 //  which interrupt service routine to jump to.
 //
+//  Like those request lines, every IRQ is a single pending bit, so a device
+//  that asks again before it has been serviced is still only serviced once.
+//  Every IRQ can also be masked, which leaves it pending until it is unmasked
+//  again. When more than one IRQ is pending, the lowest numbered one goes
+//  first.
+//
+//  The CPU asks whether anything is pending at the start of every
+//  instruction, so that has to be cheap. Alongside the pending and mask
+//  bitmaps, the controller keeps a summary with a bit for each 64 IRQs that
+//  has something pending and unmasked in it. Asking is then a single test,
+//  and picking the IRQ to service is two count-leading-zeros (IRQ 0 is kept
+//  in the top bit of the first word, so the lowest numbered IRQ is the first
+//  one that clz finds).
+//
 // ----------------------------------------------------------------------------
 
 #include <stdio.h>
 #include <stdint.h>
 #include <stdbool.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "interrupt_controller.h"
-#include "queue.h"
+
+#define IRQS_PER_WORD       (64)
+#define NUM_IRQ_WORDS       (MAX_NUM_IRQS / IRQS_PER_WORD)
 
 //TODO: make sure to add some mechanism for globally disabling interrupts (or
 //at least the maskable interrupts)
 
 struct interrupt_controller_t
 {
-    // Each interrupt request in the queue contains the 8-bit interrupt vector
-    // number of the device requesting the interrupt
-    queue_t* interrupt_requests;
+    uint64_t pending[NUM_IRQ_WORDS];
+    uint64_t masked[NUM_IRQ_WORDS];
+    //bit (63 - n) is set when word n of pending has an unmasked IRQ in it
+    uint64_t active_words;
     uint32_t INTERRUPT_VECTOR_TABLE_START_ADDRESS;
 };
 
 interrupt_controller_t* make_interrupt_controller(uint32_t ivt_start_address)
 {
     interrupt_controller_t* ic = calloc(1, sizeof(struct interrupt_controller_t));
-    ic->interrupt_requests = queue_create(MAX_NUM_IRQS);
     ic->INTERRUPT_VECTOR_TABLE_START_ADDRESS = ivt_start_address;
     return ic;
 }
 
 void destroy_interrupt_controller(interrupt_controller_t* ic)
 {
-    free(ic->interrupt_requests);
     free(ic);
 }
 
+//forgets every request and unmasks every IRQ
+void interrupt_controller_reset(interrupt_controller_t* ic)
+{
+    memset(ic->pending, 0, sizeof(ic->pending));
+    memset(ic->masked, 0, sizeof(ic->masked));
+    ic->active_words = 0;
+}
+
+static uint64_t irq_bit(uint8_t irq_number)
+{
+    return (1ull << 63) >> (irq_number % IRQS_PER_WORD);
+}
+
+static void update_active_words(interrupt_controller_t* ic, uint8_t word)
+{
+    uint64_t word_bit = (1ull << 63) >> word;
+    if(ic->pending[word] & ~ic->masked[word])
+    {
+        ic->active_words |= word_bit;
+    }
+    else
+    {
+        ic->active_words &= ~word_bit;
+    }
+}
+
 //External interface function that hardware peripherals call to make interrupt
 //requests
 void request_interrupt(interrupt_controller_t* ic, uint8_t irq_number)
 {
-    queue_put(ic->interrupt_requests, irq_number);
+    uint8_t word = irq_number / IRQS_PER_WORD;
+    ic->pending[word] |= irq_bit(irq_number);
+    update_active_words(ic, word);
 }
 
 //Reports back if at least one peripheral device has requested an interrupt
+//that isn't masked
 bool interrupt_requested(interrupt_controller_t* ic)
 {
-    return !queue_is_empty(ic->interrupt_requests);
+    return 0 != ic->active_words;
 }
 
 //Precondition: interrupt_requested() must be true in order for this function to work
+//The IRQ that should be serviced next. It stays pending until it is
+//acknowledged.
 uint8_t get_interrupt_source(interrupt_controller_t* ic)
 {
-    queue_return_data_t interrupt_request =  queue_get(ic->interrupt_requests);
-    return interrupt_request.value;
+    uint8_t word = (uint8_t)__builtin_clzll(ic->active_words);
+    uint64_t active = ic->pending[word] & ~ic->masked[word];
+    return (uint8_t)(word * IRQS_PER_WORD + __builtin_clzll(active));
+}
+
+//called once the CPU has taken the interrupt, so that it isn't taken again
+void acknowledge_interrupt(interrupt_controller_t* ic, uint8_t irq_number)
+{
+    uint8_t word = irq_number / IRQS_PER_WORD;
+    ic->pending[word] &= ~irq_bit(irq_number);
+    update_active_words(ic, word);
+}
+
+//masked IRQs can still be requested, they just wait until they're unmasked
+void mask_interrupt(interrupt_controller_t* ic, uint8_t irq_number)
+{
+    uint8_t word = irq_number / IRQS_PER_WORD;
+    ic->masked[word] |= irq_bit(irq_number);
+    update_active_words(ic, word);
+}
+
+void unmask_interrupt(interrupt_controller_t* ic, uint8_t irq_number)
+{
+    uint8_t word = irq_number / IRQS_PER_WORD;
+    ic->masked[word] &= ~irq_bit(irq_number);
+    update_active_words(ic, word);
 }
 
 uint32_t get_interrupt_vector_table_starting_address(interrupt_controller_t* ic)
 {
     return ic->INTERRUPT_VECTOR_TABLE_START_ADDRESS;
 }
+
+//the summary is worked out again from the bitmaps rather than saved
+void interrupt_controller_save_state(interrupt_controller_t* ic, state_writer_t* writer)
+{
+    for(uint8_t word = 0; word < NUM_IRQ_WORDS; word++)
+    {
+        state_write_u64(writer, ic->pending[word]);
+        state_write_u64(writer, ic->masked[word]);
+    }
+}
+
+void interrupt_controller_restore_state(interrupt_controller_t* ic, state_reader_t* reader)
+{
+    for(uint8_t word = 0; word < NUM_IRQ_WORDS; word++)
+    {
+        ic->pending[word] = state_read_u64(reader);
+        ic->masked[word] = state_read_u64(reader);
+        update_active_words(ic, word);
+    }
+}
@@ -14,74 +14,205 @@
 //  On the user interface side of this simulator, the virtual keyboard hardware
 //  is connected to real keyboard hardware via SDL. SDL can capture keyboard
 //  events from the OS which we can then pass along to the simulator via
-//  interrupt requests and memory-mapped registers.
+//  interrupt requests and memory-mapped registers. SDL lives on the display's
+//  render thread (see graphics.c), so the events arrive here over a queue.
+//
+//  Every key that goes down puts a make scancode (its SDL keycode) in the
+//  keyboard's FIFO, and every key that comes back up puts in a break scancode
+//  (the keycode with KEYBOARD_BREAK_CODE set), so nothing typed in between
+//  two reads gets lost. The registers are:
+//
+//      status  bit 0: interrupt enable
+//              bit 1: data available (read only)
+//              bit 2: overflow flag, set when a scancode had to be dropped
+//                     because the FIFO was full (only software clears it,
+//                     by writing a 0 to it)
+//              bits 16-31: the number of scancodes in the FIFO (read only)
+//      data    reading takes the oldest scancode out of the FIFO (0 if it's
+//              empty), writes are ignored
+//
+//  With interrupts enabled, the keyboard requests one every time a scancode
+//  arrives. Several can arrive before the handler gets to run, so it should
+//  keep reading until the data available bit goes clear.
 //
 // ----------------------------------------------------------------------------
 
 
 
-#include "SDL.h"
 #include "memory_bus.h"
 #include "keyboard.h"
+#include "bit_twiddling.h"
+#include "memory_map.h"
+#include <stdlib.h>
 
 
-//FIXME: THIS IS A FILTHY HACK! KILL IT WITH FIRE!
-//seriously though, I just want to get a way up and running to gracefully
-//terminate the program. I'll figure out the proper way later
-extern bool simulation_running;
+enum keyboard_status_bits_t
+{
+    KEYBOARD_INTERRUPT_ENABLE_BIT = 0,
+    KEYBOARD_DATA_AVAILABLE_BIT = 1,
+    KEYBOARD_OVERFLOW_FLAG_BIT = 2,
+};
 
+#define KEYBOARD_COUNT_SHIFT    (16)
 
-//FIXME: I'm not sure what else to add here just yet, we'll figure that out
-//later
 struct keyboard_t
 {
-    //FIXME: do we want to have more than just this one register for
-    //communicating with the keyboard? Do we even need a keyboard status
-    //register if the keyboard can interrupt the CPU to tell it there is new
-    //data? The memory map currently has space allocated for 2 keyboard
-    //registers, but I think I may end up only using one
-    uint16_t keycode;
+    uint8_t status_bits;    //only the interrupt enable and overflow bits live here
+    uint8_t IRQ_number;
+    interrupt_controller_t* ic;
+
+    //a circular buffer of scancodes, oldest first
+    uint32_t* fifo;
+    size_t fifo_depth;
+    size_t fifo_head;
+    size_t fifo_count;
+
+    //set when the user asks to close the simulator, and left for whoever is
+    //running the simulation to act on
+    bool quit_requested;
+
+    keyboard_input_listener_t input_listener;
+    void* input_listener_context;
 };
 
-keyboard_t* create_keyboard(void)
+keyboard_t* create_keyboard(uint8_t IRQ_number, size_t fifo_depth, interrupt_controller_t* ic)
 {
+    if(fifo_depth < 1)
+    {
+        return NULL;
+    }
+
     keyboard_t* keyboard = calloc(1, sizeof(struct keyboard_t));
+    keyboard->IRQ_number = IRQ_number;
+    keyboard->ic = ic;
+    keyboard->fifo = calloc(fifo_depth, sizeof(*(keyboard->fifo)));
+    keyboard->fifo_depth = fifo_depth;
     return keyboard;
 }
 
 void destroy_keyboard(keyboard_t* keyboard)
 {
+    free(keyboard->fifo);
     free(keyboard);
 }
 
+//empties the FIFO and turns interrupts off
+void keyboard_reset(keyboard_t* keyboard)
+{
+    keyboard->status_bits = 0;
+    keyboard->fifo_head = 0;
+    keyboard->fifo_count = 0;
+}
+
+//returns false (and sets the overflow flag) if the FIFO was full
+bool keyboard_press(keyboard_t* keyboard, uint32_t scancode)
+{
+    if(keyboard->fifo_count == keyboard->fifo_depth)
+    {
+        BIT_SET(keyboard->status_bits, KEYBOARD_OVERFLOW_FLAG_BIT);
+        return false;
+    }
+
+    keyboard->fifo[(keyboard->fifo_head + keyboard->fifo_count) % keyboard->fifo_depth] = scancode;
+    keyboard->fifo_count++;
+    if(CHECK_BIT_SET(keyboard->status_bits, KEYBOARD_INTERRUPT_ENABLE_BIT))
+    {
+        request_interrupt(keyboard->ic, keyboard->IRQ_number);
+    }
+    return true;
+}
+
+static uint32_t take_scancode(keyboard_t* keyboard)
+{
+    if(0 == keyboard->fifo_count)
+    {
+        return 0;
+    }
+
+    uint32_t scancode = keyboard->fifo[keyboard->fifo_head];
+    keyboard->fifo_head = (keyboard->fifo_head + 1) % keyboard->fifo_depth;
+    keyboard->fifo_count--;
+    return scancode;
+}
+
 
-//This is all debug code for now, we will have to revise this later
-void input(keyboard_t* keyboard)
+//Takes in the key presses that have been queued up since the last call (the
+//queue is NULL when there's no window to type into)
+void input(keyboard_t* keyboard, spsc_queue_t* key_events)
 {
-    SDL_Event e;
-    while(SDL_PollEvent(&e))
+    uint32_t keycode = 0;
+    while((NULL != key_events) && spsc_queue_get(key_events, &keycode))
     {
-        if(e.type == SDL_QUIT)
+        if(KEYBOARD_QUIT_EVENT == keycode)
         {
-            simulation_running = false;
+            keyboard->quit_requested = true;
             break;
         }
-        else if(e.type == SDL_KEYDOWN)
+
+        //SDL keycodes for printable keys are just the character on the key
+        if('q' == keycode)
         {
-            keyboard->keycode = e.key.keysym.sym;
-            if(e.key.keysym.sym == SDLK_q)
-            {
-                simulation_running = false;
-                break;
-            }
-            else
+            keyboard->quit_requested = true;
+            break;
+        }
+
+        if(NULL != keyboard->input_listener)
+        {
+            keyboard->input_listener(keyboard->input_listener_context, keycode);
+        }
+        keyboard_press(keyboard, keycode);
+    }
+}
+
+void keyboard_set_input_listener(keyboard_t* keyboard, keyboard_input_listener_t listener, void* context)
+{
+    keyboard->input_listener = listener;
+    keyboard->input_listener_context = context;
+}
+
+
+bool keyboard_quit_requested(keyboard_t* keyboard)
+{
+    return keyboard->quit_requested;
+}
+
+static uint32_t read_register(keyboard_t* keyboard, uint32_t offset)
+{
+    switch(offset)
+    {
+        case KEYBOARD_STATUS_REGISTER:
+        {
+            uint32_t status = keyboard->status_bits;
+            if(0 != keyboard->fifo_count)
             {
-                printf("Some other key was pressed...\n");
+                BIT_SET(status, KEYBOARD_DATA_AVAILABLE_BIT);
             }
+            return status | ((uint32_t)keyboard->fifo_count << KEYBOARD_COUNT_SHIFT);
         }
+        case KEYBOARD_DATA_REGISTER:
+            return take_scancode(keyboard);
+        default:
+            return 0;
     }
 }
 
+//The overflow flag can only be cleared from software (by writing a 0 to it),
+//only the keyboard itself gets to set it. Turning interrupts on while there
+//is data waiting requests one straight away.
+static void write_register(keyboard_t* keyboard, uint32_t offset, uint32_t value)
+{
+    if(KEYBOARD_STATUS_REGISTER != offset)
+    {
+        return;
+    }
+
+    uint8_t overflow_flag = keyboard->status_bits & value & (1u << KEYBOARD_OVERFLOW_FLAG_BIT);
+    keyboard->status_bits = overflow_flag | (value & (1u << KEYBOARD_INTERRUPT_ENABLE_BIT));
+    if(CHECK_BIT_SET(keyboard->status_bits, KEYBOARD_INTERRUPT_ENABLE_BIT) && (0 != keyboard->fifo_count))
+    {
+        request_interrupt(keyboard->ic, keyboard->IRQ_number);
+    }
+}
 
 void keyboard_cycle(keyboard_t* keyboard, memory_bus_t* bus)
 {
@@ -90,11 +221,41 @@ void keyboard_cycle(keyboard_t* keyboard, memory_bus_t* bus)
         return;
     }
 
-    //it makes no sense to write data _to_ the keyboard, so only reading is supported
+    uint32_t offset = bus_get_address_lines(bus) - KEYBOARD_REGION_START;
     if(bus_is_read_operation(bus))
     {
-        bus_set_data_lines(bus, keyboard->keycode);
+        bus_set_data_lines(bus, read_register(keyboard, offset));
+    }
+    else
+    {
+        write_register(keyboard, offset, bus_get_data_lines(bus));
     }
-    //FIXME: is this even needed if we are only writing to a block of memory/a device?
     bus_set_device_ready(bus); //read/write complete
 }
+
+//the FIFO is saved oldest scancode first, so it doesn't matter where in the
+//buffer it had got to
+void keyboard_save_state(keyboard_t* keyboard, state_writer_t* writer)
+{
+    state_write_u8(writer, keyboard->status_bits);
+    state_write_u32(writer, (uint32_t)keyboard->fifo_count);
+    for(size_t i = 0; i < keyboard->fifo_count; i++)
+    {
+        state_write_u32(writer, keyboard->fifo[(keyboard->fifo_head + i) % keyboard->fifo_depth]);
+    }
+}
+
+void keyboard_restore_state(keyboard_t* keyboard, state_reader_t* reader)
+{
+    keyboard_reset(keyboard);
+    uint8_t status_bits = state_read_u8(reader);
+    uint32_t fifo_count = state_read_u32(reader);
+    if(!state_reader_check(reader, fifo_count <= keyboard->fifo_depth))
+    {
+        return;
+    }
+
+    keyboard->status_bits = status_bits;
+    state_read_words(reader, keyboard->fifo, fifo_count);
+    keyboard->fifo_count = fifo_count;
+}
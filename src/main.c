@@ -16,17 +16,15 @@
 // represents a fake hard drive image, which would more accurately reflect how
 // a real personal computer system boots.
 
-// TODO: I don't know at the moment, but it may be better to separate out the
-// graphics simulation code from the SDL initialization code and then stick the
-// SDL initialization here so that the simulator can run without needing to
-// create a window each time. I haven't decided how to do this just yet.
-
 #include <stdio.h>
 #include <stdint.h>
 #include <stdbool.h>
+#include <string.h>
+#include <inttypes.h>
 #include "debug.h"
 
 #include "computer.h"
+#include "batch_runner.h"
 
 //This will allow us to write test programs inline without manually encoding
 //the instructions. The only caveat is that there is no support for labels, so
@@ -56,6 +54,8 @@ static void quit_simulation(void)
 #define BOX_HEIGHT  100
 #define STARTING_POSITION_IN_FRAME_BUFFER    (((SCREEN_HEIGHT/2) - (BOX_HEIGHT/2))*SCREEN_WIDTH + ((SCREEN_WIDTH/2) - (BOX_WIDTH/2)))
 #define SOFTWARE_INTERRUPT_SOURCE   47
+//60 frames for every second of simulated time on a 25MHz cpu
+#define DEFAULT_CAPTURE_INTERVAL    (25000000 / 60)
 
 #define PIXEL_POSITION R1
 #define PIXEL_VALUE R2
@@ -126,15 +126,224 @@ static void run(computer_t* computer, int num_steps)
     }
 }
 
-int main(void)
+//enough to tell whether a replay ended up where the recording did
+static void print_final_state(computer_t* computer)
+{
+    printf("stopped at cycle %" PRIu64 ": pc 0x%08" PRIx32 ", memory hash %016" PRIx64 ", screen hash %016" PRIx64 "\n",
+           computer_get_elapsed_cycles(computer), computer_get_pc(computer),
+           computer_hash_memory(computer), computer_hash_frame_buffer(computer));
+}
+
+static void print_usage(const char* program_name)
+{
+    printf("usage: %s [--fast | --jit] [--batch <manifest> [--threads <n>] | --headless <cycles> [--dump-frame <file>]]\n", program_name);
+    printf("       [--capture <file> [--capture-interval <cycles>]] [--input-script <file>]\n");
+    printf("       [--record <file> | --replay <file>] [--restore-state <file>] [--save-state <file> [--compress-state]]\n");
+    printf("    --fast       run a whole instruction at a time instead of simulating each pipeline stage\n");
+    printf("    --jit        like --fast, but translate the program to native code as it runs\n");
+    printf("    --batch      run every program listed in the manifest without a display and print\n");
+    printf("                 their final state. Uses the fast engine unless another one is given\n");
+    printf("    --threads    number of host threads for --batch (default: one per core)\n");
+    printf("    --headless   run for the given number of cycles without opening a window\n");
+    printf("    --dump-frame write the screen to a file once a --headless run is done, as a PPM\n");
+    printf("                 image if the file ends in .ppm and raw RGBA bytes otherwise\n");
+    printf("    --capture    record the screen as the program runs, as Y4M video if the file ends\n");
+    printf("                 in .y4m and raw RGBA frames otherwise\n");
+    printf("    --capture-interval  cycles between captured frames (default: 60 frames a second)\n");
+    printf("    --input-script  type the key events in the script at the cycles that it gives for them\n");
+    printf("    --record     write every key typed into the window to a journal, along with the cycle\n");
+    printf("                 that it arrived on\n");
+    printf("    --replay     play a recorded journal back without a window, as fast as possible, with\n");
+    printf("                 the engine it was recorded with, until the cycle the recording stopped on\n");
+    printf("                 (or the number given to --headless)\n");
+    printf("    --restore-state  start from a machine state saved by --save-state instead of from reset\n");
+    printf("    --save-state     save the whole machine state to a file once the run is over\n");
+    printf("    --compress-state run-length encode the saved memory and screen\n");
+}
+
+int main(int argc, char* argv[])
 {
-    computer_t* computer = build_computer();
+    execution_engine_t engine = TIMING_ENGINE;
+    bool engine_chosen = false;
+    const char* batch_manifest = NULL;
+    unsigned num_threads = 0;
+    bool headless = false;
+    uint64_t headless_cycles = 0;
+    const char* frame_dump_path = NULL;
+    const char* capture_path = NULL;
+    uint64_t capture_interval = DEFAULT_CAPTURE_INTERVAL;
+    const char* input_script_path = NULL;
+    const char* record_path = NULL;
+    const char* replay_path = NULL;
+    const char* restore_state_path = NULL;
+    const char* save_state_path = NULL;
+    bool compress_state = false;
+    for(int i = 1; i < argc; i++)
+    {
+        if(0 == strcmp(argv[i], "--fast"))
+        {
+            engine = FAST_ENGINE;
+            engine_chosen = true;
+        }
+        else if(0 == strcmp(argv[i], "--jit"))
+        {
+            engine = JIT_ENGINE;
+            engine_chosen = true;
+        }
+        else if((0 == strcmp(argv[i], "--batch")) && (i + 1 < argc))
+        {
+            batch_manifest = argv[++i];
+        }
+        else if((0 == strcmp(argv[i], "--threads")) && (i + 1 < argc))
+        {
+            num_threads = (unsigned)strtoul(argv[++i], NULL, 10);
+        }
+        else if((0 == strcmp(argv[i], "--headless")) && (i + 1 < argc))
+        {
+            headless = true;
+            headless_cycles = strtoull(argv[++i], NULL, 10);
+        }
+        else if((0 == strcmp(argv[i], "--dump-frame")) && (i + 1 < argc))
+        {
+            frame_dump_path = argv[++i];
+        }
+        else if((0 == strcmp(argv[i], "--capture")) && (i + 1 < argc))
+        {
+            capture_path = argv[++i];
+        }
+        else if((0 == strcmp(argv[i], "--capture-interval")) && (i + 1 < argc))
+        {
+            capture_interval = strtoull(argv[++i], NULL, 10);
+        }
+        else if((0 == strcmp(argv[i], "--input-script")) && (i + 1 < argc))
+        {
+            input_script_path = argv[++i];
+        }
+        else if((0 == strcmp(argv[i], "--record")) && (i + 1 < argc))
+        {
+            record_path = argv[++i];
+        }
+        else if((0 == strcmp(argv[i], "--replay")) && (i + 1 < argc))
+        {
+            replay_path = argv[++i];
+        }
+        else if((0 == strcmp(argv[i], "--restore-state")) && (i + 1 < argc))
+        {
+            restore_state_path = argv[++i];
+        }
+        else if((0 == strcmp(argv[i], "--save-state")) && (i + 1 < argc))
+        {
+            save_state_path = argv[++i];
+        }
+        else if(0 == strcmp(argv[i], "--compress-state"))
+        {
+            compress_state = true;
+        }
+        else
+        {
+            print_usage(argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    if(NULL != batch_manifest)
+    {
+        int num_failed = run_batch(batch_manifest, num_threads, engine_chosen ? engine : FAST_ENGINE, stdout);
+        return (0 == num_failed) ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+    if((NULL != record_path) && (NULL != replay_path))
+    {
+        print_usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    computer_t* computer = (headless || (NULL != replay_path)) ? build_headless_computer() : build_computer();
+    computer_set_execution_engine(computer, engine);
     computer_load_program(computer, program, PROGRAM_LENGTH);
+    if((NULL != restore_state_path) && !computer_restore_state(computer, restore_state_path))
+    {
+        fprintf(stderr, "could not restore the machine state in %s\n", restore_state_path);
+        destroy_computer(computer);
+        return EXIT_FAILURE;
+    }
+    if((NULL != input_script_path) && !computer_load_input_script(computer, input_script_path))
+    {
+        destroy_computer(computer);
+        return EXIT_FAILURE;
+    }
+    if(NULL != replay_path)
+    {
+        uint64_t end_cycle;
+        if(!computer_replay_journal(computer, replay_path, &end_cycle))
+        {
+            destroy_computer(computer);
+            return EXIT_FAILURE;
+        }
+        if(!headless)
+        {
+            headless = true;
+            headless_cycles = end_cycle;
+        }
+    }
+    if((NULL != record_path) && !computer_start_recording(computer, record_path))
+    {
+        fprintf(stderr, "could not record the input to %s\n", record_path);
+        destroy_computer(computer);
+        return EXIT_FAILURE;
+    }
+    if((NULL != capture_path) && !computer_start_capture(computer, capture_path, capture_interval))
+    {
+        fprintf(stderr, "could not capture the screen to %s\n", capture_path);
+        destroy_computer(computer);
+        return EXIT_FAILURE;
+    }
+
+    if(headless)
+    {
+        computer_run_until_cycle(computer, headless_cycles);
+        if(NULL != replay_path)
+        {
+            print_final_state(computer);
+        }
+
+        bool written = computer_stop_capture(computer);
+        if(!written)
+        {
+            fprintf(stderr, "could not finish writing %s\n", capture_path);
+        }
+        if((NULL != frame_dump_path) && !computer_dump_frame_buffer(computer, frame_dump_path))
+        {
+            fprintf(stderr, "could not write the screen to %s\n", frame_dump_path);
+            written = false;
+        }
+        if((NULL != save_state_path) && !computer_save_state(computer, save_state_path, compress_state))
+        {
+            fprintf(stderr, "could not save the machine state to %s\n", save_state_path);
+            written = false;
+        }
+        destroy_computer(computer);
+        return written ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
 
     const int RUN_FOREVER = -1;
     //const int num_steps = 30;
     run(computer, RUN_FOREVER);
 
+    //anything still on its way into the video has to be written out first
+    computer_stop_capture(computer);
+    if(NULL != record_path)
+    {
+        if(!computer_stop_recording(computer))
+        {
+            fprintf(stderr, "could not finish writing %s\n", record_path);
+        }
+        print_final_state(computer);
+    }
+    if((NULL != save_state_path) && !computer_save_state(computer, save_state_path, compress_state))
+    {
+        fprintf(stderr, "could not save the machine state to %s\n", save_state_path);
+    }
     quit_simulation();
 
     return 0;
@@ -19,38 +19,348 @@
 #include "debug.h"
 #include "memory_bus.h"
 #include "memory.h"
+#include "hash.h"
 #include <stdlib.h>
 #include <string.h>
 
 
-//I'm not sure if this memory structure needs to be more elaborate. Just leave it alone for now
+//RAM is sparse: the 32-bit address space is split into 4 KiB pages that only
+//get allocated the first time something is written to them, and a two-level
+//page table finds them again. Reading a page that has never been written just
+//gives back zeros, so the host only pays for the memory the guest really uses.
+#define PAGE_OFFSET_BITS        MEMORY_PAGE_OFFSET_BITS
+#define TABLE_INDEX_BITS        (12)
+#define DIRECTORY_INDEX_BITS    (32 - TABLE_INDEX_BITS - PAGE_OFFSET_BITS)
+#define WORDS_PER_PAGE          MEMORY_PAGE_WORDS
+#define PAGES_PER_TABLE         (1u << TABLE_INDEX_BITS)
+#define TABLES_PER_DIRECTORY    (1u << DIRECTORY_INDEX_BITS)
+
+typedef uint32_t* page_table_t[PAGES_PER_TABLE];
+
 struct memory
 {
-    uint32_t memory_size;
-    uint32_t* system_memory;
+    size_t memory_size;
+    page_table_t* page_directory[TABLES_PER_DIRECTORY];
+    size_t resident_pages;
+    uint32_t wait_cycles;   //how long the current bus access has been waiting
 }; 
 
+static inline uint32_t directory_index(uint32_t address)
+{
+    return address >> (TABLE_INDEX_BITS + PAGE_OFFSET_BITS);
+}
+
+static inline uint32_t table_index(uint32_t address)
+{
+    return (address >> PAGE_OFFSET_BITS) & (PAGES_PER_TABLE - 1);
+}
+
+static inline uint32_t page_offset(uint32_t address)
+{
+    return address & (WORDS_PER_PAGE - 1);
+}
+
+//the address of the first word in page t of table d
+static inline uint32_t page_start_address(uint32_t d, uint32_t t)
+{
+    return (d << (TABLE_INDEX_BITS + PAGE_OFFSET_BITS)) | (t << PAGE_OFFSET_BITS);
+}
+
+//returns NULL if nothing has been written to the page yet
+static inline uint32_t* find_page(memory_t* RAM, uint32_t address)
+{
+    page_table_t* table = RAM->page_directory[directory_index(address)];
+    if(NULL == table)
+    {
+        return NULL;
+    }
+    return (*table)[table_index(address)];
+}
+
+static uint32_t* allocate_page(memory_t* RAM, uint32_t address)
+{
+    page_table_t** table = &RAM->page_directory[directory_index(address)];
+    if(NULL == *table)
+    {
+        *table = calloc(1, sizeof(page_table_t));
+    }
+
+    uint32_t** page = &(**table)[table_index(address)];
+    if(NULL == *page)
+    {
+        *page = calloc(WORDS_PER_PAGE, sizeof(uint32_t));
+        RAM->resident_pages++;
+    }
+    return *page;
+}
+
+static void free_all_pages(memory_t* RAM)
+{
+    for(uint32_t d = 0; d < TABLES_PER_DIRECTORY; d++)
+    {
+        page_table_t* table = RAM->page_directory[d];
+        if(NULL == table)
+        {
+            continue;
+        }
+        for(uint32_t t = 0; t < PAGES_PER_TABLE; t++)
+        {
+            free((*table)[t]);
+        }
+        free(table);
+        RAM->page_directory[d] = NULL;
+    }
+    RAM->resident_pages = 0;
+}
+
+//mem_size is the number of addressable words, anything from 0 to mem_size-1
+//can be used. Nothing is actually allocated until it gets written to, so it's
+//fine to ask for the whole 32-bit address space.
 memory_t* make_memory(size_t mem_size)
 {
     memory_t* RAM = calloc(1, sizeof(struct memory));
     RAM->memory_size = mem_size;
-    RAM->system_memory = calloc(RAM->memory_size, sizeof(uint32_t));
     return RAM;
 }
 
+void destroy_memory(memory_t* RAM)
+{
+    free_all_pages(RAM);
+    free(RAM);
+}
+
 void memory_reset(memory_t* RAM)
 {
-    memset(RAM->system_memory, 0x00, RAM->memory_size);
+    free_all_pages(RAM);
+    RAM->wait_cycles = 0;
 }
 
+//addresses past the end of memory read back as 0 and ignore writes
 uint32_t memory_get(memory_t* RAM, size_t address)
 {
-    return RAM->system_memory[address];
+    if(address >= RAM->memory_size)
+    {
+        return 0;
+    }
+
+    uint32_t* page = find_page(RAM, (uint32_t)address);
+    return (NULL == page) ? 0 : page[page_offset((uint32_t)address)];
 }
 
 void memory_set(memory_t* RAM, size_t address, uint32_t value)
 {
-    RAM->system_memory[address] = value;
+    if(address >= RAM->memory_size)
+    {
+        return;
+    }
+
+    uint32_t* page = find_page(RAM, (uint32_t)address);
+    if(NULL == page)
+    {
+        //writing zero to a page that was never touched doesn't change anything
+        if(0 == value)
+        {
+            return;
+        }
+        page = allocate_page(RAM, (uint32_t)address);
+    }
+    page[page_offset((uint32_t)address)] = value;
+}
+
+size_t memory_size(memory_t* RAM)
+{
+    return RAM->memory_size;
+}
+
+//copies count words starting at address out to values, a page at a time.
+//Like memory_get(), anything that has never been written (or is past the
+//end of memory) reads back as 0, and no pages get allocated for it.
+void memory_read_block(memory_t* RAM, size_t address, uint32_t* values, size_t count)
+{
+    while(count > 0)
+    {
+        size_t chunk = WORDS_PER_PAGE - (address & (WORDS_PER_PAGE - 1));
+        if(chunk > count)
+        {
+            chunk = count;
+        }
+
+        //the part of a page that hangs off the end of memory can never be
+        //written, so it's always 0 anyway
+        const uint32_t* page = (address < RAM->memory_size) ? find_page(RAM, (uint32_t)address) : NULL;
+        if(NULL == page)
+        {
+            memset(values, 0, chunk * sizeof(uint32_t));
+        }
+        else
+        {
+            memcpy(values, &page[page_offset((uint32_t)address)], chunk * sizeof(uint32_t));
+        }
+
+        address += chunk;
+        values += chunk;
+        count -= chunk;
+    }
+}
+
+//hands out the host copy of the page holding the address (allocating it if
+//needed) so that it can be accessed directly. The page stays put until the
+//memory is reset or destroyed. Returns NULL if the page is past the end of
+//memory.
+uint32_t* memory_get_page(memory_t* RAM, size_t address)
+{
+    size_t page_start = address & ~(size_t)(WORDS_PER_PAGE - 1);
+    if(page_start + WORDS_PER_PAGE > RAM->memory_size)
+    {
+        return NULL;
+    }
+
+    uint32_t* page = find_page(RAM, (uint32_t)address);
+    return (NULL != page) ? page : allocate_page(RAM, (uint32_t)address);
+}
+
+//the number of 4 KiB pages that are actually backed by host memory
+size_t memory_resident_pages(memory_t* RAM)
+{
+    return RAM->resident_pages;
+}
+
+//a fingerprint of everything that is currently in memory. Only the locations
+//that hold something other than zero (and their addresses) go into the hash,
+//so it doesn't depend on how much memory there is or how it is laid out
+uint64_t memory_hash(memory_t* RAM)
+{
+    uint64_t hash = HASH_SEED;
+    for(uint32_t d = 0; d < TABLES_PER_DIRECTORY; d++)
+    {
+        page_table_t* table = RAM->page_directory[d];
+        if(NULL == table)
+        {
+            continue;
+        }
+        for(uint32_t t = 0; t < PAGES_PER_TABLE; t++)
+        {
+            uint32_t* page = (*table)[t];
+            if(NULL == page)
+            {
+                continue;
+            }
+            uint32_t page_start = page_start_address(d, t);
+            for(uint32_t i = 0; i < WORDS_PER_PAGE; i++)
+            {
+                if(0 != page[i])
+                {
+                    hash = hash_word(hash, page_start + i);
+                    hash = hash_word(hash, page[i]);
+                }
+            }
+        }
+    }
+    return hash;
+}
+
+//a page that has been allocated but still only holds zeros reads back the
+//same as one that was never allocated at all
+static bool page_is_empty(const uint32_t* page)
+{
+    for(uint32_t i = 0; i < WORDS_PER_PAGE; i++)
+    {
+        if(0 != page[i])
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+//Only the pages that hold something are saved. The image has a table of
+//where each page goes and how many words it was encoded in (0 for a page
+//that was stored as it is), then the pages themselves from the next 4 KiB
+//boundary on. Pages that weren't compressed stay on 4 KiB boundaries in the
+//image, so they can be copied (or mapped) straight out of it.
+void memory_save_state(memory_t* RAM, state_writer_t* writer, bool compress)
+{
+    uint32_t* addresses = malloc((RAM->resident_pages + 1) * sizeof(uint32_t));
+    uint32_t* encoded_lengths = malloc((RAM->resident_pages + 1) * sizeof(uint32_t));
+    uint32_t num_pages = 0;
+    for(uint32_t d = 0; d < TABLES_PER_DIRECTORY; d++)
+    {
+        page_table_t* table = RAM->page_directory[d];
+        for(uint32_t t = 0; (NULL != table) && (t < PAGES_PER_TABLE); t++)
+        {
+            const uint32_t* page = (*table)[t];
+            if((NULL == page) || page_is_empty(page))
+            {
+                continue;
+            }
+
+            size_t rle_length = compress ? state_rle_length(page, WORDS_PER_PAGE) : WORDS_PER_PAGE;
+            addresses[num_pages] = page_start_address(d, t);
+            encoded_lengths[num_pages] = (rle_length < WORDS_PER_PAGE) ? (uint32_t)rle_length : 0;
+            num_pages++;
+        }
+    }
+
+    state_write_u32(writer, num_pages);
+    for(uint32_t i = 0; i < num_pages; i++)
+    {
+        state_write_u32(writer, addresses[i]);
+        state_write_u32(writer, encoded_lengths[i]);
+    }
+    state_writer_align(writer, WORDS_PER_PAGE * sizeof(uint32_t));
+    for(uint32_t i = 0; i < num_pages; i++)
+    {
+        const uint32_t* page = find_page(RAM, addresses[i]);
+        if(0 == encoded_lengths[i])
+        {
+            state_write_words(writer, page, WORDS_PER_PAGE);
+        }
+        else
+        {
+            state_write_rle(writer, page, WORDS_PER_PAGE);
+        }
+    }
+    free(addresses);
+    free(encoded_lengths);
+}
+
+//memory has to have been reset first
+void memory_restore_state(memory_t* RAM, state_reader_t* reader)
+{
+    uint32_t num_pages = state_read_u32(reader);
+    if(!state_reader_check(reader, num_pages <= (uint64_t)TABLES_PER_DIRECTORY * PAGES_PER_TABLE))
+    {
+        return;
+    }
+
+    uint32_t* addresses = malloc(((size_t)num_pages + 1) * sizeof(uint32_t));
+    uint32_t* encoded_lengths = malloc(((size_t)num_pages + 1) * sizeof(uint32_t));
+    for(uint32_t i = 0; i < num_pages; i++)
+    {
+        addresses[i] = state_read_u32(reader);
+        encoded_lengths[i] = state_read_u32(reader);
+        state_reader_check(reader, (0 == page_offset(addresses[i])) && (encoded_lengths[i] < WORDS_PER_PAGE));
+    }
+    state_reader_align(reader, WORDS_PER_PAGE * sizeof(uint32_t));
+    for(uint32_t i = 0; (i < num_pages) && !state_reader_failed(reader); i++)
+    {
+        uint32_t* page = memory_get_page(RAM, addresses[i]);
+        if(!state_reader_check(reader, NULL != page))
+        {
+            break;
+        }
+
+        if(0 == encoded_lengths[i])
+        {
+            state_read_words(reader, page, WORDS_PER_PAGE);
+        }
+        else
+        {
+            state_read_rle(reader, page, WORDS_PER_PAGE, encoded_lengths[i]);
+        }
+    }
+    free(addresses);
+    free(encoded_lengths);
 }
 
 //prints the range in memory from the starting to the ending address inclusive
@@ -76,16 +386,15 @@ void memory_cycle(memory_t* RAM, memory_bus_t* bus)
     //for now, memory will take at least one cycle to read/write
     //static const uint32_t MAX_CYCLES = 80000;
     static const uint32_t MAX_CYCLES = 1;
-    static uint32_t cycle_count = 0;
 
-    if(cycle_count < MAX_CYCLES)
+    if(RAM->wait_cycles < MAX_CYCLES)
     {
-        cycle_count++;
+        RAM->wait_cycles++;
         return;
     }
     else
     {
-        cycle_count = 0;
+        RAM->wait_cycles = 0;
         if(bus_is_write_operation(bus))
         {
             memory_set(RAM, bus_get_address_lines(bus), bus_get_data_lines(bus));
@@ -14,12 +14,28 @@
 
 #include "debug.h"
 #include "memory_bus.h"
-#include "memory_map.h"
 #include <stdlib.h>
 #include <stdint.h>
 #include <stdbool.h>
+#include <string.h>
 
 
+//Devices are looked up a page at a time: every page up to the last one that
+//has a device in it gets an entry saying which device owns the whole page.
+//The few pages that are shared between devices (or a device and memory)
+//fall back to searching the list of device ranges, and everything past the
+//end of the table is memory.
+#define BUS_PAGE_OFFSET_BITS    (10)
+#define BUS_PAGE_WORDS          (1u << BUS_PAGE_OFFSET_BITS)
+#define SHARED_PAGE             (0xFF)
+
+struct device_range_t
+{
+    selected_device_t device;
+    uint32_t first_address;
+    uint32_t last_address;
+};
+
 struct memory_bus_t
 {
     uint32_t address_lines;
@@ -28,6 +44,12 @@ struct memory_bus_t
     selected_device_t selected_device;
     bool device_ready; //report back the status of devices that take multiple bus cycles
     bool bus_active;
+
+    //the device map (a bus with nothing mapped is all memory)
+    uint8_t* page_devices;
+    uint32_t num_mapped_pages;
+    struct device_range_t* devices;
+    size_t num_devices;
 };
 
 memory_bus_t* make_memory_bus(void)
@@ -36,6 +58,13 @@ memory_bus_t* make_memory_bus(void)
     return bus;
 }
 
+void destroy_memory_bus(memory_bus_t* bus)
+{
+    free(bus->page_devices);
+    free(bus->devices);
+    free(bus);
+}
+
 //the device being read/written to is signaling the data is ready
 void bus_set_device_ready(memory_bus_t* bus)
 {
@@ -46,7 +75,7 @@ void bus_set_device_ready(memory_bus_t* bus)
 //so we don't get confused
 void bus_clear_device_ready(memory_bus_t* bus)
 {
-    bus->device_ready = true;
+    bus->device_ready = false;
 }
 
 bool bus_is_device_ready(memory_bus_t* bus)
@@ -69,6 +98,14 @@ bool bus_is_enabled(memory_bus_t* bus)
     return bus->bus_active;
 }
 
+//tells us if clocking the bus (and the devices on it) would do nothing at all:
+//it is disabled and has already been through the cycle that deselects
+//everything
+bool bus_is_idle(memory_bus_t* bus)
+{
+    return !bus->bus_active && (NO_DEVICE_SELECTED == bus->selected_device) && !bus->device_ready;
+}
+
 void bus_set_read_operation(memory_bus_t* bus)
 {
     bus->bus_mode = DATA_READ;
@@ -124,35 +161,97 @@ void bus_cycle(memory_bus_t* bus)
         return;
     }
 
-    //decode memory map
-    if(bus->address_lines <= BOOT_ROM_END)
+    bus->selected_device = bus_decode_address(bus, bus->address_lines);
+}
+
+//works out which device is mapped to the given address. Anything that isn't
+//a device is plain memory (this includes the boot ROM region, since there's no
+//boot ROM yet and test programs get loaded into RAM starting at address 0).
+selected_device_t bus_decode_address(memory_bus_t* bus, uint32_t address)
+{
+    uint32_t page = address >> BUS_PAGE_OFFSET_BITS;
+    if(page >= bus->num_mapped_pages)
     {
-        //NOTE: haven't implemented a BOOT ROM yet, so leave this commented out for now
-        //bus->selected_device = BOOT_ROM_SELECTED;
-
-        //FIXME: until we create an actual boot rom, we'll just say that we are
-        //reading these addresses from RAM because that's where our little test
-        //programs for the instruction set are being loaded in RAM starting at
-        //address 0 I will eventually need to fix this by making a dummy boot
-        //rom that loads the PC with the first address in RAM, and then using
-        //the new PC as an index into our program array, but I haven't even
-        //implemented a jump instruction yet!
-        bus->selected_device = MEMORY_SELECTED;
+        return MEMORY_SELECTED;
     }
-    else if((INTERRUPT_VECTOR_TABLE_START <= bus->address_lines) && (bus->address_lines <= INTERRUPT_VECTOR_TABLE_END))
+
+    uint8_t device = bus->page_devices[page];
+    if(SHARED_PAGE != device)
     {
-        bus->selected_device = MEMORY_SELECTED;
+        return (selected_device_t)device;
     }
-    else if((GRAPHICS_REGION_START <= bus->address_lines) && (bus->address_lines <= GRAPHICS_REGION_END))
+
+    //the page is split between devices (or a device and memory), so check
+    //each device's range
+    for(size_t i = 0; i < bus->num_devices; i++)
     {
-        bus->selected_device = GRAPHICS_SELECTED;
+        if((bus->devices[i].first_address <= address) && (address <= bus->devices[i].last_address))
+        {
+            return bus->devices[i].device;
+        }
     }
-    else if((KEYBOARD_REGION_START <= bus->address_lines) && (bus->address_lines <= KEYBOARD_REGION_END))
+    return MEMORY_SELECTED;
+}
+
+static bool ranges_overlap(uint32_t first_a, uint32_t last_a, uint32_t first_b, uint32_t last_b)
+{
+    return (first_a <= last_b) && (first_b <= last_a);
+}
+
+//tells us if every address in the (inclusive) range is plain memory, i.e. no
+//device is mapped anywhere inside of it
+bool bus_range_is_memory(memory_bus_t* bus, uint32_t first_address, uint32_t last_address)
+{
+    for(size_t i = 0; i < bus->num_devices; i++)
+    {
+        if(ranges_overlap(first_address, last_address, bus->devices[i].first_address, bus->devices[i].last_address))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+//attaches a device to the (inclusive) range of addresses. This is meant to be
+//done while the computer is being built, since it rebuilds the lookup table.
+//Returns false if the range is empty or overlaps a device that is already
+//mapped.
+bool bus_map_device(memory_bus_t* bus, selected_device_t device, uint32_t first_address, uint32_t last_address)
+{
+    if((last_address < first_address) || !bus_range_is_memory(bus, first_address, last_address))
+    {
+        return false;
+    }
+
+    bus->devices = realloc(bus->devices, (bus->num_devices + 1) * sizeof(*bus->devices));
+    bus->devices[bus->num_devices].device = device;
+    bus->devices[bus->num_devices].first_address = first_address;
+    bus->devices[bus->num_devices].last_address = last_address;
+    bus->num_devices++;
+
+    //the table only has to reach as far as the last page with a device in it
+    uint32_t first_page = first_address >> BUS_PAGE_OFFSET_BITS;
+    uint32_t last_page = last_address >> BUS_PAGE_OFFSET_BITS;
+    if(last_page >= bus->num_mapped_pages)
     {
-        bus->selected_device = KEYBOARD_SELECTED;
+        bus->page_devices = realloc(bus->page_devices, (size_t)last_page + 1);
+        memset(&bus->page_devices[bus->num_mapped_pages], MEMORY_SELECTED, (size_t)last_page + 1 - bus->num_mapped_pages);
+        bus->num_mapped_pages = last_page + 1;
     }
-    else //no special addresses, so pick normal memory
+
+    for(uint32_t page = first_page; page <= last_page; page++)
     {
-        bus->selected_device = MEMORY_SELECTED;
+        uint32_t page_start = page << BUS_PAGE_OFFSET_BITS;
+        uint32_t page_end = page_start + (BUS_PAGE_WORDS - 1);
+        bool whole_page = (first_address <= page_start) && (page_end <= last_address);
+        if(whole_page && (MEMORY_SELECTED == bus->page_devices[page]))
+        {
+            bus->page_devices[page] = (uint8_t)device;
+        }
+        else
+        {
+            bus->page_devices[page] = SHARED_PAGE;
+        }
     }
+    return true;
 }
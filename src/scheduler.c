@@ -0,0 +1,235 @@
+// ----------------------------------------------------------------------------
+//
+//  FILE: scheduler.c
+//
+//  DESCRIPTION: This module keeps track of when each device next needs
+//  attention, so that the main loop can let the CPU run freely and only stop
+//  to service devices when something is actually due. Most devices spend
+//  almost all of their time doing nothing at all (a timer counting up towards
+//  an overflow that is millions of cycles away), and clocking them on every
+//  cycle used to be where most of the simulator's time went.
+//
+//  The pending events are kept in a binary min-heap ordered by the cycle they
+//  are due at (ties go to whichever was scheduled first). Events live in a
+//  table of slots that remember where they are in the heap so that they can
+//  be cancelled without searching for them.
+//
+// ----------------------------------------------------------------------------
+
+
+#include "scheduler.h"
+#include <stdlib.h>
+
+
+struct event_t
+{
+    uint64_t cycle;
+    uint64_t sequence;      //breaks ties between events due on the same cycle
+    scheduler_callback_t callback;
+    void* context;
+    uint32_t generation;    //bumped every time the slot is reused so stale ids don't match
+    uint32_t heap_position;
+    bool in_use;
+};
+
+typedef struct event_t event_t;
+
+struct scheduler_t
+{
+    event_t* events;
+    uint32_t num_slots;
+
+    uint32_t* heap;         //slot numbers, earliest event first
+    uint32_t heap_size;
+
+    uint32_t* free_slots;
+    uint32_t num_free_slots;
+
+    uint64_t next_sequence;
+};
+
+
+scheduler_t* make_scheduler(void)
+{
+    scheduler_t* scheduler = calloc(1, sizeof(struct scheduler_t));
+    return scheduler;
+}
+
+void destroy_scheduler(scheduler_t* scheduler)
+{
+    free(scheduler->events);
+    free(scheduler->heap);
+    free(scheduler->free_slots);
+    free(scheduler);
+}
+
+//throws away every pending event
+void scheduler_reset(scheduler_t* scheduler)
+{
+    scheduler->heap_size = 0;
+    scheduler->num_free_slots = 0;
+    for(uint32_t slot = 0; slot < scheduler->num_slots; slot++)
+    {
+        scheduler->events[slot].in_use = false;
+        scheduler->events[slot].generation++;
+        scheduler->free_slots[scheduler->num_free_slots++] = slot;
+    }
+}
+
+static bool is_earlier(scheduler_t* scheduler, uint32_t slot_a, uint32_t slot_b)
+{
+    const event_t* a = &scheduler->events[slot_a];
+    const event_t* b = &scheduler->events[slot_b];
+    return (a->cycle < b->cycle) || ((a->cycle == b->cycle) && (a->sequence < b->sequence));
+}
+
+static void place_in_heap(scheduler_t* scheduler, uint32_t position, uint32_t slot)
+{
+    scheduler->heap[position] = slot;
+    scheduler->events[slot].heap_position = position;
+}
+
+static void sift_up(scheduler_t* scheduler, uint32_t position)
+{
+    uint32_t slot = scheduler->heap[position];
+    while(position > 0)
+    {
+        uint32_t parent = (position - 1) / 2;
+        if(!is_earlier(scheduler, slot, scheduler->heap[parent]))
+        {
+            break;
+        }
+        place_in_heap(scheduler, position, scheduler->heap[parent]);
+        position = parent;
+    }
+    place_in_heap(scheduler, position, slot);
+}
+
+static void sift_down(scheduler_t* scheduler, uint32_t position)
+{
+    uint32_t slot = scheduler->heap[position];
+    while(true)
+    {
+        uint32_t earliest_child = 2 * position + 1;
+        if(earliest_child >= scheduler->heap_size)
+        {
+            break;
+        }
+        if((earliest_child + 1 < scheduler->heap_size) &&
+           is_earlier(scheduler, scheduler->heap[earliest_child + 1], scheduler->heap[earliest_child]))
+        {
+            earliest_child++;
+        }
+        if(!is_earlier(scheduler, scheduler->heap[earliest_child], slot))
+        {
+            break;
+        }
+        place_in_heap(scheduler, position, scheduler->heap[earliest_child]);
+        position = earliest_child;
+    }
+    place_in_heap(scheduler, position, slot);
+}
+
+static void remove_from_heap(scheduler_t* scheduler, uint32_t position)
+{
+    uint32_t slot = scheduler->heap[position];
+    scheduler->events[slot].in_use = false;
+    scheduler->events[slot].generation++;
+    scheduler->free_slots[scheduler->num_free_slots++] = slot;
+
+    scheduler->heap_size--;
+    if(position == scheduler->heap_size)
+    {
+        return;
+    }
+
+    //move the last event into the hole and let it find its place, which may
+    //be in either direction
+    uint32_t moved_slot = scheduler->heap[scheduler->heap_size];
+    place_in_heap(scheduler, position, moved_slot);
+    sift_down(scheduler, position);
+    sift_up(scheduler, scheduler->events[moved_slot].heap_position);
+}
+
+static uint32_t allocate_slot(scheduler_t* scheduler)
+{
+    if(0 == scheduler->num_free_slots)
+    {
+        uint32_t old_num_slots = scheduler->num_slots;
+        uint32_t new_num_slots = (0 == old_num_slots) ? 8 : 2 * old_num_slots;
+        scheduler->events = realloc(scheduler->events, new_num_slots * sizeof(*scheduler->events));
+        scheduler->heap = realloc(scheduler->heap, new_num_slots * sizeof(*scheduler->heap));
+        scheduler->free_slots = realloc(scheduler->free_slots, new_num_slots * sizeof(*scheduler->free_slots));
+        for(uint32_t slot = new_num_slots; slot-- > old_num_slots;)
+        {
+            scheduler->events[slot].in_use = false;
+            scheduler->events[slot].generation = 1;
+            scheduler->free_slots[scheduler->num_free_slots++] = slot;
+        }
+        scheduler->num_slots = new_num_slots;
+    }
+    return scheduler->free_slots[--scheduler->num_free_slots];
+}
+
+static event_id_t make_event_id(scheduler_t* scheduler, uint32_t slot)
+{
+    return ((event_id_t)scheduler->events[slot].generation << 32) | slot;
+}
+
+//schedules the callback to be run once the given cycle is reached. The id
+//that comes back can be used to cancel the event before then.
+event_id_t scheduler_add_event(scheduler_t* scheduler, uint64_t cycle, scheduler_callback_t callback, void* context)
+{
+    uint32_t slot = allocate_slot(scheduler);
+    event_t* event = &scheduler->events[slot];
+    event->cycle = cycle;
+    event->sequence = scheduler->next_sequence++;
+    event->callback = callback;
+    event->context = context;
+    event->in_use = true;
+
+    scheduler->heap_size++;
+    place_in_heap(scheduler, scheduler->heap_size - 1, slot);
+    sift_up(scheduler, scheduler->heap_size - 1);
+    return make_event_id(scheduler, slot);
+}
+
+//returns false if the event has already run or been cancelled
+bool scheduler_cancel_event(scheduler_t* scheduler, event_id_t id)
+{
+    uint32_t slot = (uint32_t)id;
+    uint32_t generation = (uint32_t)(id >> 32);
+    if((slot >= scheduler->num_slots) || !scheduler->events[slot].in_use || (scheduler->events[slot].generation != generation))
+    {
+        return false;
+    }
+    remove_from_heap(scheduler, scheduler->events[slot].heap_position);
+    return true;
+}
+
+uint64_t scheduler_next_event_cycle(scheduler_t* scheduler)
+{
+    if(0 == scheduler->heap_size)
+    {
+        return NO_EVENT_SCHEDULED;
+    }
+    return scheduler->events[scheduler->heap[0]].cycle;
+}
+
+size_t scheduler_num_events(scheduler_t* scheduler)
+{
+    return scheduler->heap_size;
+}
+
+//runs every event that is due at or before the given cycle, earliest first.
+//Callbacks are free to schedule more events (including ones that are already
+//due, which will run before this returns).
+void scheduler_run_due_events(scheduler_t* scheduler, uint64_t cycle)
+{
+    while((0 != scheduler->heap_size) && (scheduler->events[scheduler->heap[0]].cycle <= cycle))
+    {
+        event_t event = scheduler->events[scheduler->heap[0]];
+        remove_from_heap(scheduler, 0);
+        event.callback(event.context, event.cycle);
+    }
+}
@@ -0,0 +1,97 @@
+// ----------------------------------------------------------------------------
+//
+//  FILE: spsc_queue.c
+//
+//  DESCRIPTION: This module is a circular queue that one thread can put
+//  values into while another thread takes them out, without either of them
+//  taking a lock. The producer is the only one that moves the tail and the
+//  consumer is the only one that moves the head, so each side only has to
+//  look at (never change) the other side's index to see if there is room or
+//  anything to take.
+//
+//  The head and tail just keep counting up and are only wrapped around when
+//  they are used to index the queue, so the queue is full when they are
+//  exactly one queue size apart. The size is rounded up to a power of two so
+//  that the wrapping is a mask.
+//
+// ----------------------------------------------------------------------------
+
+
+#include "spsc_queue.h"
+#include <stdlib.h>
+
+
+struct spsc_queue_t
+{
+    size_t size;
+    uint32_t* data;
+    size_t head;    //the next value to take out, only moved by the consumer
+    size_t tail;    //where the next value goes in, only moved by the producer
+};
+
+spsc_queue_t* spsc_queue_create(size_t queue_size)
+{
+    if(queue_size < 1)
+        return NULL;
+
+    size_t size = 1;
+    while(size < queue_size)
+    {
+        size *= 2;
+    }
+
+    spsc_queue_t* queue = calloc(1, sizeof(spsc_queue_t));
+    queue->data = calloc(size, sizeof(*(queue->data)));
+    queue->size = size;
+    queue->head = 0;
+    queue->tail = 0;
+    return queue;
+}
+
+void spsc_queue_destroy(spsc_queue_t* queue)
+{
+    free(queue->data);
+    free(queue);
+}
+
+//the number of values the queue can hold (the requested size rounded up to
+//a power of two)
+size_t spsc_queue_get_size(spsc_queue_t* queue)
+{
+    return queue->size;
+}
+
+//returns false (and drops the value) if the queue is full
+bool spsc_queue_put(spsc_queue_t* queue, uint32_t value)
+{
+    size_t tail = __atomic_load_n(&queue->tail, __ATOMIC_RELAXED);
+    size_t head = __atomic_load_n(&queue->head, __ATOMIC_ACQUIRE);
+    if(tail - head == queue->size)
+    {
+        return false;
+    }
+
+    queue->data[tail & (queue->size - 1)] = value;
+    __atomic_store_n(&queue->tail, tail + 1, __ATOMIC_RELEASE);
+    return true;
+}
+
+bool spsc_queue_is_empty(spsc_queue_t* queue)
+{
+    return __atomic_load_n(&queue->head, __ATOMIC_RELAXED) == __atomic_load_n(&queue->tail, __ATOMIC_ACQUIRE);
+}
+
+//returns false if there was nothing to take out
+bool spsc_queue_get(spsc_queue_t* queue, uint32_t* value)
+{
+    size_t head = __atomic_load_n(&queue->head, __ATOMIC_RELAXED);
+    size_t tail = __atomic_load_n(&queue->tail, __ATOMIC_ACQUIRE);
+    if(head == tail)
+    {
+        return false;
+    }
+
+    *value = queue->data[head & (queue->size - 1)];
+    __atomic_store_n(&queue->head, head + 1, __ATOMIC_RELEASE);
+    return true;
+}
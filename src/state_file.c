@@ -0,0 +1,299 @@
+// ----------------------------------------------------------------------------
+//
+//  FILE: state_file.c
+//
+//  DESCRIPTION: This module reads and writes machine state images. Writing
+//  goes through stdio with a large buffer, since images are written once in
+//  a long stream. Reading maps the whole image into memory (where the host
+//  supports it) and walks through it, so restoring a big image is little
+//  more than copying its pages out of the page cache.
+//
+// ----------------------------------------------------------------------------
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "state_file.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define STATE_FILE_MMAP_SUPPORTED
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#define WRITE_BUFFER_SIZE   (1 << 20)
+
+struct state_writer_t
+{
+    FILE* file;
+    char* buffer;
+    size_t offset;      //bytes written so far
+    bool failed;
+};
+
+struct state_reader_t
+{
+    const uint8_t* image;
+    size_t size;
+    size_t offset;      //the next byte to read
+    bool mapped;        //whether image has to be unmapped or freed
+    bool failed;
+};
+
+state_writer_t* state_writer_create(const char* path)
+{
+    FILE* file = fopen(path, "wb");
+    if(NULL == file)
+    {
+        return NULL;
+    }
+
+    state_writer_t* writer = calloc(1, sizeof(struct state_writer_t));
+    writer->file = file;
+    writer->buffer = malloc(WRITE_BUFFER_SIZE);
+    setvbuf(file, writer->buffer, _IOFBF, WRITE_BUFFER_SIZE);
+    return writer;
+}
+
+bool state_writer_close(state_writer_t* writer)
+{
+    bool written = (0 == fclose(writer->file)) && !writer->failed;
+    free(writer->buffer);
+    free(writer);
+    return written;
+}
+
+static void write_bytes(state_writer_t* writer, const void* bytes, size_t length)
+{
+    if(writer->failed || (0 == length))
+    {
+        return;
+    }
+
+    if(1 != fwrite(bytes, length, 1, writer->file))
+    {
+        writer->failed = true;
+        return;
+    }
+    writer->offset += length;
+}
+
+void state_write_u8(state_writer_t* writer, uint8_t value)
+{
+    write_bytes(writer, &value, sizeof(value));
+}
+
+void state_write_u32(state_writer_t* writer, uint32_t value)
+{
+    write_bytes(writer, &value, sizeof(value));
+}
+
+void state_write_u64(state_writer_t* writer, uint64_t value)
+{
+    write_bytes(writer, &value, sizeof(value));
+}
+
+void state_write_words(state_writer_t* writer, const uint32_t* words, size_t count)
+{
+    write_bytes(writer, words, count * sizeof(uint32_t));
+}
+
+void state_writer_align(state_writer_t* writer, size_t alignment)
+{
+    static const uint8_t ZERO = 0;
+    while(!writer->failed && (0 != writer->offset % alignment))
+    {
+        write_bytes(writer, &ZERO, 1);
+    }
+}
+
+size_t state_rle_length(const uint32_t* words, size_t count)
+{
+    size_t runs = 0;
+    for(size_t i = 0; i < count; i++)
+    {
+        if((0 == i) || (words[i] != words[i - 1]))
+        {
+            runs++;
+        }
+    }
+    return 2 * runs;
+}
+
+void state_write_rle(state_writer_t* writer, const uint32_t* words, size_t count)
+{
+    size_t start = 0;
+    while(start < count)
+    {
+        size_t end = start + 1;
+        while((end < count) && (words[end] == words[start]))
+        {
+            end++;
+        }
+        state_write_u32(writer, (uint32_t)(end - start));
+        state_write_u32(writer, words[start]);
+        start = end;
+    }
+}
+
+//reads the whole file in for hosts that can't map it
+static bool read_whole_file(state_reader_t* reader, const char* path)
+{
+    FILE* file = fopen(path, "rb");
+    if(NULL == file)
+    {
+        return false;
+    }
+
+    bool read = (0 == fseek(file, 0, SEEK_END));
+    long size = read ? ftell(file) : -1;
+    read = (size >= 0) && (0 == fseek(file, 0, SEEK_SET));
+    uint8_t* image = read ? malloc((size_t)size + 1) : NULL;
+    read = (NULL != image) && ((size_t)size == fread(image, 1, (size_t)size, file));
+    fclose(file);
+    if(!read)
+    {
+        free(image);
+        return false;
+    }
+
+    reader->image = image;
+    reader->size = (size_t)size;
+    return true;
+}
+
+state_reader_t* state_reader_open(const char* path)
+{
+    state_reader_t* reader = calloc(1, sizeof(struct state_reader_t));
+#ifdef STATE_FILE_MMAP_SUPPORTED
+    int fd = open(path, O_RDONLY);
+    struct stat status;
+    if((fd >= 0) && (0 == fstat(fd, &status)) && (status.st_size > 0))
+    {
+        void* image = mmap(NULL, (size_t)status.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if(MAP_FAILED != image)
+        {
+            reader->image = image;
+            reader->size = (size_t)status.st_size;
+            reader->mapped = true;
+        }
+    }
+    if(fd >= 0)
+    {
+        close(fd);
+    }
+#endif
+
+    if(!reader->mapped && !read_whole_file(reader, path))
+    {
+        free(reader);
+        return NULL;
+    }
+    return reader;
+}
+
+void state_reader_close(state_reader_t* reader)
+{
+#ifdef STATE_FILE_MMAP_SUPPORTED
+    if(reader->mapped)
+    {
+        munmap((void*)reader->image, reader->size);
+    }
+#endif
+    if(!reader->mapped)
+    {
+        free((void*)reader->image);
+    }
+    free(reader);
+}
+
+static void read_bytes(state_reader_t* reader, void* bytes, size_t length)
+{
+    if(reader->failed || (length > reader->size - reader->offset))
+    {
+        reader->failed = true;
+        memset(bytes, 0, length);
+        return;
+    }
+
+    memcpy(bytes, &reader->image[reader->offset], length);
+    reader->offset += length;
+}
+
+uint8_t state_read_u8(state_reader_t* reader)
+{
+    uint8_t value;
+    read_bytes(reader, &value, sizeof(value));
+    return value;
+}
+
+uint32_t state_read_u32(state_reader_t* reader)
+{
+    uint32_t value;
+    read_bytes(reader, &value, sizeof(value));
+    return value;
+}
+
+uint64_t state_read_u64(state_reader_t* reader)
+{
+    uint64_t value;
+    read_bytes(reader, &value, sizeof(value));
+    return value;
+}
+
+void state_read_words(state_reader_t* reader, uint32_t* words, size_t count)
+{
+    read_bytes(reader, words, count * sizeof(uint32_t));
+}
+
+void state_reader_align(state_reader_t* reader, size_t alignment)
+{
+    size_t padding = (alignment - reader->offset % alignment) % alignment;
+    if(state_reader_check(reader, padding <= reader->size - reader->offset))
+    {
+        reader->offset += padding;
+    }
+}
+
+void state_read_rle(state_reader_t* reader, uint32_t* words, size_t count, size_t encoded_length)
+{
+    size_t decoded = 0;
+    for(size_t i = 0; state_reader_check(reader, 0 == encoded_length % 2) && (i < encoded_length); i += 2)
+    {
+        uint32_t run_length = state_read_u32(reader);
+        uint32_t value = state_read_u32(reader);
+        if(!state_reader_check(reader, run_length <= count - decoded))
+        {
+            return;
+        }
+        for(uint32_t j = 0; j < run_length; j++)
+        {
+            words[decoded++] = value;
+        }
+    }
+    state_reader_check(reader, decoded == count);
+}
+
+bool state_reader_check(state_reader_t* reader, bool condition)
+{
+    if(!condition)
+    {
+        reader->failed = true;
+    }
+    return !reader->failed;
+}
+
+bool state_reader_failed(state_reader_t* reader)
+{
+    return reader->failed;
+}
+
+bool state_reader_at_end(state_reader_t* reader)
+{
+    return reader->offset == reader->size;
+}
@@ -14,6 +14,11 @@
 //  might consider changing things in the future depending on how this scheme
 //  works out.
 //
+//  Rather than being clocked every cycle, a timer remembers the cycle it was
+//  last brought up to date at and works out its count from there whenever it
+//  is needed: when its registers are accessed over the bus, or when the
+//  overflow that it registered with the scheduler comes due.
+//
 // ----------------------------------------------------------------------------
 
 
@@ -24,8 +29,7 @@
 
 #include "timer.h"
 #include "bit_twiddling.h"
-
-#include "debug.h"
+#include "memory_map.h"
 
 #define Hz (1u)
 #define MHz (1000000*Hz)
@@ -50,21 +54,28 @@ struct timer_t
     uint32_t prescale_counter;
 
     uint32_t timer_value;
+
+    scheduler_t* scheduler;
+    interrupt_controller_t* ic;
+    uint64_t last_synced_cycle;     //the cycle that timer_value is up to date for
+    event_id_t overflow_event;
 };
 
 
-static void prescale_tick(timer_t* timer);
-static void tick(timer_t* timer);
+static void schedule_overflow(timer_t* timer);
 static void update_interrupt_status(timer_t* timer, interrupt_controller_t* ic);
+static bool prescaling_enabled(timer_t* timer);
 static void update_timer_overflow_status(timer_t* timer);
 
 
-timer_t* make_timer(uint8_t IRQ_number)
+timer_t* make_timer(uint8_t IRQ_number, scheduler_t* scheduler, interrupt_controller_t* ic)
 {
     //timer has value of 0, no prescaling, is turned off, and has its
     //interrupts masked when first created
     timer_t* timer =  calloc(1, sizeof(struct timer_t));
     timer->IRQ_number = IRQ_number;
+    timer->scheduler = scheduler;
+    timer->ic = ic;
 
     //DEBUG
 
@@ -77,72 +88,205 @@ timer_t* make_timer(uint8_t IRQ_number)
     return timer;
 }
 
+void destroy_timer(timer_t* timer)
+{
+    free(timer);
+}
 
-void timer_cycle(timer_t* timer, memory_bus_t* bus, interrupt_controller_t* ic)
+
+//how many system clock cycles after last_synced_cycle the timer next
+//increments on. With prescaling on, the first increment only needs to
+//finish off the current prescale period.
+static uint64_t cycles_until_first_increment(timer_t* timer)
 {
-    //timer register manipulation here
+    if(prescaling_enabled(timer) && (timer->prescale_counter < timer->prescale_value))
+    {
+        return timer->prescale_value - timer->prescale_counter + 1;
+    }
+    return 1;
+}
 
-        //FIXME: figure out what I want to do with the timer-specific
-        //registers: should I decode them "by hand" or just stick everything in
-        //a lookup table?
+//how many system clock cycles go by between increments once the prescaler
+//has lined up
+static uint64_t cycles_per_increment(timer_t* timer)
+{
+    return prescaling_enabled(timer) ? timer->prescale_value : 1;
+}
 
-    if(CHECK_BIT_CLEAR(timer->control_bits, TIMER_ON_BIT))
+//brings the timer up to date with the given cycle. Rather than stepping the
+//timer one cycle at a time, this works out how many times it has incremented
+//since it was last synced and where the prescaler has got to, so catching up
+//after a long stretch costs the same as catching up after a short one.
+static void sync_timer(timer_t* timer, uint64_t cycle)
+{
+    uint64_t elapsed = cycle - timer->last_synced_cycle;
+    timer->last_synced_cycle = cycle;
+    if((0 == elapsed) || CHECK_BIT_CLEAR(timer->control_bits, TIMER_ON_BIT))
+    {
         return;
+    }
 
-    uint32_t previous_timer_value = timer->timer_value;
-
-    tick(timer);
+    uint64_t first_increment = cycles_until_first_increment(timer);
+    uint64_t increments = 0;
+    if(elapsed >= first_increment)
+    {
+        uint64_t period = cycles_per_increment(timer);
+        increments = 1 + (elapsed - first_increment) / period;
+        //counting up from 1 fixes the off-by-one error and allows us to think
+        //in terms of the prescaler factor instead of (prescaler factor - 1)
+        timer->prescale_counter = (uint32_t)(1 + (elapsed - first_increment) % period);
+    }
+    else
+    {
+        timer->prescale_counter += (uint32_t)elapsed;
+    }
 
-    if(timer->timer_value < previous_timer_value)
+    uint64_t increments_until_overflow = (uint64_t)UINT32_MAX - timer->timer_value + 1;
+    timer->timer_value += (uint32_t)increments;
+    if(increments >= increments_until_overflow)
     {
-        beacon();
         update_timer_overflow_status(timer);
-        update_interrupt_status(timer, ic);
+        update_interrupt_status(timer, timer->ic);
     }
+}
 
+//how many more system clock cycles it will take for the timer to wrap around
+//to 0
+static uint64_t cycles_until_overflow(timer_t* timer)
+{
+    uint64_t increments_left = (uint64_t)UINT32_MAX - timer->timer_value + 1;
+    return cycles_until_first_increment(timer) + (increments_left - 1) * cycles_per_increment(timer);
 }
 
-static void update_interrupt_status(timer_t* timer, interrupt_controller_t* ic)
+static void overflow_event(void* context, uint64_t cycle)
 {
-    if(CHECK_BIT_SET(timer->control_bits, TIMER_INTERRUPT_ENABLE_BIT) && CHECK_BIT_SET(timer->control_bits, TIMER_INTERRUPT_FLAG_BIT))
+    timer_t* timer = context;
+    timer->overflow_event = NO_EVENT_ID;
+    sync_timer(timer, cycle);
+    schedule_overflow(timer);
+}
+
+static void schedule_overflow(timer_t* timer)
+{
+    scheduler_cancel_event(timer->scheduler, timer->overflow_event);
+    timer->overflow_event = NO_EVENT_ID;
+    if(CHECK_BIT_SET(timer->control_bits, TIMER_ON_BIT))
     {
-        //at this point, interrupts are enabled and the overflow interrupt has
-        //occured, so we need to signal the processor
-        request_interrupt(ic, timer->IRQ_number);
+        uint64_t overflow_cycle = timer->last_synced_cycle + cycles_until_overflow(timer);
+        timer->overflow_event = scheduler_add_event(timer->scheduler, overflow_cycle, &overflow_event, timer);
     }
 }
 
+//starts the timer's clock from the given cycle. This must be called again
+//whenever the scheduler's notion of the current cycle starts over (i.e. when
+//the computer is reset).
+void timer_start(timer_t* timer, uint64_t cycle)
+{
+    timer->last_synced_cycle = cycle;
+    timer->overflow_event = NO_EVENT_ID;
+    schedule_overflow(timer);
+}
+
+//The timer is brought up to date with the given cycle first, so that it can
+//be restored on any cycle, as long as that's where the rest of the computer
+//is restored to as well
+void timer_save_state(timer_t* timer, state_writer_t* writer, uint64_t cycle)
+{
+    sync_timer(timer, cycle);
+    state_write_u8(writer, timer->control_bits);
+    state_write_u32(writer, timer->prescale_value);
+    state_write_u32(writer, timer->prescale_counter);
+    state_write_u32(writer, timer->timer_value);
+}
 
-static void prescale_tick(timer_t* timer)
+//the timer has to have been started on the scheduler already
+void timer_restore_state(timer_t* timer, state_reader_t* reader, uint64_t cycle)
 {
-    if(timer->prescale_counter < timer->prescale_value)
+    timer->control_bits = state_read_u8(reader);
+    timer->prescale_value = state_read_u32(reader);
+    timer->prescale_counter = state_read_u32(reader);
+    timer->timer_value = state_read_u32(reader);
+    timer->last_synced_cycle = cycle;
+    schedule_overflow(timer);
+}
+
+static uint32_t read_register(timer_t* timer, uint32_t offset)
+{
+    switch(offset)
     {
-        timer->prescale_counter++;
-    }
-    else
-    {
-        //counting up from 1 fixes the off-by-one error and allows us to think
-        //in terms of the prescaler factor instead of (prescaler factor - 1)
-        timer->prescale_counter = 1;
-        timer->timer_value++;
+        case TIMER_CONTROL_REGISTER:
+            return timer->control_bits;
+        case TIMER_PRESCALE_REGISTER:
+            return timer->prescale_value;
+        case TIMER_VALUE_REGISTER:
+            return timer->timer_value;
+        default:
+            return 0;
     }
 }
 
-static bool prescaling_enabled(timer_t* timer)
+//The overflow flag can only be cleared from software (by writing a 0 to it),
+//only the timer itself gets to set it
+static void write_register(timer_t* timer, uint32_t offset, uint32_t value)
 {
-    return (MIN_PRESCALE_VALUE <= timer->prescale_value);
+    switch(offset)
+    {
+        case TIMER_CONTROL_REGISTER:
+        {
+            //the on and interrupt enable bits sit below the flag
+            uint32_t overflow_flag = timer->control_bits & value & ((1u) << TIMER_INTERRUPT_FLAG_BIT);
+            timer->control_bits = (uint8_t)(overflow_flag | (value & GENERATE_ONES(TIMER_INTERRUPT_FLAG_BIT)));
+            break;
+        }
+        case TIMER_PRESCALE_REGISTER:
+            timer->prescale_value = value;
+            timer->prescale_counter = 0;
+            break;
+        case TIMER_VALUE_REGISTER:
+            timer->timer_value = value;
+            break;
+        default:
+            break;
+    }
 }
 
-static void tick(timer_t* timer)
+//The timer's registers are only brought up to date when something actually
+//looks at them (or changes them) over the bus. Writes can move the overflow,
+//so it gets rescheduled afterwards.
+void timer_cycle(timer_t* timer, memory_bus_t* bus, uint64_t cycle)
 {
-    if(!prescaling_enabled(timer))
+    if(TIMER_SELECTED != bus_get_selected_device(bus) || !bus_is_enabled(bus))
+    {
+        return;
+    }
+
+    sync_timer(timer, cycle);
+    uint32_t offset = bus_get_address_lines(bus) - TIMER_REGION_START;
+    if(bus_is_read_operation(bus))
     {
-        timer->timer_value++;
+        bus_set_data_lines(bus, read_register(timer, offset));
     }
     else
     {
-        prescale_tick(timer);
+        write_register(timer, offset, bus_get_data_lines(bus));
+        schedule_overflow(timer);
     }
+    bus_set_device_ready(bus);
+}
+
+static void update_interrupt_status(timer_t* timer, interrupt_controller_t* ic)
+{
+    if(CHECK_BIT_SET(timer->control_bits, TIMER_INTERRUPT_ENABLE_BIT) && CHECK_BIT_SET(timer->control_bits, TIMER_INTERRUPT_FLAG_BIT))
+    {
+        //at this point, interrupts are enabled and the overflow interrupt has
+        //occured, so we need to signal the processor
+        request_interrupt(ic, timer->IRQ_number);
+    }
+}
+
+static bool prescaling_enabled(timer_t* timer)
+{
+    return (MIN_PRESCALE_VALUE <= timer->prescale_value);
 }
 
 // This function sets the timer overflow flag. It is only allowed to set this
@@ -0,0 +1,88 @@
+// ----------------------------------------------------------------------------
+//
+//  FILE: triple_buffer.c
+//
+//  DESCRIPTION: This module lets the simulation thread hand frames over to
+//  the render thread without either of them ever having to take a lock or
+//  wait for the other one.
+//
+//  There are three buffers. The producer owns the "back" buffer and the
+//  consumer owns the "front" buffer. The third one sits in the middle, and
+//  the only thing that the two threads share is which buffer that is (plus a
+//  bit that says whether it holds a snapshot that the consumer hasn't seen
+//  yet). Publishing swaps the back buffer into the middle and reading the
+//  latest snapshot swaps the middle buffer out to the front, each with a
+//  single atomic exchange.
+//
+// ----------------------------------------------------------------------------
+
+
+#include "triple_buffer.h"
+#include <stdint.h>
+#include <stdlib.h>
+
+
+//the middle index has this bit set when it holds a snapshot that hasn't been
+//picked up by the consumer yet
+#define FRESH_BIT       (0x4u)
+#define INDEX_MASK      (0x3u)
+
+struct triple_buffer_t
+{
+    void* buffers[3];
+    uint32_t back;      //only ever touched by the producer
+    uint32_t front;     //only ever touched by the consumer
+    uint32_t middle;    //shared, only accessed atomically
+};
+
+
+//all three buffers start out zeroed
+triple_buffer_t* triple_buffer_create(size_t buffer_size)
+{
+    triple_buffer_t* buffer = calloc(1, sizeof(struct triple_buffer_t));
+    for(int i = 0; i < 3; i++)
+    {
+        buffer->buffers[i] = calloc(1, buffer_size);
+    }
+    buffer->back = 0;
+    buffer->middle = 1;
+    buffer->front = 2;
+    return buffer;
+}
+
+void triple_buffer_destroy(triple_buffer_t* buffer)
+{
+    for(int i = 0; i < 3; i++)
+    {
+        free(buffer->buffers[i]);
+    }
+    free(buffer);
+}
+
+//the buffer that the producer fills in before publishing it. It still holds
+//whatever was published in it a couple of snapshots ago.
+void* triple_buffer_get_back_buffer(triple_buffer_t* buffer)
+{
+    return buffer->buffers[buffer->back];
+}
+
+//makes the back buffer the latest snapshot and hands the producer a new one
+void triple_buffer_publish(triple_buffer_t* buffer)
+{
+    uint32_t old_middle = __atomic_exchange_n(&buffer->middle, buffer->back | FRESH_BIT, __ATOMIC_ACQ_REL);
+    buffer->back = old_middle & INDEX_MASK;
+}
+
+//gives the consumer the most recently published snapshot, which it can keep
+//reading until the next call. is_new says if it changed since the last call.
+const void* triple_buffer_get_latest(triple_buffer_t* buffer, bool* is_new)
+{
+    *is_new = false;
+    if(__atomic_load_n(&buffer->middle, __ATOMIC_ACQUIRE) & FRESH_BIT)
+    {
+        uint32_t old_middle = __atomic_exchange_n(&buffer->middle, buffer->front, __ATOMIC_ACQ_REL);
+        buffer->front = old_middle & INDEX_MASK;
+        *is_new = true;
+    }
+    return buffer->buffers[buffer->front];
+}
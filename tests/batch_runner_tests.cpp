@@ -0,0 +1,157 @@
+#include "CppUTest/TestHarness.h"
+
+extern "C"
+{
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "batch_runner.h"
+#include "preprocessor_assembler.h"
+}
+
+static const char* MANIFEST_PATH = "batch_runner_tests.manifest";
+static const char* COUNTING_PATH = "batch_runner_tests_counting.bin";
+static const char* SPINNING_PATH = "batch_runner_tests_spinning.bin";
+
+TEST_GROUP(BATCH_RUNNER_TESTS)
+{
+
+    void setup(void)
+    {
+        const uint32_t counting[] = {
+            ADD_IMMEDIATE(R1, R1, 1),
+            STORER(R1, R0, 0x40),
+            JUMP(-3),
+        };
+        const uint32_t spinning[] = {
+            ADD_IMMEDIATE(R2, R2, 7),
+            HCF,
+        };
+        write_program(COUNTING_PATH, counting, sizeof(counting) / sizeof(counting[0]));
+        write_program(SPINNING_PATH, spinning, sizeof(spinning) / sizeof(spinning[0]));
+    }
+
+    void teardown(void)
+    {
+        remove(MANIFEST_PATH);
+        remove(COUNTING_PATH);
+        remove(SPINNING_PATH);
+    }
+
+    //program files are little-endian whatever the host is
+    void write_program(const char* path, const uint32_t* program, size_t num_words)
+    {
+        FILE* file = fopen(path, "wb");
+        for(size_t i = 0; i < num_words; i++)
+        {
+            for(int byte = 0; byte < 4; byte++)
+            {
+                fputc((program[i] >> (8 * byte)) & 0xFF, file);
+            }
+        }
+        fclose(file);
+    }
+
+    void write_manifest(const char* contents)
+    {
+        FILE* file = fopen(MANIFEST_PATH, "w");
+        fputs(contents, file);
+        fclose(file);
+    }
+
+    //runs the manifest and hands back everything it printed, which the
+    //caller has to free
+    char* run_manifest(unsigned num_threads, int* num_failed)
+    {
+        FILE* output = tmpfile();
+        CHECK(output != NULL);
+        *num_failed = run_batch(MANIFEST_PATH, num_threads, FAST_ENGINE, output);
+
+        long size = ftell(output);
+        char* printed = (char*)calloc((size_t)size + 1, 1);
+        rewind(output);
+        LONGS_EQUAL(size, (long)fread(printed, 1, (size_t)size, output));
+        fclose(output);
+        return printed;
+    }
+
+    //checks that a manifest made of just this line gets turned away before
+    //anything is run
+    void check_rejected(const char* line)
+    {
+        write_manifest(line);
+        int num_failed;
+        char* printed = run_manifest(1, &num_failed);
+        LONGS_EQUAL(-1, num_failed);
+        STRCMP_EQUAL("", printed);
+        free(printed);
+    }
+};
+
+
+TEST(BATCH_RUNNER_TESTS, malformed_lines_are_rejected)
+{
+    check_rejected("batch_runner_tests_counting.bin\n");
+    check_rejected("batch_runner_tests_counting.bin cycles\n");
+    check_rejected("batch_runner_tests_counting.bin seconds 100\n");
+    check_rejected("batch_runner_tests_counting.bin cycles lots\n");
+    check_rejected("batch_runner_tests_counting.bin cycles 100 colour red\n");
+}
+
+TEST(BATCH_RUNNER_TESTS, options_missing_their_arguments_are_rejected)
+{
+    check_rejected("batch_runner_tests_counting.bin cycles 100 frame\n");
+    check_rejected("batch_runner_tests_counting.bin cycles 100 input\n");
+    check_rejected("batch_runner_tests_counting.bin cycles 100 capture\n");
+    check_rejected("batch_runner_tests_counting.bin cycles 100 capture out.y4m\n");
+    check_rejected("batch_runner_tests_counting.bin cycles 100 capture out.y4m 0\n");
+    check_rejected("batch_runner_tests_counting.bin cycles 100 capture out.y4m often\n");
+}
+
+TEST(BATCH_RUNNER_TESTS, one_bad_line_rejects_the_whole_manifest)
+{
+    check_rejected("batch_runner_tests_counting.bin cycles 100\n"
+                   "batch_runner_tests_spinning.bin instructions\n");
+}
+
+TEST(BATCH_RUNNER_TESTS, blank_lines_and_comments_are_skipped)
+{
+    write_manifest("# a comment on its own\n"
+                   "\n"
+                   "batch_runner_tests_spinning.bin instructions 10   # and one after a job\n");
+    int num_failed;
+    char* printed = run_manifest(1, &num_failed);
+    LONGS_EQUAL(0, num_failed);
+    CHECK(NULL != strstr(printed, "path=batch_runner_tests_spinning.bin\n"));
+    CHECK(NULL != strstr(printed, "r2=0x00000007\n"));
+    free(printed);
+}
+
+TEST(BATCH_RUNNER_TESTS, jobs_that_cant_load_fail_on_their_own)
+{
+    write_manifest("no_such_program.bin cycles 100\n"
+                   "batch_runner_tests_spinning.bin cycles 100\n");
+    int num_failed;
+    char* printed = run_manifest(2, &num_failed);
+    LONGS_EQUAL(1, num_failed);
+    CHECK(NULL != strstr(printed, "path=no_such_program.bin\nerror=could not load program\n"));
+    CHECK(NULL != strstr(printed, "r2=0x00000007\n"));
+    free(printed);
+}
+
+TEST(BATCH_RUNNER_TESTS, output_does_not_depend_on_the_number_of_threads)
+{
+    write_manifest("batch_runner_tests_counting.bin cycles 50000\n"
+                   "batch_runner_tests_spinning.bin cycles 50000\n");
+    int num_failed;
+    char* one_thread = run_manifest(1, &num_failed);
+    LONGS_EQUAL(0, num_failed);
+    char* four_threads = run_manifest(4, &num_failed);
+    LONGS_EQUAL(0, num_failed);
+
+    //results come out in manifest order
+    CHECK(strstr(one_thread, COUNTING_PATH) < strstr(one_thread, SPINNING_PATH));
+    STRCMP_EQUAL(one_thread, four_threads);
+    free(one_thread);
+    free(four_threads);
+}
@@ -0,0 +1,241 @@
+#include "CppUTest/TestHarness.h"
+
+extern "C"
+{
+#include <stdio.h>
+#include "blitter.h"
+#include "graphics.h"
+#include "memory.h"
+#include "memory_bus.h"
+#include "memory_map.h"
+#include "scheduler.h"
+#include "interrupt_controller.h"
+}
+
+static const uint32_t INTERRUPT_ENABLE = 1u << 0;
+static const uint32_t DONE_FLAG = 1u << 1;
+static const uint32_t BUSY = 1u << 2;
+
+static const uint16_t SCREEN_WIDTH = 640;
+static const uint16_t SCREEN_HEIGHT = 480;
+static const uint32_t RED = 0xFF0000FF;
+static const uint32_t BLUE = 0x0000FFFF;
+static const uint32_t KEY = 0xFF00FFFF;
+
+blitter_t* blitter;
+graphics_t* blitter_screen;
+memory_t* blitter_RAM;
+memory_bus_t* blitter_bus;
+scheduler_t* blitter_scheduler;
+interrupt_controller_t* blitter_ic;
+
+TEST_GROUP(BLITTER_TESTS)
+{
+
+    void setup(void)
+    {
+        blitter_bus = make_memory_bus();
+        bus_map_device(blitter_bus, GRAPHICS_SELECTED, GRAPHICS_REGION_START, GRAPHICS_REGION_END);
+        bus_map_device(blitter_bus, BLITTER_SELECTED, BLITTER_REGION_START, BLITTER_REGION_END);
+        blitter_screen = create_headless_graphics_display(SCREEN_WIDTH, SCREEN_HEIGHT, GRAPHICS_REGION_START);
+        blitter_RAM = make_memory((size_t)1 << 32);
+        blitter_scheduler = make_scheduler();
+        blitter_ic = make_interrupt_controller(INTERRUPT_VECTOR_TABLE_START);
+        blitter = make_blitter(IRQ_3, blitter_screen, blitter_RAM, blitter_scheduler, blitter_ic);
+        blitter_reset(blitter);
+    }
+
+    void teardown(void)
+    {
+        destroy_blitter(blitter);
+        destroy_interrupt_controller(blitter_ic);
+        destroy_scheduler(blitter_scheduler);
+        destroy_memory(blitter_RAM);
+        graphics_destroy(blitter_screen);
+        destroy_memory_bus(blitter_bus);
+    }
+
+    uint32_t access_register(blitter_register_t reg, bool write, uint32_t value, uint64_t cycle)
+    {
+        bus_enable(blitter_bus);
+        bus_set_address_lines(blitter_bus, BLITTER_REGION_START + reg);
+        if(write)
+        {
+            bus_set_write_operation(blitter_bus);
+            bus_set_data_lines(blitter_bus, value);
+        }
+        else
+        {
+            bus_set_read_operation(blitter_bus);
+        }
+        bus_cycle(blitter_bus);
+        blitter_cycle(blitter, blitter_bus, cycle);
+        CHECK(bus_is_device_ready(blitter_bus));
+
+        value = bus_get_data_lines(blitter_bus);
+        bus_disable(blitter_bus);
+        bus_cycle(blitter_bus);
+        return value;
+    }
+
+    uint32_t read_register(blitter_register_t reg, uint64_t cycle)
+    {
+        return access_register(reg, false, 0, cycle);
+    }
+
+    void write_register(blitter_register_t reg, uint32_t value, uint64_t cycle)
+    {
+        access_register(reg, true, value, cycle);
+    }
+
+    uint32_t pixel_address(uint16_t x, uint16_t y)
+    {
+        return GRAPHICS_REGION_START + y * SCREEN_WIDTH + x;
+    }
+
+    uint32_t get_pixel(uint16_t x, uint16_t y)
+    {
+        uint32_t pixel = 0;
+        graphics_read_rect(blitter_screen, pixel_address(x, y), 1, 1, &pixel);
+        return pixel;
+    }
+
+    void run_command(blitter_command_t command, uint32_t source, uint32_t destination,
+                     uint16_t width, uint16_t height, uint32_t color, uint64_t cycle)
+    {
+        write_register(BLITTER_SOURCE_REGISTER, source, cycle);
+        write_register(BLITTER_DESTINATION_REGISTER, destination, cycle);
+        write_register(BLITTER_SIZE_REGISTER, width | ((uint32_t)height << 16), cycle);
+        write_register(BLITTER_COLOR_REGISTER, color, cycle);
+        write_register(BLITTER_COMMAND_REGISTER, command, cycle);
+    }
+};
+
+
+TEST(BLITTER_TESTS, fill_rect_fills_only_the_rectangle)
+{
+    run_command(BLITTER_FILL_RECT, 0, pixel_address(10, 20), 7, 3, RED, 0);
+
+    LONGS_EQUAL(RED, get_pixel(10, 20));
+    LONGS_EQUAL(RED, get_pixel(16, 22));
+    LONGS_EQUAL(0, get_pixel(9, 20));
+    LONGS_EQUAL(0, get_pixel(17, 20));
+    LONGS_EQUAL(0, get_pixel(10, 19));
+    LONGS_EQUAL(0, get_pixel(10, 23));
+}
+
+TEST(BLITTER_TESTS, rectangles_are_clipped_to_the_screen)
+{
+    run_command(BLITTER_FILL_RECT, 0, pixel_address(SCREEN_WIDTH - 2, SCREEN_HEIGHT - 1), 10, 10, RED, 0);
+
+    LONGS_EQUAL(RED, get_pixel(SCREEN_WIDTH - 1, SCREEN_HEIGHT - 1));
+    //nothing wrapped around onto the start of the next row
+    LONGS_EQUAL(0, get_pixel(0, SCREEN_HEIGHT - 1));
+}
+
+TEST(BLITTER_TESTS, copy_rect_copies_from_ram)
+{
+    //a 3x2 image packed into RAM
+    const uint32_t IMAGE = 0x00100000;
+    for(uint32_t i = 0; i < 6; i++)
+    {
+        memory_set(blitter_RAM, IMAGE + i, 0x01000000u * (i + 1));
+    }
+    run_command(BLITTER_COPY_RECT, IMAGE, pixel_address(100, 50), 3, 2, 0, 0);
+
+    LONGS_EQUAL(0x01000000, get_pixel(100, 50));
+    LONGS_EQUAL(0x03000000, get_pixel(102, 50));
+    LONGS_EQUAL(0x04000000, get_pixel(100, 51));
+    LONGS_EQUAL(0x06000000, get_pixel(102, 51));
+}
+
+TEST(BLITTER_TESTS, copy_rect_handles_overlapping_parts_of_the_screen)
+{
+    for(uint16_t x = 0; x < 8; x++)
+    {
+        graphics_update(blitter_screen, pixel_address(x, 0), x + 1);
+    }
+    //slide the row over to the right by 2 pixels
+    run_command(BLITTER_COPY_RECT, pixel_address(0, 0), pixel_address(2, 0), 8, 1, 0, 0);
+
+    LONGS_EQUAL(1, get_pixel(0, 0));
+    LONGS_EQUAL(2, get_pixel(1, 0));
+    for(uint16_t x = 0; x < 8; x++)
+    {
+        LONGS_EQUAL(x + 1, get_pixel(x + 2, 0));
+    }
+}
+
+TEST(BLITTER_TESTS, copies_are_clipped_to_the_edge_of_the_source)
+{
+    for(uint16_t y = 50; y < 53; y++)
+    {
+        for(uint16_t x = 100; x < 104; x++)
+        {
+            graphics_update(blitter_screen, pixel_address(x, y), BLUE);
+        }
+    }
+    graphics_update(blitter_screen, pixel_address(SCREEN_WIDTH - 2, SCREEN_HEIGHT - 1), RED);
+    graphics_update(blitter_screen, pixel_address(SCREEN_WIDTH - 1, SCREEN_HEIGHT - 1), RED);
+    //only the bottom right 2x1 corner of this source is on the screen
+    run_command(BLITTER_COPY_RECT, pixel_address(SCREEN_WIDTH - 2, SCREEN_HEIGHT - 1), pixel_address(100, 50), 4, 3, 0, 0);
+
+    LONGS_EQUAL(RED, get_pixel(100, 50));
+    LONGS_EQUAL(RED, get_pixel(101, 50));
+    LONGS_EQUAL(BLUE, get_pixel(102, 50));
+    LONGS_EQUAL(BLUE, get_pixel(103, 50));
+    LONGS_EQUAL(BLUE, get_pixel(100, 51));
+    LONGS_EQUAL(BLUE, get_pixel(103, 52));
+}
+
+TEST(BLITTER_TESTS, color_key_blit_leaves_key_colored_pixels_out)
+{
+    run_command(BLITTER_FILL_RECT, 0, pixel_address(0, 0), 9, 1, BLUE, 0);
+    scheduler_run_due_events(blitter_scheduler, 100);
+
+    //a sprite with holes in it, wide enough for the vectorized part
+    const uint32_t SPRITE = 0x00200000;
+    for(uint32_t i = 0; i < 9; i++)
+    {
+        memory_set(blitter_RAM, SPRITE + i, (i % 3 == 0) ? KEY : RED);
+    }
+    run_command(BLITTER_COLOR_KEY_BLIT, SPRITE, pixel_address(0, 0), 9, 1, KEY, 100);
+
+    for(uint16_t x = 0; x < 9; x++)
+    {
+        LONGS_EQUAL((x % 3 == 0) ? BLUE : RED, get_pixel(x, 0));
+    }
+}
+
+TEST(BLITTER_TESTS, stays_busy_until_done_and_then_interrupts)
+{
+    write_register(BLITTER_CONTROL_REGISTER, INTERRUPT_ENABLE, 0);
+    //8 cycles of setup plus 100 pixels at 4 pixels a cycle
+    run_command(BLITTER_FILL_RECT, 0, pixel_address(0, 0), 10, 10, RED, 1000);
+    LONGS_EQUAL(INTERRUPT_ENABLE | BUSY, read_register(BLITTER_CONTROL_REGISTER, 1000));
+    LONGS_EQUAL(1033, scheduler_next_event_cycle(blitter_scheduler));
+
+    scheduler_run_due_events(blitter_scheduler, 1032);
+    CHECK_FALSE(interrupt_requested(blitter_ic));
+    scheduler_run_due_events(blitter_scheduler, 1033);
+    CHECK(interrupt_requested(blitter_ic));
+    LONGS_EQUAL(IRQ_3, get_interrupt_source(blitter_ic));
+    LONGS_EQUAL(INTERRUPT_ENABLE | DONE_FLAG, read_register(BLITTER_CONTROL_REGISTER, 1033));
+
+    //and software clears the flag
+    write_register(BLITTER_CONTROL_REGISTER, INTERRUPT_ENABLE, 1034);
+    LONGS_EQUAL(INTERRUPT_ENABLE, read_register(BLITTER_CONTROL_REGISTER, 1034));
+}
+
+TEST(BLITTER_TESTS, commands_are_ignored_while_busy)
+{
+    run_command(BLITTER_FILL_RECT, 0, pixel_address(0, 0), 4, 1, RED, 0);
+    run_command(BLITTER_FILL_RECT, 0, pixel_address(0, 0), 4, 1, BLUE, 1);
+    LONGS_EQUAL(RED, get_pixel(0, 0));
+    LONGS_EQUAL(1, scheduler_num_events(blitter_scheduler));
+
+    scheduler_run_due_events(blitter_scheduler, 100);
+    CHECK_FALSE(interrupt_requested(blitter_ic));
+    run_command(BLITTER_FILL_RECT, 0, pixel_address(0, 0), 4, 1, BLUE, 100);
+    LONGS_EQUAL(BLUE, get_pixel(0, 0));
+}
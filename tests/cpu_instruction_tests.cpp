@@ -4,11 +4,13 @@
 extern "C"
 {
 #include <stdio.h>
+#include <string.h>
 #include "preprocessor_assembler.h"
 #include "memory_bus.h"
 #include "interrupt_controller.h"
 #include "cpu.h"
 #include "cpu_private.h"
+#include "cpu_ops.h"
 }
 
 //This file contains tests that will demonstrate that the CPU is executing
@@ -40,6 +42,12 @@ struct memory_bus_t
     selected_device_t selected_device;
     bool device_ready; //report back the status of devices that take multiple bus cycles
     bool bus_active;
+
+    //nothing is ever mapped, so the whole mock bus is memory
+    uint8_t* page_devices;
+    uint32_t num_mapped_pages;
+    void* devices;
+    size_t num_devices;
 };
 
 /* ******* END OF STRUCTS FOR MOCKING PURPOSES ******** */
@@ -57,6 +65,7 @@ void set_expected_instruction(memory_bus_t* fake_bus, uint32_t instruction)
 {
     fake_bus->data_lines = instruction;
     //make the CPU think that memory is ready and has returned the fetched instruction
+    fake_bus->bus_active = true;
     fake_bus->device_ready = true;
 }
 
@@ -81,7 +90,7 @@ uint32_t get_register_value(cpu_t* cpu, uint8_t register_name)
 
 TEST(CPU_INSTRUCTION_TESTS, cpu_test_helper_functions_working_correctly)
 {
-    memory_bus_t mock_bus;
+    memory_bus_t mock_bus = {};
     cpu_t* cpu = build_cpu(&mock_bus, ic);
 
     const uint32_t instruction = 0xAAAAAAAA; //not a real instruction encoding
@@ -137,7 +146,7 @@ const uint32_t ALL_ONES = ((uint32_t)(~0));
 
 TEST(CPU_INSTRUCTION_TESTS, AND_with_register_value_of_zero_yields_zero)
 {
-    memory_bus_t mock_bus;
+    memory_bus_t mock_bus = {};
     cpu_t* cpu = build_cpu(&mock_bus, ic);
 
     const zcpu_register_t DEST_REG    = { .name = R0, .value = INVALID_DATA };
@@ -156,7 +165,7 @@ TEST(CPU_INSTRUCTION_TESTS, AND_with_register_value_of_zero_yields_zero)
 
 TEST(CPU_INSTRUCTION_TESTS, AND_with_register_value_of_all_ones_yields_a_result_identical_to_the_value_of_the_other_register)
 {
-    memory_bus_t mock_bus;
+    memory_bus_t mock_bus = {};
     cpu_t* cpu = build_cpu(&mock_bus, ic);
 
     const zcpu_register_t DEST_REG    = { .name = R0, .value = INVALID_DATA };
@@ -175,7 +184,7 @@ TEST(CPU_INSTRUCTION_TESTS, AND_with_register_value_of_all_ones_yields_a_result_
 
 TEST(CPU_INSTRUCTION_TESTS, AND_with_bitmask_clears_the_desired_bits)
 {
-    memory_bus_t mock_bus;
+    memory_bus_t mock_bus = {};
     cpu_t* cpu = build_cpu(&mock_bus, ic);
 
     const zcpu_register_t DEST_REG    = { .name = R0, .value = INVALID_DATA };
@@ -194,7 +203,7 @@ TEST(CPU_INSTRUCTION_TESTS, AND_with_bitmask_clears_the_desired_bits)
 
 TEST(CPU_INSTRUCTION_TESTS, ANDING_a_register_with_itself_changes_nothing)
 {
-    memory_bus_t mock_bus;
+    memory_bus_t mock_bus = {};
     cpu_t* cpu = build_cpu(&mock_bus, ic);
 
     const zcpu_register_t DEST_REG    = { .name = R0, .value = INVALID_DATA };
@@ -213,7 +222,7 @@ TEST(CPU_INSTRUCTION_TESTS, ANDING_a_register_with_itself_changes_nothing)
 
 TEST(CPU_INSTRUCTION_TESTS, result_of_ANDING_two_registers_can_be_written_to_any_register)
 {
-    memory_bus_t mock_bus;
+    memory_bus_t mock_bus = {};
     cpu_t* cpu = build_cpu(&mock_bus, ic);
 
     const zcpu_register_t DEST_REG    = { .name = R31, .value = INVALID_DATA };
@@ -235,7 +244,7 @@ TEST(CPU_INSTRUCTION_TESTS, result_of_ANDING_two_registers_can_be_written_to_any
 
 TEST(CPU_INSTRUCTION_TESTS, OR_with_register_value_of_zero_yields_a_result_identical_to_the_value_of_the_other_register)
 {
-    memory_bus_t mock_bus;
+    memory_bus_t mock_bus = {};
     cpu_t* cpu = build_cpu(&mock_bus, ic);
 
     const zcpu_register_t DEST_REG    = { .name = R0, .value = INVALID_DATA };
@@ -254,7 +263,7 @@ TEST(CPU_INSTRUCTION_TESTS, OR_with_register_value_of_zero_yields_a_result_ident
 
 TEST(CPU_INSTRUCTION_TESTS, OR_with_register_value_of_all_ones_yields_all_ones)
 {
-    memory_bus_t mock_bus;
+    memory_bus_t mock_bus = {};
     cpu_t* cpu = build_cpu(&mock_bus, ic);
 
     const zcpu_register_t DEST_REG    = { .name = R0, .value = INVALID_DATA };
@@ -273,7 +282,7 @@ TEST(CPU_INSTRUCTION_TESTS, OR_with_register_value_of_all_ones_yields_all_ones)
 
 TEST(CPU_INSTRUCTION_TESTS, OR_with_bitmask_sets_the_desired_bits)
 {
-    memory_bus_t mock_bus;
+    memory_bus_t mock_bus = {};
     cpu_t* cpu = build_cpu(&mock_bus, ic);
 
     const zcpu_register_t DEST_REG    = { .name = R0, .value = INVALID_DATA };
@@ -292,7 +301,7 @@ TEST(CPU_INSTRUCTION_TESTS, OR_with_bitmask_sets_the_desired_bits)
 
 TEST(CPU_INSTRUCTION_TESTS, ORING_a_register_with_itself_changes_nothing)
 {
-    memory_bus_t mock_bus;
+    memory_bus_t mock_bus = {};
     cpu_t* cpu = build_cpu(&mock_bus, ic);
 
     const zcpu_register_t DEST_REG    = { .name = R0, .value = INVALID_DATA };
@@ -311,7 +320,7 @@ TEST(CPU_INSTRUCTION_TESTS, ORING_a_register_with_itself_changes_nothing)
 
 TEST(CPU_INSTRUCTION_TESTS, result_of_ORING_two_registers_can_be_written_to_any_register)
 {
-    memory_bus_t mock_bus;
+    memory_bus_t mock_bus = {};
     cpu_t* cpu = build_cpu(&mock_bus, ic);
 
     const zcpu_register_t DEST_REG    = { .name = R31, .value = INVALID_DATA };
@@ -334,7 +343,7 @@ TEST(CPU_INSTRUCTION_TESTS, result_of_ORING_two_registers_can_be_written_to_any_
 
 TEST(CPU_INSTRUCTION_TESTS, INVERTING_a_register_with_value_zero_yields_all_ones)
 {
-    memory_bus_t mock_bus;
+    memory_bus_t mock_bus = {};
     cpu_t* cpu = build_cpu(&mock_bus, ic);
 
     const uint8_t VALUE_UNUSED = 77;
@@ -354,7 +363,7 @@ TEST(CPU_INSTRUCTION_TESTS, INVERTING_a_register_with_value_zero_yields_all_ones
 
 TEST(CPU_INSTRUCTION_TESTS, INVERTING_a_register_with_value_all_ones_yields_zero)
 {
-    memory_bus_t mock_bus;
+    memory_bus_t mock_bus = {};
     cpu_t* cpu = build_cpu(&mock_bus, ic);
 
     const uint8_t VALUE_UNUSED = 77;
@@ -374,7 +383,7 @@ TEST(CPU_INSTRUCTION_TESTS, INVERTING_a_register_with_value_all_ones_yields_zero
 
 TEST(CPU_INSTRUCTION_TESTS, INVERTING_works_with_arbitrary_source_and_destination_registers)
 {
-    memory_bus_t mock_bus;
+    memory_bus_t mock_bus = {};
     cpu_t* cpu = build_cpu(&mock_bus, ic);
 
     const uint8_t VALUE_UNUSED = 77;
@@ -398,7 +407,7 @@ TEST(CPU_INSTRUCTION_TESTS, INVERTING_works_with_arbitrary_source_and_destinatio
 
 TEST(CPU_INSTRUCTION_TESTS, XORING_a_register_with_a_value_of_zero_yields_a_result_identical_to_the_value_of_the_other_register)
 {
-    memory_bus_t mock_bus;
+    memory_bus_t mock_bus = {};
     cpu_t* cpu = build_cpu(&mock_bus, ic);
 
     const zcpu_register_t DEST_REG    = { .name = R0, .value = INVALID_DATA };
@@ -417,7 +426,7 @@ TEST(CPU_INSTRUCTION_TESTS, XORING_a_register_with_a_value_of_zero_yields_a_resu
 
 TEST(CPU_INSTRUCTION_TESTS, XORING_a_register_with_a_value_of_all_ones_is_the_same_as_inverting_the_other_register)
 {
-    memory_bus_t mock_bus;
+    memory_bus_t mock_bus = {};
     cpu_t* cpu = build_cpu(&mock_bus, ic);
 
     const zcpu_register_t DEST_REG    = { .name = R0, .value = INVALID_DATA };
@@ -436,7 +445,7 @@ TEST(CPU_INSTRUCTION_TESTS, XORING_a_register_with_a_value_of_all_ones_is_the_sa
 
 TEST(CPU_INSTRUCTION_TESTS, XORING_works_correctly_with_arbitrary_values)
 {
-    memory_bus_t mock_bus;
+    memory_bus_t mock_bus = {};
     cpu_t* cpu = build_cpu(&mock_bus, ic);
 
     const zcpu_register_t DEST_REG    = { .name = R0, .value = INVALID_DATA };
@@ -455,7 +464,7 @@ TEST(CPU_INSTRUCTION_TESTS, XORING_works_correctly_with_arbitrary_values)
 
 TEST(CPU_INSTRUCTION_TESTS, XORING_works_with_arbitrary_source_and_destination_registers)
 {
-    memory_bus_t mock_bus;
+    memory_bus_t mock_bus = {};
     cpu_t* cpu = build_cpu(&mock_bus, ic);
 
     const zcpu_register_t DEST_REG    = { .name = R17, .value = INVALID_DATA };
@@ -477,7 +486,7 @@ TEST(CPU_INSTRUCTION_TESTS, XORING_works_with_arbitrary_source_and_destination_r
 
 TEST(CPU_INSTRUCTION_TESTS, ADDING_zero_to_a_register_changes_nothing)
 {
-    memory_bus_t mock_bus;
+    memory_bus_t mock_bus = {};
     cpu_t* cpu = build_cpu(&mock_bus, ic);
 
     const zcpu_register_t DEST_REG    = { .name = R0, .value = INVALID_DATA };
@@ -496,7 +505,7 @@ TEST(CPU_INSTRUCTION_TESTS, ADDING_zero_to_a_register_changes_nothing)
 
 TEST(CPU_INSTRUCTION_TESTS, ADDING_two_values_gives_the_expected_result)
 {
-    memory_bus_t mock_bus;
+    memory_bus_t mock_bus = {};
     cpu_t* cpu = build_cpu(&mock_bus, ic);
 
     const zcpu_register_t DEST_REG    = { .name = R0, .value = INVALID_DATA };
@@ -515,7 +524,7 @@ TEST(CPU_INSTRUCTION_TESTS, ADDING_two_values_gives_the_expected_result)
 
 TEST(CPU_INSTRUCTION_TESTS, ADDING_one_to_a_value_of_all_ones_overflows_and_yields_zero)
 {
-    memory_bus_t mock_bus;
+    memory_bus_t mock_bus = {};
     cpu_t* cpu = build_cpu(&mock_bus, ic);
 
     const zcpu_register_t DEST_REG    = { .name = R16, .value = INVALID_DATA };
@@ -534,7 +543,7 @@ TEST(CPU_INSTRUCTION_TESTS, ADDING_one_to_a_value_of_all_ones_overflows_and_yiel
 
 TEST(CPU_INSTRUCTION_TESTS, ADDING_negative_twos_complement_numbers_to_positive_values_works_properly)
 {
-    memory_bus_t mock_bus;
+    memory_bus_t mock_bus = {};
     cpu_t* cpu = build_cpu(&mock_bus, ic);
 
     const zcpu_register_t DEST_REG    = { .name = R16, .value = INVALID_DATA };
@@ -553,7 +562,7 @@ TEST(CPU_INSTRUCTION_TESTS, ADDING_negative_twos_complement_numbers_to_positive_
 
 TEST(CPU_INSTRUCTION_TESTS, ADDING_a_pair_of_twos_complement_negative_numbers_works_correctly)
 {
-    memory_bus_t mock_bus;
+    memory_bus_t mock_bus = {};
     cpu_t* cpu = build_cpu(&mock_bus, ic);
 
     const zcpu_register_t DEST_REG    = { .name = R16, .value = INVALID_DATA };
@@ -576,7 +585,7 @@ TEST(CPU_INSTRUCTION_TESTS, ADDING_a_pair_of_twos_complement_negative_numbers_wo
 
 TEST(CPU_INSTRUCTION_TESTS, SUBBING_zero_from_a_register_changes_nothing)
 {
-    memory_bus_t mock_bus;
+    memory_bus_t mock_bus = {};
     cpu_t* cpu = build_cpu(&mock_bus, ic);
 
     const zcpu_register_t DEST_REG    = { .name = R0, .value = INVALID_DATA };
@@ -595,7 +604,7 @@ TEST(CPU_INSTRUCTION_TESTS, SUBBING_zero_from_a_register_changes_nothing)
 
 TEST(CPU_INSTRUCTION_TESTS, SUBBING_one_from_zero_yields_all_ones)
 {
-    memory_bus_t mock_bus;
+    memory_bus_t mock_bus = {};
     cpu_t* cpu = build_cpu(&mock_bus, ic);
 
     const zcpu_register_t DEST_REG    = { .name = R0, .value = INVALID_DATA };
@@ -614,7 +623,7 @@ TEST(CPU_INSTRUCTION_TESTS, SUBBING_one_from_zero_yields_all_ones)
 
 TEST(CPU_INSTRUCTION_TESTS, SUBBING_a_register_from_itself_yields_zero)
 {
-    memory_bus_t mock_bus;
+    memory_bus_t mock_bus = {};
     cpu_t* cpu = build_cpu(&mock_bus, ic);
 
     const zcpu_register_t DEST_REG    = { .name = R16, .value = INVALID_DATA };
@@ -633,7 +642,7 @@ TEST(CPU_INSTRUCTION_TESTS, SUBBING_a_register_from_itself_yields_zero)
 
 TEST(CPU_INSTRUCTION_TESTS, SUBBING_a_twos_complement_negative_number_from_a_positive_number_is_the_same_as_adding)
 {
-    memory_bus_t mock_bus;
+    memory_bus_t mock_bus = {};
     cpu_t* cpu = build_cpu(&mock_bus, ic);
 
     const zcpu_register_t DEST_REG    = { .name = R16, .value = INVALID_DATA };
@@ -678,7 +687,7 @@ static void test_JUMP_instruction(cpu_t* cpu_to_test,
 //JUMP instruction tests
 TEST(CPU_INSTRUCTION_TESTS, JUMP_instructions_properly_handle_large_negative_offsets)
 {
-    memory_bus_t mock_bus;
+    memory_bus_t mock_bus = {};
     cpu_t* cpu = build_cpu(&mock_bus, ic);
 
     const uint32_t starting_addr = 0x000000FF;
@@ -692,7 +701,7 @@ TEST(CPU_INSTRUCTION_TESTS, JUMP_instructions_properly_handle_large_negative_off
 
 TEST(CPU_INSTRUCTION_TESTS, JUMP_instruction_with_offset_of_zero_leaves_the_program_counter_at_PC_plus_one)
 {
-    memory_bus_t mock_bus;
+    memory_bus_t mock_bus = {};
     cpu_t* cpu = build_cpu(&mock_bus, ic);
 
     const uint32_t starting_addr = 0x000000FF;
@@ -705,7 +714,7 @@ TEST(CPU_INSTRUCTION_TESTS, JUMP_instruction_with_offset_of_zero_leaves_the_prog
 
 TEST(CPU_INSTRUCTION_TESTS, JUMP_instructions_properly_handle_large_positive_offsets)
 {
-    memory_bus_t mock_bus;
+    memory_bus_t mock_bus = {};
     cpu_t* cpu = build_cpu(&mock_bus, ic);
 
     const uint32_t starting_addr = 0x000000FF;
@@ -735,7 +744,7 @@ static void test_JUMPR_instruction(cpu_t* cpu_to_test,
 
 TEST(CPU_INSTRUCTION_TESTS, JUMPR_instructions_properly_handle_large_negative_offsets)
 {
-    memory_bus_t mock_bus;
+    memory_bus_t mock_bus = {};
     cpu_t* cpu = build_cpu(&mock_bus, ic);
 
     const uint32_t starting_addr = 0x000000FF;
@@ -750,7 +759,7 @@ TEST(CPU_INSTRUCTION_TESTS, JUMPR_instructions_properly_handle_large_negative_of
 
 TEST(CPU_INSTRUCTION_TESTS, JUMPR_instruction_with_offset_of_zero_just_jumps_to_the_base_register_address)
 {
-    memory_bus_t mock_bus;
+    memory_bus_t mock_bus = {};
     cpu_t* cpu = build_cpu(&mock_bus, ic);
 
     const uint32_t starting_addr = 0x000000FF;
@@ -764,7 +773,7 @@ TEST(CPU_INSTRUCTION_TESTS, JUMPR_instruction_with_offset_of_zero_just_jumps_to_
 
 TEST(CPU_INSTRUCTION_TESTS, JUMPR_instructions_properly_handle_large_positive_offsets)
 {
-    memory_bus_t mock_bus;
+    memory_bus_t mock_bus = {};
     cpu_t* cpu = build_cpu(&mock_bus, ic);
 
     const uint32_t starting_addr = 0x000000FF;
@@ -779,7 +788,7 @@ TEST(CPU_INSTRUCTION_TESTS, JUMPR_instructions_properly_handle_large_positive_of
 
 TEST(CPU_INSTRUCTION_TESTS, JUMPR_instructions_works_with_other_registers)
 {
-    memory_bus_t mock_bus;
+    memory_bus_t mock_bus = {};
     cpu_t* cpu = build_cpu(&mock_bus, ic);
 
     const uint32_t starting_addr = 0x000000FF;
@@ -790,3 +799,600 @@ TEST(CPU_INSTRUCTION_TESTS, JUMPR_instructions_works_with_other_registers)
 
     test_JUMPR_instruction(cpu, &mock_bus, base_register, instruction, starting_addr, expected_ending_address);
 }
+
+//DECODED INSTRUCTION CACHE TESTS
+
+//runs the interrupt stage without clocking the bus (so that the fake bus stays
+//ready), then executes the given instruction as if it were fetched from the
+//given address
+static void execute_instruction_at(cpu_t* cpu, memory_bus_t* fake_bus, uint32_t address, uint32_t instruction)
+{
+    set_PC(cpu, address);
+    cpu_cycle(cpu);
+    set_expected_instruction(fake_bus, instruction);
+    single_step(cpu, fake_bus);
+}
+
+TEST(CPU_INSTRUCTION_TESTS, re_executing_an_instruction_from_the_same_address_gives_the_same_result)
+{
+    memory_bus_t mock_bus = {};
+    cpu_t* cpu = build_cpu(&mock_bus, ic);
+
+    const uint32_t starting_addr = 0x00000040;
+    set_register_value(cpu, R3, 0x00000010);
+
+    execute_instruction_at(cpu, &mock_bus, starting_addr, ADD_IMMEDIATE(R3, R3, 5));
+    LONGS_EQUAL(0x00000015, get_register_value(cpu, R3));
+
+    execute_instruction_at(cpu, &mock_bus, starting_addr, ADD_IMMEDIATE(R3, R3, 5));
+    LONGS_EQUAL(0x0000001A, get_register_value(cpu, R3));
+}
+
+TEST(CPU_INSTRUCTION_TESTS, flushing_the_decoded_instructions_picks_up_new_code_at_the_same_address)
+{
+    memory_bus_t mock_bus = {};
+    cpu_t* cpu = build_cpu(&mock_bus, ic);
+
+    const uint32_t starting_addr = 0x00000040;
+    set_register_value(cpu, R3, 0x00000010);
+
+    execute_instruction_at(cpu, &mock_bus, starting_addr, ADD_IMMEDIATE(R3, R3, 5));
+    LONGS_EQUAL(0x00000015, get_register_value(cpu, R3));
+
+    cpu_flush_decoded_instructions(cpu);
+    execute_instruction_at(cpu, &mock_bus, starting_addr, SUB_IMMEDIATE(R3, R3, 5));
+    LONGS_EQUAL(0x00000010, get_register_value(cpu, R3));
+}
+
+//MULTIPLE INSTANCE TESTS
+
+TEST(CPU_INSTRUCTION_TESTS, cpus_that_are_clocked_in_lockstep_do_not_share_pipeline_state)
+{
+    memory_bus_t mock_bus1 = {};
+    memory_bus_t mock_bus2 = {};
+    cpu_t* cpu1 = build_cpu(&mock_bus1, ic);
+    cpu_t* cpu2 = build_cpu(&mock_bus2, ic);
+    set_register_value(cpu1, R3, 0x10);
+    set_register_value(cpu2, R3, 0x20);
+
+    cpu_cycle(cpu1);
+    cpu_cycle(cpu2);
+    set_expected_instruction(&mock_bus1, ADD_IMMEDIATE(R3, R3, 5));
+    set_expected_instruction(&mock_bus2, SUB_IMMEDIATE(R3, R3, 5));
+    while(!cpu_completed_instruction(cpu1) || !cpu_completed_instruction(cpu2))
+    {
+        if(!cpu_completed_instruction(cpu1))
+        {
+            cpu_cycle(cpu1);
+            bus_cycle(&mock_bus1);
+        }
+        if(!cpu_completed_instruction(cpu2))
+        {
+            cpu_cycle(cpu2);
+            bus_cycle(&mock_bus2);
+        }
+    }
+
+    LONGS_EQUAL(0x15, get_register_value(cpu1, R3));
+    LONGS_EQUAL(0x1B, get_register_value(cpu2, R3));
+    destroy_cpu(cpu1);
+    destroy_cpu(cpu2);
+}
+
+//CONDITION CODE TESTS
+
+TEST(CPU_INSTRUCTION_TESTS, condition_codes_reflect_the_last_ALU_result)
+{
+    memory_bus_t mock_bus = {};
+    cpu_t* cpu = build_cpu(&mock_bus, ic);
+
+    execute_instruction_at(cpu, &mock_bus, 0x40, SUB_IMMEDIATE(R3, R0, 1));
+    LONGS_EQUAL(0x4, get_condition_code_register(cpu));
+
+    execute_instruction_at(cpu, &mock_bus, 0x41, ADD_IMMEDIATE(R3, R3, 1));
+    LONGS_EQUAL(0x2, get_condition_code_register(cpu));
+
+    execute_instruction_at(cpu, &mock_bus, 0x42, ADD_IMMEDIATE(R3, R3, 1));
+    LONGS_EQUAL(0x1, get_condition_code_register(cpu));
+}
+
+TEST(CPU_INSTRUCTION_TESTS, branches_only_see_the_condition_codes_of_the_last_ALU_operation)
+{
+    memory_bus_t mock_bus = {};
+    cpu_t* cpu = build_cpu(&mock_bus, ic);
+
+    execute_instruction_at(cpu, &mock_bus, 0x40, SUB_IMMEDIATE(R3, R0, 1));
+    execute_instruction_at(cpu, &mock_bus, 0x41, ADD_IMMEDIATE(R3, R0, 0));
+    execute_instruction_at(cpu, &mock_bus, 0x42, BRN(5));
+    LONGS_EQUAL(0x43, get_PC(cpu));
+
+    execute_instruction_at(cpu, &mock_bus, 0x43, BRZ(5));
+    LONGS_EQUAL(0x49, get_PC(cpu));
+}
+
+//TRANSLATED CODE TESTS
+
+//a plain array of RAM (exactly one page) for the fast engines' memory port
+static uint32_t fake_ram[CPU_PAGE_WORDS];
+static uint32_t fake_ram_port_accesses;
+static uint32_t fake_ram_translations;
+
+static uint32_t read_fake_ram(void* context, uint32_t address)
+{
+    (void)context;
+    fake_ram_port_accesses++;
+    return fake_ram[address % CPU_PAGE_WORDS];
+}
+
+static void write_fake_ram(void* context, uint32_t address, uint32_t value)
+{
+    (void)context;
+    fake_ram_port_accesses++;
+    fake_ram[address % CPU_PAGE_WORDS] = value;
+}
+
+static uint32_t* map_fake_ram(void* context, uint32_t address)
+{
+    (void)context;
+    fake_ram_translations++;
+    return (address < CPU_PAGE_WORDS) ? fake_ram : NULL;
+}
+
+static uint32_t* map_nothing(void* context, uint32_t address)
+{
+    (void)context;
+    (void)address;
+    fake_ram_translations++;
+    return NULL;
+}
+
+static cpu_t* build_cpu_with_fake_ram(memory_bus_t* bus, interrupt_controller_t* ic, const uint32_t* program, size_t program_length,
+                                      cpu_memory_translate_t translate = NULL)
+{
+    cpu_t* cpu = build_cpu(bus, ic);
+    memset(fake_ram, 0x00, sizeof(fake_ram));
+    memcpy(fake_ram, program, program_length * sizeof(uint32_t));
+    fake_ram_port_accesses = 0;
+    fake_ram_translations = 0;
+    cpu_attach_memory_port(cpu, &read_fake_ram, &write_fake_ram, translate, NULL);
+    return cpu;
+}
+
+TEST(CPU_INSTRUCTION_TESTS, translated_code_runs_loops_the_same_way_as_the_interpreter)
+{
+    const uint32_t program[] = {
+        LOAD(R1, 5),                //R1 = 5
+        ADD(R2, R2, R1),            //R2 += R1
+        STORER(R2, R1, 0x20),       //mem[0x20 + R1] = R2
+        ADD_IMMEDIATE(R1, R1, -1),
+        BRP(-4),
+        JUMP(-1),                   //spin forever
+        5,
+    };
+    memory_bus_t mock_bus = {};
+    cpu_t* interpreted = build_cpu_with_fake_ram(&mock_bus, ic, program, sizeof(program) / sizeof(program[0]));
+    cpu_run(interpreted, 500);
+    uint32_t interpreted_sum = get_register_value(interpreted, R2);
+    uint32_t interpreted_store = fake_ram[0x21];
+
+    cpu_t* translated = build_cpu_with_fake_ram(&mock_bus, ic, program, sizeof(program) / sizeof(program[0]));
+    cpu_run_translated(translated, 500);
+
+    LONGS_EQUAL(15, interpreted_sum);
+    LONGS_EQUAL(interpreted_sum, get_register_value(translated, R2));
+    LONGS_EQUAL(interpreted_store, fake_ram[0x21]);
+    LONGS_EQUAL(0, get_register_value(translated, R1));
+    LONGS_EQUAL(get_PC(interpreted), get_PC(translated));
+    destroy_cpu(interpreted);
+    destroy_cpu(translated);
+}
+
+TEST(CPU_INSTRUCTION_TESTS, stores_over_translated_code_are_picked_up_by_later_runs)
+{
+    const uint32_t program[] = {
+        ADD_IMMEDIATE(R3, R3, 1),   //gets overwritten by the store on the first pass
+        STORE(R4, -2),
+        JUMP(-3),
+    };
+    memory_bus_t mock_bus = {};
+    cpu_t* cpu = build_cpu_with_fake_ram(&mock_bus, ic, program, sizeof(program) / sizeof(program[0]));
+    set_register_value(cpu, R4, ADD_IMMEDIATE(R3, R3, 5));
+
+    cpu_run_translated(cpu, 1);
+    LONGS_EQUAL(1, get_register_value(cpu, R3));
+    LONGS_EQUAL(ADD_IMMEDIATE(R3, R3, 5), fake_ram[0]);
+
+    //back around the loop, which has to run the new instruction
+    cpu_run_translated(cpu, 1);
+    cpu_run_translated(cpu, 1);
+    LONGS_EQUAL(6, get_register_value(cpu, R3));
+    destroy_cpu(cpu);
+}
+
+//FAST ENGINE MEMORY ACCESS TESTS
+
+TEST(CPU_INSTRUCTION_TESTS, mapped_ram_is_accessed_without_the_memory_port)
+{
+    const uint32_t program[] = {
+        LOAD(R1, 5),                //R1 = 5
+        ADD(R2, R2, R1),            //R2 += R1
+        STORER(R2, R1, 0x20),       //mem[0x20 + R1] = R2
+        ADD_IMMEDIATE(R1, R1, -1),
+        BRP(-4),
+        JUMP(-1),                   //spin forever
+        5,
+    };
+    memory_bus_t mock_bus = {};
+    cpu_t* cpu = build_cpu_with_fake_ram(&mock_bus, ic, program, sizeof(program) / sizeof(program[0]), &map_fake_ram);
+    cpu_run(cpu, 500);
+
+    LONGS_EQUAL(15, get_register_value(cpu, R2));
+    LONGS_EQUAL(15, fake_ram[0x21]);
+    LONGS_EQUAL(0, fake_ram_port_accesses);
+    LONGS_EQUAL(1, fake_ram_translations);
+    destroy_cpu(cpu);
+}
+
+TEST(CPU_INSTRUCTION_TESTS, device_pages_always_use_the_memory_port)
+{
+    const uint32_t program[] = {
+        LOAD(R1, 1),
+        JUMP(-1),                   //spin forever
+        7,
+    };
+    memory_bus_t mock_bus = {};
+    cpu_t* cpu = build_cpu_with_fake_ram(&mock_bus, ic, program, sizeof(program) / sizeof(program[0]), &map_nothing);
+    cpu_run(cpu, 500);
+
+    LONGS_EQUAL(7, get_register_value(cpu, R1));
+    CHECK(fake_ram_port_accesses > 0);
+
+    //the page is remembered as a device page rather than being looked up again
+    LONGS_EQUAL(1, fake_ram_translations);
+    destroy_cpu(cpu);
+}
+
+TEST(CPU_INSTRUCTION_TESTS, translated_code_uses_mapped_ram_too)
+{
+    const uint32_t program[] = {
+        ADD_IMMEDIATE(R3, R3, 1),   //gets overwritten by the store on the first pass
+        STORE(R4, -2),
+        JUMP(-3),
+    };
+    memory_bus_t mock_bus = {};
+    cpu_t* cpu = build_cpu_with_fake_ram(&mock_bus, ic, program, sizeof(program) / sizeof(program[0]), &map_fake_ram);
+    set_register_value(cpu, R4, ADD_IMMEDIATE(R3, R3, 5));
+
+    cpu_run_translated(cpu, 1);
+    cpu_run_translated(cpu, 1);
+    cpu_run_translated(cpu, 1);
+    LONGS_EQUAL(6, get_register_value(cpu, R3));
+    LONGS_EQUAL(0, fake_ram_port_accesses);
+    destroy_cpu(cpu);
+}
+
+//IDLE LOOP TESTS
+
+//runs the fast engine for a while and then asks it if the program is idle
+static uint32_t check_for_idle_loop_after_running(cpu_t* cpu, bool translated)
+{
+    uint32_t cycles_run = 0;
+    for(int i = 0; i < 2; i++)
+    {
+        translated ? cpu_run_translated(cpu, 1000) : cpu_run(cpu, 1000);
+        uint32_t trip_cycles = cpu_check_for_idle_loop(cpu, 1000, &cycles_run);
+        if(0 != trip_cycles)
+        {
+            return trip_cycles;
+        }
+    }
+    return 0;
+}
+
+TEST(CPU_INSTRUCTION_TESTS, spinning_in_place_is_idle)
+{
+    const uint32_t program[] = {
+        ADD_IMMEDIATE(R1, R1, 3),
+        HCF,
+    };
+    memory_bus_t mock_bus = {};
+    cpu_t* cpu = build_cpu_with_fake_ram(&mock_bus, ic, program, sizeof(program) / sizeof(program[0]), &map_fake_ram);
+
+    LONGS_EQUAL(6, check_for_idle_loop_after_running(cpu, false));
+    LONGS_EQUAL(1, get_PC(cpu));
+    LONGS_EQUAL(3, get_register_value(cpu, R1));
+    destroy_cpu(cpu);
+}
+
+TEST(CPU_INSTRUCTION_TESTS, polling_a_value_that_never_changes_is_idle_in_both_fast_engines)
+{
+    const uint32_t program[] = {
+        LOADA(R5, 3),               //R5 = address of the flag
+        LOADR(R1, R5, 0),
+        AND_IMMEDIATE(R2, R1, 1),
+        BRZ(-3),
+        0,                          //the flag
+    };
+    memory_bus_t mock_bus = {};
+    cpu_t* interpreted = build_cpu_with_fake_ram(&mock_bus, ic, program, sizeof(program) / sizeof(program[0]), &map_fake_ram);
+    LONGS_EQUAL(21, check_for_idle_loop_after_running(interpreted, false));
+    LONGS_EQUAL(1, get_PC(interpreted));
+
+    cpu_t* translated = build_cpu_with_fake_ram(&mock_bus, ic, program, sizeof(program) / sizeof(program[0]), &map_fake_ram);
+    LONGS_EQUAL(21, check_for_idle_loop_after_running(translated, true));
+    LONGS_EQUAL(1, get_PC(translated));
+    destroy_cpu(interpreted);
+    destroy_cpu(translated);
+}
+
+TEST(CPU_INSTRUCTION_TESTS, loops_that_carry_anything_over_to_the_next_trip_are_not_idle)
+{
+    const uint32_t counting_loop[] = {
+        ADD_IMMEDIATE(R1, R1, 1),
+        AND_IMMEDIATE(R1, R1, 0),   //puts R1 back the way it was
+        BRNZP(-3),
+    };
+    const uint32_t storing_loop[] = {
+        STORER(R1, R0, 0x20),
+        BRNZP(-2),
+    };
+    memory_bus_t mock_bus = {};
+    cpu_t* cpu = build_cpu_with_fake_ram(&mock_bus, ic, counting_loop, sizeof(counting_loop) / sizeof(counting_loop[0]), &map_fake_ram);
+    LONGS_EQUAL(0, check_for_idle_loop_after_running(cpu, false));
+    destroy_cpu(cpu);
+
+    cpu = build_cpu_with_fake_ram(&mock_bus, ic, storing_loop, sizeof(storing_loop) / sizeof(storing_loop[0]), &map_fake_ram);
+    LONGS_EQUAL(0, check_for_idle_loop_after_running(cpu, false));
+    destroy_cpu(cpu);
+}
+
+TEST(CPU_INSTRUCTION_TESTS, polling_a_device_is_not_idle)
+{
+    //everything past the first page goes through the memory port, the way
+    //the timer's value register would, so it can change without a store
+    const uint32_t DEVICE_REGISTER = CPU_PAGE_WORDS + 0x20;
+    const uint32_t pc_relative_poll[] = {
+        LOAD(R1, DEVICE_REGISTER - 1),
+        AND_IMMEDIATE(R2, R1, 1),
+        BRZ(-3),
+    };
+    const uint32_t base_plus_offset_poll[] = {
+        LOADR(R1, R5, 0x20),
+        AND_IMMEDIATE(R2, R1, 1),
+        BRZ(-3),
+    };
+    memory_bus_t mock_bus = {};
+    cpu_t* cpu = build_cpu_with_fake_ram(&mock_bus, ic, pc_relative_poll, sizeof(pc_relative_poll) / sizeof(pc_relative_poll[0]), &map_fake_ram);
+    LONGS_EQUAL(0, check_for_idle_loop_after_running(cpu, false));
+    LONGS_EQUAL(0, check_for_idle_loop_after_running(cpu, true));
+    CHECK(fake_ram_port_accesses > 0);
+    destroy_cpu(cpu);
+
+    cpu = build_cpu_with_fake_ram(&mock_bus, ic, base_plus_offset_poll, sizeof(base_plus_offset_poll) / sizeof(base_plus_offset_poll[0]), &map_fake_ram);
+    set_register_value(cpu, R5, CPU_PAGE_WORDS);
+    LONGS_EQUAL(0, check_for_idle_loop_after_running(cpu, false));
+    LONGS_EQUAL(0, check_for_idle_loop_after_running(cpu, true));
+    CHECK(fake_ram_port_accesses > 0);
+    destroy_cpu(cpu);
+}
+
+TEST(CPU_INSTRUCTION_TESTS, checking_for_an_idle_loop_stays_within_the_cycle_limit)
+{
+    const uint32_t program[] = {
+        LOADA(R5, 3),
+        LOADR(R1, R5, 0),
+        AND_IMMEDIATE(R2, R1, 1),
+        BRZ(-3),
+        0,
+    };
+    memory_bus_t mock_bus = {};
+    cpu_t* cpu = build_cpu_with_fake_ram(&mock_bus, ic, program, sizeof(program) / sizeof(program[0]), &map_fake_ram);
+    cpu_run(cpu, 1000);
+    uint32_t cycles_run = 0;
+    cpu_check_for_idle_loop(cpu, 20, &cycles_run);
+    cpu_run(cpu, 1000);
+
+    LONGS_EQUAL(0, cpu_check_for_idle_loop(cpu, 20, &cycles_run));
+    CHECK(cycles_run <= 20);
+    destroy_cpu(cpu);
+}
+
+//WAIT FOR INTERRUPT TESTS
+
+TEST(CPU_INSTRUCTION_TESTS, WFI_halts_both_fast_engines_for_the_rest_of_the_run)
+{
+    const uint32_t program[] = {
+        ADD_IMMEDIATE(R1, R1, 1),
+        WFI,
+        ADD_IMMEDIATE(R1, R1, 1),
+        HCF,
+    };
+    memory_bus_t mock_bus = {};
+    cpu_t* interpreted = build_cpu_with_fake_ram(&mock_bus, ic, program, sizeof(program) / sizeof(program[0]), &map_fake_ram);
+    cpu_t* translated = build_cpu_with_fake_ram(&mock_bus, ic, program, sizeof(program) / sizeof(program[0]), &map_fake_ram);
+
+    LONGS_EQUAL(1000, cpu_run(interpreted, 1000));
+    LONGS_EQUAL(1000, cpu_run_translated(translated, 1000));
+    LONGS_EQUAL(5000, cpu_run(interpreted, 5000));
+    LONGS_EQUAL(5000, cpu_run_translated(translated, 5000));
+
+    CHECK(cpu_waiting_for_interrupt(interpreted));
+    CHECK(cpu_waiting_for_interrupt(translated));
+    LONGS_EQUAL(1, get_register_value(interpreted, R1));
+    LONGS_EQUAL(1, get_register_value(translated, R1));
+    LONGS_EQUAL(2, get_PC(interpreted));
+    LONGS_EQUAL(2, get_PC(translated));
+    destroy_cpu(interpreted);
+    destroy_cpu(translated);
+}
+
+TEST(CPU_INSTRUCTION_TESTS, requesting_an_interrupt_wakes_up_a_halted_cpu)
+{
+    //the interrupt vector table starts at 0, so IRQ_1 goes to address 1
+    const uint32_t program[] = {
+        JUMP(3),
+        JUMP(5),                    //IRQ_1
+        0,
+        0,
+        WFI,
+        ADD_IMMEDIATE(R1, R1, 1),
+        HCF,
+        ADD_IMMEDIATE(R1, R1, 100), //the IRQ_1 handler
+        STORE(R1, 0x10),
+        RETURNI,
+    };
+    memory_bus_t mock_bus = {};
+    cpu_t* cpu = build_cpu_with_fake_ram(&mock_bus, ic, program, sizeof(program) / sizeof(program[0]), &map_fake_ram);
+    cpu_run(cpu, 100);
+    CHECK(cpu_waiting_for_interrupt(cpu));
+    LONGS_EQUAL(5, get_PC(cpu));
+
+    request_interrupt(ic, IRQ_1);
+    cpu_run(cpu, 0);
+    CHECK_FALSE(cpu_waiting_for_interrupt(cpu));
+    CHECK(interrupt_in_process(cpu));
+    LONGS_EQUAL(1, get_PC(cpu));
+
+    //the handler returns to the instruction after the WFI
+    cpu_run(cpu, 200);
+    LONGS_EQUAL(100, fake_ram[0x19]);
+    CHECK_FALSE(interrupt_in_process(cpu));
+    LONGS_EQUAL(1, get_register_value(cpu, R1));
+    LONGS_EQUAL(6, get_PC(cpu));
+    destroy_cpu(cpu);
+}
+
+TEST(CPU_INSTRUCTION_TESTS, WFI_in_a_handler_carries_on_when_the_interrupt_cant_be_taken)
+{
+    const uint32_t program[] = {
+        WFI,
+        ADD_IMMEDIATE(R1, R1, 1),
+        HCF,
+        JUMP(6),                    //IRQ_3
+        0,
+        0,
+        0,
+        0,
+        JUMP(5),                    //IRQ_8
+        0,
+        WFI,                        //the IRQ_3 handler
+        ADD_IMMEDIATE(R2, R2, 1),
+        STORE(R2, 0x20),
+        RETURNI,
+        ADD_IMMEDIATE(R3, R3, 1),   //the IRQ_8 handler
+        STORE(R3, 0x20),
+        RETURNI,
+    };
+    memory_bus_t mock_bus = {};
+    cpu_t* cpu = build_cpu_with_fake_ram(&mock_bus, ic, program, sizeof(program) / sizeof(program[0]), &map_fake_ram);
+    cpu_run(cpu, 100);
+    request_interrupt(ic, IRQ_3);
+    cpu_run(cpu, 100);
+    CHECK(cpu_waiting_for_interrupt(cpu));
+    LONGS_EQUAL(11, get_PC(cpu));
+
+    //IRQ_8 can't interrupt the IRQ_3 handler, so the cpu wakes up and
+    //carries on with it, and IRQ_8 is only taken once it has returned
+    request_interrupt(ic, IRQ_8);
+    cpu_run(cpu, 6);
+    CHECK_FALSE(cpu_waiting_for_interrupt(cpu));
+    LONGS_EQUAL(12, get_PC(cpu));
+    LONGS_EQUAL(0, fake_ram[0x30]);
+
+    cpu_run(cpu, 200);
+    LONGS_EQUAL(1, fake_ram[0x2D]);
+    LONGS_EQUAL(1, fake_ram[0x30]);
+    CHECK_FALSE(interrupt_in_process(cpu));
+    LONGS_EQUAL(1, get_register_value(cpu, R1));
+    LONGS_EQUAL(2, get_PC(cpu));
+    destroy_cpu(cpu);
+}
+
+//INTERRUPT TESTS
+
+typedef uint32_t (*cpu_runner_t)(cpu_t* cpu, uint32_t cycle_budget);
+static const cpu_runner_t cpu_runners[] = { &cpu_run, &cpu_run_translated };
+
+TEST(CPU_INSTRUCTION_TESTS, returning_from_an_interrupt_switches_back_to_the_interrupted_registers)
+{
+    //the interrupt vector table starts at 0, so IRQ_5 goes to address 5
+    const uint32_t program[] = {
+        WFI,
+        ADD_IMMEDIATE(R1, R1, 1),
+        HCF,
+        0,
+        0,
+        ADD_IMMEDIATE(R1, R1, 100),
+        STORE(R1, 0x10),
+        RETURNI,
+    };
+
+    for(size_t i = 0; i < sizeof(cpu_runners) / sizeof(cpu_runners[0]); i++)
+    {
+        memory_bus_t mock_bus = {};
+        cpu_t* cpu = build_cpu_with_fake_ram(&mock_bus, ic, program, sizeof(program) / sizeof(program[0]), &map_fake_ram);
+        cpu_runners[i](cpu, 100);
+        request_interrupt(ic, IRQ_5);
+        cpu_runners[i](cpu, 200);
+
+        LONGS_EQUAL(100, fake_ram[0x17]);
+        LONGS_EQUAL(1, get_register_value(cpu, R1));
+        LONGS_EQUAL(2, get_PC(cpu));
+        CHECK_FALSE(interrupt_in_process(cpu));
+        destroy_cpu(cpu);
+    }
+}
+
+TEST(CPU_INSTRUCTION_TESTS, only_a_more_urgent_interrupt_can_interrupt_a_handler)
+{
+    const uint32_t program[] = {
+        WFI,
+        ADD_IMMEDIATE(R1, R1, 1),
+        HCF,
+        ADD_IMMEDIATE(R2, R2, 50),  //IRQ_3
+        STORE(R2, 0x20),
+        RETURNI,
+        0,
+        0,
+        ADD_IMMEDIATE(R2, R2, 1),   //IRQ_8
+        WFI,
+        STORE(R2, 0x10),
+        RETURNI,
+    };
+
+    for(size_t i = 0; i < sizeof(cpu_runners) / sizeof(cpu_runners[0]); i++)
+    {
+        memory_bus_t mock_bus = {};
+        cpu_t* cpu = build_cpu_with_fake_ram(&mock_bus, ic, program, sizeof(program) / sizeof(program[0]), &map_fake_ram);
+        cpu_runners[i](cpu, 100);
+        request_interrupt(ic, IRQ_8);
+        cpu_runners[i](cpu, 100);
+        CHECK(cpu_waiting_for_interrupt(cpu));
+        LONGS_EQUAL(10, get_PC(cpu));
+
+        //IRQ_3 interrupts the IRQ_8 handler and starts out with its registers
+        request_interrupt(ic, IRQ_3);
+        cpu_runners[i](cpu, 200);
+        LONGS_EQUAL(51, fake_ram[0x25]);
+        LONGS_EQUAL(1, fake_ram[0x1B]);
+        LONGS_EQUAL(0, get_register_value(cpu, R2));
+        LONGS_EQUAL(1, get_register_value(cpu, R1));
+
+        //when both are requested at once IRQ_3 goes first, then the IRQ_8
+        //handler gets to run and halts again
+        memset(&fake_ram[0x10], 0x00, 0x20 * sizeof(uint32_t));
+        request_interrupt(ic, IRQ_8);
+        request_interrupt(ic, IRQ_3);
+        cpu_runners[i](cpu, 200);
+        LONGS_EQUAL(50, fake_ram[0x25]);
+        CHECK(cpu_waiting_for_interrupt(cpu));
+        LONGS_EQUAL(10, get_PC(cpu));
+
+        //IRQ_8 isn't more urgent than itself, so asking for it again wakes
+        //the handler up without interrupting it
+        request_interrupt(ic, IRQ_8);
+        cpu_runners[i](cpu, 12);
+        LONGS_EQUAL(1, fake_ram[0x1B]);
+        destroy_cpu(cpu);
+    }
+}
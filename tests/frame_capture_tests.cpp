@@ -0,0 +1,168 @@
+#include "CppUTest/TestHarness.h"
+
+extern "C"
+{
+#include <stdio.h>
+#include <string.h>
+#include "frame_capture.h"
+}
+
+static const uint16_t CAPTURE_WIDTH = 13;   //not a multiple of the SIMD width
+static const uint16_t CAPTURE_HEIGHT = 3;
+static const size_t CAPTURE_PIXELS = CAPTURE_WIDTH * CAPTURE_HEIGHT;
+static const char* Y4M_PATH = "frame_capture_tests.y4m";
+static const char* RAW_PATH = "frame_capture_tests.raw";
+
+uint32_t capture_pixels[CAPTURE_PIXELS];
+uint64_t capture_row_sequence[CAPTURE_HEIGHT];
+graphics_frame_t capture_frame;
+uint8_t capture_file[4096];
+
+TEST_GROUP(FRAME_CAPTURE_TESTS)
+{
+
+    void setup(void)
+    {
+        memset(capture_pixels, 0, sizeof(capture_pixels));
+        capture_frame.width = CAPTURE_WIDTH;
+        capture_frame.height = CAPTURE_HEIGHT;
+        capture_frame.sequence = 0;
+        capture_frame.row_sequence = capture_row_sequence;
+        capture_frame.pixels = capture_pixels;
+        next_frame();
+        for(uint16_t row = 0; row < CAPTURE_HEIGHT; row++)
+        {
+            capture_row_sequence[row] = capture_frame.sequence;
+        }
+    }
+
+    void teardown(void)
+    {
+        remove(Y4M_PATH);
+        remove(RAW_PATH);
+    }
+
+    void next_frame(void)
+    {
+        capture_frame.sequence++;
+    }
+
+    void set_pixel(size_t index, uint32_t RGBA_pixel)
+    {
+        capture_pixels[index] = RGBA_pixel;
+        capture_row_sequence[index / CAPTURE_WIDTH] = capture_frame.sequence;
+    }
+
+    size_t read_capture(const char* path)
+    {
+        FILE* file = fopen(path, "rb");
+        CHECK(file != NULL);
+        size_t num_bytes = fread(capture_file, 1, sizeof(capture_file), file);
+        fclose(file);
+        return num_bytes;
+    }
+};
+
+
+TEST(FRAME_CAPTURE_TESTS, y4m_has_a_header_and_tagged_yuv_frames)
+{
+    set_pixel(0, 0xFFFFFFFF);
+    set_pixel(1, 0xFF0000FF);
+    set_pixel(CAPTURE_PIXELS - 1, 0x0000FFFF);
+    frame_capture_t* capture = frame_capture_open(Y4M_PATH, CAPTURE_WIDTH, CAPTURE_HEIGHT, 60, 1);
+    CHECK(capture != NULL);
+    CHECK(frame_capture_submit(capture, &capture_frame, 1234));
+    CHECK(frame_capture_close(capture));
+
+    const char header[] = "YUV4MPEG2 W13 H3 F60:1 Ip A1:1 C444\nFRAME Xcycle=1234\n";
+    const size_t header_length = sizeof(header) - 1;
+    LONGS_EQUAL(header_length + CAPTURE_PIXELS * 3, read_capture(Y4M_PATH));
+    MEMCMP_EQUAL(header, capture_file, header_length);
+
+    const uint8_t* y = &capture_file[header_length];
+    const uint8_t* u = &y[CAPTURE_PIXELS];
+    const uint8_t* v = &u[CAPTURE_PIXELS];
+    //white, red, black and blue in BT.601 studio range
+    LONGS_EQUAL(235, y[0]); LONGS_EQUAL(128, u[0]); LONGS_EQUAL(128, v[0]);
+    LONGS_EQUAL(82, y[1]); LONGS_EQUAL(90, u[1]); LONGS_EQUAL(240, v[1]);
+    LONGS_EQUAL(16, y[2]); LONGS_EQUAL(128, u[2]); LONGS_EQUAL(128, v[2]);
+    LONGS_EQUAL(41, y[CAPTURE_PIXELS - 1]);
+    LONGS_EQUAL(240, u[CAPTURE_PIXELS - 1]);
+    LONGS_EQUAL(110, v[CAPTURE_PIXELS - 1]);
+}
+
+TEST(FRAME_CAPTURE_TESTS, raw_frames_are_rgba_bytes)
+{
+    set_pixel(0, 0x11223344);
+    set_pixel(CAPTURE_PIXELS - 1, 0x55667788);
+    frame_capture_t* capture = frame_capture_open(RAW_PATH, CAPTURE_WIDTH, CAPTURE_HEIGHT, 60, 1);
+    CHECK(frame_capture_submit(capture, &capture_frame, 0));
+    CHECK(frame_capture_close(capture));
+
+    LONGS_EQUAL(CAPTURE_PIXELS * 4, read_capture(RAW_PATH));
+    const uint8_t first[] = { 0x11, 0x22, 0x33, 0x44 };
+    const uint8_t last[] = { 0x55, 0x66, 0x77, 0x88 };
+    MEMCMP_EQUAL(first, capture_file, 4);
+    MEMCMP_EQUAL(last, &capture_file[(CAPTURE_PIXELS - 1) * 4], 4);
+}
+
+TEST(FRAME_CAPTURE_TESTS, identical_frames_are_only_written_once)
+{
+    frame_capture_t* capture = frame_capture_open(RAW_PATH, CAPTURE_WIDTH, CAPTURE_HEIGHT, 60, 1);
+    CHECK(frame_capture_submit(capture, &capture_frame, 0));
+    next_frame();
+    //rewriting a pixel with what was already there doesn't change the frame
+    set_pixel(5, 0);
+    CHECK(frame_capture_submit(capture, &capture_frame, 10));
+    next_frame();
+    set_pixel(5, 0xABCDEF01);
+    CHECK(frame_capture_submit(capture, &capture_frame, 20));
+    CHECK(frame_capture_close(capture));
+
+    LONGS_EQUAL(2 * CAPTURE_PIXELS * 4, read_capture(RAW_PATH));
+    const uint8_t changed[] = { 0xAB, 0xCD, 0xEF, 0x01 };
+    MEMCMP_EQUAL(changed, &capture_file[(CAPTURE_PIXELS + 5) * 4], 4);
+}
+
+//frames go through a handful of reused buffers that only get the rows that
+//changed copied into them, so every frame has to come out whole anyway
+TEST(FRAME_CAPTURE_TESTS, every_frame_comes_out_whole)
+{
+    const int NUM_FRAMES = 20;
+    frame_capture_t* capture = frame_capture_open(RAW_PATH, CAPTURE_WIDTH, CAPTURE_HEIGHT, 60, 1);
+    int num_submitted = 0;
+    for(int i = 0; i < NUM_FRAMES; i++)
+    {
+        next_frame();
+        set_pixel((size_t)(i * 7) % CAPTURE_PIXELS, 0x01000000u * (uint32_t)(i + 1));
+        set_pixel(0, (uint32_t)i);
+        if(frame_capture_submit(capture, &capture_frame, (uint64_t)i))
+        {
+            num_submitted++;
+        }
+        uint64_t dropped = frame_capture_frames_dropped(capture);
+        LONGS_EQUAL(i + 1, num_submitted + (int)dropped);
+    }
+    CHECK(frame_capture_close(capture));
+
+    size_t frame_size = CAPTURE_PIXELS * 4;
+    LONGS_EQUAL(num_submitted * frame_size, read_capture(RAW_PATH));
+    //the last one that went in has every change up to then
+    const uint8_t* last = &capture_file[(num_submitted - 1) * frame_size];
+    if(num_submitted == NUM_FRAMES)
+    {
+        for(int i = 1; i < NUM_FRAMES; i++)
+        {
+            size_t index = (size_t)(i * 7) % CAPTURE_PIXELS;
+            if(index != 0)
+            {
+                LONGS_EQUAL(i + 1, last[index * 4]);
+            }
+        }
+    }
+}
+
+TEST(FRAME_CAPTURE_TESTS, capture_to_a_bad_path_fails)
+{
+    POINTERS_EQUAL(NULL, frame_capture_open("no/such/directory/video.y4m", CAPTURE_WIDTH, CAPTURE_HEIGHT, 60, 1));
+}
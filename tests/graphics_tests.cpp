@@ -0,0 +1,213 @@
+#include "CppUTest/TestHarness.h"
+
+extern "C"
+{
+#include <stdio.h>
+#include <string.h>
+#include "graphics.h"
+#include "graphics_backend.h"
+}
+
+static const uint16_t TEST_WIDTH = 4;
+static const uint16_t TEST_HEIGHT = 3;
+static const uint32_t TEST_START_ADDRESS = 0x1000;
+static const char* TEST_DUMP_PATH = "graphics_tests_frame.dump";
+
+//a backend that just remembers what it was shown
+static int frames_presented;
+static uint64_t last_sequence;
+static uint16_t last_changed_rows;
+
+static void* counting_create(uint16_t width, uint16_t height)
+{
+    (void)width;
+    (void)height;
+    return &frames_presented;
+}
+
+static void counting_destroy(void* backend)
+{
+    (void)backend;
+}
+
+static void counting_present(void* backend, const graphics_frame_t* frame)
+{
+    (void)backend;
+    last_changed_rows = 0;
+    for(uint16_t row = 0; row < frame->height; row++)
+    {
+        if(frame->row_sequence[row] > last_sequence)
+        {
+            last_changed_rows++;
+        }
+    }
+    last_sequence = frame->sequence;
+    frames_presented++;
+}
+
+static spsc_queue_t* counting_get_key_events(void* backend)
+{
+    (void)backend;
+    return NULL;
+}
+
+static const graphics_backend_ops_t counting_backend =
+{
+    "counting", &counting_create, &counting_destroy, &counting_present, &counting_get_key_events
+};
+
+graphics_t* graphics;
+
+TEST_GROUP(GRAPHICS_TESTS)
+{
+
+    void setup(void)
+    {
+        frames_presented = 0;
+        last_sequence = 0;
+        last_changed_rows = 0;
+        graphics = create_graphics(TEST_WIDTH, TEST_HEIGHT, TEST_START_ADDRESS, &counting_backend);
+    }
+
+    void teardown(void)
+    {
+        graphics_destroy(graphics);
+        remove(TEST_DUMP_PATH);
+    }
+
+    void set_pixel(uint16_t x, uint16_t y, uint32_t RGBA_pixel)
+    {
+        graphics_update(graphics, TEST_START_ADDRESS + y * TEST_WIDTH + x, RGBA_pixel);
+    }
+
+    size_t read_dump(uint8_t* bytes, size_t max_bytes)
+    {
+        FILE* file = fopen(TEST_DUMP_PATH, "rb");
+        CHECK(file != NULL);
+        size_t num_bytes = fread(bytes, 1, max_bytes, file);
+        fclose(file);
+        return num_bytes;
+    }
+};
+
+
+TEST(GRAPHICS_TESTS, first_frame_is_presented_whole)
+{
+    graphics_draw(graphics);
+    LONGS_EQUAL(1, frames_presented);
+    LONGS_EQUAL(TEST_HEIGHT, last_changed_rows);
+}
+
+TEST(GRAPHICS_TESTS, nothing_is_presented_when_nothing_changed)
+{
+    graphics_draw(graphics);
+    graphics_draw(graphics);
+    graphics_draw(graphics);
+    LONGS_EQUAL(1, frames_presented);
+}
+
+TEST(GRAPHICS_TESTS, only_changed_rows_are_marked)
+{
+    graphics_draw(graphics);
+    set_pixel(1, 2, 0x11223344);
+    set_pixel(3, 2, 0x55667788);
+    graphics_draw(graphics);
+    LONGS_EQUAL(2, frames_presented);
+    LONGS_EQUAL(1, last_changed_rows);
+}
+
+TEST(GRAPHICS_TESTS, rows_changed_in_earlier_frames_are_not_marked_again)
+{
+    graphics_draw(graphics);
+    set_pixel(0, 0, 0x11223344);
+    graphics_draw(graphics);
+    set_pixel(0, 1, 0x11223344);
+    set_pixel(2, 1, 0x55667788);
+    graphics_draw(graphics);
+    LONGS_EQUAL(3, frames_presented);
+    LONGS_EQUAL(1, last_changed_rows);
+}
+
+TEST(GRAPHICS_TESTS, reset_marks_every_row)
+{
+    graphics_draw(graphics);
+    graphics_reset(graphics);
+    graphics_draw(graphics);
+    LONGS_EQUAL(2, frames_presented);
+    LONGS_EQUAL(TEST_HEIGHT, last_changed_rows);
+}
+
+TEST(GRAPHICS_TESTS, headless_display_has_no_key_events)
+{
+    graphics_t* headless = create_headless_graphics_display(TEST_WIDTH, TEST_HEIGHT, TEST_START_ADDRESS);
+    graphics_draw(headless);
+    POINTERS_EQUAL(NULL, graphics_get_key_events(headless));
+    graphics_destroy(headless);
+}
+
+TEST(GRAPHICS_TESTS, dump_format_comes_from_the_extension)
+{
+    LONGS_EQUAL(GRAPHICS_DUMP_PPM, graphics_dump_format_for_path("out/frame.ppm"));
+    LONGS_EQUAL(GRAPHICS_DUMP_RAW, graphics_dump_format_for_path("out/frame.rgba"));
+    LONGS_EQUAL(GRAPHICS_DUMP_RAW, graphics_dump_format_for_path("frame"));
+}
+
+TEST(GRAPHICS_TESTS, ppm_dump_has_a_header_and_rgb_pixels)
+{
+    set_pixel(0, 0, 0xFF0000FF);
+    set_pixel(3, 2, 0x123456FF);
+    CHECK(graphics_dump_frame(graphics, TEST_DUMP_PATH, GRAPHICS_DUMP_PPM));
+
+    const char header[] = "P6\n4 3\n255\n";
+    const size_t header_length = sizeof(header) - 1;
+    uint8_t bytes[128];
+    LONGS_EQUAL(header_length + TEST_WIDTH * TEST_HEIGHT * 3, read_dump(bytes, sizeof(bytes)));
+    MEMCMP_EQUAL(header, bytes, header_length);
+
+    const uint8_t* pixels = &bytes[header_length];
+    const uint8_t first[] = { 0xFF, 0x00, 0x00 };
+    const uint8_t last[] = { 0x12, 0x34, 0x56 };
+    MEMCMP_EQUAL(first, pixels, 3);
+    MEMCMP_EQUAL(last, &pixels[(TEST_WIDTH * TEST_HEIGHT - 1) * 3], 3);
+}
+
+TEST(GRAPHICS_TESTS, raw_dump_is_rgba_bytes)
+{
+    set_pixel(1, 0, 0x11223344);
+    CHECK(graphics_dump_frame(graphics, TEST_DUMP_PATH, GRAPHICS_DUMP_RAW));
+
+    uint8_t bytes[128];
+    LONGS_EQUAL(TEST_WIDTH * TEST_HEIGHT * 4, read_dump(bytes, sizeof(bytes)));
+    const uint8_t expected[] = { 0x00, 0x00, 0x00, 0x00, 0x11, 0x22, 0x33, 0x44 };
+    MEMCMP_EQUAL(expected, bytes, sizeof(expected));
+}
+
+TEST(GRAPHICS_TESTS, dump_to_a_bad_path_fails)
+{
+    CHECK_FALSE(graphics_dump_frame(graphics, "no/such/directory/frame.ppm", GRAPHICS_DUMP_PPM));
+}
+
+TEST(GRAPHICS_TESTS, capture_leaves_out_frames_where_nothing_was_drawn)
+{
+    CHECK(graphics_start_capture(graphics, TEST_DUMP_PATH, 60, 1));
+    graphics_capture_frame(graphics, 0);
+    graphics_capture_frame(graphics, 10);
+    set_pixel(2, 1, 0x11223344);
+    graphics_capture_frame(graphics, 20);
+    graphics_capture_frame(graphics, 30);
+    CHECK(graphics_stop_capture(graphics));
+
+    uint8_t bytes[256];
+    LONGS_EQUAL(2 * TEST_WIDTH * TEST_HEIGHT * 4, read_dump(bytes, sizeof(bytes)));
+}
+
+TEST(GRAPHICS_TESTS, capturing_does_not_hide_changes_from_the_backend)
+{
+    graphics_draw(graphics);
+    CHECK(graphics_start_capture(graphics, TEST_DUMP_PATH, 60, 1));
+    set_pixel(0, 1, 0x11223344);
+    graphics_capture_frame(graphics, 0);
+    graphics_draw(graphics);
+    LONGS_EQUAL(2, frames_presented);
+    LONGS_EQUAL(1, last_changed_rows);
+}
@@ -0,0 +1,147 @@
+#include "CppUTest/TestHarness.h"
+
+extern "C"
+{
+#include <stdio.h>
+#include "input_journal.h"
+#include "input_script.h"
+#include "keyboard.h"
+#include "scheduler.h"
+#include "memory_bus.h"
+#include "memory_map.h"
+#include "interrupt_controller.h"
+}
+
+static const char* JOURNAL_PATH = "input_journal_tests.bin";
+
+keyboard_t* journal_keyboard;
+scheduler_t* journal_scheduler;
+memory_bus_t* journal_bus;
+interrupt_controller_t* journal_ic;
+
+TEST_GROUP(INPUT_JOURNAL_TESTS)
+{
+
+    void setup(void)
+    {
+        journal_bus = make_memory_bus();
+        bus_map_device(journal_bus, KEYBOARD_SELECTED, KEYBOARD_REGION_START, KEYBOARD_REGION_END);
+        journal_ic = make_interrupt_controller(INTERRUPT_VECTOR_TABLE_START);
+        journal_keyboard = create_keyboard(IRQ_2, 16, journal_ic);
+        journal_scheduler = make_scheduler();
+    }
+
+    void teardown(void)
+    {
+        destroy_scheduler(journal_scheduler);
+        destroy_keyboard(journal_keyboard);
+        destroy_interrupt_controller(journal_ic);
+        destroy_memory_bus(journal_bus);
+        remove(JOURNAL_PATH);
+    }
+
+    long file_size(void)
+    {
+        FILE* file = fopen(JOURNAL_PATH, "rb");
+        CHECK(file != NULL);
+        fseek(file, 0, SEEK_END);
+        long size = ftell(file);
+        fclose(file);
+        return size;
+    }
+
+    //takes the oldest scancode out of the keyboard the way the guest would
+    uint32_t read_scancode(void)
+    {
+        bus_enable(journal_bus);
+        bus_set_address_lines(journal_bus, KEYBOARD_REGION_START + KEYBOARD_DATA_REGISTER);
+        bus_set_read_operation(journal_bus);
+        bus_cycle(journal_bus);
+        keyboard_cycle(journal_keyboard, journal_bus);
+        uint32_t scancode = bus_get_data_lines(journal_bus);
+        bus_disable(journal_bus);
+        bus_cycle(journal_bus);
+        return scancode;
+    }
+};
+
+
+TEST(INPUT_JOURNAL_TESTS, recorded_keys_play_back_on_their_cycles)
+{
+    input_journal_t* journal = input_journal_create(JOURNAL_PATH, JIT_ENGINE);
+    CHECK(journal != NULL);
+    CHECK(input_journal_record(journal, 100, 'a'));
+    CHECK(input_journal_record(journal, 100, 'a' | KEYBOARD_BREAK_CODE));
+    CHECK(input_journal_record(journal, 5000000000ull, 0x4000004F));
+    CHECK(input_journal_close(journal, 5000001234ull));
+
+    execution_engine_t engine = TIMING_ENGINE;
+    uint64_t end_cycle = 0;
+    input_script_t* script = input_journal_load(JOURNAL_PATH, &engine, &end_cycle);
+    CHECK(script != NULL);
+    LONGS_EQUAL(JIT_ENGINE, engine);
+    CHECK(5000001234ull == end_cycle);
+    LONGS_EQUAL(3, input_script_num_events(script));
+
+    input_script_start(script, journal_keyboard, journal_scheduler, 0);
+    scheduler_run_due_events(journal_scheduler, 100);
+    LONGS_EQUAL('a', read_scancode());
+    LONGS_EQUAL('a' | KEYBOARD_BREAK_CODE, read_scancode());
+    CHECK(5000000000ull == scheduler_next_event_cycle(journal_scheduler));
+    scheduler_run_due_events(journal_scheduler, 5000000000ull);
+    LONGS_EQUAL(0x4000004F, read_scancode());
+    destroy_input_script(script);
+}
+
+TEST(INPUT_JOURNAL_TESTS, records_are_compact)
+{
+    input_journal_t* journal = input_journal_create(JOURNAL_PATH, FAST_ENGINE);
+    long header_size = file_size();
+    input_journal_record(journal, 1000, 'x');
+    input_journal_record(journal, 2000, 'x' | KEYBOARD_BREAK_CODE);
+    //a tag, two bytes for the gap and one for the key
+    LONGS_EQUAL(header_size + 8, file_size());
+    input_journal_close(journal, 2000);
+}
+
+TEST(INPUT_JOURNAL_TESTS, unfinished_journals_play_up_to_the_last_key)
+{
+    input_journal_t* journal = input_journal_create(JOURNAL_PATH, FAST_ENGINE);
+    input_journal_record(journal, 100, 'a');
+    input_journal_record(journal, 300, 'b');
+    //a run that gets killed never writes the end, and may not even finish
+    //the record it was on
+    FILE* file = fopen(JOURNAL_PATH, "ab");
+    fputc(1, file);
+    fputc(0x80, file);
+    fclose(file);
+
+    execution_engine_t engine;
+    uint64_t end_cycle = 0;
+    input_script_t* script = input_journal_load(JOURNAL_PATH, &engine, &end_cycle);
+    CHECK(script != NULL);
+    LONGS_EQUAL(2, input_script_num_events(script));
+    LONGS_EQUAL(300, end_cycle);
+    destroy_input_script(script);
+    input_journal_close(journal, 400);
+}
+
+TEST(INPUT_JOURNAL_TESTS, other_files_are_rejected)
+{
+    execution_engine_t engine;
+    uint64_t end_cycle;
+    POINTERS_EQUAL(NULL, input_journal_load(JOURNAL_PATH, &engine, &end_cycle));
+
+    FILE* file = fopen(JOURNAL_PATH, "wb");
+    fputs("100 down a\n", file);
+    fclose(file);
+    POINTERS_EQUAL(NULL, input_journal_load(JOURNAL_PATH, &engine, &end_cycle));
+
+    input_journal_t* journal = input_journal_create(JOURNAL_PATH, FAST_ENGINE);
+    input_journal_close(journal, 10);
+    file = fopen(JOURNAL_PATH, "r+b");
+    fseek(file, 8, SEEK_SET);
+    fputc(99, file);
+    fclose(file);
+    POINTERS_EQUAL(NULL, input_journal_load(JOURNAL_PATH, &engine, &end_cycle));
+}
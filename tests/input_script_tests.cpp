@@ -0,0 +1,143 @@
+#include "CppUTest/TestHarness.h"
+
+extern "C"
+{
+#include <stdio.h>
+#include "input_script.h"
+#include "keyboard.h"
+#include "scheduler.h"
+#include "memory_bus.h"
+#include "memory_map.h"
+#include "interrupt_controller.h"
+}
+
+static const char* SCRIPT_PATH = "input_script_tests.txt";
+
+keyboard_t* script_keyboard;
+scheduler_t* script_scheduler;
+memory_bus_t* script_bus;
+interrupt_controller_t* script_ic;
+
+TEST_GROUP(INPUT_SCRIPT_TESTS)
+{
+
+    void setup(void)
+    {
+        script_bus = make_memory_bus();
+        bus_map_device(script_bus, KEYBOARD_SELECTED, KEYBOARD_REGION_START, KEYBOARD_REGION_END);
+        script_ic = make_interrupt_controller(INTERRUPT_VECTOR_TABLE_START);
+        script_keyboard = create_keyboard(IRQ_2, 16, script_ic);
+        script_scheduler = make_scheduler();
+    }
+
+    void teardown(void)
+    {
+        destroy_scheduler(script_scheduler);
+        destroy_keyboard(script_keyboard);
+        destroy_interrupt_controller(script_ic);
+        destroy_memory_bus(script_bus);
+        remove(SCRIPT_PATH);
+    }
+
+    void write_script(const char* text)
+    {
+        FILE* file = fopen(SCRIPT_PATH, "w");
+        CHECK(file != NULL);
+        fputs(text, file);
+        fclose(file);
+    }
+
+    //takes the oldest scancode out of the keyboard the way the guest would
+    uint32_t read_scancode(void)
+    {
+        bus_enable(script_bus);
+        bus_set_address_lines(script_bus, KEYBOARD_REGION_START + KEYBOARD_DATA_REGISTER);
+        bus_set_read_operation(script_bus);
+        bus_cycle(script_bus);
+        keyboard_cycle(script_keyboard, script_bus);
+        uint32_t scancode = bus_get_data_lines(script_bus);
+        bus_disable(script_bus);
+        bus_cycle(script_bus);
+        return scancode;
+    }
+};
+
+
+TEST(INPUT_SCRIPT_TESTS, scripts_are_read_from_text_files)
+{
+    write_script("# a comment\n"
+                 "100 down a\n"
+                 "\n"
+                 "200 up a   # trailing comment\n"
+                 "300 press space\n"
+                 "300 down 0x4000004F\n");
+    input_script_t* script = input_script_load(SCRIPT_PATH);
+    CHECK(script != NULL);
+    LONGS_EQUAL(5, input_script_num_events(script));
+    destroy_input_script(script);
+}
+
+TEST(INPUT_SCRIPT_TESTS, malformed_scripts_are_rejected)
+{
+    const char* bad_scripts[] = {
+        "100 down\n",
+        "100 sideways a\n",
+        "100 down a b\n",
+        "100 down notakey\n",
+        "200 down a\n100 down b\n",
+    };
+    for(size_t i = 0; i < sizeof(bad_scripts) / sizeof(bad_scripts[0]); i++)
+    {
+        write_script(bad_scripts[i]);
+        POINTERS_EQUAL(NULL, input_script_load(SCRIPT_PATH));
+    }
+    remove(SCRIPT_PATH);
+    POINTERS_EQUAL(NULL, input_script_load(SCRIPT_PATH));
+}
+
+TEST(INPUT_SCRIPT_TESTS, events_arrive_on_their_cycles)
+{
+    input_script_t* script = make_input_script();
+    CHECK(input_script_add(script, 100, 'a'));
+    CHECK(input_script_add(script, 100, 'a' | KEYBOARD_BREAK_CODE));
+    CHECK(input_script_add(script, 250, '\r'));
+    CHECK_FALSE(input_script_add(script, 200, 'b'));
+
+    input_script_start(script, script_keyboard, script_scheduler, 0);
+    LONGS_EQUAL(100, scheduler_next_event_cycle(script_scheduler));
+    scheduler_run_due_events(script_scheduler, 99);
+    LONGS_EQUAL(0, read_scancode());
+
+    scheduler_run_due_events(script_scheduler, 100);
+    LONGS_EQUAL('a', read_scancode());
+    LONGS_EQUAL('a' | KEYBOARD_BREAK_CODE, read_scancode());
+    LONGS_EQUAL(0, read_scancode());
+    LONGS_EQUAL(250, scheduler_next_event_cycle(script_scheduler));
+
+    scheduler_run_due_events(script_scheduler, 250);
+    LONGS_EQUAL('\r', read_scancode());
+    LONGS_EQUAL(NO_EVENT_SCHEDULED, scheduler_next_event_cycle(script_scheduler));
+    destroy_input_script(script);
+}
+
+TEST(INPUT_SCRIPT_TESTS, starting_again_plays_from_the_given_cycle)
+{
+    input_script_t* script = make_input_script();
+    input_script_add(script, 100, 'a');
+    input_script_add(script, 200, 'b');
+
+    input_script_start(script, script_keyboard, script_scheduler, 150);
+    LONGS_EQUAL(200, scheduler_next_event_cycle(script_scheduler));
+
+    //after a reset time starts over, and so does the script
+    scheduler_reset(script_scheduler);
+    input_script_start(script, script_keyboard, script_scheduler, 0);
+    scheduler_run_due_events(script_scheduler, 1000);
+    LONGS_EQUAL('a', read_scancode());
+    LONGS_EQUAL('b', read_scancode());
+
+    input_script_start(script, script_keyboard, script_scheduler, 0);
+    input_script_stop(script);
+    LONGS_EQUAL(0, scheduler_num_events(script_scheduler));
+    destroy_input_script(script);
+}
@@ -0,0 +1,108 @@
+#include "CppUTest/TestHarness.h"
+
+extern "C"
+{
+#include <stdio.h>
+#include "interrupt_controller.h"
+}
+
+const uint32_t TEST_IVT_START_ADDRESS = 0x100;
+interrupt_controller_t* test_ic;
+
+TEST_GROUP(INTERRUPT_CONTROLLER_TESTS)
+{
+    void setup(void)
+    {
+        test_ic = make_interrupt_controller(TEST_IVT_START_ADDRESS);
+    }
+
+    void teardown(void)
+    {
+        destroy_interrupt_controller(test_ic);
+    }
+};
+
+TEST(INTERRUPT_CONTROLLER_TESTS, NothingIsRequestedAtFirst)
+{
+    CHECK_FALSE(interrupt_requested(test_ic));
+    LONGS_EQUAL(TEST_IVT_START_ADDRESS, get_interrupt_vector_table_starting_address(test_ic));
+}
+
+TEST(INTERRUPT_CONTROLLER_TESTS, RequestStaysPendingUntilAcknowledged)
+{
+    request_interrupt(test_ic, IRQ_5);
+    CHECK_TRUE(interrupt_requested(test_ic));
+    LONGS_EQUAL(IRQ_5, get_interrupt_source(test_ic));
+    LONGS_EQUAL(IRQ_5, get_interrupt_source(test_ic));
+
+    acknowledge_interrupt(test_ic, IRQ_5);
+    CHECK_FALSE(interrupt_requested(test_ic));
+}
+
+TEST(INTERRUPT_CONTROLLER_TESTS, RepeatedRequestsAreServicedOnce)
+{
+    request_interrupt(test_ic, IRQ_3);
+    request_interrupt(test_ic, IRQ_3);
+    acknowledge_interrupt(test_ic, IRQ_3);
+    CHECK_FALSE(interrupt_requested(test_ic));
+}
+
+TEST(INTERRUPT_CONTROLLER_TESTS, LowestNumberedRequestIsServicedFirst)
+{
+    request_interrupt(test_ic, IRQ_200);
+    request_interrupt(test_ic, IRQ_130);
+    request_interrupt(test_ic, IRQ_63);
+    request_interrupt(test_ic, IRQ_64);
+
+    uint8_t expected[] = {IRQ_63, IRQ_64, IRQ_130, IRQ_200};
+    for(unsigned i = 0; i < sizeof(expected); i++)
+    {
+        CHECK_TRUE(interrupt_requested(test_ic));
+        LONGS_EQUAL(expected[i], get_interrupt_source(test_ic));
+        acknowledge_interrupt(test_ic, expected[i]);
+    }
+    CHECK_FALSE(interrupt_requested(test_ic));
+}
+
+TEST(INTERRUPT_CONTROLLER_TESTS, EveryIRQCanBeRequested)
+{
+    for(int irq = 0; irq < MAX_NUM_IRQS; irq++)
+    {
+        request_interrupt(test_ic, irq);
+        LONGS_EQUAL(irq, get_interrupt_source(test_ic));
+        acknowledge_interrupt(test_ic, irq);
+        CHECK_FALSE(interrupt_requested(test_ic));
+    }
+}
+
+TEST(INTERRUPT_CONTROLLER_TESTS, MaskedRequestWaitsUntilUnmasked)
+{
+    mask_interrupt(test_ic, IRQ_0);
+    request_interrupt(test_ic, IRQ_0);
+    CHECK_FALSE(interrupt_requested(test_ic));
+
+    request_interrupt(test_ic, IRQ_255);
+    LONGS_EQUAL(IRQ_255, get_interrupt_source(test_ic));
+
+    unmask_interrupt(test_ic, IRQ_0);
+    LONGS_EQUAL(IRQ_0, get_interrupt_source(test_ic));
+}
+
+TEST(INTERRUPT_CONTROLLER_TESTS, AcknowledgingAnotherIRQLeavesTheRestPending)
+{
+    request_interrupt(test_ic, IRQ_1);
+    request_interrupt(test_ic, IRQ_2);
+    acknowledge_interrupt(test_ic, IRQ_2);
+    LONGS_EQUAL(IRQ_1, get_interrupt_source(test_ic));
+}
+
+TEST(INTERRUPT_CONTROLLER_TESTS, ResetClearsRequestsAndMasks)
+{
+    mask_interrupt(test_ic, IRQ_7);
+    request_interrupt(test_ic, IRQ_9);
+    interrupt_controller_reset(test_ic);
+    CHECK_FALSE(interrupt_requested(test_ic));
+
+    request_interrupt(test_ic, IRQ_7);
+    LONGS_EQUAL(IRQ_7, get_interrupt_source(test_ic));
+}
@@ -0,0 +1,216 @@
+#include "CppUTest/TestHarness.h"
+
+extern "C"
+{
+#include <stdio.h>
+#include "keyboard.h"
+#include "memory_bus.h"
+#include "memory_map.h"
+#include "spsc_queue.h"
+#include "interrupt_controller.h"
+#include "state_file.h"
+}
+
+static const uint32_t INTERRUPT_ENABLE = 1u << 0;
+static const uint32_t DATA_AVAILABLE = 1u << 1;
+static const uint32_t OVERFLOW_FLAG = 1u << 2;
+static const uint32_t COUNT_SHIFT = 16;
+static const size_t TEST_FIFO_DEPTH = 4;
+
+keyboard_t* keyboard;
+memory_bus_t* keyboard_bus;
+interrupt_controller_t* keyboard_ic;
+
+TEST_GROUP(KEYBOARD_TESTS)
+{
+
+    void setup(void)
+    {
+        keyboard_bus = make_memory_bus();
+        bus_map_device(keyboard_bus, KEYBOARD_SELECTED, KEYBOARD_REGION_START, KEYBOARD_REGION_END);
+        keyboard_ic = make_interrupt_controller(INTERRUPT_VECTOR_TABLE_START);
+        keyboard = create_keyboard(IRQ_2, TEST_FIFO_DEPTH, keyboard_ic);
+    }
+
+    void teardown(void)
+    {
+        destroy_keyboard(keyboard);
+        destroy_interrupt_controller(keyboard_ic);
+        destroy_memory_bus(keyboard_bus);
+    }
+
+    uint32_t access_register(keyboard_register_t reg, bool write, uint32_t value)
+    {
+        bus_enable(keyboard_bus);
+        bus_set_address_lines(keyboard_bus, KEYBOARD_REGION_START + reg);
+        if(write)
+        {
+            bus_set_write_operation(keyboard_bus);
+            bus_set_data_lines(keyboard_bus, value);
+        }
+        else
+        {
+            bus_set_read_operation(keyboard_bus);
+        }
+        bus_cycle(keyboard_bus);
+        keyboard_cycle(keyboard, keyboard_bus);
+        CHECK(bus_is_device_ready(keyboard_bus));
+
+        value = bus_get_data_lines(keyboard_bus);
+        bus_disable(keyboard_bus);
+        bus_cycle(keyboard_bus);
+        return value;
+    }
+
+    uint32_t read_register(keyboard_register_t reg)
+    {
+        return access_register(reg, false, 0);
+    }
+
+    void write_register(keyboard_register_t reg, uint32_t value)
+    {
+        access_register(reg, true, value);
+    }
+};
+
+
+TEST(KEYBOARD_TESTS, empty_keyboard_has_nothing_to_read)
+{
+    LONGS_EQUAL(0, read_register(KEYBOARD_STATUS_REGISTER));
+    LONGS_EQUAL(0, read_register(KEYBOARD_DATA_REGISTER));
+    CHECK_FALSE(interrupt_requested(keyboard_ic));
+}
+
+TEST(KEYBOARD_TESTS, scancodes_are_read_back_oldest_first)
+{
+    CHECK(keyboard_press(keyboard, 'a'));
+    CHECK(keyboard_press(keyboard, 'a' | KEYBOARD_BREAK_CODE));
+    CHECK(keyboard_press(keyboard, 'b'));
+
+    LONGS_EQUAL(DATA_AVAILABLE | (3 << COUNT_SHIFT), read_register(KEYBOARD_STATUS_REGISTER));
+    LONGS_EQUAL('a', read_register(KEYBOARD_DATA_REGISTER));
+    LONGS_EQUAL('a' | KEYBOARD_BREAK_CODE, read_register(KEYBOARD_DATA_REGISTER));
+    LONGS_EQUAL('b', read_register(KEYBOARD_DATA_REGISTER));
+    LONGS_EQUAL(0, read_register(KEYBOARD_STATUS_REGISTER));
+}
+
+TEST(KEYBOARD_TESTS, fifo_wraps_around)
+{
+    for(uint32_t key = 1; key <= 3 * TEST_FIFO_DEPTH; key++)
+    {
+        CHECK(keyboard_press(keyboard, key));
+        LONGS_EQUAL(key, read_register(KEYBOARD_DATA_REGISTER));
+    }
+}
+
+TEST(KEYBOARD_TESTS, full_fifo_drops_new_scancodes_and_sets_overflow_flag)
+{
+    for(uint32_t key = 1; key <= TEST_FIFO_DEPTH; key++)
+    {
+        CHECK(keyboard_press(keyboard, key));
+    }
+    CHECK_FALSE(keyboard_press(keyboard, 99));
+    LONGS_EQUAL(OVERFLOW_FLAG | DATA_AVAILABLE | (TEST_FIFO_DEPTH << COUNT_SHIFT), read_register(KEYBOARD_STATUS_REGISTER));
+
+    //software can clear the flag, but it can't set it
+    write_register(KEYBOARD_STATUS_REGISTER, 0);
+    LONGS_EQUAL(0, read_register(KEYBOARD_STATUS_REGISTER) & OVERFLOW_FLAG);
+    write_register(KEYBOARD_STATUS_REGISTER, OVERFLOW_FLAG);
+    LONGS_EQUAL(0, read_register(KEYBOARD_STATUS_REGISTER) & OVERFLOW_FLAG);
+
+    for(uint32_t key = 1; key <= TEST_FIFO_DEPTH; key++)
+    {
+        LONGS_EQUAL(key, read_register(KEYBOARD_DATA_REGISTER));
+    }
+}
+
+TEST(KEYBOARD_TESTS, interrupt_is_only_requested_when_enabled)
+{
+    keyboard_press(keyboard, 'a');
+    CHECK_FALSE(interrupt_requested(keyboard_ic));
+
+    write_register(KEYBOARD_STATUS_REGISTER, INTERRUPT_ENABLE);
+    CHECK(interrupt_requested(keyboard_ic));
+    LONGS_EQUAL(IRQ_2, get_interrupt_source(keyboard_ic));
+    acknowledge_interrupt(keyboard_ic, IRQ_2);
+
+    keyboard_press(keyboard, 'b');
+    CHECK(interrupt_requested(keyboard_ic));
+    LONGS_EQUAL(IRQ_2, get_interrupt_source(keyboard_ic));
+}
+
+TEST(KEYBOARD_TESTS, input_queues_every_key_event)
+{
+    spsc_queue_t* key_events = spsc_queue_create(8);
+    spsc_queue_put(key_events, 'a');
+    spsc_queue_put(key_events, 'a' | KEYBOARD_BREAK_CODE);
+    input(keyboard, key_events);
+
+    CHECK_FALSE(keyboard_quit_requested(keyboard));
+    LONGS_EQUAL('a', read_register(KEYBOARD_DATA_REGISTER));
+    LONGS_EQUAL('a' | KEYBOARD_BREAK_CODE, read_register(KEYBOARD_DATA_REGISTER));
+
+    spsc_queue_put(key_events, KEYBOARD_QUIT_EVENT);
+    input(keyboard, key_events);
+    CHECK(keyboard_quit_requested(keyboard));
+    spsc_queue_destroy(key_events);
+}
+
+static void count_key_events(void* context, uint32_t scancode)
+{
+    (void)scancode;
+    (*(int*)context)++;
+}
+
+TEST(KEYBOARD_TESTS, listener_hears_about_key_events_from_the_host)
+{
+    int num_heard = 0;
+    keyboard_set_input_listener(keyboard, &count_key_events, &num_heard);
+    spsc_queue_t* key_events = spsc_queue_create(8);
+    spsc_queue_put(key_events, 'a');
+    spsc_queue_put(key_events, 'a' | KEYBOARD_BREAK_CODE);
+    input(keyboard, key_events);
+    LONGS_EQUAL(2, num_heard);
+
+    //scancodes that didn't come from the host aren't its business
+    keyboard_press(keyboard, 'b');
+    keyboard_set_input_listener(keyboard, NULL, NULL);
+    spsc_queue_put(key_events, 'c');
+    input(keyboard, key_events);
+    LONGS_EQUAL(2, num_heard);
+    spsc_queue_destroy(key_events);
+}
+
+TEST(KEYBOARD_TESTS, reset_empties_the_fifo_and_disables_interrupts)
+{
+    write_register(KEYBOARD_STATUS_REGISTER, INTERRUPT_ENABLE);
+    keyboard_press(keyboard, 'a');
+    keyboard_reset(keyboard);
+    LONGS_EQUAL(0, read_register(KEYBOARD_STATUS_REGISTER));
+}
+
+TEST(KEYBOARD_TESTS, saved_state_keeps_the_fifo_in_order)
+{
+    const char* STATE_PATH = "keyboard_tests.state";
+    write_register(KEYBOARD_STATUS_REGISTER, INTERRUPT_ENABLE);
+    keyboard_press(keyboard, 'x');
+    read_register(KEYBOARD_DATA_REGISTER);
+    keyboard_press(keyboard, 'a');
+    keyboard_press(keyboard, 'b');
+    keyboard_press(keyboard, 'c');
+    state_writer_t* writer = state_writer_create(STATE_PATH);
+    keyboard_save_state(keyboard, writer);
+    state_writer_close(writer);
+
+    keyboard_reset(keyboard);
+    state_reader_t* reader = state_reader_open(STATE_PATH);
+    keyboard_restore_state(keyboard, reader);
+    CHECK_FALSE(state_reader_failed(reader));
+    state_reader_close(reader);
+    remove(STATE_PATH);
+
+    LONGS_EQUAL(INTERRUPT_ENABLE | DATA_AVAILABLE | (3 << COUNT_SHIFT), read_register(KEYBOARD_STATUS_REGISTER));
+    LONGS_EQUAL('a', read_register(KEYBOARD_DATA_REGISTER));
+    LONGS_EQUAL('b', read_register(KEYBOARD_DATA_REGISTER));
+    LONGS_EQUAL('c', read_register(KEYBOARD_DATA_REGISTER));
+}
@@ -0,0 +1,83 @@
+#include "CppUTest/TestHarness.h"
+
+extern "C"
+{
+#include <stdio.h>
+#include "memory_bus.h"
+#include "memory_map.h"
+}
+
+memory_bus_t* bus;
+
+TEST_GROUP(MEMORY_BUS_TESTS)
+{
+
+    void setup(void)
+    {
+        bus = make_memory_bus();
+    }
+
+    void teardown(void)
+    {
+        destroy_memory_bus(bus);
+    }
+
+    void map_standard_devices(void)
+    {
+        CHECK(bus_map_device(bus, GRAPHICS_SELECTED, GRAPHICS_REGION_START, GRAPHICS_REGION_END));
+        CHECK(bus_map_device(bus, KEYBOARD_SELECTED, KEYBOARD_REGION_START, KEYBOARD_REGION_END));
+    }
+};
+
+
+TEST(MEMORY_BUS_TESTS, a_bus_with_nothing_mapped_is_all_memory)
+{
+    LONGS_EQUAL(MEMORY_SELECTED, bus_decode_address(bus, 0));
+    LONGS_EQUAL(MEMORY_SELECTED, bus_decode_address(bus, GRAPHICS_REGION_START));
+    LONGS_EQUAL(MEMORY_SELECTED, bus_decode_address(bus, 0xFFFFFFFF));
+}
+
+TEST(MEMORY_BUS_TESTS, addresses_decode_to_the_device_mapped_there)
+{
+    map_standard_devices();
+
+    LONGS_EQUAL(MEMORY_SELECTED, bus_decode_address(bus, BOOT_ROM_START));
+    LONGS_EQUAL(MEMORY_SELECTED, bus_decode_address(bus, INTERRUPT_VECTOR_TABLE_END));
+    LONGS_EQUAL(GRAPHICS_SELECTED, bus_decode_address(bus, GRAPHICS_REGION_START));
+    LONGS_EQUAL(GRAPHICS_SELECTED, bus_decode_address(bus, GRAPHICS_REGION_START + 5000));
+    LONGS_EQUAL(GRAPHICS_SELECTED, bus_decode_address(bus, GRAPHICS_REGION_END));
+    LONGS_EQUAL(KEYBOARD_SELECTED, bus_decode_address(bus, KEYBOARD_REGION_START));
+    LONGS_EQUAL(KEYBOARD_SELECTED, bus_decode_address(bus, KEYBOARD_REGION_END));
+    LONGS_EQUAL(MEMORY_SELECTED, bus_decode_address(bus, KEYBOARD_REGION_END + 1));
+    LONGS_EQUAL(MEMORY_SELECTED, bus_decode_address(bus, 0x00050000));
+}
+
+TEST(MEMORY_BUS_TESTS, devices_can_not_overlap)
+{
+    map_standard_devices();
+    CHECK_FALSE(bus_map_device(bus, KEYBOARD_SELECTED, GRAPHICS_REGION_END, GRAPHICS_REGION_END + 10));
+    CHECK_FALSE(bus_map_device(bus, KEYBOARD_SELECTED, 20, 10));
+    LONGS_EQUAL(GRAPHICS_SELECTED, bus_decode_address(bus, GRAPHICS_REGION_END));
+}
+
+TEST(MEMORY_BUS_TESTS, ranges_with_a_device_in_them_are_not_memory)
+{
+    map_standard_devices();
+    CHECK(bus_range_is_memory(bus, 0, BOOT_ROM_END));
+    CHECK_FALSE(bus_range_is_memory(bus, INTERRUPT_VECTOR_TABLE_START, INTERRUPT_VECTOR_TABLE_START + 1023));
+    CHECK_FALSE(bus_range_is_memory(bus, KEYBOARD_REGION_END, KEYBOARD_REGION_END + 100));
+    CHECK(bus_range_is_memory(bus, KEYBOARD_REGION_END + 1, 0xFFFFFFFF));
+}
+
+TEST(MEMORY_BUS_TESTS, bus_cycle_selects_the_decoded_device)
+{
+    map_standard_devices();
+    bus_enable(bus);
+    bus_set_address_lines(bus, KEYBOARD_REGION_START);
+    bus_cycle(bus);
+    LONGS_EQUAL(KEYBOARD_SELECTED, bus_get_selected_device(bus));
+
+    bus_disable(bus);
+    bus_cycle(bus);
+    LONGS_EQUAL(NO_DEVICE_SELECTED, bus_get_selected_device(bus));
+}
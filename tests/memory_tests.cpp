@@ -0,0 +1,202 @@
+#include "CppUTest/TestHarness.h"
+
+extern "C"
+{
+#include <stdio.h>
+#include "memory_bus.h"
+#include "memory.h"
+#include "state_file.h"
+}
+
+static const char* MEMORY_STATE_PATH = "memory_tests.state";
+
+const size_t FULL_ADDRESS_SPACE = (size_t)1 << 32;
+const uint32_t WORDS_PER_PAGE = 1024;
+memory_t* RAM;
+
+TEST_GROUP(MEMORY_TESTS)
+{
+
+    void setup(void)
+    {
+        RAM = make_memory(FULL_ADDRESS_SPACE);
+    }
+
+    void teardown(void)
+    {
+        destroy_memory(RAM);
+        remove(MEMORY_STATE_PATH);
+    }
+
+    //saves RAM and reads it back into a fresh memory
+    memory_t* save_and_restore(bool compress)
+    {
+        state_writer_t* writer = state_writer_create(MEMORY_STATE_PATH);
+        memory_save_state(RAM, writer, compress);
+        CHECK(state_writer_close(writer));
+
+        memory_t* restored = make_memory(FULL_ADDRESS_SPACE);
+        state_reader_t* reader = state_reader_open(MEMORY_STATE_PATH);
+        memory_restore_state(restored, reader);
+        CHECK_FALSE(state_reader_failed(reader));
+        CHECK(state_reader_at_end(reader));
+        state_reader_close(reader);
+        return restored;
+    }
+};
+
+
+TEST(MEMORY_TESTS, memory_starts_out_empty)
+{
+    LONGS_EQUAL(0, memory_get(RAM, 0));
+    LONGS_EQUAL(0, memory_get(RAM, 0xFFFFFFFF));
+    LONGS_EQUAL(0, memory_resident_pages(RAM));
+}
+
+TEST(MEMORY_TESTS, reading_does_not_allocate_pages)
+{
+    for(uint32_t address = 0; address < 16 * WORDS_PER_PAGE; address += 7)
+    {
+        memory_get(RAM, address);
+    }
+    LONGS_EQUAL(0, memory_resident_pages(RAM));
+}
+
+TEST(MEMORY_TESTS, writes_can_be_read_back_anywhere_in_the_address_space)
+{
+    memory_set(RAM, 0x00000000, 0x11111111);
+    memory_set(RAM, 0x00050000, 0x22222222);
+    memory_set(RAM, 0x7FFFFFFF, 0x33333333);
+    memory_set(RAM, 0xFFFFFFFF, 0x44444444);
+
+    UNSIGNED_LONGS_EQUAL(0x11111111, memory_get(RAM, 0x00000000));
+    UNSIGNED_LONGS_EQUAL(0x22222222, memory_get(RAM, 0x00050000));
+    UNSIGNED_LONGS_EQUAL(0x33333333, memory_get(RAM, 0x7FFFFFFF));
+    UNSIGNED_LONGS_EQUAL(0x44444444, memory_get(RAM, 0xFFFFFFFF));
+    LONGS_EQUAL(4, memory_resident_pages(RAM));
+}
+
+TEST(MEMORY_TESTS, only_pages_that_are_written_become_resident)
+{
+    for(uint32_t address = 0; address < WORDS_PER_PAGE; address++)
+    {
+        memory_set(RAM, address, address + 1);
+    }
+    LONGS_EQUAL(1, memory_resident_pages(RAM));
+
+    memory_set(RAM, WORDS_PER_PAGE, 1);
+    LONGS_EQUAL(2, memory_resident_pages(RAM));
+
+    //neighbouring words on a page that is already resident don't change anything
+    UNSIGNED_LONGS_EQUAL(0, memory_get(RAM, WORDS_PER_PAGE + 1));
+    UNSIGNED_LONGS_EQUAL(WORDS_PER_PAGE, memory_get(RAM, WORDS_PER_PAGE - 1));
+}
+
+TEST(MEMORY_TESTS, writing_zero_to_an_untouched_page_does_not_allocate_it)
+{
+    memory_set(RAM, 0x12345678, 0);
+    LONGS_EQUAL(0, memory_resident_pages(RAM));
+}
+
+TEST(MEMORY_TESTS, reset_releases_every_page)
+{
+    memory_set(RAM, 0x00001000, 5);
+    memory_set(RAM, 0x80000000, 6);
+    memory_reset(RAM);
+
+    LONGS_EQUAL(0, memory_resident_pages(RAM));
+    LONGS_EQUAL(0, memory_get(RAM, 0x00001000));
+    LONGS_EQUAL(0, memory_get(RAM, 0x80000000));
+}
+
+TEST(MEMORY_TESTS, addresses_past_the_end_of_small_memories_are_ignored)
+{
+    memory_t* small_RAM = make_memory(WORDS_PER_PAGE);
+    memory_set(small_RAM, WORDS_PER_PAGE, 9);
+    LONGS_EQUAL(0, memory_get(small_RAM, WORDS_PER_PAGE));
+    LONGS_EQUAL(0, memory_resident_pages(small_RAM));
+    destroy_memory(small_RAM);
+}
+
+TEST(MEMORY_TESTS, hash_only_depends_on_contents)
+{
+    memory_t* other_RAM = make_memory(WORDS_PER_PAGE * 4);
+    memory_set(RAM, 100, 1);
+    memory_set(RAM, 2000, 2);
+    memory_set(other_RAM, 2000, 2);
+    memory_set(other_RAM, 100, 1);
+    CHECK(memory_hash(RAM) == memory_hash(other_RAM));
+
+    memory_set(other_RAM, 100, 3);
+    CHECK(memory_hash(RAM) != memory_hash(other_RAM));
+    destroy_memory(other_RAM);
+}
+
+TEST(MEMORY_TESTS, block_reads_span_pages_without_allocating_any)
+{
+    //the block starts near the end of one page, skips an untouched page and
+    //finishes in a third one
+    const uint32_t START = 3 * WORDS_PER_PAGE - 2;
+    memory_set(RAM, START, 11);
+    memory_set(RAM, START + 1, 22);
+    memory_set(RAM, START + 2 * WORDS_PER_PAGE + 2, 33);
+    size_t resident_pages = memory_resident_pages(RAM);
+
+    static uint32_t values[2 * WORDS_PER_PAGE + 3];
+    for(size_t i = 0; i < sizeof(values) / sizeof(values[0]); i++)
+    {
+        values[i] = 0xAAAAAAAA;
+    }
+    memory_read_block(RAM, START, values, sizeof(values) / sizeof(values[0]));
+
+    LONGS_EQUAL(11, values[0]);
+    LONGS_EQUAL(22, values[1]);
+    LONGS_EQUAL(0, values[2]);
+    LONGS_EQUAL(0, values[WORDS_PER_PAGE + 2]);
+    LONGS_EQUAL(33, values[2 * WORDS_PER_PAGE + 2]);
+    LONGS_EQUAL(resident_pages, memory_resident_pages(RAM));
+}
+
+TEST(MEMORY_TESTS, only_pages_with_something_in_them_are_saved)
+{
+    memory_set(RAM, 5, 0x12345678);
+    memory_set(RAM, 0xFFFFFFFF, 42);
+    memory_get_page(RAM, 7 * WORDS_PER_PAGE);   //allocated, but empty
+    for(uint32_t i = 0; i < WORDS_PER_PAGE; i++)
+    {
+        memory_set(RAM, 9 * WORDS_PER_PAGE + i, i * 2654435761u);
+    }
+
+    for(int compress = 0; compress < 2; compress++)
+    {
+        memory_t* restored = save_and_restore(compress);
+        LONGS_EQUAL(3, memory_resident_pages(restored));
+        CHECK(memory_hash(RAM) == memory_hash(restored));
+        LONGS_EQUAL(42, memory_get(restored, 0xFFFFFFFF));
+        destroy_memory(restored);
+    }
+}
+
+TEST(MEMORY_TESTS, damaged_state_is_rejected)
+{
+    memory_set(RAM, 5, 1);
+    state_writer_t* writer = state_writer_create(MEMORY_STATE_PATH);
+    memory_save_state(RAM, writer, false);
+    state_writer_close(writer);
+
+    //cut the page off part way through
+    FILE* file = fopen(MEMORY_STATE_PATH, "rb");
+    static uint8_t image[8 * WORDS_PER_PAGE];
+    size_t size = fread(image, 1, sizeof(image), file);
+    fclose(file);
+    file = fopen(MEMORY_STATE_PATH, "wb");
+    fwrite(image, 1, size - 4, file);
+    fclose(file);
+
+    memory_t* restored = make_memory(FULL_ADDRESS_SPACE);
+    state_reader_t* reader = state_reader_open(MEMORY_STATE_PATH);
+    memory_restore_state(restored, reader);
+    CHECK(state_reader_failed(reader));
+    state_reader_close(reader);
+    destroy_memory(restored);
+}
@@ -701,6 +701,13 @@ TEST(PREPROCESSOR_ASSEMBLER_TESTS, returni_instruction_encoded_correctly)
     CHECK( RETURNI == 0x58000000 );
 }
 
+//WFI instruction Test
+TEST(PREPROCESSOR_ASSEMBLER_TESTS, wfi_instruction_encoded_correctly)
+{
+    CHECK( WFI == 0x5C000000 );
+    CHECK( HALT == WFI );
+}
+
 //SHIFTL instruction tests
 TEST(PREPROCESSOR_ASSEMBLER_TESTS, shiftl_encodes_destination_properly)
 {
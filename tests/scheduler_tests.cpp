@@ -0,0 +1,188 @@
+#include "CppUTest/TestHarness.h"
+
+extern "C"
+{
+#include <stdio.h>
+#include "scheduler.h"
+}
+
+scheduler_t* scheduler;
+
+//records the order that events ran in
+static uint64_t fired_cycles[64];
+static uintptr_t fired_tags[64];
+static size_t num_fired;
+
+static void record_event(void* context, uint64_t cycle)
+{
+    fired_cycles[num_fired] = cycle;
+    fired_tags[num_fired] = (uintptr_t)context;
+    num_fired++;
+}
+
+//schedules another event 10 cycles after itself, until it has run 3 times
+static void reschedule_event(void* context, uint64_t cycle)
+{
+    record_event(context, cycle);
+    if(num_fired < 3)
+    {
+        scheduler_add_event(scheduler, cycle + 10, &reschedule_event, context);
+    }
+}
+
+TEST_GROUP(SCHEDULER_TESTS)
+{
+
+    void setup(void)
+    {
+        scheduler = make_scheduler();
+        num_fired = 0;
+    }
+
+    void teardown(void)
+    {
+        destroy_scheduler(scheduler);
+    }
+
+    void add_tagged_event(uint64_t cycle, uintptr_t tag)
+    {
+        scheduler_add_event(scheduler, cycle, &record_event, (void*)tag);
+    }
+};
+
+
+TEST(SCHEDULER_TESTS, scheduler_is_empty_on_creation)
+{
+    LONGS_EQUAL(0, scheduler_num_events(scheduler));
+    CHECK(NO_EVENT_SCHEDULED == scheduler_next_event_cycle(scheduler));
+}
+
+TEST(SCHEDULER_TESTS, next_event_is_the_earliest_one)
+{
+    add_tagged_event(500, 1);
+    add_tagged_event(20, 2);
+    add_tagged_event(300, 3);
+
+    LONGS_EQUAL(3, scheduler_num_events(scheduler));
+    LONGS_EQUAL(20, scheduler_next_event_cycle(scheduler));
+}
+
+TEST(SCHEDULER_TESTS, only_events_that_are_due_get_run)
+{
+    add_tagged_event(100, 1);
+    add_tagged_event(200, 2);
+
+    scheduler_run_due_events(scheduler, 99);
+    LONGS_EQUAL(0, num_fired);
+
+    scheduler_run_due_events(scheduler, 150);
+    LONGS_EQUAL(1, num_fired);
+    LONGS_EQUAL(100, fired_cycles[0]);
+    LONGS_EQUAL(200, scheduler_next_event_cycle(scheduler));
+}
+
+TEST(SCHEDULER_TESTS, events_run_in_cycle_order_and_ties_run_in_the_order_they_were_added)
+{
+    const uint64_t cycles[] = { 70, 10, 40, 10, 90, 40, 30, 10 };
+    for(uintptr_t i = 0; i < sizeof(cycles) / sizeof(cycles[0]); i++)
+    {
+        add_tagged_event(cycles[i], i);
+    }
+
+    scheduler_run_due_events(scheduler, 1000);
+
+    const uintptr_t expected_order[] = { 1, 3, 7, 6, 2, 5, 0, 4 };
+    LONGS_EQUAL(8, num_fired);
+    for(size_t i = 0; i < num_fired; i++)
+    {
+        LONGS_EQUAL(expected_order[i], fired_tags[i]);
+    }
+    LONGS_EQUAL(0, scheduler_num_events(scheduler));
+}
+
+TEST(SCHEDULER_TESTS, cancelled_events_never_run)
+{
+    add_tagged_event(10, 1);
+    event_id_t id = scheduler_add_event(scheduler, 20, &record_event, (void*)2);
+    add_tagged_event(30, 3);
+
+    CHECK(scheduler_cancel_event(scheduler, id));
+    scheduler_run_due_events(scheduler, 100);
+
+    LONGS_EQUAL(2, num_fired);
+    LONGS_EQUAL(1, fired_tags[0]);
+    LONGS_EQUAL(3, fired_tags[1]);
+}
+
+TEST(SCHEDULER_TESTS, events_can_only_be_cancelled_once)
+{
+    event_id_t id = scheduler_add_event(scheduler, 20, &record_event, NULL);
+    CHECK(scheduler_cancel_event(scheduler, id));
+    CHECK_FALSE(scheduler_cancel_event(scheduler, id));
+    CHECK_FALSE(scheduler_cancel_event(scheduler, NO_EVENT_ID));
+}
+
+TEST(SCHEDULER_TESTS, stale_ids_do_not_cancel_a_new_event_in_the_same_slot)
+{
+    event_id_t old_id = scheduler_add_event(scheduler, 20, &record_event, (void*)1);
+    scheduler_run_due_events(scheduler, 20);
+    add_tagged_event(40, 2);
+
+    CHECK_FALSE(scheduler_cancel_event(scheduler, old_id));
+    LONGS_EQUAL(1, scheduler_num_events(scheduler));
+}
+
+TEST(SCHEDULER_TESTS, callbacks_can_schedule_more_events)
+{
+    scheduler_add_event(scheduler, 5, &reschedule_event, NULL);
+
+    scheduler_run_due_events(scheduler, 15);
+    LONGS_EQUAL(2, num_fired);
+    LONGS_EQUAL(25, scheduler_next_event_cycle(scheduler));
+
+    scheduler_run_due_events(scheduler, 100);
+    LONGS_EQUAL(3, num_fired);
+    LONGS_EQUAL(25, fired_cycles[2]);
+    LONGS_EQUAL(0, scheduler_num_events(scheduler));
+}
+
+TEST(SCHEDULER_TESTS, lots_of_events_come_out_in_order)
+{
+    //a simple LCG so that the cycles are scrambled but repeatable
+    uint32_t random = 12345;
+    event_id_t ids[200];
+    for(int i = 0; i < 200; i++)
+    {
+        random = random * 1103515245 + 12345;
+        ids[i] = scheduler_add_event(scheduler, random % 1000, &record_event, NULL);
+    }
+    for(int i = 0; i < 200; i += 5)
+    {
+        CHECK(scheduler_cancel_event(scheduler, ids[i]));
+    }
+
+    uint64_t last_cycle = 0;
+    size_t total_fired = 0;
+    while(0 != scheduler_num_events(scheduler))
+    {
+        num_fired = 0;
+        uint64_t next = scheduler_next_event_cycle(scheduler);
+        CHECK(next >= last_cycle);
+        scheduler_run_due_events(scheduler, next);
+        total_fired += num_fired;
+        last_cycle = next;
+    }
+    LONGS_EQUAL(160, total_fired);
+}
+
+TEST(SCHEDULER_TESTS, reset_drops_every_event)
+{
+    event_id_t id = scheduler_add_event(scheduler, 20, &record_event, NULL);
+    add_tagged_event(30, 1);
+    scheduler_reset(scheduler);
+
+    LONGS_EQUAL(0, scheduler_num_events(scheduler));
+    CHECK_FALSE(scheduler_cancel_event(scheduler, id));
+    scheduler_run_due_events(scheduler, 100);
+    LONGS_EQUAL(0, num_fired);
+}
@@ -0,0 +1,117 @@
+#include "CppUTest/TestHarness.h"
+
+extern "C"
+{
+#include <stdio.h>
+#include <pthread.h>
+#include "spsc_queue.h"
+}
+
+spsc_queue_t* spsc_queue;
+
+TEST_GROUP(SPSC_QUEUE_TESTS)
+{
+
+    void setup(void)
+    {
+        spsc_queue = spsc_queue_create(100);
+    }
+
+    void teardown(void)
+    {
+        spsc_queue_destroy(spsc_queue);
+    }
+};
+
+
+TEST(SPSC_QUEUE_TESTS, queue_is_empty_on_creation)
+{
+    uint32_t value = 0;
+    CHECK(spsc_queue_is_empty(spsc_queue));
+    CHECK_FALSE(spsc_queue_get(spsc_queue, &value));
+}
+
+TEST(SPSC_QUEUE_TESTS, queue_size_is_rounded_up_to_a_power_of_two)
+{
+    LONGS_EQUAL(128, spsc_queue_get_size(spsc_queue));
+    POINTERS_EQUAL(NULL, spsc_queue_create(0));
+}
+
+TEST(SPSC_QUEUE_TESTS, values_come_out_in_the_order_they_went_in)
+{
+    for(uint32_t i = 0; i < 10; i++)
+    {
+        CHECK(spsc_queue_put(spsc_queue, i * 1000));
+    }
+
+    uint32_t value = 0;
+    for(uint32_t i = 0; i < 10; i++)
+    {
+        CHECK(spsc_queue_get(spsc_queue, &value));
+        LONGS_EQUAL(i * 1000, value);
+    }
+    CHECK(spsc_queue_is_empty(spsc_queue));
+}
+
+TEST(SPSC_QUEUE_TESTS, full_queue_drops_new_values)
+{
+    for(uint32_t i = 0; i < spsc_queue_get_size(spsc_queue); i++)
+    {
+        CHECK(spsc_queue_put(spsc_queue, i));
+    }
+    CHECK_FALSE(spsc_queue_put(spsc_queue, 0xDEADBEEF));
+
+    uint32_t value = 0;
+    CHECK(spsc_queue_get(spsc_queue, &value));
+    LONGS_EQUAL(0, value);
+    CHECK(spsc_queue_put(spsc_queue, 0xDEADBEEF));
+}
+
+TEST(SPSC_QUEUE_TESTS, queue_wraps_around_many_times)
+{
+    uint32_t value = 0;
+    for(uint32_t i = 0; i < 1000; i++)
+    {
+        CHECK(spsc_queue_put(spsc_queue, i));
+        CHECK(spsc_queue_put(spsc_queue, i + 1));
+        CHECK(spsc_queue_get(spsc_queue, &value));
+        CHECK(spsc_queue_get(spsc_queue, &value));
+        LONGS_EQUAL(i + 1, value);
+    }
+    CHECK(spsc_queue_is_empty(spsc_queue));
+}
+
+static const uint32_t NUM_VALUES_FROM_PRODUCER = 200000;
+
+static void* produce_values(void* context)
+{
+    spsc_queue_t* queue = (spsc_queue_t*)context;
+    for(uint32_t i = 0; i < NUM_VALUES_FROM_PRODUCER;)
+    {
+        if(spsc_queue_put(queue, i))
+        {
+            i++;
+        }
+    }
+    return NULL;
+}
+
+TEST(SPSC_QUEUE_TESTS, nothing_is_lost_or_reordered_between_threads)
+{
+    pthread_t producer;
+    pthread_create(&producer, NULL, &produce_values, spsc_queue);
+
+    uint32_t expected = 0;
+    uint32_t value = 0;
+    while(expected < NUM_VALUES_FROM_PRODUCER)
+    {
+        if(spsc_queue_get(spsc_queue, &value))
+        {
+            LONGS_EQUAL(expected, value);
+            expected++;
+        }
+    }
+
+    pthread_join(producer, NULL);
+    CHECK(spsc_queue_is_empty(spsc_queue));
+}
@@ -0,0 +1,90 @@
+#include "CppUTest/TestHarness.h"
+
+extern "C"
+{
+#include <stdio.h>
+#include "state_file.h"
+}
+
+static const char* STATE_PATH = "state_file_tests.state";
+
+TEST_GROUP(STATE_FILE_TESTS)
+{
+
+    void setup(void)
+    {
+    }
+
+    void teardown(void)
+    {
+        remove(STATE_PATH);
+    }
+};
+
+
+TEST(STATE_FILE_TESTS, values_read_back_in_the_order_they_were_written)
+{
+    const uint32_t words[] = { 1, 2, 3 };
+    state_writer_t* writer = state_writer_create(STATE_PATH);
+    CHECK(writer != NULL);
+    state_write_u8(writer, 0xAB);
+    state_writer_align(writer, 16);
+    state_write_u32(writer, 0xDEADBEEF);
+    state_write_u64(writer, 0x0123456789ABCDEFull);
+    state_write_words(writer, words, 3);
+    CHECK(state_writer_close(writer));
+
+    uint32_t read_words[3];
+    state_reader_t* reader = state_reader_open(STATE_PATH);
+    CHECK(reader != NULL);
+    LONGS_EQUAL(0xAB, state_read_u8(reader));
+    state_reader_align(reader, 16);
+    LONGS_EQUAL(0xDEADBEEF, state_read_u32(reader));
+    CHECK(0x0123456789ABCDEFull == state_read_u64(reader));
+    state_read_words(reader, read_words, 3);
+    MEMCMP_EQUAL(words, read_words, sizeof(words));
+    CHECK(state_reader_at_end(reader));
+    CHECK_FALSE(state_reader_failed(reader));
+    state_reader_close(reader);
+}
+
+TEST(STATE_FILE_TESTS, runs_of_words_are_encoded_as_pairs)
+{
+    const uint32_t words[] = { 0, 0, 0, 0, 7, 7, 9, 0, 0, 0 };
+    const size_t count = sizeof(words) / sizeof(words[0]);
+    LONGS_EQUAL(8, state_rle_length(words, count));
+
+    state_writer_t* writer = state_writer_create(STATE_PATH);
+    state_write_rle(writer, words, count);
+    state_writer_close(writer);
+
+    uint32_t decoded[sizeof(words) / sizeof(words[0])];
+    state_reader_t* reader = state_reader_open(STATE_PATH);
+    state_read_rle(reader, decoded, count, 8);
+    MEMCMP_EQUAL(words, decoded, sizeof(words));
+    CHECK_FALSE(state_reader_failed(reader));
+    state_reader_close(reader);
+
+    //the runs have to add up to exactly the size of the block
+    reader = state_reader_open(STATE_PATH);
+    state_read_rle(reader, decoded, count - 1, 8);
+    CHECK(state_reader_failed(reader));
+    state_reader_close(reader);
+}
+
+TEST(STATE_FILE_TESTS, reading_past_the_end_fails_for_good)
+{
+    state_writer_t* writer = state_writer_create(STATE_PATH);
+    state_write_u32(writer, 5);
+    state_writer_close(writer);
+
+    state_reader_t* reader = state_reader_open(STATE_PATH);
+    LONGS_EQUAL(5, state_read_u32(reader));
+    LONGS_EQUAL(0, state_read_u8(reader));
+    CHECK(state_reader_failed(reader));
+    CHECK_FALSE(state_reader_check(reader, true));
+    state_reader_close(reader);
+
+    remove(STATE_PATH);
+    POINTERS_EQUAL(NULL, state_reader_open(STATE_PATH));
+}
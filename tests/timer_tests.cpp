@@ -0,0 +1,175 @@
+#include "CppUTest/TestHarness.h"
+
+extern "C"
+{
+#include <stdio.h>
+#include "timer.h"
+#include "memory_bus.h"
+#include "memory_map.h"
+#include "scheduler.h"
+#include "interrupt_controller.h"
+}
+
+static const uint32_t ON = 1u << 0;
+static const uint32_t INTERRUPT_ENABLE = 1u << 1;
+static const uint32_t OVERFLOW_FLAG = 1u << 2;
+
+timer_t* timer;
+memory_bus_t* timer_bus;
+scheduler_t* timer_scheduler;
+interrupt_controller_t* timer_ic;
+
+TEST_GROUP(TIMER_TESTS)
+{
+
+    void setup(void)
+    {
+        timer_bus = make_memory_bus();
+        bus_map_device(timer_bus, TIMER_SELECTED, TIMER_REGION_START, TIMER_REGION_END);
+        timer_scheduler = make_scheduler();
+        timer_ic = make_interrupt_controller(INTERRUPT_VECTOR_TABLE_START);
+        timer = make_timer(IRQ_1, timer_scheduler, timer_ic);
+        timer_start(timer, 0);
+    }
+
+    void teardown(void)
+    {
+        destroy_timer(timer);
+        destroy_interrupt_controller(timer_ic);
+        destroy_scheduler(timer_scheduler);
+        destroy_memory_bus(timer_bus);
+    }
+
+    uint32_t access_register(timer_register_t reg, bool write, uint32_t value, uint64_t cycle)
+    {
+        bus_enable(timer_bus);
+        bus_set_address_lines(timer_bus, TIMER_REGION_START + reg);
+        if(write)
+        {
+            bus_set_write_operation(timer_bus);
+            bus_set_data_lines(timer_bus, value);
+        }
+        else
+        {
+            bus_set_read_operation(timer_bus);
+        }
+        bus_cycle(timer_bus);
+        timer_cycle(timer, timer_bus, cycle);
+        CHECK(bus_is_device_ready(timer_bus));
+
+        value = bus_get_data_lines(timer_bus);
+        bus_disable(timer_bus);
+        bus_cycle(timer_bus);
+        return value;
+    }
+
+    uint32_t read_register(timer_register_t reg, uint64_t cycle)
+    {
+        return access_register(reg, false, 0, cycle);
+    }
+
+    void write_register(timer_register_t reg, uint32_t value, uint64_t cycle)
+    {
+        access_register(reg, true, value, cycle);
+    }
+};
+
+
+TEST(TIMER_TESTS, timer_counts_every_cycle_without_prescaling)
+{
+    write_register(TIMER_PRESCALE_REGISTER, 0, 0);
+    write_register(TIMER_VALUE_REGISTER, 100, 0);
+
+    LONGS_EQUAL(100, read_register(TIMER_VALUE_REGISTER, 0));
+    LONGS_EQUAL(137, read_register(TIMER_VALUE_REGISTER, 37));
+    LONGS_EQUAL(100 + 5000000, read_register(TIMER_VALUE_REGISTER, 5000000));
+}
+
+TEST(TIMER_TESTS, prescaled_timer_counts_once_per_prescale_period)
+{
+    write_register(TIMER_PRESCALE_REGISTER, 4, 0);
+    write_register(TIMER_VALUE_REGISTER, 0, 0);
+
+    LONGS_EQUAL(0, read_register(TIMER_VALUE_REGISTER, 4));
+    LONGS_EQUAL(1, read_register(TIMER_VALUE_REGISTER, 5));
+    LONGS_EQUAL(2, read_register(TIMER_VALUE_REGISTER, 10));
+    LONGS_EQUAL(250, read_register(TIMER_VALUE_REGISTER, 1001));
+}
+
+//steps a model of the prescaler one cycle at a time and makes sure that
+//syncing the timer at irregular intervals always agrees with it
+TEST(TIMER_TESTS, syncing_at_any_point_matches_counting_every_cycle)
+{
+    const uint32_t PRESCALE = 7;
+    write_register(TIMER_PRESCALE_REGISTER, PRESCALE, 0);
+    write_register(TIMER_VALUE_REGISTER, 0, 0);
+
+    uint32_t expected_value = 0;
+    uint32_t prescale_counter = 0;
+    uint64_t next_read = 1;
+    for(uint64_t cycle = 1; cycle <= 2000; cycle++)
+    {
+        if(prescale_counter < PRESCALE)
+        {
+            prescale_counter++;
+        }
+        else
+        {
+            prescale_counter = 1;
+            expected_value++;
+        }
+
+        if(cycle == next_read)
+        {
+            LONGS_EQUAL(expected_value, read_register(TIMER_VALUE_REGISTER, cycle));
+            next_read += 1 + (cycle % 13);
+        }
+    }
+}
+
+TEST(TIMER_TESTS, overflow_is_scheduled_and_raises_an_interrupt)
+{
+    write_register(TIMER_PRESCALE_REGISTER, 0, 100);
+    write_register(TIMER_VALUE_REGISTER, UINT32_MAX - 9, 100);
+    write_register(TIMER_CONTROL_REGISTER, ON | INTERRUPT_ENABLE, 100);
+
+    LONGS_EQUAL(110, scheduler_next_event_cycle(timer_scheduler));
+    scheduler_run_due_events(timer_scheduler, 109);
+    CHECK_FALSE(interrupt_requested(timer_ic));
+
+    scheduler_run_due_events(timer_scheduler, 110);
+    CHECK(interrupt_requested(timer_ic));
+    LONGS_EQUAL(IRQ_1, get_interrupt_source(timer_ic));
+    LONGS_EQUAL(ON | INTERRUPT_ENABLE | OVERFLOW_FLAG, read_register(TIMER_CONTROL_REGISTER, 110));
+    LONGS_EQUAL(0, read_register(TIMER_VALUE_REGISTER, 110));
+
+    //and the next overflow is a full trip around the counter away
+    CHECK(110 + (1ull << 32) == scheduler_next_event_cycle(timer_scheduler));
+}
+
+TEST(TIMER_TESTS, overflow_flag_can_only_be_cleared_by_software)
+{
+    write_register(TIMER_VALUE_REGISTER, UINT32_MAX, 0);
+    write_register(TIMER_CONTROL_REGISTER, ON | OVERFLOW_FLAG, 0);
+    LONGS_EQUAL(ON, read_register(TIMER_CONTROL_REGISTER, 0));
+
+    scheduler_run_due_events(timer_scheduler, 1);
+    LONGS_EQUAL(ON | OVERFLOW_FLAG, read_register(TIMER_CONTROL_REGISTER, 1));
+    CHECK_FALSE(interrupt_requested(timer_ic));
+
+    write_register(TIMER_CONTROL_REGISTER, ON, 2);
+    LONGS_EQUAL(ON, read_register(TIMER_CONTROL_REGISTER, 2));
+}
+
+TEST(TIMER_TESTS, stopped_timer_holds_its_value_and_schedules_nothing)
+{
+    write_register(TIMER_VALUE_REGISTER, 1234, 0);
+    write_register(TIMER_CONTROL_REGISTER, 0, 10);
+
+    LONGS_EQUAL(0, scheduler_num_events(timer_scheduler));
+    LONGS_EQUAL(1244, read_register(TIMER_VALUE_REGISTER, 1000000));
+
+    write_register(TIMER_CONTROL_REGISTER, ON, 2000000);
+    LONGS_EQUAL(1, scheduler_num_events(timer_scheduler));
+    LONGS_EQUAL(1254, read_register(TIMER_VALUE_REGISTER, 2000010));
+}
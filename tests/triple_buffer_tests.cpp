@@ -0,0 +1,130 @@
+#include "CppUTest/TestHarness.h"
+
+extern "C"
+{
+#include <stdio.h>
+#include <pthread.h>
+#include "triple_buffer.h"
+}
+
+triple_buffer_t* triple_buffer;
+
+TEST_GROUP(TRIPLE_BUFFER_TESTS)
+{
+
+    void setup(void)
+    {
+        triple_buffer = triple_buffer_create(sizeof(uint32_t));
+    }
+
+    void teardown(void)
+    {
+        triple_buffer_destroy(triple_buffer);
+    }
+
+    void publish(uint32_t value)
+    {
+        *(uint32_t*)triple_buffer_get_back_buffer(triple_buffer) = value;
+        triple_buffer_publish(triple_buffer);
+    }
+
+    uint32_t get_latest(bool* is_new)
+    {
+        return *(const uint32_t*)triple_buffer_get_latest(triple_buffer, is_new);
+    }
+};
+
+
+TEST(TRIPLE_BUFFER_TESTS, nothing_new_before_the_first_publish)
+{
+    bool is_new = true;
+    LONGS_EQUAL(0, get_latest(&is_new));
+    CHECK_FALSE(is_new);
+}
+
+TEST(TRIPLE_BUFFER_TESTS, consumer_sees_what_was_published)
+{
+    bool is_new = false;
+    publish(42);
+    LONGS_EQUAL(42, get_latest(&is_new));
+    CHECK(is_new);
+
+    //and keeps seeing it until something else is published
+    LONGS_EQUAL(42, get_latest(&is_new));
+    CHECK_FALSE(is_new);
+}
+
+TEST(TRIPLE_BUFFER_TESTS, consumer_only_sees_the_latest_of_several_publishes)
+{
+    bool is_new = false;
+    publish(1);
+    publish(2);
+    publish(3);
+    LONGS_EQUAL(3, get_latest(&is_new));
+    CHECK(is_new);
+}
+
+TEST(TRIPLE_BUFFER_TESTS, producer_never_gets_the_buffer_the_consumer_is_reading)
+{
+    bool is_new = false;
+    publish(7);
+    const void* front = triple_buffer_get_latest(triple_buffer, &is_new);
+    for(int i = 0; i < 10; i++)
+    {
+        CHECK(front != triple_buffer_get_back_buffer(triple_buffer));
+        publish(100 + i);
+    }
+    LONGS_EQUAL(7, *(const uint32_t*)front);
+}
+
+//every snapshot is a counter repeated across the whole buffer, so a torn
+//read would show up as a mix of two counters
+struct snapshot_t
+{
+    uint32_t values[64];
+};
+
+static const uint32_t NUM_SNAPSHOTS = 50000;
+
+static void* publish_snapshots(void* context)
+{
+    triple_buffer_t* buffer = (triple_buffer_t*)context;
+    for(uint32_t counter = 1; counter <= NUM_SNAPSHOTS; counter++)
+    {
+        snapshot_t* snapshot = (snapshot_t*)triple_buffer_get_back_buffer(buffer);
+        for(int i = 0; i < 64; i++)
+        {
+            snapshot->values[i] = counter;
+        }
+        triple_buffer_publish(buffer);
+    }
+    return NULL;
+}
+
+TEST(TRIPLE_BUFFER_TESTS, snapshots_are_never_torn_or_seen_out_of_order)
+{
+    triple_buffer_t* buffer = triple_buffer_create(sizeof(snapshot_t));
+    pthread_t producer;
+    pthread_create(&producer, NULL, &publish_snapshots, buffer);
+
+    uint32_t last_counter = 0;
+    while(last_counter < NUM_SNAPSHOTS)
+    {
+        bool is_new = false;
+        const snapshot_t* snapshot = (const snapshot_t*)triple_buffer_get_latest(buffer, &is_new);
+        if(!is_new)
+        {
+            continue;
+        }
+
+        CHECK(snapshot->values[0] > last_counter);
+        for(int i = 1; i < 64; i++)
+        {
+            LONGS_EQUAL(snapshot->values[0], snapshot->values[i]);
+        }
+        last_counter = snapshot->values[0];
+    }
+
+    pthread_join(producer, NULL);
+    triple_buffer_destroy(buffer);
+}